@@ -32,12 +32,15 @@ For discussion please visit http://www.box2d.org/forum
 // These include files constitute the main Box2D API
 
 #include "../Source/Common/b2Settings.h"
+#include "../Source/Common/b2Allocator.h"
+#include "../Source/Common/b2Timer.h"
 
 #include "../Source/Collision/Shapes/b2CircleShape.h"
 #include "../Source/Collision/Shapes/b2PolygonShape.h"
 #include "../Source/Collision/b2BroadPhase.h"
 #include "../Source/Dynamics/b2WorldCallbacks.h"
 #include "../Source/Dynamics/b2World.h"
+#include "../Source/Dynamics/b2WorldSnapshot.h"
 #include "../Source/Dynamics/b2Body.h"
 
 #include "../Source/Dynamics/Contacts/b2Contact.h"
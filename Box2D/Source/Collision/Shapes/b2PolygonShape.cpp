@@ -430,6 +430,11 @@ b2Vec2 b2PolygonShape::Centroid(const b2XForm& xf) const
 }
 
 b2Vec2 b2PolygonShape::Support(const b2XForm& xf, const b2Vec2& d) const
+{
+	return b2Mul(xf, m_coreVertices[GetSupport(xf, d)]);
+}
+
+int32 b2PolygonShape::GetSupport(const b2XForm& xf, const b2Vec2& d) const
 {
 	b2Vec2 dLocal = b2MulT(xf.R, d);
 
@@ -445,5 +450,5 @@ b2Vec2 b2PolygonShape::Support(const b2XForm& xf, const b2Vec2& d) const
 		}
 	}
 
-	return b2Mul(xf, m_coreVertices[bestIndex]);
+	return bestIndex;
 }
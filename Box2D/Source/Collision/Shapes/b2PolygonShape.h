@@ -106,6 +106,12 @@ public:
 	/// Use the supplied transform.
 	b2Vec2 Support(const b2XForm& xf, const b2Vec2& d) const;
 
+	/// Get the index of the core vertex that is the support point.
+	int32 GetSupport(const b2XForm& xf, const b2Vec2& d) const;
+
+	/// Get a core vertex and apply the supplied transform.
+	b2Vec2 GetCoreVertex(const b2XForm& xf, int32 index) const;
+
 private:
 
 	friend class b2Shape;
@@ -130,6 +136,12 @@ inline b2Vec2 b2PolygonShape::GetFirstVertex(const b2XForm& xf) const
 	return b2Mul(xf, m_coreVertices[0]);
 }
 
+inline b2Vec2 b2PolygonShape::GetCoreVertex(const b2XForm& xf, int32 index) const
+{
+	b2Assert(0 <= index && index < m_vertexCount);
+	return b2Mul(xf, m_coreVertices[index]);
+}
+
 inline const b2OBB& b2PolygonShape::GetOBB() const
 {
 	return m_obb;
@@ -66,6 +66,38 @@ void b2Shape::Destroy(b2Shape* s, b2BlockAllocator* allocator)
 	}
 }
 
+int32 b2Shape::GetByteSize(b2ShapeType type)
+{
+	switch (type)
+	{
+	case e_circleShape:
+		return sizeof(b2CircleShape);
+
+	case e_polygonShape:
+		return sizeof(b2PolygonShape);
+
+	default:
+		b2Assert(false);
+		return 0;
+	}
+}
+
+b2Shape* b2Shape::Copy(const b2Shape* shape, void* mem)
+{
+	switch (shape->GetType())
+	{
+	case e_circleShape:
+		return new (mem) b2CircleShape(*(const b2CircleShape*)shape);
+
+	case e_polygonShape:
+		return new (mem) b2PolygonShape(*(const b2PolygonShape*)shape);
+
+	default:
+		b2Assert(false);
+		return NULL;
+	}
+}
+
 b2Shape::b2Shape(const b2ShapeDef* def)
 {
 	m_userData = def->userData;
@@ -133,7 +165,7 @@ bool b2Shape::Synchronize(b2BroadPhase* broadPhase, const b2XForm& transform1, c
 
 	if (broadPhase->InRange(aabb))
 	{
-		broadPhase->MoveProxy(m_proxyId, aabb);
+		broadPhase->MoveProxy(m_proxyId, aabb, transform2.position - transform1.position);
 		return true;
 	}
 	else
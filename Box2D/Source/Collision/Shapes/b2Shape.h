@@ -198,6 +198,11 @@ protected:
 	static b2Shape* Create(const b2ShapeDef* def, b2BlockAllocator* allocator);
 	static void Destroy(b2Shape* shape, b2BlockAllocator* allocator);
 
+	// Used by world snapshots: the size of a shape of the given type and an
+	// exact copy of a shape (pointers included) constructed in place at mem.
+	static int32 GetByteSize(b2ShapeType type);
+	static b2Shape* Copy(const b2Shape* shape, void* mem);
+
 	b2Shape(const b2ShapeDef* def);
 	virtual ~b2Shape();
 
@@ -219,7 +224,7 @@ protected:
 	float32 m_friction;
 	float32 m_restitution;
 
-	uint16 m_proxyId;
+	int32 m_proxyId;
 	b2FilterData m_filter;
 
 	bool m_isSensor;
@@ -23,7 +23,7 @@
 // Notes:
 // - we use bound arrays instead of linked lists for cache coherence.
 // - we use quantized integral values for fast compares.
-// - we use short indices rather than pointers to save memory.
+// - we use 32-bit indices rather than pointers to save memory.
 // - we use a stabbing count for fast overlap queries (less than order N).
 // - we also use a time stamp on each proxy to speed up the registration of
 //   overlap query results.
@@ -57,16 +57,18 @@ static int32 BinarySearch(b2Bound* bounds, int32 count, uint16 value)
 		}
 		else
 		{
-			return (uint16)mid;
+			return mid;
 		}
 	}
 	
 	return low;
 }
 
-b2BroadPhase::b2BroadPhase(const b2AABB& worldAABB, b2PairCallback* callback)
+b2BroadPhase::b2BroadPhase(const b2AABB& worldAABB, b2PairCallback* callback,
+						   b2BroadPhaseType type, int32 proxyCapacity, int32 pairCapacity)
 {
-	m_pairManager.Initialize(this, callback);
+	m_pairManager.Initialize(this, callback, pairCapacity);
+	m_type = type;
 
 	b2Assert(worldAABB.IsValid());
 	m_worldAABB = worldAABB;
@@ -76,30 +78,102 @@ b2BroadPhase::b2BroadPhase(const b2AABB& worldAABB, b2PairCallback* callback)
 	m_quantizationFactor.x = float32(B2BROADPHASE_MAX) / d.x;
 	m_quantizationFactor.y = float32(B2BROADPHASE_MAX) / d.y;
 
-	for (uint16 i = 0; i < b2_maxProxies - 1; ++i)
+	b2Assert(proxyCapacity > 0);
+	m_proxyCapacity = proxyCapacity;
+	m_proxyPool = (b2Proxy*)b2Alloc(m_proxyCapacity * sizeof(b2Proxy));
+	m_queryResults = (int32*)b2Alloc(m_proxyCapacity * sizeof(int32));
+
+	if (m_type == e_sweepAndPruneBroadPhase)
+	{
+		m_bounds[0] = (b2Bound*)b2Alloc(2 * m_proxyCapacity * sizeof(b2Bound));
+		m_bounds[1] = (b2Bound*)b2Alloc(2 * m_proxyCapacity * sizeof(b2Bound));
+	}
+	else
+	{
+		m_bounds[0] = NULL;
+		m_bounds[1] = NULL;
+	}
+
+	for (int32 i = 0; i < m_proxyCapacity - 1; ++i)
 	{
 		m_proxyPool[i].SetNext(i + 1);
 		m_proxyPool[i].timeStamp = 0;
 		m_proxyPool[i].overlapCount = b2_invalid;
 		m_proxyPool[i].userData = NULL;
+		m_proxyPool[i].treeId = b2_nullNode;
 	}
-	m_proxyPool[b2_maxProxies-1].SetNext(b2_nullProxy);
-	m_proxyPool[b2_maxProxies-1].timeStamp = 0;
-	m_proxyPool[b2_maxProxies-1].overlapCount = b2_invalid;
-	m_proxyPool[b2_maxProxies-1].userData = NULL;
+	m_proxyPool[m_proxyCapacity-1].SetNext(b2_nullProxy);
+	m_proxyPool[m_proxyCapacity-1].timeStamp = 0;
+	m_proxyPool[m_proxyCapacity-1].overlapCount = b2_invalid;
+	m_proxyPool[m_proxyCapacity-1].userData = NULL;
+	m_proxyPool[m_proxyCapacity-1].treeId = b2_nullNode;
 	m_freeProxy = 0;
 
 	m_timeStamp = 1;
 	m_queryResultCount = 0;
+
+	m_moveCapacity = 16;
+	m_moveCount = 0;
+	m_moveBuffer = (int32*)b2Alloc(m_moveCapacity * sizeof(int32));
+	m_queryProxyId = b2_nullProxy;
 }
 
 b2BroadPhase::~b2BroadPhase()
 {
+	b2Free(m_proxyPool);
+	b2Free(m_bounds[0]);
+	b2Free(m_bounds[1]);
+	b2Free(m_queryResults);
+	b2Free(m_moveBuffer);
+}
+
+// Only called when every proxy is in use, so the new proxies become the free list.
+// They are handed out in order, just as the tail of a fixed pool would be.
+void b2BroadPhase::Grow()
+{
+	b2Assert(m_freeProxy == b2_nullProxy && m_proxyCount == m_proxyCapacity);
+
+	int32 oldCapacity = m_proxyCapacity;
+	m_proxyCapacity = 2 * oldCapacity;
+
+	b2Proxy* proxyPool = (b2Proxy*)b2Alloc(m_proxyCapacity * sizeof(b2Proxy));
+	memcpy(proxyPool, m_proxyPool, oldCapacity * sizeof(b2Proxy));
+	b2Free(m_proxyPool);
+	m_proxyPool = proxyPool;
+
+	for (int32 axis = 0; axis < 2 && m_type == e_sweepAndPruneBroadPhase; ++axis)
+	{
+		b2Bound* bounds = (b2Bound*)b2Alloc(2 * m_proxyCapacity * sizeof(b2Bound));
+		memcpy(bounds, m_bounds[axis], 2 * m_proxyCount * sizeof(b2Bound));
+		b2Free(m_bounds[axis]);
+		m_bounds[axis] = bounds;
+	}
+
+	// Only used between a query and the next time stamp, so nothing to keep.
+	b2Assert(m_queryResultCount == 0);
+	b2Free(m_queryResults);
+	m_queryResults = (int32*)b2Alloc(m_proxyCapacity * sizeof(int32));
+
+	for (int32 i = oldCapacity; i < m_proxyCapacity; ++i)
+	{
+		m_proxyPool[i].SetNext(i + 1);
+		m_proxyPool[i].timeStamp = 0;
+		m_proxyPool[i].overlapCount = b2_invalid;
+		m_proxyPool[i].userData = NULL;
+		m_proxyPool[i].treeId = b2_nullNode;
+	}
+	m_proxyPool[m_proxyCapacity-1].SetNext(b2_nullProxy);
+	m_freeProxy = oldCapacity;
 }
 
 // This one is only used for validation.
 bool b2BroadPhase::TestOverlap(b2Proxy* p1, b2Proxy* p2)
 {
+	if (m_type == e_dynamicTreeBroadPhase)
+	{
+		return b2TestOverlap(m_tree.GetFatAABB(p1->treeId), m_tree.GetFatAABB(p2->treeId));
+	}
+
 	for (int32 axis = 0; axis < 2; ++axis)
 	{
 		b2Bound* bounds = m_bounds[axis];
@@ -160,7 +234,7 @@ void b2BroadPhase::IncrementTimeStamp()
 {
 	if (m_timeStamp == B2BROADPHASE_MAX)
 	{
-		for (uint16 i = 0; i < b2_maxProxies; ++i)
+		for (int32 i = 0; i < m_proxyCapacity; ++i)
 		{
 			m_proxyPool[i].timeStamp = 0;
 		}
@@ -183,8 +257,8 @@ void b2BroadPhase::IncrementOverlapCount(int32 proxyId)
 	else
 	{
 		proxy->overlapCount = 2;
-		b2Assert(m_queryResultCount < b2_maxProxies);
-		m_queryResults[m_queryResultCount] = (uint16)proxyId;
+		b2Assert(m_queryResultCount < m_proxyCapacity);
+		m_queryResults[m_queryResultCount] = proxyId;
 		++m_queryResultCount;
 	}
 }
@@ -235,12 +309,22 @@ void b2BroadPhase::Query(int32* lowerQueryOut, int32* upperQueryOut,
 	*upperQueryOut = upperQuery;
 }
 
-uint16 b2BroadPhase::CreateProxy(const b2AABB& aabb, void* userData)
+int32 b2BroadPhase::CreateProxy(const b2AABB& aabb, void* userData)
 {
-	b2Assert(m_proxyCount < b2_maxProxies);
+	if (m_type == e_dynamicTreeBroadPhase)
+	{
+		return CreateTreeProxy(aabb, userData);
+	}
+
+	if (m_freeProxy == b2_nullProxy)
+	{
+		Grow();
+	}
+
+	b2Assert(m_proxyCount < m_proxyCapacity);
 	b2Assert(m_freeProxy != b2_nullProxy);
 
-	uint16 proxyId = m_freeProxy;
+	int32 proxyId = m_freeProxy;
 	b2Proxy* proxy = m_proxyPool + proxyId;
 	m_freeProxy = proxy->GetNext();
 
@@ -285,23 +369,23 @@ uint16 b2BroadPhase::CreateProxy(const b2AABB& aabb, void* userData)
 			b2Proxy* proxy = m_proxyPool + bounds[index].proxyId;
 			if (bounds[index].IsLower())
 			{
-				proxy->lowerBounds[axis] = (uint16)index;
+				proxy->lowerBounds[axis] = index;
 			}
 			else
 			{
-				proxy->upperBounds[axis] = (uint16)index;
+				proxy->upperBounds[axis] = index;
 			}
 		}
 	}
 
 	++m_proxyCount;
 
-	b2Assert(m_queryResultCount < b2_maxProxies);
+	b2Assert(m_queryResultCount < m_proxyCapacity);
 
 	// Create pairs if the AABB is in range.
 	for (int32 i = 0; i < m_queryResultCount; ++i)
 	{
-		b2Assert(m_queryResults[i] < b2_maxProxies);
+		b2Assert(m_queryResults[i] < m_proxyCapacity);
 		b2Assert(m_proxyPool[m_queryResults[i]].IsValid());
 
 		m_pairManager.AddBufferedPair(proxyId, m_queryResults[i]);
@@ -323,7 +407,13 @@ uint16 b2BroadPhase::CreateProxy(const b2AABB& aabb, void* userData)
 
 void b2BroadPhase::DestroyProxy(int32 proxyId)
 {
-	b2Assert(0 < m_proxyCount && m_proxyCount <= b2_maxProxies);
+	if (m_type == e_dynamicTreeBroadPhase)
+	{
+		DestroyTreeProxy(proxyId);
+		return;
+	}
+
+	b2Assert(0 < m_proxyCount && m_proxyCount <= m_proxyCapacity);
 	b2Proxy* proxy = m_proxyPool + proxyId;
 	b2Assert(proxy->IsValid());
 
@@ -347,11 +437,11 @@ void b2BroadPhase::DestroyProxy(int32 proxyId)
 			b2Proxy* proxy = m_proxyPool + bounds[index].proxyId;
 			if (bounds[index].IsLower())
 			{
-				proxy->lowerBounds[axis] = (uint16)index;
+				proxy->lowerBounds[axis] = index;
 			}
 			else
 			{
-				proxy->upperBounds[axis] = (uint16)index;
+				proxy->upperBounds[axis] = index;
 			}
 		}
 
@@ -365,7 +455,7 @@ void b2BroadPhase::DestroyProxy(int32 proxyId)
 		Query(&lowerIndex, &upperIndex, lowerValue, upperValue, bounds, boundCount - 2, axis);
 	}
 
-	b2Assert(m_queryResultCount < b2_maxProxies);
+	b2Assert(m_queryResultCount < m_proxyCapacity);
 
 	for (int32 i = 0; i < m_queryResultCount; ++i)
 	{
@@ -388,7 +478,7 @@ void b2BroadPhase::DestroyProxy(int32 proxyId)
 	proxy->upperBounds[1] = b2_invalid;
 
 	proxy->SetNext(m_freeProxy);
-	m_freeProxy = (uint16)proxyId;
+	m_freeProxy = proxyId;
 	--m_proxyCount;
 
 	if (s_validate)
@@ -397,9 +487,9 @@ void b2BroadPhase::DestroyProxy(int32 proxyId)
 	}
 }
 
-void b2BroadPhase::MoveProxy(int32 proxyId, const b2AABB& aabb)
+void b2BroadPhase::MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement)
 {
-	if (proxyId == b2_nullProxy || b2_maxProxies <= proxyId)
+	if (proxyId == b2_nullProxy || m_proxyCapacity <= proxyId)
 	{
 		b2Assert(false);
 		return;
@@ -411,6 +501,12 @@ void b2BroadPhase::MoveProxy(int32 proxyId, const b2AABB& aabb)
 		return;
 	}
 
+	if (m_type == e_dynamicTreeBroadPhase)
+	{
+		MoveTreeProxy(proxyId, aabb, displacement);
+		return;
+	}
+
 	int32 boundCount = 2 * m_proxyCount;
 
 	b2Proxy* proxy = m_proxyPool + proxyId;
@@ -603,26 +699,39 @@ void b2BroadPhase::MoveProxy(int32 proxyId, const b2AABB& aabb)
 
 void b2BroadPhase::Commit()
 {
+	if (m_type == e_dynamicTreeBroadPhase)
+	{
+		UpdatePairs();
+		return;
+	}
+
 	m_pairManager.Commit();
 }
 
 int32 b2BroadPhase::Query(const b2AABB& aabb, void** userData, int32 maxCount)
 {
-	uint16 lowerValues[2];
-	uint16 upperValues[2];
-	ComputeBounds(lowerValues, upperValues, aabb);
+	if (m_type == e_dynamicTreeBroadPhase)
+	{
+		QueryTree(b2_nullProxy, aabb);
+	}
+	else
+	{
+		uint16 lowerValues[2];
+		uint16 upperValues[2];
+		ComputeBounds(lowerValues, upperValues, aabb);
 
-	int32 lowerIndex, upperIndex;
+		int32 lowerIndex, upperIndex;
 
-	Query(&lowerIndex, &upperIndex, lowerValues[0], upperValues[0], m_bounds[0], 2*m_proxyCount, 0);
-	Query(&lowerIndex, &upperIndex, lowerValues[1], upperValues[1], m_bounds[1], 2*m_proxyCount, 1);
+		Query(&lowerIndex, &upperIndex, lowerValues[0], upperValues[0], m_bounds[0], 2*m_proxyCount, 0);
+		Query(&lowerIndex, &upperIndex, lowerValues[1], upperValues[1], m_bounds[1], 2*m_proxyCount, 1);
+	}
 
-	b2Assert(m_queryResultCount < b2_maxProxies);
+	b2Assert(m_queryResultCount <= m_proxyCapacity);
 
 	int32 count = 0;
 	for (int32 i = 0; i < m_queryResultCount && count < maxCount; ++i, ++count)
 	{
-		b2Assert(m_queryResults[i] < b2_maxProxies);
+		b2Assert(m_queryResults[i] < m_proxyCapacity);
 		b2Proxy* proxy = m_proxyPool + m_queryResults[i];
 		b2Assert(proxy->IsValid());
 		userData[i] = proxy->userData;
@@ -635,14 +744,42 @@ int32 b2BroadPhase::Query(const b2AABB& aabb, void** userData, int32 maxCount)
 	return count;
 }
 
+b2AABB b2BroadPhase::GetAABB(int32 proxyId) const
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	const b2Proxy* p = m_proxyPool + proxyId;
+	b2Assert(p->IsValid());
+
+	if (m_type == e_dynamicTreeBroadPhase)
+	{
+		return m_tree.GetFatAABB(p->treeId);
+	}
+
+	b2Vec2 invQ;
+	invQ.Set(1.0f / m_quantizationFactor.x, 1.0f / m_quantizationFactor.y);
+
+	b2AABB aabb;
+	aabb.lowerBound.x = m_worldAABB.lowerBound.x + invQ.x * m_bounds[0][p->lowerBounds[0]].value;
+	aabb.lowerBound.y = m_worldAABB.lowerBound.y + invQ.y * m_bounds[1][p->lowerBounds[1]].value;
+	aabb.upperBound.x = m_worldAABB.lowerBound.x + invQ.x * m_bounds[0][p->upperBounds[0]].value;
+	aabb.upperBound.y = m_worldAABB.lowerBound.y + invQ.y * m_bounds[1][p->upperBounds[1]].value;
+	return aabb;
+}
+
 void b2BroadPhase::Validate()
 {
+	if (m_type == e_dynamicTreeBroadPhase)
+	{
+		m_tree.Validate();
+		return;
+	}
+
 	for (int32 axis = 0; axis < 2; ++axis)
 	{
 		b2Bound* bounds = m_bounds[axis];
 
 		int32 boundCount = 2 * m_proxyCount;
-		uint16 stabbingCount = 0;
+		int32 stabbingCount = 0;
 
 		for (int32 i = 0; i < boundCount; ++i)
 		{
@@ -666,3 +803,187 @@ void b2BroadPhase::Validate()
 		}
 	}
 }
+
+//
+// Dynamic tree
+//
+// A pair exists while the fat AABBs of its proxies overlap. A fat AABB only
+// changes when its proxy leaves it, so Commit only has to look at the proxies
+// in the move buffer.
+//
+
+void b2BroadPhase::QueryCallback(int32 proxyId)
+{
+	// A proxy does not pair with itself.
+	if (proxyId == m_queryProxyId)
+	{
+		return;
+	}
+
+	b2Assert(m_queryResultCount < m_proxyCapacity);
+	m_queryResults[m_queryResultCount] = proxyId;
+	++m_queryResultCount;
+}
+
+void b2BroadPhase::QueryTree(int32 proxyId, const b2AABB& aabb)
+{
+	m_queryProxyId = proxyId;
+	m_tree.Query(this, aabb);
+}
+
+int32 b2BroadPhase::CreateTreeProxy(const b2AABB& aabb, void* userData)
+{
+	// Pairs of the new proxy are found against committed fat AABBs.
+	UpdatePairs();
+
+	if (m_freeProxy == b2_nullProxy)
+	{
+		Grow();
+	}
+
+	int32 proxyId = m_freeProxy;
+	b2Proxy* proxy = m_proxyPool + proxyId;
+	m_freeProxy = proxy->GetNext();
+
+	proxy->overlapCount = 0;
+	proxy->userData = userData;
+	proxy->treeId = m_tree.CreateProxy(aabb, proxyId);
+
+	++m_proxyCount;
+
+	QueryTree(proxyId, m_tree.GetFatAABB(proxy->treeId));
+
+	for (int32 i = 0; i < m_queryResultCount; ++i)
+	{
+		b2Assert(m_proxyPool[m_queryResults[i]].IsValid());
+		m_pairManager.AddBufferedPair(proxyId, m_queryResults[i]);
+	}
+
+	m_pairManager.Commit();
+	m_queryResultCount = 0;
+
+	if (s_validate)
+	{
+		Validate();
+	}
+
+	return proxyId;
+}
+
+void b2BroadPhase::DestroyTreeProxy(int32 proxyId)
+{
+	b2Assert(0 < m_proxyCount && m_proxyCount <= m_proxyCapacity);
+
+	// Bring the pairs up to date, then the pairs of this proxy are exactly
+	// the proxies its fat AABB overlaps.
+	UpdatePairs();
+
+	b2Proxy* proxy = m_proxyPool + proxyId;
+	b2Assert(proxy->IsValid());
+
+	QueryTree(proxyId, m_tree.GetFatAABB(proxy->treeId));
+
+	for (int32 i = 0; i < m_queryResultCount; ++i)
+	{
+		b2Assert(m_proxyPool[m_queryResults[i]].IsValid());
+		m_pairManager.RemoveBufferedPair(proxyId, m_queryResults[i]);
+	}
+
+	m_pairManager.Commit();
+	m_queryResultCount = 0;
+
+	m_tree.DestroyProxy(proxy->treeId);
+
+	// Return the proxy to the pool.
+	proxy->userData = NULL;
+	proxy->overlapCount = b2_invalid;
+	proxy->treeId = b2_nullNode;
+
+	proxy->SetNext(m_freeProxy);
+	m_freeProxy = proxyId;
+	--m_proxyCount;
+
+	if (s_validate)
+	{
+		Validate();
+	}
+}
+
+void b2BroadPhase::MoveTreeProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement)
+{
+	b2Proxy* proxy = m_proxyPool + proxyId;
+	b2Assert(proxy->IsValid());
+
+	if (m_tree.MoveProxy(proxy->treeId, aabb, displacement) == false)
+	{
+		return;
+	}
+
+	if (m_moveCount == m_moveCapacity)
+	{
+		int32* oldBuffer = m_moveBuffer;
+		m_moveCapacity *= 2;
+		m_moveBuffer = (int32*)b2Alloc(m_moveCapacity * sizeof(int32));
+		memcpy(m_moveBuffer, oldBuffer, m_moveCount * sizeof(int32));
+		b2Free(oldBuffer);
+	}
+
+	m_moveBuffer[m_moveCount] = proxyId;
+	++m_moveCount;
+}
+
+void b2BroadPhase::UpdatePairs()
+{
+	if (m_moveCount == 0)
+	{
+		m_pairManager.Commit();
+		return;
+	}
+
+	// Remove the pairs whose fat AABBs came apart. Only moved proxies have new
+	// fat AABBs, but scanning the pairs is cheaper than finding theirs.
+	b2Pair* pairs = m_pairManager.m_pairs;
+	for (int32 i = 0; i < m_pairManager.m_pairCapacity; ++i)
+	{
+		b2Pair* pair = pairs + i;
+		if (pair->proxyId1 == b2_nullProxy)
+		{
+			continue;
+		}
+
+		const b2AABB& aabb1 = m_tree.GetFatAABB(m_proxyPool[pair->proxyId1].treeId);
+		const b2AABB& aabb2 = m_tree.GetFatAABB(m_proxyPool[pair->proxyId2].treeId);
+		if (b2TestOverlap(aabb1, aabb2) == false)
+		{
+			m_pairManager.RemoveBufferedPair(pair->proxyId1, pair->proxyId2);
+		}
+	}
+
+	// Add the new pairs of the moved proxies. A proxy may be in the buffer
+	// more than once and both proxies of a pair may have moved, so existing
+	// pairs are skipped.
+	for (int32 i = 0; i < m_moveCount; ++i)
+	{
+		int32 proxyId = m_moveBuffer[i];
+		QueryTree(proxyId, m_tree.GetFatAABB(m_proxyPool[proxyId].treeId));
+
+		for (int32 j = 0; j < m_queryResultCount; ++j)
+		{
+			if (m_pairManager.Find(proxyId, m_queryResults[j]) == NULL)
+			{
+				m_pairManager.AddBufferedPair(proxyId, m_queryResults[j]);
+			}
+		}
+
+		m_queryResultCount = 0;
+	}
+
+	m_moveCount = 0;
+
+	m_pairManager.Commit();
+
+	if (s_validate)
+	{
+		Validate();
+	}
+}
@@ -24,11 +24,15 @@ This broad phase uses the Sweep and Prune algorithm as described in:
 Collision Detection in Interactive 3D Environments by Gino van den Bergen
 Also, some ideas, such as using integral values for fast compares comes from
 Bullet (http:/www.bulletphysics.com).
+
+Alternatively it keeps the proxies in a dynamic AABB tree (b2DynamicTree).
+Both report pairs through the same pair manager and b2PairCallback.
 */
 
 #include "../Common/b2Settings.h"
 #include "b2Collision.h"
 #include "b2PairManager.h"
+#include "b2DynamicTree.h"
 #include <climits>
 
 #ifdef TARGET_FLOAT32_IS_FIXED
@@ -39,26 +43,41 @@ Bullet (http:/www.bulletphysics.com).
 #endif
 
 const uint16 b2_invalid = B2BROADPHASE_MAX;
-const uint16 b2_nullEdge = B2BROADPHASE_MAX;
+const int32 b2_nullEdge = -1;
 struct b2BoundValues;
 
+/// The broad-phase algorithm, chosen when the world is constructed.
+enum b2BroadPhaseType
+{
+	/// Sorted bound arrays per axis. Cheap when few proxies move per step.
+	e_sweepAndPruneBroadPhase,
+
+	/// A dynamic AABB tree with fat AABBs. Does not degrade when many
+	/// proxies move at once, e.g. after an explosion. A pair exists while
+	/// the fat AABBs overlap.
+	e_dynamicTreeBroadPhase,
+};
+
+// Bound values are still quantized to 16 bits. That only limits how finely
+// the world AABB is divided, not how many proxies fit.
 struct b2Bound
 {
 	bool IsLower() const { return (value & 1) == 0; }
 	bool IsUpper() const { return (value & 1) == 1; }
 
 	uint16 value;
-	uint16 proxyId;
-	uint16 stabbingCount;
+	int32 proxyId;
+	int32 stabbingCount;
 };
 
 struct b2Proxy
 {
-	uint16 GetNext() const { return lowerBounds[0]; }
-	void SetNext(uint16 next) { lowerBounds[0] = next; }
+	int32 GetNext() const { return lowerBounds[0]; }
+	void SetNext(int32 next) { lowerBounds[0] = next; }
 	bool IsValid() const { return overlapCount != b2_invalid; }
 
-	uint16 lowerBounds[2], upperBounds[2];
+	int32 lowerBounds[2], upperBounds[2];	// sweep and prune only
+	int32 treeId;	// dynamic tree only
 	uint16 overlapCount;
 	uint16 timeStamp;
 	void* userData;
@@ -67,21 +86,28 @@ struct b2Proxy
 class b2BroadPhase
 {
 public:
-	b2BroadPhase(const b2AABB& worldAABB, b2PairCallback* callback);
+	b2BroadPhase(const b2AABB& worldAABB, b2PairCallback* callback,
+				b2BroadPhaseType type = e_sweepAndPruneBroadPhase,
+				int32 proxyCapacity = b2_initialProxyCapacity,
+				int32 pairCapacity = b2_initialPairCapacity);
 	~b2BroadPhase();
 
+	b2BroadPhaseType GetType() const;
+
 	// Use this to see if your proxy is in range. If it is not in range,
 	// it should be destroyed. Otherwise you may get O(m^2) pairs, where m
 	// is the number of proxies that are out of range.
 	bool InRange(const b2AABB& aabb) const;
 
-	// Create and destroy proxies. These call Flush first.
-	uint16 CreateProxy(const b2AABB& aabb, void* userData);
+	// Create and destroy proxies. These call Flush first. The proxy pool
+	// doubles when it is full.
+	int32 CreateProxy(const b2AABB& aabb, void* userData);
 	void DestroyProxy(int32 proxyId);
 
 	// Call MoveProxy as many times as you like, then when you are done
 	// call Commit to finalized the proxy pairs (for your time step).
-	void MoveProxy(int32 proxyId, const b2AABB& aabb);
+	// The displacement is only used by the dynamic tree to predict motion.
+	void MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement = b2Vec2_zero);
 	void Commit();
 
 	// Get a single proxy. Returns NULL if the id is invalid.
@@ -91,9 +117,15 @@ public:
 	// the count, up to the supplied maximum count.
 	int32 Query(const b2AABB& aabb, void** userData, int32 maxCount);
 
+	// Get the box a proxy is sorted by: its quantized bounds or its fat AABB.
+	b2AABB GetAABB(int32 proxyId) const;
+
 	void Validate();
 	void ValidatePairs();
 
+	// Called by b2DynamicTree::Query for each overlapping leaf.
+	void QueryCallback(int32 proxyId);
+
 private:
 	void ComputeBounds(uint16* lowerValues, uint16* upperValues, const b2AABB& aabb);
 
@@ -105,17 +137,34 @@ private:
 	void IncrementOverlapCount(int32 proxyId);
 	void IncrementTimeStamp();
 
+	// Double the proxy pool, the bound arrays and the query buffer. Proxy ids
+	// and bound indices do not change.
+	void Grow();
+
+	// The dynamic tree versions of the public functions.
+	int32 CreateTreeProxy(const b2AABB& aabb, void* userData);
+	void DestroyTreeProxy(int32 proxyId);
+	void MoveTreeProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement);
+	void QueryTree(int32 proxyId, const b2AABB& aabb);
+
+	// Turn the moved tree proxies into buffered pairs and commit them.
+	void UpdatePairs();
+
+	b2BroadPhase(const b2BroadPhase&);
+	void operator=(const b2BroadPhase&);
+
 public:
 	friend class b2PairManager;
 
 	b2PairManager m_pairManager;
 
-	b2Proxy m_proxyPool[b2_maxProxies];
-	uint16 m_freeProxy;
+	b2Proxy* m_proxyPool;
+	int32 m_proxyCapacity;
+	int32 m_freeProxy;
 
-	b2Bound m_bounds[2][2*b2_maxProxies];
+	b2Bound* m_bounds[2];	// 2 * m_proxyCapacity each, sweep and prune only
 
-	uint16 m_queryResults[b2_maxProxies];
+	int32* m_queryResults;	// m_proxyCapacity
 	int32 m_queryResultCount;
 
 	b2AABB m_worldAABB;
@@ -123,9 +172,22 @@ public:
 	int32 m_proxyCount;
 	uint16 m_timeStamp;
 
+	b2BroadPhaseType m_type;
+
+	b2DynamicTree m_tree;
+	int32* m_moveBuffer;	// proxies whose fat AABB changed since the last commit
+	int32 m_moveCapacity;
+	int32 m_moveCount;
+	int32 m_queryProxyId;	// skipped by QueryCallback
+
 	static bool s_validate;
 };
 
+inline b2BroadPhaseType b2BroadPhase::GetType() const
+{
+	return m_type;
+}
+
 
 inline bool b2BroadPhase::InRange(const b2AABB& aabb) const
 {
@@ -23,7 +23,8 @@
 void b2CollideCircles(
 	b2Manifold* manifold,
 	const b2CircleShape* circle1, const b2XForm& xf1,
-	const b2CircleShape* circle2, const b2XForm& xf2)
+	const b2CircleShape* circle2, const b2XForm& xf2,
+	float32 margin)
 {
 	manifold->pointCount = 0;
 
@@ -35,7 +36,8 @@ void b2CollideCircles(
 	float32 r1 = circle1->GetRadius();
 	float32 r2 = circle2->GetRadius();
 	float32 radiusSum = r1 + r2;
-	if (distSqr > radiusSum * radiusSum)
+	float32 maxDistance = radiusSum + margin;
+	if (distSqr > maxDistance * maxDistance)
 	{
 		return;
 	}
@@ -71,7 +73,8 @@ void b2CollideCircles(
 void b2CollidePolygonAndCircle(
 	b2Manifold* manifold,
 	const b2PolygonShape* polygon, const b2XForm& xf1,
-	const b2CircleShape* circle, const b2XForm& xf2)
+	const b2CircleShape* circle, const b2XForm& xf2,
+	float32 margin)
 {
 	manifold->pointCount = 0;
 
@@ -91,7 +94,7 @@ void b2CollidePolygonAndCircle(
 	{
 		float32 s = b2Dot(normals[i], cLocal - vertices[i]);
 
-		if (s > radius)
+		if (s > radius + margin)
 		{
 			// Early out.
 			return;
@@ -152,7 +155,7 @@ void b2CollidePolygonAndCircle(
 
 	b2Vec2 d = cLocal - p;
 	float32 dist = d.Normalize();
-	if (dist > radius)
+	if (dist > radius + margin)
 	{
 		return;
 	}
@@ -19,6 +19,11 @@
 #include "b2Collision.h"
 #include "Shapes/b2PolygonShape.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define B2_COLLIDE_SSE2
+#include <emmintrin.h>
+#endif
+
 struct ClipVertex
 {
 	b2Vec2 v;
@@ -96,11 +101,190 @@ static float32 EdgeSeparation(const b2PolygonShape* poly1, const b2XForm& xf1, i
 	return separation;
 }
 
+#ifdef B2_COLLIDE_SSE2
+
+// The box functions do exactly the floating point operations of the generic
+// ones, four edges at a time, so both give the same bits.
+
+// Load four vertices or normals as x and y lanes.
+static inline void b2LoadBox(const b2Vec2* v, __m128* x, __m128* y)
+{
+	__m128 a = _mm_loadu_ps(&v[0].x);
+	__m128 b = _mm_loadu_ps(&v[2].x);
+	*x = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+	*y = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+}
+
+// Transform four points in lanes, like b2Mul(xf, v).
+static inline void b2MulBox(const b2XForm& xf, __m128 x, __m128 y, __m128* outX, __m128* outY)
+{
+	__m128 rx = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(xf.R.col1.x), x), _mm_mul_ps(_mm_set1_ps(xf.R.col2.x), y));
+	__m128 ry = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(xf.R.col1.y), x), _mm_mul_ps(_mm_set1_ps(xf.R.col2.y), y));
+	*outX = _mm_add_ps(_mm_set1_ps(xf.position.x), rx);
+	*outY = _mm_add_ps(_mm_set1_ps(xf.position.y), ry);
+}
+
+// EdgeSeparation for all four edges of poly1.
+static void EdgeSeparationsBox(float32 separations[4],
+							   const b2PolygonShape* poly1, const b2XForm& xf1,
+							   const b2PolygonShape* poly2, const b2XForm& xf2)
+{
+	// Convert the normals from poly1's frame into poly2's frame.
+	__m128 n1X, n1Y;
+	b2LoadBox(poly1->GetNormals(), &n1X, &n1Y);
+	__m128 worldX = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(xf1.R.col1.x), n1X), _mm_mul_ps(_mm_set1_ps(xf1.R.col2.x), n1Y));
+	__m128 worldY = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(xf1.R.col1.y), n1X), _mm_mul_ps(_mm_set1_ps(xf1.R.col2.y), n1Y));
+	__m128 normalX = _mm_add_ps(_mm_mul_ps(worldX, _mm_set1_ps(xf2.R.col1.x)), _mm_mul_ps(worldY, _mm_set1_ps(xf2.R.col1.y)));
+	__m128 normalY = _mm_add_ps(_mm_mul_ps(worldX, _mm_set1_ps(xf2.R.col2.x)), _mm_mul_ps(worldY, _mm_set1_ps(xf2.R.col2.y)));
+
+	// Find the support vertex on poly2 for every -normal. Only a strictly
+	// smaller dot product replaces the minimum, as in EdgeSeparation.
+	const b2Vec2* vertices2 = poly2->GetVertices();
+	__m128i index = _mm_setzero_si128();
+	__m128 minDot = _mm_set1_ps(B2_FLT_MAX);
+	for (int32 i = 0; i < 4; ++i)
+	{
+		__m128 dot = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(vertices2[i].x), normalX), _mm_mul_ps(_mm_set1_ps(vertices2[i].y), normalY));
+		__m128 less = _mm_cmplt_ps(dot, minDot);
+		minDot = _mm_or_ps(_mm_and_ps(less, dot), _mm_andnot_ps(less, minDot));
+		__m128i lessMask = _mm_castps_si128(less);
+		index = _mm_or_si128(_mm_and_si128(lessMask, _mm_set1_epi32(i)), _mm_andnot_si128(lessMask, index));
+	}
+
+	__m128 v2X, v2Y;
+	b2LoadBox(vertices2, &v2X, &v2Y);
+	b2MulBox(xf2, v2X, v2Y, &v2X, &v2Y);
+
+	float32 world2X[4], world2Y[4];
+	int32 support[4];
+	_mm_storeu_ps(world2X, v2X);
+	_mm_storeu_ps(world2Y, v2Y);
+	_mm_storeu_si128((__m128i*)support, index);
+	v2X = _mm_setr_ps(world2X[support[0]], world2X[support[1]], world2X[support[2]], world2X[support[3]]);
+	v2Y = _mm_setr_ps(world2Y[support[0]], world2Y[support[1]], world2Y[support[2]], world2Y[support[3]]);
+
+	__m128 v1X, v1Y;
+	b2LoadBox(poly1->GetVertices(), &v1X, &v1Y);
+	b2MulBox(xf1, v1X, v1Y, &v1X, &v1Y);
+
+	__m128 separation = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(v2X, v1X), worldX), _mm_mul_ps(_mm_sub_ps(v2Y, v1Y), worldY));
+	_mm_storeu_ps(separations, separation);
+}
+
+// FindMaxSeparation for two polygons with four vertices, which is what
+// b2PolygonDef::SetAsBox makes. All four edge separations are computed at
+// once, the search then follows the generic one.
+static float32 FindMaxSeparationBox(int32* edgeIndex,
+									const b2PolygonShape* poly1, const b2XForm& xf1,
+									const b2PolygonShape* poly2, const b2XForm& xf2,
+									float32 margin)
+{
+	const b2Vec2* normals1 = poly1->GetNormals();
+
+	// Vector pointing from the centroid of poly1 to the centroid of poly2.
+	b2Vec2 d = b2Mul(xf2, poly2->GetCentroid()) - b2Mul(xf1, poly1->GetCentroid());
+	b2Vec2 dLocal1 = b2MulT(xf1.R, d);
+
+	// Find edge normal on poly1 that has the largest projection onto d.
+	int32 edge = 0;
+	float32 maxDot = -B2_FLT_MAX;
+	for (int32 i = 0; i < 4; ++i)
+	{
+		float32 dot = b2Dot(normals1[i], dLocal1);
+		if (dot > maxDot)
+		{
+			maxDot = dot;
+			edge = i;
+		}
+	}
+
+	float32 separations[4];
+	EdgeSeparationsBox(separations, poly1, xf1, poly2, xf2);
+
+	float32 s = separations[edge];
+	if (s > margin)
+	{
+		return s;
+	}
+
+	int32 prevEdge = (edge + 3) & 3;
+	float32 sPrev = separations[prevEdge];
+	if (sPrev > margin)
+	{
+		return sPrev;
+	}
+
+	int32 nextEdge = (edge + 1) & 3;
+	float32 sNext = separations[nextEdge];
+	if (sNext > margin)
+	{
+		return sNext;
+	}
+
+	int32 bestEdge;
+	float32 bestSeparation;
+	int32 increment;
+	if (sPrev > s && sPrev > sNext)
+	{
+		increment = 3;
+		bestEdge = prevEdge;
+		bestSeparation = sPrev;
+	}
+	else if (sNext > s)
+	{
+		increment = 1;
+		bestEdge = nextEdge;
+		bestSeparation = sNext;
+	}
+	else
+	{
+		*edgeIndex = edge;
+		return s;
+	}
+
+	for ( ; ; )
+	{
+		edge = (bestEdge + increment) & 3;
+
+		s = separations[edge];
+		if (s > margin)
+		{
+			return s;
+		}
+
+		if (s > bestSeparation)
+		{
+			bestEdge = edge;
+			bestSeparation = s;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	*edgeIndex = bestEdge;
+	return bestSeparation;
+}
+
+#endif
+
 // Find the max separation between poly1 and poly2 using edge normals from poly1.
+// Boxes take FindMaxSeparationBox unless useBox is false.
 static float32 FindMaxSeparation(int32* edgeIndex,
 								 const b2PolygonShape* poly1, const b2XForm& xf1,
-								 const b2PolygonShape* poly2, const b2XForm& xf2)
+								 const b2PolygonShape* poly2, const b2XForm& xf2,
+								 float32 margin, bool useBox)
 {
+#ifdef B2_COLLIDE_SSE2
+	if (useBox && poly1->GetVertexCount() == 4 && poly2->GetVertexCount() == 4)
+	{
+		return FindMaxSeparationBox(edgeIndex, poly1, xf1, poly2, xf2, margin);
+	}
+#else
+	B2_NOT_USED(useBox);
+#endif
+
 	int32 count1 = poly1->GetVertexCount();
 	const b2Vec2* normals1 = poly1->GetNormals();
 
@@ -123,7 +307,7 @@ static float32 FindMaxSeparation(int32* edgeIndex,
 
 	// Get the separation for the edge normal.
 	float32 s = EdgeSeparation(poly1, xf1, edge, poly2, xf2);
-	if (s > 0.0f)
+	if (s > margin)
 	{
 		return s;
 	}
@@ -131,7 +315,7 @@ static float32 FindMaxSeparation(int32* edgeIndex,
 	// Check the separation for the previous edge normal.
 	int32 prevEdge = edge - 1 >= 0 ? edge - 1 : count1 - 1;
 	float32 sPrev = EdgeSeparation(poly1, xf1, prevEdge, poly2, xf2);
-	if (sPrev > 0.0f)
+	if (sPrev > margin)
 	{
 		return sPrev;
 	}
@@ -139,7 +323,7 @@ static float32 FindMaxSeparation(int32* edgeIndex,
 	// Check the separation for the next edge normal.
 	int32 nextEdge = edge + 1 < count1 ? edge + 1 : 0;
 	float32 sNext = EdgeSeparation(poly1, xf1, nextEdge, poly2, xf2);
-	if (sNext > 0.0f)
+	if (sNext > margin)
 	{
 		return sNext;
 	}
@@ -175,7 +359,7 @@ static float32 FindMaxSeparation(int32* edgeIndex,
 			edge = bestEdge + 1 < count1 ? bestEdge + 1 : 0;
 
 		s = EdgeSeparation(poly1, xf1, edge, poly2, xf2);
-		if (s > 0.0f)
+		if (s > margin)
 		{
 			return s;
 		}
@@ -246,20 +430,21 @@ static void FindIncidentEdge(ClipVertex c[2],
 // Clip
 
 // The normal points from 1 to 2
-void b2CollidePolygons(b2Manifold* manifold,
-					  const b2PolygonShape* polyA, const b2XForm& xfA,
-					  const b2PolygonShape* polyB, const b2XForm& xfB)
+static void CollidePolygons(b2Manifold* manifold,
+							const b2PolygonShape* polyA, const b2XForm& xfA,
+							const b2PolygonShape* polyB, const b2XForm& xfB,
+							float32 margin, bool useBox)
 {
 	manifold->pointCount = 0;
 
 	int32 edgeA = 0;
-	float32 separationA = FindMaxSeparation(&edgeA, polyA, xfA, polyB, xfB);
-	if (separationA > 0.0f)
+	float32 separationA = FindMaxSeparation(&edgeA, polyA, xfA, polyB, xfB, margin, useBox);
+	if (separationA > margin)
 		return;
 
 	int32 edgeB = 0;
-	float32 separationB = FindMaxSeparation(&edgeB, polyB, xfB, polyA, xfA);
-	if (separationB > 0.0f)
+	float32 separationB = FindMaxSeparation(&edgeB, polyB, xfB, polyA, xfA, margin, useBox);
+	if (separationB > margin)
 		return;
 
 	const b2PolygonShape* poly1;	// reference poly
@@ -336,7 +521,7 @@ void b2CollidePolygons(b2Manifold* manifold,
 	{
 		float32 separation = b2Dot(frontNormal, clipPoints2[i].v) - frontOffset;
 
-		if (separation <= 0.0f)
+		if (separation <= margin)
 		{
 			b2ManifoldPoint* cp = manifold->points + pointCount;
 			cp->separation = separation;
@@ -350,3 +535,19 @@ void b2CollidePolygons(b2Manifold* manifold,
 
 	manifold->pointCount = pointCount;
 }
+
+void b2CollidePolygons(b2Manifold* manifold,
+					  const b2PolygonShape* polyA, const b2XForm& xfA,
+					  const b2PolygonShape* polyB, const b2XForm& xfB,
+					  float32 margin)
+{
+	CollidePolygons(manifold, polyA, xfA, polyB, xfB, margin, true);
+}
+
+void b2CollidePolygonsGeneric(b2Manifold* manifold,
+							 const b2PolygonShape* polyA, const b2XForm& xfA,
+							 const b2PolygonShape* polyB, const b2XForm& xfB,
+							 float32 margin)
+{
+	CollidePolygons(manifold, polyA, xfA, polyB, xfB, margin, false);
+}
@@ -98,32 +98,70 @@ struct b2OBB
 };
 
 /// Compute the collision manifold between two circles.
+/// Points separated by up to margin are kept too (speculative contacts),
+/// their separation is positive.
 void b2CollideCircles(b2Manifold* manifold,
 					  const b2CircleShape* circle1, const b2XForm& xf1,
-					  const b2CircleShape* circle2, const b2XForm& xf2);
+					  const b2CircleShape* circle2, const b2XForm& xf2,
+					  float32 margin = 0.0f);
 
 /// Compute the collision manifold between a polygon and a circle.
 void b2CollidePolygonAndCircle(b2Manifold* manifold,
 							   const b2PolygonShape* polygon, const b2XForm& xf1,
-							   const b2CircleShape* circle, const b2XForm& xf2);
+							   const b2CircleShape* circle, const b2XForm& xf2,
+							   float32 margin = 0.0f);
 
 /// Compute the collision manifold between two circles.
 void b2CollidePolygons(b2Manifold* manifold,
 					   const b2PolygonShape* polygon1, const b2XForm& xf1,
-					   const b2PolygonShape* polygon2, const b2XForm& xf2);
+					   const b2PolygonShape* polygon2, const b2XForm& xf2,
+					   float32 margin = 0.0f);
+
+/// Same as b2CollidePolygons, but never takes the SSE2 path for boxes.
+/// Both must give the same manifold, box2d-bench -k checks that.
+void b2CollidePolygonsGeneric(b2Manifold* manifold,
+							  const b2PolygonShape* polygon1, const b2XForm& xf1,
+							  const b2PolygonShape* polygon2, const b2XForm& xf2,
+							  float32 margin = 0.0f);
+
+/// Used to warm start b2Distance. Holds the vertex indices of the simplex the
+/// last call ended with, GJK starts from these vertices at the new transforms.
+/// Set count to zero before the first call and keep one cache per shape pair.
+struct b2SimplexCache
+{
+	int32 count;		///< number of simplex vertices, zero if empty
+	uint8 index1[3];	///< vertices on shape1
+	uint8 index2[3];	///< vertices on shape2
+};
+
+/// GJK statistics. b2Distance and b2TimeOfImpact add to the counts when
+/// given one, set them to zero first.
+struct b2DistanceStats
+{
+	int32 callCount;		///< b2Distance calls that ran GJK
+	int32 iterationCount;	///< support points evaluated by these calls
+};
 
 /// Compute the distance between two shapes and the closest points.
+/// @param cache optional simplex cache for the same pair of shapes, it is
+/// read and updated. The result is as precise as without it, but may differ
+/// slightly because GJK takes another path.
+/// @param stats optional GJK statistics to add to.
 /// @return the distance between the shapes or zero if they are overlapped/touching.
 float32 b2Distance(b2Vec2* x1, b2Vec2* x2,
 				   const b2Shape* shape1, const b2XForm& xf1,
-				   const b2Shape* shape2, const b2XForm& xf2);
+				   const b2Shape* shape2, const b2XForm& xf2,
+				   b2SimplexCache* cache = NULL, b2DistanceStats* stats = NULL);
 
 /// Compute the time when two shapes begin to touch or touch at a closer distance.
 /// @warning the sweeps must have the same time interval.
+/// @param cache optional simplex cache passed to every b2Distance call.
+/// @param stats optional GJK statistics passed to every b2Distance call.
 /// @return the fraction between [0,1] in which the shapes first touch.
 /// fraction=0 means the shapes begin touching/overlapped, and fraction=1 means the shapes don't touch.
 float32 b2TimeOfImpact(const b2Shape* shape1, const b2Sweep& sweep1,
-					   const b2Shape* shape2, const b2Sweep& sweep2);
+					   const b2Shape* shape2, const b2Sweep& sweep2,
+					   b2SimplexCache* cache = NULL, b2DistanceStats* stats = NULL);
 
 
 // ---------------- Inline Functions ------------------------------------------
@@ -20,14 +20,13 @@
 #include "Shapes/b2CircleShape.h"
 #include "Shapes/b2PolygonShape.h"
 
-int32 g_GJK_Iterations = 0;
-
 // GJK using Voronoi regions (Christer Ericson) and region selection
 // optimizations (Casey Muratori).
 
 // The origin is either in the region of points[1] or in the edge region. The origin is
 // not in region of points[0] because that is the old point.
-static int32 ProcessTwo(b2Vec2* x1, b2Vec2* x2, b2Vec2* p1s, b2Vec2* p2s, b2Vec2* points)
+static int32 ProcessTwo(b2Vec2* x1, b2Vec2* x2, b2Vec2* p1s, b2Vec2* p2s, b2Vec2* points,
+						 int32* i1s, int32* i2s)
 {
 	// If in point[1] region
 	b2Vec2 r = -points[1];
@@ -42,6 +41,8 @@ static int32 ProcessTwo(b2Vec2* x1, b2Vec2* x2, b2Vec2* p1s, b2Vec2* p2s, b2Vec2
 		p1s[0] = p1s[1];
 		p2s[0] = p2s[1];
 		points[0] = points[1];
+		i1s[0] = i1s[1];
+		i2s[0] = i2s[1];
 		return 1;
 	}
 
@@ -57,7 +58,8 @@ static int32 ProcessTwo(b2Vec2* x1, b2Vec2* x2, b2Vec2* p1s, b2Vec2* p2s, b2Vec2
 // - edge points[0]-points[2]
 // - edge points[1]-points[2]
 // - inside the triangle
-static int32 ProcessThree(b2Vec2* x1, b2Vec2* x2, b2Vec2* p1s, b2Vec2* p2s, b2Vec2* points)
+static int32 ProcessThree(b2Vec2* x1, b2Vec2* x2, b2Vec2* p1s, b2Vec2* p2s, b2Vec2* points,
+						   int32* i1s, int32* i2s)
 {
 	b2Vec2 a = points[0];
 	b2Vec2 b = points[1];
@@ -80,6 +82,8 @@ static int32 ProcessThree(b2Vec2* x1, b2Vec2* x2, b2Vec2* p1s, b2Vec2* p2s, b2Ve
 		p1s[0] = p1s[2];
 		p2s[0] = p2s[2];
 		points[0] = points[2];
+		i1s[0] = i1s[2];
+		i2s[0] = i2s[2];
 		return 1;
 	}
 
@@ -110,6 +114,8 @@ static int32 ProcessThree(b2Vec2* x1, b2Vec2* x2, b2Vec2* p1s, b2Vec2* p2s, b2Ve
 		p1s[0] = p1s[2];
 		p2s[0] = p2s[2];
 		points[0] = points[2];
+		i1s[0] = i1s[2];
+		i2s[0] = i2s[2];
 		return 2;
 	}
 
@@ -124,6 +130,8 @@ static int32 ProcessThree(b2Vec2* x1, b2Vec2* x2, b2Vec2* p1s, b2Vec2* p2s, b2Ve
 		p1s[1] = p1s[2];
 		p2s[1] = p2s[2];
 		points[1] = points[2];
+		i1s[1] = i1s[2];
+		i2s[1] = i2s[2];
 		return 2;
 	}
 
@@ -163,25 +171,124 @@ static bool InPoints(const b2Vec2& w, const b2Vec2* points, int32 pointCount)
 	return false;
 }
 
+// The cached simplex was built at other transforms, so the origin may be in
+// any of its regions. Rule out the regions ProcessTwo and ProcessThree skip
+// because they belong to the old points.
+static int32 ProcessCached(b2Vec2* x1, b2Vec2* x2, b2Vec2* p1s, b2Vec2* p2s, b2Vec2* points,
+						   int32* i1s, int32* i2s, int32 pointCount)
+{
+	if (pointCount == 3)
+	{
+		b2Vec2 a = points[0];
+		b2Vec2 b = points[1];
+		b2Vec2 ab = b - a;
+		b2Vec2 ac = points[2] - a;
+		b2Vec2 bc = points[2] - b;
+
+		float32 sn = -b2Dot(a, ab), sd = b2Dot(b, ab);
+		float32 tn = -b2Dot(a, ac), un = -b2Dot(b, bc);
+		float32 n = b2Cross(ab, ac);
+		float32 vc = n * b2Cross(a, b);
+
+		// In vertex a, vertex b or edge ab region? Then the closest point
+		// is on edge ab, drop points[2]. Also drop it if the triangle has
+		// collapsed to a line.
+		bool inA = sn <= 0.0f && tn <= 0.0f;
+		bool inB = sd <= 0.0f && un <= 0.0f;
+		bool inAB = vc <= 0.0f && sn >= 0.0f && sd >= 0.0f;
+		if (inA == false && inB == false && inAB == false && n != 0.0f)
+		{
+			return ProcessThree(x1, x2, p1s, p2s, points, i1s, i2s);
+		}
+	}
+
+	if (pointCount >= 2)
+	{
+		// In vertex points[0] region?
+		b2Vec2 d = points[1] - points[0];
+		if (b2Dot(points[0], d) < 0.0f)
+		{
+			return ProcessTwo(x1, x2, p1s, p2s, points, i1s, i2s);
+		}
+	}
+
+	*x1 = p1s[0];
+	*x2 = p2s[0];
+	return 1;
+}
+
+static void StoreCache(b2SimplexCache* cache, const int32* i1s, const int32* i2s, int32 pointCount)
+{
+	if (cache)
+	{
+		cache->count = pointCount;
+		for (int32 i = 0; i < pointCount; ++i)
+		{
+			cache->index1[i] = (uint8)i1s[i];
+			cache->index2[i] = (uint8)i2s[i];
+		}
+	}
+}
+
 template <typename T1, typename T2>
 float32 DistanceGeneric(b2Vec2* x1, b2Vec2* x2,
 				   const T1* shape1, const b2XForm& xf1,
-				   const T2* shape2, const b2XForm& xf2)
+				   const T2* shape2, const b2XForm& xf2,
+				   b2SimplexCache* cache, b2DistanceStats* stats)
 {
 	b2Vec2 p1s[3], p2s[3];
 	b2Vec2 points[3];
+	int32 i1s[3], i2s[3];	// vertex indices of the simplex points
 	int32 pointCount = 0;
 
 	*x1 = shape1->GetFirstVertex(xf1);
 	*x2 = shape2->GetFirstVertex(xf2);
 
+	++stats->callCount;
+
+	// Start from the vertices the previous call ended with. The search below
+	// then usually ends on its first support point.
+	if (cache && cache->count > 0)
+	{
+		pointCount = cache->count;
+		for (int32 i = 0; i < pointCount; ++i)
+		{
+			i1s[i] = cache->index1[i];
+			i2s[i] = cache->index2[i];
+			if (i1s[i] >= shape1->GetVertexCount() || i2s[i] >= shape2->GetVertexCount())
+			{
+				// The cache belongs to other shapes.
+				pointCount = 0;
+				break;
+			}
+
+			p1s[i] = shape1->GetCoreVertex(xf1, i1s[i]);
+			p2s[i] = shape2->GetCoreVertex(xf2, i2s[i]);
+			points[i] = p2s[i] - p1s[i];
+		}
+
+		if (pointCount > 0)
+		{
+			pointCount = ProcessCached(x1, x2, p1s, p2s, points, i1s, i2s, pointCount);
+			if (pointCount == 3)
+			{
+				StoreCache(cache, i1s, i2s, pointCount);
+				return 0.0f;
+			}
+		}
+	}
+
 	float32 vSqr = 0.0f;
 	const int32 maxIterations = 20;
 	for (int32 iter = 0; iter < maxIterations; ++iter)
 	{
+		++stats->iterationCount;
+
 		b2Vec2 v = *x2 - *x1;
-		b2Vec2 w1 = shape1->Support(xf1, v);
-		b2Vec2 w2 = shape2->Support(xf2, -v);
+		int32 i1 = shape1->GetSupport(xf1, v);
+		int32 i2 = shape2->GetSupport(xf2, -v);
+		b2Vec2 w1 = shape1->GetCoreVertex(xf1, i1);
+		b2Vec2 w2 = shape2->GetCoreVertex(xf2, i2);
 
 		vSqr = b2Dot(v, v);
 		b2Vec2 w = w2 - w1;
@@ -192,8 +299,11 @@ float32 DistanceGeneric(b2Vec2* x1, b2Vec2* x2,
 			{
 				*x1 = w1;
 				*x2 = w2;
+				i1s[0] = i1;
+				i2s[0] = i2;
+				pointCount = 1;
 			}
-			g_GJK_Iterations = iter;
+			StoreCache(cache, i1s, i2s, pointCount);
 			return b2Sqrt(vSqr);
 		}
 
@@ -203,6 +313,8 @@ float32 DistanceGeneric(b2Vec2* x1, b2Vec2* x2,
 			p1s[0] = w1;
 			p2s[0] = w2;
 			points[0] = w;
+			i1s[0] = i1;
+			i2s[0] = i2;
 			*x1 = p1s[0];
 			*x2 = p2s[0];
 			++pointCount;
@@ -212,21 +324,25 @@ float32 DistanceGeneric(b2Vec2* x1, b2Vec2* x2,
 			p1s[1] = w1;
 			p2s[1] = w2;
 			points[1] = w;
-			pointCount = ProcessTwo(x1, x2, p1s, p2s, points);
+			i1s[1] = i1;
+			i2s[1] = i2;
+			pointCount = ProcessTwo(x1, x2, p1s, p2s, points, i1s, i2s);
 			break;
 
 		case 2:
 			p1s[2] = w1;
 			p2s[2] = w2;
 			points[2] = w;
-			pointCount = ProcessThree(x1, x2, p1s, p2s, points);
+			i1s[2] = i1;
+			i2s[2] = i2;
+			pointCount = ProcessThree(x1, x2, p1s, p2s, points, i1s, i2s);
 			break;
 		}
 
 		// If we have three points, then the origin is in the corresponding triangle.
 		if (pointCount == 3)
 		{
-			g_GJK_Iterations = iter;
+			StoreCache(cache, i1s, i2s, pointCount);
 			return 0.0f;
 		}
 
@@ -242,14 +358,14 @@ float32 DistanceGeneric(b2Vec2* x1, b2Vec2* x2,
 		if (pointCount == 3 || vSqr <= 100.0f * B2_FLT_EPSILON * maxSqr)
 #endif
 		{
-			g_GJK_Iterations = iter;
+			StoreCache(cache, i1s, i2s, pointCount);
 			v = *x2 - *x1;
 			vSqr = b2Dot(v, v);
 			return b2Sqrt(vSqr);
 		}
 	}
 
-	g_GJK_Iterations = maxIterations;
+	StoreCache(cache, i1s, i2s, pointCount);
 	return b2Sqrt(vSqr);
 }
 
@@ -290,11 +406,21 @@ static float32 DistanceCC(
 // This is used for polygon-vs-circle distance.
 struct Point
 {
-	b2Vec2 Support(const b2XForm&, const b2Vec2&) const
+	int32 GetSupport(const b2XForm&, const b2Vec2&) const
+	{
+		return 0;
+	}
+
+	b2Vec2 GetCoreVertex(const b2XForm&, int32) const
 	{
 		return p;
 	}
 
+	int32 GetVertexCount() const
+	{
+		return 1;
+	}
+
 	b2Vec2 GetFirstVertex(const b2XForm&) const
 	{
 		return p;
@@ -308,12 +434,13 @@ struct Point
 static float32 DistancePC(
 	b2Vec2* x1, b2Vec2* x2,
 	const b2PolygonShape* polygon, const b2XForm& xf1,
-	const b2CircleShape* circle, const b2XForm& xf2)
+	const b2CircleShape* circle, const b2XForm& xf2,
+	b2SimplexCache* cache, b2DistanceStats* stats)
 {
 	Point point;
 	point.p = b2Mul(xf2, circle->GetLocalPosition());
 
-	float32 distance = DistanceGeneric(x1, x2, polygon, xf1, &point, b2XForm_identity);
+	float32 distance = DistanceGeneric(x1, x2, polygon, xf1, &point, b2XForm_identity, cache, stats);
 
 	float32 r = circle->GetRadius() - b2_toiSlop;
 
@@ -335,11 +462,20 @@ static float32 DistancePC(
 
 float32 b2Distance(b2Vec2* x1, b2Vec2* x2,
 				   const b2Shape* shape1, const b2XForm& xf1,
-				   const b2Shape* shape2, const b2XForm& xf2)
+				   const b2Shape* shape2, const b2XForm& xf2,
+				   b2SimplexCache* cache, b2DistanceStats* stats)
 {
 	b2ShapeType type1 = shape1->GetType();
 	b2ShapeType type2 = shape2->GetType();
 
+	b2DistanceStats unused;
+	if (stats == NULL)
+	{
+		unused.callCount = 0;
+		unused.iterationCount = 0;
+		stats = &unused;
+	}
+
 	if (type1 == e_circleShape && type2 == e_circleShape)
 	{
 		return DistanceCC(x1, x2, (b2CircleShape*)shape1, xf1, (b2CircleShape*)shape2, xf2);
@@ -347,17 +483,17 @@ float32 b2Distance(b2Vec2* x1, b2Vec2* x2,
 	
 	if (type1 == e_polygonShape && type2 == e_circleShape)
 	{
-		return DistancePC(x1, x2, (b2PolygonShape*)shape1, xf1, (b2CircleShape*)shape2, xf2);
+		return DistancePC(x1, x2, (b2PolygonShape*)shape1, xf1, (b2CircleShape*)shape2, xf2, cache, stats);
 	}
 
 	if (type1 == e_circleShape && type2 == e_polygonShape)
 	{
-		return DistancePC(x2, x1, (b2PolygonShape*)shape2, xf2, (b2CircleShape*)shape1, xf1);
+		return DistancePC(x2, x1, (b2PolygonShape*)shape2, xf2, (b2CircleShape*)shape1, xf1, cache, stats);
 	}
 
 	if (type1 == e_polygonShape && type2 == e_polygonShape)
 	{
-		return DistanceGeneric(x1, x2, (b2PolygonShape*)shape1, xf1, (b2PolygonShape*)shape2, xf2);
+		return DistanceGeneric(x1, x2, (b2PolygonShape*)shape1, xf1, (b2PolygonShape*)shape2, xf2, cache, stats);
 	}
 
 	return 0.0f;
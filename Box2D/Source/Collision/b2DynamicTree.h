@@ -0,0 +1,175 @@
+/*
+* Copyright (c) 2006-2007 Erin Catto http://www.gphysics.com
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef B2_DYNAMIC_TREE_H
+#define B2_DYNAMIC_TREE_H
+
+#include "b2Collision.h"
+
+const int32 b2_nullNode = -1;
+
+/// The deepest tree a query can walk. A balanced tree of a million leaves
+/// is about 30 levels deep.
+const int32 b2_treeStackSize = 128;
+
+/// A node in the dynamic tree. Nodes are pooled and referenced by index, so
+/// the whole tree can be copied with memcpy.
+struct b2TreeNode
+{
+	bool IsLeaf() const { return child1 == b2_nullNode; }
+
+	/// The fat AABB of a leaf, or the union of the children.
+	b2AABB aabb;
+
+	/// The broad-phase proxy of a leaf.
+	int32 proxyId;
+
+	union
+	{
+		int32 parent;
+		int32 next;
+	};
+
+	int32 child1;
+	int32 child2;
+
+	/// Leaves are at height 0, free nodes at -1.
+	int32 height;
+};
+
+/// A dynamic AABB tree. Each leaf holds a proxy with a fat AABB: the AABB
+/// of the shape grown by b2_aabbExtension. A proxy that moves within its fat
+/// AABB does not touch the tree at all. Otherwise the leaf is removed and
+/// inserted again, choosing the sibling with the surface area heuristic, and
+/// every node on the way back to the root is balanced with a tree rotation.
+/// This keeps the tree balanced incrementally, with no full rebuilds.
+class b2DynamicTree
+{
+public:
+	b2DynamicTree();
+	~b2DynamicTree();
+
+	/// Create a leaf for a proxy. Returns the node id.
+	int32 CreateProxy(const b2AABB& aabb, int32 proxyId);
+
+	/// Destroy a leaf.
+	void DestroyProxy(int32 nodeId);
+
+	/// Move a leaf to a new AABB. Returns true if the leaf was reinserted
+	/// with a new fat AABB, false if the old fat AABB still contains aabb.
+	/// The new fat AABB is extended along the displacement of the proxy.
+	bool MoveProxy(int32 nodeId, const b2AABB& aabb, const b2Vec2& displacement);
+
+	/// Get the proxy stored in a leaf.
+	int32 GetProxyId(int32 nodeId) const;
+
+	/// Get the fat AABB of a leaf.
+	const b2AABB& GetFatAABB(int32 nodeId) const;
+
+	/// Call callback->QueryCallback(proxyId) for every leaf whose fat AABB
+	/// overlaps aabb.
+	template <typename T>
+	void Query(T* callback, const b2AABB& aabb) const;
+
+	/// Get the height of the tree. Zero for a single leaf.
+	int32 GetHeight() const;
+
+	/// Check the links, heights and bounds of every node.
+	void Validate() const;
+
+	int32 m_root;
+
+	b2TreeNode* m_nodes;
+	int32 m_nodeCount;
+	int32 m_nodeCapacity;
+
+	int32 m_freeList;
+
+private:
+	b2DynamicTree(const b2DynamicTree&);
+	void operator=(const b2DynamicTree&);
+
+	int32 AllocateNode();
+	void FreeNode(int32 nodeId);
+
+	void InsertLeaf(int32 leaf);
+	void RemoveLeaf(int32 leaf);
+
+	int32 Balance(int32 index);
+
+	int32 ComputeHeight(int32 nodeId) const;
+	void ValidateStructure(int32 index) const;
+	void ValidateMetrics(int32 index) const;
+};
+
+inline int32 b2DynamicTree::GetProxyId(int32 nodeId) const
+{
+	b2Assert(0 <= nodeId && nodeId < m_nodeCapacity);
+	return m_nodes[nodeId].proxyId;
+}
+
+inline const b2AABB& b2DynamicTree::GetFatAABB(int32 nodeId) const
+{
+	b2Assert(0 <= nodeId && nodeId < m_nodeCapacity);
+	return m_nodes[nodeId].aabb;
+}
+
+inline int32 b2DynamicTree::GetHeight() const
+{
+	if (m_root == b2_nullNode)
+	{
+		return 0;
+	}
+
+	return m_nodes[m_root].height;
+}
+
+template <typename T>
+inline void b2DynamicTree::Query(T* callback, const b2AABB& aabb) const
+{
+	int32 stack[b2_treeStackSize];
+	int32 count = 0;
+	stack[count++] = m_root;
+
+	while (count > 0)
+	{
+		int32 nodeId = stack[--count];
+		if (nodeId == b2_nullNode)
+		{
+			continue;
+		}
+
+		const b2TreeNode* node = m_nodes + nodeId;
+
+		if (b2TestOverlap(node->aabb, aabb))
+		{
+			if (node->IsLeaf())
+			{
+				callback->QueryCallback(node->proxyId);
+			}
+			else
+			{
+				b2Assert(count + 2 <= b2_treeStackSize);
+				stack[count++] = node->child1;
+				stack[count++] = node->child2;
+			}
+		}
+	}
+}
+
+#endif
@@ -15,17 +15,26 @@
 * misrepresented as being the original software.
 * 3. This notice may not be removed or altered from any source distribution.
 */
-
 #include "b2PairManager.h"
 #include "b2BroadPhase.h"
 
 #include <algorithm>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define B2_PAIR_SSE2
+#include <emmintrin.h>
+#endif
+
+// Control bytes. A full slot holds the low 7 bits of the hash of its pair.
+const int8 b2_slotEmpty = -128;
+const int8 b2_slotDeleted = -2;
 
 // Thomas Wang's hash, see: http://www.concentric.net/~Ttwang/tech/inthash.htm
-// This assumes proxyId1 and proxyId2 are 16-bit.
+// The high half of proxyId2 is folded in so that ids above 16 bits still spread.
 inline uint32 Hash(uint32 proxyId1, uint32 proxyId2)
 {
-	uint32 key = (proxyId2 << 16) | proxyId1;
+	uint32 key = (proxyId2 << 16) ^ (proxyId2 >> 16) ^ proxyId1;
 	key = ~key + (key << 15);
 	key = key ^ (key >> 12);
 	key = key + (key << 2);
@@ -40,82 +49,253 @@ inline bool Equals(const b2Pair& pair, int32 proxyId1, int32 proxyId2)
 	return pair.proxyId1 == proxyId1 && pair.proxyId2 == proxyId2;
 }
 
-inline bool Equals(const b2BufferedPair& pair1, const b2BufferedPair& pair2)
+// Bit i is set if control[i] == value.
+inline uint32 MatchGroup(const int8* control, int8 value)
 {
-	return pair1.proxyId1 == pair2.proxyId1 && pair1.proxyId2 == pair2.proxyId2;
+#ifdef B2_PAIR_SSE2
+	__m128i group = _mm_loadu_si128((const __m128i*)control);
+	return (uint32)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(value)));
+#else
+	uint32 mask = 0;
+	for (int32 i = 0; i < b2_pairGroupSize; ++i)
+	{
+		if (control[i] == value)
+		{
+			mask |= 1u << i;
+		}
+	}
+	return mask;
+#endif
 }
 
-// For sorting.
-inline bool operator < (const b2BufferedPair& pair1, const b2BufferedPair& pair2)
+// Bit i is set if slot i is empty or deleted.
+inline uint32 MatchFree(const int8* control)
 {
-	if (pair1.proxyId1 < pair2.proxyId1)
+#ifdef B2_PAIR_SSE2
+	__m128i group = _mm_loadu_si128((const __m128i*)control);
+	return (uint32)_mm_movemask_epi8(group);
+#else
+	uint32 mask = 0;
+	for (int32 i = 0; i < b2_pairGroupSize; ++i)
 	{
-		return true;
+		if (control[i] < 0)
+		{
+			mask |= 1u << i;
+		}
 	}
+	return mask;
+#endif
+}
 
-	if (pair1.proxyId1 == pair2.proxyId1)
+// Index of the lowest set bit, mask must not be zero.
+inline int32 LowestBit(uint32 mask)
+{
+#if defined(__GNUC__)
+	return __builtin_ctz(mask);
+#else
+	int32 i = 0;
+	while ((mask & 1) == 0)
 	{
-		return pair1.proxyId2 < pair2.proxyId2;
+		mask >>= 1;
+		++i;
 	}
-
-	return false;
+	return i;
+#endif
 }
 
+// The groups are probed in triangular steps, which visits every group of a
+// power of two sized table.
+inline int32 FirstGroup(uint32 hash, int32 groupMask)
+{
+	return (int32)(hash >> 7) & groupMask;
+}
 
 b2PairManager::b2PairManager()
 {
-	b2Assert(b2IsPowerOfTwo(b2_tableCapacity) == true);
-	b2Assert(b2_tableCapacity >= b2_maxPairs);
-	for (int32 i = 0; i < b2_tableCapacity; ++i)
-	{
-		m_hashTable[i] = b2_nullPair;
-	}
+	m_broadPhase = NULL;
+	m_callback = NULL;
+	m_pairs = NULL;
+	m_pairCapacity = 0;
+	m_freePair = b2_nullPair;
+	m_pairCount = 0;
+	m_pairBuffer = NULL;
+	m_pairBufferCount = 0;
+	m_control = NULL;
+	m_table = NULL;
+	m_tableCapacity = 0;
+	m_deletedCount = 0;
+}
+
+b2PairManager::~b2PairManager()
+{
+	b2Free(m_pairs);
+	b2Free(m_pairBuffer);
+	b2Free(m_control);
+	b2Free(m_table);
+}
+
+void b2PairManager::Initialize(b2BroadPhase* broadPhase, b2PairCallback* callback, int32 pairCapacity)
+{
+	b2Assert(b2IsPowerOfTwo(pairCapacity) == true);
+	b2Assert(2 * pairCapacity >= b2_pairGroupSize);
+	b2Assert(m_pairs == NULL);
+
+	m_broadPhase = broadPhase;
+	m_callback = callback;
+
+	m_pairCapacity = pairCapacity;
+	m_pairs = (b2Pair*)b2Alloc(m_pairCapacity * sizeof(b2Pair));
+	m_pairBuffer = (int32*)b2Alloc(m_pairCapacity * sizeof(int32));
+
+	m_tableCapacity = 2 * m_pairCapacity;
+	m_control = (int8*)b2Alloc(m_tableCapacity * sizeof(int8));
+	m_table = (int32*)b2Alloc(m_tableCapacity * sizeof(int32));
+	memset(m_control, b2_slotEmpty, m_tableCapacity * sizeof(int8));
+	m_deletedCount = 0;
+
 	m_freePair = 0;
-	for (int32 i = 0; i < b2_maxPairs; ++i)
+	for (int32 i = 0; i < m_pairCapacity; ++i)
 	{
 		m_pairs[i].proxyId1 = b2_nullProxy;
 		m_pairs[i].proxyId2 = b2_nullProxy;
 		m_pairs[i].userData = NULL;
 		m_pairs[i].status = 0;
-		m_pairs[i].next = uint16(i + 1);
+		m_pairs[i].next = i + 1;
 	}
-	m_pairs[b2_maxPairs-1].next = b2_nullPair;
+	m_pairs[m_pairCapacity-1].next = b2_nullPair;
 	m_pairCount = 0;
 	m_pairBufferCount = 0;
 }
 
-void b2PairManager::Initialize(b2BroadPhase* broadPhase, b2PairCallback* callback)
+// Only called when every pair is in use, so the new pairs become the free list.
+// Pair indices do not change, the buffered pairs stay valid.
+void b2PairManager::Grow()
 {
-	m_broadPhase = broadPhase;
-	m_callback = callback;
+	b2Assert(m_freePair == b2_nullPair && m_pairCount == m_pairCapacity);
+
+	int32 oldCapacity = m_pairCapacity;
+	m_pairCapacity = 2 * oldCapacity;
+
+	b2Pair* pairs = (b2Pair*)b2Alloc(m_pairCapacity * sizeof(b2Pair));
+	memcpy(pairs, m_pairs, oldCapacity * sizeof(b2Pair));
+	b2Free(m_pairs);
+	m_pairs = pairs;
+
+	int32* pairBuffer = (int32*)b2Alloc(m_pairCapacity * sizeof(int32));
+	memcpy(pairBuffer, m_pairBuffer, m_pairBufferCount * sizeof(int32));
+	b2Free(m_pairBuffer);
+	m_pairBuffer = pairBuffer;
+
+	for (int32 i = oldCapacity; i < m_pairCapacity; ++i)
+	{
+		m_pairs[i].proxyId1 = b2_nullProxy;
+		m_pairs[i].proxyId2 = b2_nullProxy;
+		m_pairs[i].userData = NULL;
+		m_pairs[i].status = 0;
+		m_pairs[i].next = i + 1;
+	}
+	m_pairs[m_pairCapacity-1].next = b2_nullPair;
+	m_freePair = oldCapacity;
+
+	b2Free(m_control);
+	b2Free(m_table);
+	m_tableCapacity = 2 * m_pairCapacity;
+	m_control = (int8*)b2Alloc(m_tableCapacity * sizeof(int8));
+	m_table = (int32*)b2Alloc(m_tableCapacity * sizeof(int32));
+
+	Rehash();
 }
 
-b2Pair* b2PairManager::Find(int32 proxyId1, int32 proxyId2, uint32 hash)
+void b2PairManager::Rehash()
 {
-	int32 index = m_hashTable[hash];
+	memset(m_control, b2_slotEmpty, m_tableCapacity * sizeof(int8));
+	m_deletedCount = 0;
 
-	while (index != b2_nullPair && Equals(m_pairs[index], proxyId1, proxyId2) == false)
+	for (int32 i = 0; i < m_pairCapacity; ++i)
 	{
-		index = m_pairs[index].next;
+		b2Pair* pair = m_pairs + i;
+		if (pair->proxyId1 != b2_nullProxy)
+		{
+			InsertSlot(i, Hash(pair->proxyId1, pair->proxyId2));
+		}
 	}
+}
+
+// Puts a pair into the first free slot on its probe sequence. The pair must
+// not be in the table.
+void b2PairManager::InsertSlot(int32 pairIndex, uint32 hash)
+{
+	int32 groupMask = m_tableCapacity / b2_pairGroupSize - 1;
+	int32 group = FirstGroup(hash, groupMask);
 
-	if (index == b2_nullPair)
+	for (int32 step = 1; ; ++step)
 	{
-		return NULL;
+		int32 base = group * b2_pairGroupSize;
+		uint32 free = MatchFree(m_control + base);
+		if (free != 0)
+		{
+			int32 slot = base + LowestBit(free);
+			if (m_control[slot] == b2_slotDeleted)
+			{
+				--m_deletedCount;
+			}
+
+			m_control[slot] = (int8)(hash & 0x7F);
+			m_table[slot] = pairIndex;
+			return;
+		}
+
+		group = (group + step) & groupMask;
 	}
+}
 
-	b2Assert(index < b2_maxPairs);
+int32 b2PairManager::FindSlot(int32 proxyId1, int32 proxyId2, uint32 hash) const
+{
+	int32 groupMask = m_tableCapacity / b2_pairGroupSize - 1;
+	int32 group = FirstGroup(hash, groupMask);
+	int8 tag = (int8)(hash & 0x7F);
+
+	// The table is never full, so some group has an empty slot.
+	for (int32 step = 1; ; ++step)
+	{
+		int32 base = group * b2_pairGroupSize;
+		const int8* control = m_control + base;
 
-	return m_pairs + index;
+		uint32 match = MatchGroup(control, tag);
+		while (match != 0)
+		{
+			int32 slot = base + LowestBit(match);
+			if (Equals(m_pairs[m_table[slot]], proxyId1, proxyId2))
+			{
+				return slot;
+			}
+
+			match &= match - 1;
+		}
+
+		// A pair is never inserted beyond a group with an empty slot.
+		if (MatchGroup(control, b2_slotEmpty) != 0)
+		{
+			return -1;
+		}
+
+		group = (group + step) & groupMask;
+	}
 }
 
 b2Pair* b2PairManager::Find(int32 proxyId1, int32 proxyId2)
 {
 	if (proxyId1 > proxyId2) b2Swap(proxyId1, proxyId2);
 
-	int32 hash = Hash(proxyId1, proxyId2) & b2_tableMask;
+	int32 slot = FindSlot(proxyId1, proxyId2, Hash(proxyId1, proxyId2));
+	if (slot == -1)
+	{
+		return NULL;
+	}
+
+	b2Assert(m_table[slot] < m_pairCapacity);
 
-	return Find(proxyId1, proxyId2, hash);
+	return m_pairs + m_table[slot];
 }
 
 // Returns existing pair or creates a new one.
@@ -123,30 +303,43 @@ b2Pair* b2PairManager::AddPair(int32 proxyId1, int32 proxyId2)
 {
 	if (proxyId1 > proxyId2) b2Swap(proxyId1, proxyId2);
 
-	int32 hash = Hash(proxyId1, proxyId2) & b2_tableMask;
+	uint32 hash = Hash(proxyId1, proxyId2);
+
+	int32 slot = FindSlot(proxyId1, proxyId2, hash);
+	if (slot != -1)
+	{
+		return m_pairs + m_table[slot];
+	}
 
-	b2Pair* pair = Find(proxyId1, proxyId2, hash);
-	if (pair != NULL)
+	if (m_freePair == b2_nullPair)
 	{
-		return pair;
+		Grow();
 	}
 
-	b2Assert(m_pairCount < b2_maxPairs && m_freePair != b2_nullPair);
+	b2Assert(m_pairCount < m_pairCapacity && m_freePair != b2_nullPair);
 
-	uint16 pairIndex = m_freePair;
-	pair = m_pairs + pairIndex;
+	int32 pairIndex = m_freePair;
+	b2Pair* pair = m_pairs + pairIndex;
 	m_freePair = pair->next;
 
-	pair->proxyId1 = (uint16)proxyId1;
-	pair->proxyId2 = (uint16)proxyId2;
+	pair->proxyId1 = proxyId1;
+	pair->proxyId2 = proxyId2;
 	pair->status = 0;
 	pair->userData = NULL;
-	pair->next = m_hashTable[hash];
-
-	m_hashTable[hash] = pairIndex;
+	pair->next = b2_nullPair;
 
 	++m_pairCount;
 
+	// Keep at least a quarter of the slots empty so probes stay short.
+	if (4 * (m_pairCount + m_deletedCount) > 3 * m_tableCapacity)
+	{
+		Rehash();
+	}
+	else
+	{
+		InsertSlot(pairIndex, hash);
+	}
+
 	return pair;
 }
 
@@ -157,38 +350,40 @@ void* b2PairManager::RemovePair(int32 proxyId1, int32 proxyId2)
 
 	if (proxyId1 > proxyId2) b2Swap(proxyId1, proxyId2);
 
-	int32 hash = Hash(proxyId1, proxyId2) & b2_tableMask;
+	int32 slot = FindSlot(proxyId1, proxyId2, Hash(proxyId1, proxyId2));
+	if (slot == -1)
+	{
+		b2Assert(false);
+		return NULL;
+	}
 
-	uint16* node = &m_hashTable[hash];
-	while (*node != b2_nullPair)
+	// A probe never goes past a group with an empty slot, so in such a
+	// group the slot can be emptied. Otherwise it must stay occupied.
+	int32 base = slot & ~(b2_pairGroupSize - 1);
+	if (MatchGroup(m_control + base, b2_slotEmpty) != 0)
 	{
-		if (Equals(m_pairs[*node], proxyId1, proxyId2))
-		{
-			uint16 index = *node;
-			*node = m_pairs[*node].next;
-			
-			b2Pair* pair = m_pairs + index;
-			void* userData = pair->userData;
-
-			// Scrub
-			pair->next = m_freePair;
-			pair->proxyId1 = b2_nullProxy;
-			pair->proxyId2 = b2_nullProxy;
-			pair->userData = NULL;
-			pair->status = 0;
-
-			m_freePair = index;
-			--m_pairCount;
-			return userData;
-		}
-		else
-		{
-			node = &m_pairs[*node].next;
-		}
+		m_control[slot] = b2_slotEmpty;
+	}
+	else
+	{
+		m_control[slot] = b2_slotDeleted;
+		++m_deletedCount;
 	}
 
-	b2Assert(false);
-	return NULL;
+	int32 index = m_table[slot];
+	b2Pair* pair = m_pairs + index;
+	void* userData = pair->userData;
+
+	// Scrub
+	pair->next = m_freePair;
+	pair->proxyId1 = b2_nullProxy;
+	pair->proxyId2 = b2_nullProxy;
+	pair->userData = NULL;
+	pair->status = 0;
+
+	m_freePair = index;
+	--m_pairCount;
+	return userData;
 }
 
 /*
@@ -210,7 +405,7 @@ If the added pair is not a new pair, then it must be in the pair buffer (because
 void b2PairManager::AddBufferedPair(int32 id1, int32 id2)
 {
 	b2Assert(id1 != b2_nullProxy && id2 != b2_nullProxy);
-	b2Assert(m_pairBufferCount < b2_maxPairs);
+	b2Assert(m_pairBufferCount < m_pairCapacity);
 
 	b2Pair* pair = AddPair(id1, id2);
 
@@ -222,8 +417,7 @@ void b2PairManager::AddBufferedPair(int32 id1, int32 id2)
 
 		// Add it to the pair buffer.
 		pair->SetBuffered();
-		m_pairBuffer[m_pairBufferCount].proxyId1 = pair->proxyId1;
-		m_pairBuffer[m_pairBufferCount].proxyId2 = pair->proxyId2;
+		m_pairBuffer[m_pairBufferCount] = (int32)(pair - m_pairs);
 		++m_pairBufferCount;
 
 		b2Assert(m_pairBufferCount <= m_pairCount);
@@ -242,7 +436,7 @@ void b2PairManager::AddBufferedPair(int32 id1, int32 id2)
 void b2PairManager::RemoveBufferedPair(int32 id1, int32 id2)
 {
 	b2Assert(id1 != b2_nullProxy && id2 != b2_nullProxy);
-	b2Assert(m_pairBufferCount < b2_maxPairs);
+	b2Assert(m_pairBufferCount < m_pairCapacity);
 
 	b2Pair* pair = Find(id1, id2);
 
@@ -259,8 +453,7 @@ void b2PairManager::RemoveBufferedPair(int32 id1, int32 id2)
 		b2Assert(pair->IsFinal() == true);
 
 		pair->SetBuffered();
-		m_pairBuffer[m_pairBufferCount].proxyId1 = pair->proxyId1;
-		m_pairBuffer[m_pairBufferCount].proxyId2 = pair->proxyId2;
+		m_pairBuffer[m_pairBufferCount] = (int32)(pair - m_pairs);
 		++m_pairBufferCount;
 
 		b2Assert(m_pairBufferCount <= m_pairCount);
@@ -282,11 +475,11 @@ void b2PairManager::Commit()
 
 	for (int32 i = 0; i < m_pairBufferCount; ++i)
 	{
-		b2Pair* pair = Find(m_pairBuffer[i].proxyId1, m_pairBuffer[i].proxyId2);
+		b2Pair* pair = m_pairs + m_pairBuffer[i];
 		b2Assert(pair->IsBuffered());
 		pair->ClearBuffered();
 
-		b2Assert(pair->proxyId1 < b2_maxProxies && pair->proxyId2 < b2_maxProxies);
+		b2Assert(pair->proxyId1 < m_broadPhase->m_proxyCapacity && pair->proxyId2 < m_broadPhase->m_proxyCapacity);
 
 		b2Proxy* proxy1 = proxies + pair->proxyId1;
 		b2Proxy* proxy2 = proxies + pair->proxyId2;
@@ -304,9 +497,8 @@ void b2PairManager::Commit()
 				m_callback->PairRemoved(proxy1->userData, proxy2->userData, pair->userData);
 			}
 
-			// Store the ids so we can actually remove the pair below.
-			m_pairBuffer[removeCount].proxyId1 = pair->proxyId1;
-			m_pairBuffer[removeCount].proxyId2 = pair->proxyId2;
+			// Store the pair so we can actually remove it below.
+			m_pairBuffer[removeCount] = m_pairBuffer[i];
 			++removeCount;
 		}
 		else
@@ -323,7 +515,8 @@ void b2PairManager::Commit()
 
 	for (int32 i = 0; i < removeCount; ++i)
 	{
-		RemovePair(m_pairBuffer[i].proxyId1, m_pairBuffer[i].proxyId2);
+		b2Pair* pair = m_pairs + m_pairBuffer[i];
+		RemovePair(pair->proxyId1, pair->proxyId2);
 	}
 
 	m_pairBufferCount = 0;
@@ -345,15 +538,16 @@ void b2PairManager::ValidateBuffer()
 	{
 		if (i > 0)
 		{
-			b2Assert(Equals(m_pairBuffer[i], m_pairBuffer[i-1]) == false);
+			b2Assert(m_pairBuffer[i] != m_pairBuffer[i-1]);
 		}
 
-		b2Pair* pair = Find(m_pairBuffer[i].proxyId1, m_pairBuffer[i].proxyId2);
+		b2Pair* pair = m_pairs + m_pairBuffer[i];
 		b2Assert(pair->IsBuffered());
+		b2Assert(Find(pair->proxyId1, pair->proxyId2) == pair);
 
 		b2Assert(pair->proxyId1 != pair->proxyId2);
-		b2Assert(pair->proxyId1 < b2_maxProxies);
-		b2Assert(pair->proxyId2 < b2_maxProxies);
+		b2Assert(pair->proxyId1 < m_broadPhase->m_proxyCapacity);
+		b2Assert(pair->proxyId2 < m_broadPhase->m_proxyCapacity);
 
 		b2Proxy* proxy1 = m_broadPhase->m_proxyPool + pair->proxyId1;
 		b2Proxy* proxy2 = m_broadPhase->m_proxyPool + pair->proxyId2;
@@ -367,30 +561,42 @@ void b2PairManager::ValidateBuffer()
 void b2PairManager::ValidateTable()
 {
 #ifdef _DEBUG
-	for (int32 i = 0; i < b2_tableCapacity; ++i)
+	int32 count = 0;
+	int32 deletedCount = 0;
+	for (int32 i = 0; i < m_tableCapacity; ++i)
 	{
-		uint16 index = m_hashTable[i];
-		while (index != b2_nullPair)
+		if (m_control[i] == b2_slotDeleted)
 		{
-			b2Pair* pair = m_pairs + index;
-			b2Assert(pair->IsBuffered() == false);
-			b2Assert(pair->IsFinal() == true);
-			b2Assert(pair->IsRemoved() == false);
+			++deletedCount;
+		}
 
-			b2Assert(pair->proxyId1 != pair->proxyId2);
-			b2Assert(pair->proxyId1 < b2_maxProxies);
-			b2Assert(pair->proxyId2 < b2_maxProxies);
+		if (m_control[i] < 0)
+		{
+			continue;
+		}
 
-			b2Proxy* proxy1 = m_broadPhase->m_proxyPool + pair->proxyId1;
-			b2Proxy* proxy2 = m_broadPhase->m_proxyPool + pair->proxyId2;
+		b2Pair* pair = m_pairs + m_table[i];
+		b2Assert(pair->IsBuffered() == false);
+		b2Assert(pair->IsFinal() == true);
+		b2Assert(pair->IsRemoved() == false);
+		b2Assert(m_control[i] == (int8)(Hash(pair->proxyId1, pair->proxyId2) & 0x7F));
+		b2Assert(FindSlot(pair->proxyId1, pair->proxyId2, Hash(pair->proxyId1, pair->proxyId2)) == i);
 
-			b2Assert(proxy1->IsValid() == true);
-			b2Assert(proxy2->IsValid() == true);
+		b2Assert(pair->proxyId1 < pair->proxyId2);
+		b2Assert(pair->proxyId2 < m_broadPhase->m_proxyCapacity);
 
-			b2Assert(m_broadPhase->TestOverlap(proxy1, proxy2) == true);
+		b2Proxy* proxy1 = m_broadPhase->m_proxyPool + pair->proxyId1;
+		b2Proxy* proxy2 = m_broadPhase->m_proxyPool + pair->proxyId2;
 
-			index = pair->next;
-		}
+		b2Assert(proxy1->IsValid() == true);
+		b2Assert(proxy2->IsValid() == true);
+
+		b2Assert(m_broadPhase->TestOverlap(proxy1, proxy2) == true);
+
+		++count;
 	}
+
+	b2Assert(count == m_pairCount);
+	b2Assert(deletedCount == m_deletedCount);
 #endif
 }
@@ -19,6 +19,10 @@
 // The pair manager is used by the broad-phase to quickly add/remove/find pairs
 // of overlapping proxies. It is based closely on code provided by Pierre Terdiman.
 // http://www.codercorner.com/IncrementalSAP.txt
+// The pairs are found through an open addressing hash table. Each slot has a
+// control byte holding 7 bits of the hash, so a probe compares a whole group of
+// slots at once (with SSE2 where available) and only touches the pairs whose
+// hash bits match.
 
 #ifndef B2_PAIR_MANAGER_H
 #define B2_PAIR_MANAGER_H
@@ -26,15 +30,14 @@
 #include "../Common/b2Settings.h"
 #include "../Common/b2Math.h"
 
-#include <climits>
-
 class b2BroadPhase;
 struct b2Proxy;
 
-const uint16 b2_nullPair = USHRT_MAX;
-const uint16 b2_nullProxy = USHRT_MAX;
-const int32 b2_tableCapacity = b2_maxPairs;	// must be a power of two
-const int32 b2_tableMask = b2_tableCapacity - 1;
+const int32 b2_nullPair = -1;
+const int32 b2_nullProxy = -1;
+
+/// The hash table is probed this many slots at a time.
+const int32 b2_pairGroupSize = 16;
 
 struct b2Pair
 {
@@ -57,18 +60,12 @@ struct b2Pair
 	bool IsFinal()		{ return (status & e_pairFinal) == e_pairFinal; }
 
 	void* userData;
-	uint16 proxyId1;
-	uint16 proxyId2;
-	uint16 next;
+	int32 proxyId1;
+	int32 proxyId2;
+	int32 next;		// free list
 	uint16 status;
 };
 
-struct b2BufferedPair
-{
-	uint16 proxyId1;
-	uint16 proxyId2;
-};
-
 class b2PairCallback
 {
 public:
@@ -87,8 +84,9 @@ class b2PairManager
 {
 public:
 	b2PairManager();
+	~b2PairManager();
 
-	void Initialize(b2BroadPhase* broadPhase, b2PairCallback* callback);
+	void Initialize(b2BroadPhase* broadPhase, b2PairCallback* callback, int32 pairCapacity);
 
 	void AddBufferedPair(int32 proxyId1, int32 proxyId2);
 	void RemoveBufferedPair(int32 proxyId1, int32 proxyId2);
@@ -96,26 +94,42 @@ public:
 	void Commit();
 
 private:
+	friend class b2BroadPhase;
+
 	b2Pair* Find(int32 proxyId1, int32 proxyId2);
-	b2Pair* Find(int32 proxyId1, int32 proxyId2, uint32 hashValue);
+
+	// Returns the table slot of a pair, or -1.
+	int32 FindSlot(int32 proxyId1, int32 proxyId2, uint32 hashValue) const;
 
 	b2Pair* AddPair(int32 proxyId1, int32 proxyId2);
 	void* RemovePair(int32 proxyId1, int32 proxyId2);
 
+	// Double the pair pool and the hash table.
+	void Grow();
+
+	// Insert every pair into an empty table. Also drops the deleted slots.
+	void Rehash();
+
+	void InsertSlot(int32 pairIndex, uint32 hashValue);
+
 	void ValidateBuffer();
 	void ValidateTable();
 
 public:
 	b2BroadPhase *m_broadPhase;
 	b2PairCallback *m_callback;
-	b2Pair m_pairs[b2_maxPairs];
-	uint16 m_freePair;
+	b2Pair* m_pairs;
+	int32 m_pairCapacity;	// a power of two
+	int32 m_freePair;
 	int32 m_pairCount;
 
-	b2BufferedPair m_pairBuffer[b2_maxPairs];
+	int32* m_pairBuffer;	// pair indices, pairs do not move while buffered
 	int32 m_pairBufferCount;
 
-	uint16 m_hashTable[b2_tableCapacity];
+	int8* m_control;		// per slot: hash bits, empty or deleted
+	int32* m_table;			// per slot: pair index
+	int32 m_tableCapacity;	// twice the pair capacity
+	int32 m_deletedCount;
 };
 
 #endif
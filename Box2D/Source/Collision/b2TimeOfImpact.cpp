@@ -23,7 +23,8 @@
 // impact (TOI) of two shapes.
 // Refs: Bullet, Young Kim
 float32 b2TimeOfImpact(const b2Shape* shape1, const b2Sweep& sweep1,
-					   const b2Shape* shape2, const b2Sweep& sweep2)
+					   const b2Shape* shape2, const b2Sweep& sweep2,
+					   b2SimplexCache* cache, b2DistanceStats* stats)
 {
 	float32 r1 = shape1->GetSweepRadius();
 	float32 r2 = shape2->GetSweepRadius();
@@ -53,7 +54,7 @@ float32 b2TimeOfImpact(const b2Shape* shape1, const b2Sweep& sweep1,
 		sweep2.GetXForm(&xf2, t);
 
 		// Get the distance between shapes.
-		distance = b2Distance(&p1, &p2, shape1, xf1, shape2, xf2);
+		distance = b2Distance(&p1, &p2, shape1, xf1, shape2, xf2, cache, stats);
 
 		if (iter == 0)
 		{
@@ -0,0 +1,133 @@
+/*
+* Copyright (c) 2006-2007 Erin Catto http://www.gphysics.com
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "b2Allocator.h"
+#include "b2Math.h"
+
+// Rounds a size up to b2_allocAlignment.
+inline int32 b2AlignSize(int32 size)
+{
+	return (size + b2_allocAlignment - 1) & ~(b2_allocAlignment - 1);
+}
+
+void* b2HeapAllocator::Allocate(int32 size)
+{
+	b2AtomicAdd(&m_byteCount, size);
+	return b2Alloc(size);
+}
+
+void b2HeapAllocator::Free(void* p, int32 size)
+{
+	if (p == NULL)
+	{
+		return;
+	}
+
+	b2Assert(b2AtomicAdd(&m_byteCount, 0) >= size);
+	b2AtomicAdd(&m_byteCount, -size);
+	b2Free(p);
+}
+
+b2ArenaAllocator::b2ArenaAllocator(int32 blockSize)
+{
+	m_blocks = NULL;
+	m_blockSize = blockSize;
+	m_reservedCount = 0;
+}
+
+b2ArenaAllocator::~b2ArenaAllocator()
+{
+	while (m_blocks)
+	{
+		b2ArenaBlock* block = m_blocks;
+		m_blocks = block->next;
+		b2Free(block);
+	}
+}
+
+void* b2ArenaAllocator::Allocate(int32 size)
+{
+	const int32 headerSize = b2AlignSize(sizeof(b2ArenaBlock));
+	int32 alignedSize = b2AlignSize(size);
+
+	b2ArenaBlock* block = m_blocks;
+	if (block == NULL || block->used + alignedSize > block->size)
+	{
+		int32 blockSize = b2Max(m_blockSize, headerSize + alignedSize);
+		block = (b2ArenaBlock*)b2Alloc(blockSize);
+		block->size = blockSize;
+		block->used = headerSize;
+		m_reservedCount += blockSize;
+
+		// A block of its own for a large request goes behind the current
+		// block, so the current one keeps being filled.
+		if (m_blocks != NULL && blockSize > m_blockSize)
+		{
+			block->next = m_blocks->next;
+			m_blocks->next = block;
+		}
+		else
+		{
+			block->next = m_blocks;
+			m_blocks = block;
+		}
+	}
+
+	char* p = (char*)block + block->used;
+	block->used += alignedSize;
+	m_byteCount += size;
+	return p;
+}
+
+void b2ArenaAllocator::Free(void* p, int32 size)
+{
+	if (p == NULL)
+	{
+		return;
+	}
+
+	b2Assert(m_byteCount >= size);
+	m_byteCount -= size;
+
+	// Only the last allocation of the current block can be taken back.
+	b2ArenaBlock* block = m_blocks;
+	int32 alignedSize = b2AlignSize(size);
+	if ((char*)p + alignedSize == (char*)block + block->used)
+	{
+		block->used -= alignedSize;
+	}
+}
+
+void b2ArenaAllocator::Reset()
+{
+	if (m_blocks == NULL)
+	{
+		return;
+	}
+
+	while (m_blocks->next)
+	{
+		b2ArenaBlock* block = m_blocks->next;
+		m_blocks->next = block->next;
+		m_reservedCount -= block->size;
+		b2Free(block);
+	}
+
+	m_blocks->used = b2AlignSize(sizeof(b2ArenaBlock));
+	m_byteCount = 0;
+}
@@ -0,0 +1,92 @@
+/*
+* Copyright (c) 2006-2007 Erin Catto http://www.gphysics.com
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef B2_ALLOCATOR_H
+#define B2_ALLOCATOR_H
+
+#include "b2Settings.h"
+
+const int32 b2_arenaBlockSize = 64 * 1024;	// 64k
+
+/// Heap memory of a world. The block allocator takes its chunks and the stack
+/// allocator its overflow from here, so a world can be given its own memory
+/// and its own byte count. Allocations are aligned to b2_allocAlignment.
+class b2Allocator
+{
+public:
+	b2Allocator() : m_byteCount(0) {}
+	virtual ~b2Allocator() {}
+
+	/// Allocate size bytes.
+	virtual void* Allocate(int32 size) = 0;
+
+	/// Free memory from Allocate. The size must be the one given to Allocate.
+	virtual void Free(void* p, int32 size) = 0;
+
+	/// The number of bytes allocated and not yet freed.
+	int32 GetByteCount() const { return m_byteCount; }
+
+protected:
+	volatile int32 m_byteCount;
+};
+
+/// Allocates every request with b2Alloc. This is the default allocator of a
+/// world. It may be used by several threads at once.
+class b2HeapAllocator : public b2Allocator
+{
+public:
+	void* Allocate(int32 size);
+	void Free(void* p, int32 size);
+};
+
+/// A bump allocator. Memory is taken from b2Alloc in large blocks and handed
+/// out in order. Free only gives memory back if it was the last allocation,
+/// everything else stays in use until Reset, which frees it all at once. A world
+/// that uses an arena can be torn down by destroying the world and then the
+/// arena. The arena must not be used by several threads at once.
+class b2ArenaAllocator : public b2Allocator
+{
+public:
+	/// @param blockSize the bytes taken from b2Alloc at a time. Larger
+	/// requests get a block of their own.
+	b2ArenaAllocator(int32 blockSize = b2_arenaBlockSize);
+	~b2ArenaAllocator();
+
+	void* Allocate(int32 size);
+	void Free(void* p, int32 size);
+
+	/// Free all allocations. The current block is kept for reuse.
+	void Reset();
+
+	/// The number of bytes taken from b2Alloc.
+	int32 GetReservedCount() const { return m_reservedCount; }
+
+private:
+	struct b2ArenaBlock
+	{
+		b2ArenaBlock* next;
+		int32 size;
+		int32 used;
+	};
+
+	b2ArenaBlock* m_blocks;		// the current block, followed by the full ones
+	int32 m_blockSize;
+	int32 m_reservedCount;
+};
+
+#endif
@@ -17,6 +17,8 @@
 */
 
 #include "b2BlockAllocator.h"
+#include "b2Allocator.h"
+#include "b2ThreadPool.h"
 #include <cstdlib>
 #include <memory>
 #include <climits>
@@ -53,46 +55,177 @@ struct b2Block
 	b2Block* next;
 };
 
-b2BlockAllocator::b2BlockAllocator()
+// Fill the block size lookup during static initialization so that worlds
+// created on different threads never race on it.
+static struct b2BlockSizeLookupInit
+{
+	b2BlockSizeLookupInit()
+	{
+		b2BlockAllocator::InitializeBlockSizeLookup();
+	}
+} s_blockSizeLookupInit;
+
+void b2BlockAllocator::InitializeBlockSizeLookup()
+{
+	if (s_blockSizeLookupInitialized)
+	{
+		return;
+	}
+
+	int32 j = 0;
+	for (int32 i = 1; i <= b2_maxBlockSize; ++i)
+	{
+		b2Assert(j < b2_blockSizes);
+		if (i <= s_blockSizes[j])
+		{
+			s_blockSizeLookup[i] = (uint8)j;
+		}
+		else
+		{
+			++j;
+			s_blockSizeLookup[i] = (uint8)j;
+		}
+	}
+
+	s_blockSizeLookupInitialized = true;
+}
+
+b2BlockAllocator::b2BlockAllocator(b2Allocator* allocator)
 {
 	b2Assert(b2_blockSizes < UCHAR_MAX);
 
-	m_chunkSpace = b2_chunkArrayIncrement;
-	m_chunkCount = 0;
-	m_chunks = (b2Chunk*)b2Alloc(m_chunkSpace * sizeof(b2Chunk));
-	
-	memset(m_chunks, 0, m_chunkSpace * sizeof(b2Chunk));
-	memset(m_freeLists, 0, sizeof(m_freeLists));
+	m_allocator = allocator;
+	InitializeCache(&m_cache, allocator);
+
+	m_threadCaches = NULL;
+	m_threadCacheCount = 0;
+	m_threadCount = 1;
+
+	memset((void*)m_sharedLists, 0, sizeof(m_sharedLists));
+
+	// A world constructed during static initialization may come first.
+	InitializeBlockSizeLookup();
+}
+
+b2BlockAllocator::~b2BlockAllocator()
+{
+	DestroyCache(&m_cache);
+
+	for (int32 i = 0; i < m_threadCacheCount; ++i)
+	{
+		DestroyCache(m_threadCaches + i);
+	}
+
+	if (m_threadCaches)
+	{
+		b2Free(m_threadCaches);
+	}
+}
+
+void b2BlockAllocator::InitializeCache(b2BlockCache* cache, b2Allocator* allocator)
+{
+	cache->allocator = allocator;
+	cache->chunkSpace = b2_chunkArrayIncrement;
+	cache->chunkCount = 0;
+	cache->chunks = (b2Chunk*)allocator->Allocate(cache->chunkSpace * sizeof(b2Chunk));
+
+	memset(cache->chunks, 0, cache->chunkSpace * sizeof(b2Chunk));
+	memset(cache->freeLists, 0, sizeof(cache->freeLists));
+	memset(cache->freeCounts, 0, sizeof(cache->freeCounts));
+}
+
+void b2BlockAllocator::DestroyCache(b2BlockCache* cache)
+{
+	for (int32 i = 0; i < cache->chunkCount; ++i)
+	{
+		cache->allocator->Free(cache->chunks[i].blocks, b2_chunkSize);
+	}
+
+	cache->allocator->Free(cache->chunks, cache->chunkSpace * sizeof(b2Chunk));
+}
+
+void b2BlockAllocator::SetThreadCount(int32 count, b2Allocator* threadAllocator)
+{
+	b2Assert(count >= 1);
 
-	if (s_blockSizeLookupInitialized == false)
+	if (count - 1 > m_threadCacheCount)
 	{
-		int32 j = 0;
-		for (int32 i = 1; i <= b2_maxBlockSize; ++i)
+		// The caches are plain data, so they can be moved with memcpy.
+		b2BlockCache* oldCaches = m_threadCaches;
+		m_threadCaches = (b2BlockCache*)b2Alloc((count - 1) * sizeof(b2BlockCache));
+		if (oldCaches)
 		{
-			b2Assert(j < b2_blockSizes);
-			if (i <= s_blockSizes[j])
-			{
-				s_blockSizeLookup[i] = (uint8)j;
-			}
-			else
-			{
-				++j;
-				s_blockSizeLookup[i] = (uint8)j;
-			}
+			memcpy(m_threadCaches, oldCaches, m_threadCacheCount * sizeof(b2BlockCache));
+			b2Free(oldCaches);
+		}
+
+		for (int32 i = m_threadCacheCount; i < count - 1; ++i)
+		{
+			InitializeCache(m_threadCaches + i, threadAllocator);
 		}
 
-		s_blockSizeLookupInitialized = true;
+		m_threadCacheCount = count - 1;
+	}
+
+	// The chunks of unused caches stay alive because their blocks may still
+	// be in use. Their free blocks go to the shared lists.
+	for (int32 i = count - 1; i < m_threadCacheCount; ++i)
+	{
+		b2BlockCache* cache = m_threadCaches + i;
+		for (int32 j = 0; j < b2_blockSizes; ++j)
+		{
+			ShareFreeList(cache, j, 0);
+		}
 	}
+
+	m_threadCount = count;
 }
 
-b2BlockAllocator::~b2BlockAllocator()
+inline b2BlockAllocator::b2BlockCache* b2BlockAllocator::GetCache()
+{
+	int32 threadIndex = b2ThreadPool::GetThreadIndex();
+	b2Assert(0 <= threadIndex && threadIndex < m_threadCount);
+	return threadIndex == 0 ? &m_cache : m_threadCaches + threadIndex - 1;
+}
+
+// Keep the first keepCount blocks of the cache's free list, the most recently
+// freed ones, and move the rest to the shared list. Threads only ever push a
+// chain or take a whole shared list, so the compare and swap does not suffer
+// from the ABA problem.
+void b2BlockAllocator::ShareFreeList(b2BlockCache* cache, int32 index, int32 keepCount)
 {
-	for (int32 i = 0; i < m_chunkCount; ++i)
+	b2Block** link = &cache->freeLists[index];
+	for (int32 i = 0; i < keepCount && *link; ++i)
+	{
+		link = &(*link)->next;
+	}
+
+	cache->freeCounts[index] = keepCount;
+
+	b2Block* first = *link;
+	if (first == NULL)
 	{
-		b2Free(m_chunks[i].blocks);
+		return;
+	}
+
+	*link = NULL;
+	b2Block* last = first;
+	while (last->next)
+	{
+		last = last->next;
 	}
 
-	b2Free(m_chunks);
+	b2Block* head = NULL;
+	for (;;)
+	{
+		last->next = head;
+		b2Block* oldHead = (b2Block*)b2AtomicCompareAndSwap((void* volatile*)&m_sharedLists[index], head, first);
+		if (oldHead == head)
+		{
+			break;
+		}
+		head = oldHead;
+	}
 }
 
 void* b2BlockAllocator::Allocate(int32 size)
@@ -105,26 +238,38 @@ void* b2BlockAllocator::Allocate(int32 size)
 	int32 index = s_blockSizeLookup[size];
 	b2Assert(0 <= index && index < b2_blockSizes);
 
-	if (m_freeLists[index])
+	b2BlockCache* cache = GetCache();
+
+	if (cache->freeLists[index] == NULL)
+	{
+		cache->freeLists[index] = (b2Block*)b2AtomicExchange((void* volatile*)&m_sharedLists[index], NULL);
+		cache->freeCounts[index] = 0;
+	}
+
+	if (cache->freeLists[index])
 	{
-		b2Block* block = m_freeLists[index];
-		m_freeLists[index] = block->next;
+		b2Block* block = cache->freeLists[index];
+		cache->freeLists[index] = block->next;
+		if (cache->freeCounts[index] > 0)
+		{
+			--cache->freeCounts[index];
+		}
 		return block;
 	}
 	else
 	{
-		if (m_chunkCount == m_chunkSpace)
+		if (cache->chunkCount == cache->chunkSpace)
 		{
-			b2Chunk* oldChunks = m_chunks;
-			m_chunkSpace += b2_chunkArrayIncrement;
-			m_chunks = (b2Chunk*)b2Alloc(m_chunkSpace * sizeof(b2Chunk));
-			memcpy(m_chunks, oldChunks, m_chunkCount * sizeof(b2Chunk));
-			memset(m_chunks + m_chunkCount, 0, b2_chunkArrayIncrement * sizeof(b2Chunk));
-			b2Free(oldChunks);
+			b2Chunk* oldChunks = cache->chunks;
+			cache->chunkSpace += b2_chunkArrayIncrement;
+			cache->chunks = (b2Chunk*)cache->allocator->Allocate(cache->chunkSpace * sizeof(b2Chunk));
+			memcpy(cache->chunks, oldChunks, cache->chunkCount * sizeof(b2Chunk));
+			memset(cache->chunks + cache->chunkCount, 0, b2_chunkArrayIncrement * sizeof(b2Chunk));
+			cache->allocator->Free(oldChunks, (cache->chunkSpace - b2_chunkArrayIncrement) * sizeof(b2Chunk));
 		}
 
-		b2Chunk* chunk = m_chunks + m_chunkCount;
-		chunk->blocks = (b2Block*)b2Alloc(b2_chunkSize);
+		b2Chunk* chunk = cache->chunks + cache->chunkCount;
+		chunk->blocks = (b2Block*)cache->allocator->Allocate(b2_chunkSize);
 #if defined(_DEBUG)
 		memset(chunk->blocks, 0xcd, b2_chunkSize);
 #endif
@@ -141,8 +286,8 @@ void* b2BlockAllocator::Allocate(int32 size)
 		b2Block* last = (b2Block*)((int8*)chunk->blocks + blockSize * (blockCount - 1));
 		last->next = NULL;
 
-		m_freeLists[index] = chunk->blocks->next;
-		++m_chunkCount;
+		cache->freeLists[index] = chunk->blocks->next;
+		++cache->chunkCount;
 
 		return chunk->blocks;
 	}
@@ -161,46 +306,70 @@ void b2BlockAllocator::Free(void* p, int32 size)
 	b2Assert(0 <= index && index < b2_blockSizes);
 
 #ifdef _DEBUG
-	// Verify the memory address and size is valid.
 	int32 blockSize = s_blockSizes[index];
-	bool found = false;
-	int32 gap = (int32)((int8*)&m_chunks->blocks - (int8*)m_chunks);
-	for (int32 i = 0; i < m_chunkCount; ++i)
+
+	// Verify the memory address and size is valid. This scans every chunk, and
+	// other threads may be growing their chunk arrays, so only do it when
+	// running on one thread.
+	if (m_threadCount == 1)
 	{
-		b2Chunk* chunk = m_chunks + i;
-		if (chunk->blockSize != blockSize)
-		{
-			b2Assert(	(int8*)p + blockSize <= (int8*)chunk->blocks ||
-						(int8*)chunk->blocks + b2_chunkSize + gap <= (int8*)p);
-		}
-		else
+		bool found = false;
+		int32 gap = (int32)((int8*)&m_cache.chunks->blocks - (int8*)m_cache.chunks);
+		for (int32 k = -1; k < m_threadCacheCount; ++k)
 		{
-			if ((int8*)chunk->blocks <= (int8*)p && (int8*)p + blockSize <= (int8*)chunk->blocks + b2_chunkSize)
+			b2BlockCache* owner = k < 0 ? &m_cache : m_threadCaches + k;
+			for (int32 i = 0; i < owner->chunkCount; ++i)
 			{
-				found = true;
+				b2Chunk* chunk = owner->chunks + i;
+				if (chunk->blockSize != blockSize)
+				{
+					b2Assert(	(int8*)p + blockSize <= (int8*)chunk->blocks ||
+								(int8*)chunk->blocks + b2_chunkSize + gap <= (int8*)p);
+				}
+				else
+				{
+					if ((int8*)chunk->blocks <= (int8*)p && (int8*)p + blockSize <= (int8*)chunk->blocks + b2_chunkSize)
+					{
+						found = true;
+					}
+				}
 			}
 		}
-	}
 
-	b2Assert(found);
+		b2Assert(found);
+	}
 
 	memset(p, 0xfd, blockSize);
 #endif
 
+	b2BlockCache* cache = GetCache();
+
 	b2Block* block = (b2Block*)p;
-	block->next = m_freeLists[index];
-	m_freeLists[index] = block;
+	block->next = cache->freeLists[index];
+	cache->freeLists[index] = block;
+
+	if (m_threadCount > 1 && ++cache->freeCounts[index] > 2 * b2_blockCacheSize)
+	{
+		ShareFreeList(cache, index, b2_blockCacheSize);
+	}
 }
 
 void b2BlockAllocator::Clear()
 {
-	for (int32 i = 0; i < m_chunkCount; ++i)
+	for (int32 k = -1; k < m_threadCacheCount; ++k)
 	{
-		b2Free(m_chunks[i].blocks);
-	}
+		b2BlockCache* cache = k < 0 ? &m_cache : m_threadCaches + k;
+		for (int32 i = 0; i < cache->chunkCount; ++i)
+		{
+			cache->allocator->Free(cache->chunks[i].blocks, b2_chunkSize);
+		}
 
-	m_chunkCount = 0;
-	memset(m_chunks, 0, m_chunkSpace * sizeof(b2Chunk));
+		cache->chunkCount = 0;
+		memset(cache->chunks, 0, cache->chunkSpace * sizeof(b2Chunk));
+
+		memset(cache->freeLists, 0, sizeof(cache->freeLists));
+		memset(cache->freeCounts, 0, sizeof(cache->freeCounts));
+	}
 
-	memset(m_freeLists, 0, sizeof(m_freeLists));
+	memset((void*)m_sharedLists, 0, sizeof(m_sharedLists));
 }
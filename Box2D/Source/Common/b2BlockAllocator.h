@@ -21,21 +21,33 @@
 
 #include "b2Settings.h"
 
+class b2Allocator;
+
 const int32 b2_chunkSize = 4096;
 const int32 b2_maxBlockSize = 640;
 const int32 b2_blockSizes = 14;
 const int32 b2_chunkArrayIncrement = 128;
+const int32 b2_blockCacheSize = 64;
 
 struct b2Block;
 struct b2Chunk;
 
 // This is a small object allocator used for allocating small
-// objects that persist for more than one time step.
+// objects that persist for more than one time step. The chunks
+// come from the given allocator.
 // See: http://www.codeproject.com/useritems/Small_Block_Allocator.asp
+//
+// With more than one thread (SetThreadCount) every thread of the world's
+// thread pool has its own cache of chunks and free lists, so allocating and
+// freeing never locks. A thread that frees more than 2 * b2_blockCacheSize
+// blocks of one size keeps the b2_blockCacheSize most recently freed ones
+// and hands the rest to a shared lock-free list, where any thread that runs
+// dry picks them up. A block may be freed
+// by a different thread than the one that allocated it.
 class b2BlockAllocator
 {
 public:
-	b2BlockAllocator();
+	b2BlockAllocator(b2Allocator* allocator);
 	~b2BlockAllocator();
 
 	void* Allocate(int32 size);
@@ -43,13 +55,41 @@ public:
 
 	void Clear();
 
+	/// Set the number of threads that allocate concurrently. The threads are
+	/// identified by b2ThreadPool::GetThreadIndex. The caches of the worker
+	/// threads take their chunks from the given allocator, which must be
+	/// thread safe. Must not be called while other threads allocate.
+	void SetThreadCount(int32 count, b2Allocator* threadAllocator);
+
+	static void InitializeBlockSizeLookup();
+
 private:
 
-	b2Chunk* m_chunks;
-	int32 m_chunkCount;
-	int32 m_chunkSpace;
+	struct b2BlockCache
+	{
+		b2Allocator* allocator;
+
+		b2Chunk* chunks;
+		int32 chunkCount;
+		int32 chunkSpace;
+
+		b2Block* freeLists[b2_blockSizes];
+		int32 freeCounts[b2_blockSizes];	// blocks freed here since the last hand over
+	};
+
+	b2BlockCache* GetCache();
+	void InitializeCache(b2BlockCache* cache, b2Allocator* allocator);
+	void DestroyCache(b2BlockCache* cache);
+	void ShareFreeList(b2BlockCache* cache, int32 index, int32 keepCount);
+
+	b2Allocator* m_allocator;
+
+	b2BlockCache m_cache;				// thread zero
+	b2BlockCache* m_threadCaches;		// threads 1 to m_threadCount - 1, never shrinks
+	int32 m_threadCacheCount;
+	int32 m_threadCount;
 
-	b2Block* m_freeLists[b2_blockSizes];
+	b2Block* volatile m_sharedLists[b2_blockSizes];
 
 	static int32 s_blockSizes[b2_blockSizes];
 	static uint8 s_blockSizeLookup[b2_maxBlockSize + 1];
@@ -18,6 +18,7 @@
 
 #include "b2Settings.h"
 #include <cstdlib>
+#include <pthread.h>
 
 b2Version b2_version = {2, 0, 1};
 
@@ -26,13 +27,16 @@ int32 b2_byteCount = 0;
 
 
 // Memory allocators. Modify these to use your own allocator.
+// The size is kept in a header in front of the memory. The header is as large
+// as the alignment, so the memory stays aligned like the block from malloc.
 void* b2Alloc(int32 size)
 {
-	size += 4;
-	b2_byteCount += size;
+	size += b2_allocAlignment;
+	// Islands may be solved on several threads (b2World::SetThreadCount).
+	b2AtomicAdd(&b2_byteCount, size);
 	char* bytes = (char*)malloc(size);
 	*(int32*)bytes = size;
-	return bytes + 4;
+	return bytes + b2_allocAlignment;
 }
 
 void b2Free(void* mem)
@@ -43,9 +47,73 @@ void b2Free(void* mem)
 	}
 
 	char* bytes = (char*)mem;
-	bytes -= 4;
+	bytes -= b2_allocAlignment;
 	int32 size = *(int32*)bytes;
-	b2Assert(b2_byteCount >= size);
-	b2_byteCount -= size;
+	b2Assert(b2AtomicAdd(&b2_byteCount, 0) >= size);
+	b2AtomicAdd(&b2_byteCount, -size);
 	free(bytes);
 }
+
+#if defined(__GNUC__)
+
+__thread int32 b2_threadIndex = 0;
+
+#else
+
+// Without compiler support every atomic operation takes the same lock. These
+// are only used by the thread pool, the allocators and b2Alloc.
+static pthread_mutex_t s_atomicMutex = PTHREAD_MUTEX_INITIALIZER;
+
+int32 b2AtomicAdd(volatile int32* p, int32 value)
+{
+	pthread_mutex_lock(&s_atomicMutex);
+	int32 old = *p;
+	*p = old + value;
+	pthread_mutex_unlock(&s_atomicMutex);
+	return old;
+}
+
+void* b2AtomicCompareAndSwap(void* volatile* p, void* expected, void* value)
+{
+	pthread_mutex_lock(&s_atomicMutex);
+	void* old = *p;
+	if (old == expected)
+	{
+		*p = value;
+	}
+	pthread_mutex_unlock(&s_atomicMutex);
+	return old;
+}
+
+void* b2AtomicExchange(void* volatile* p, void* value)
+{
+	pthread_mutex_lock(&s_atomicMutex);
+	void* old = *p;
+	*p = value;
+	pthread_mutex_unlock(&s_atomicMutex);
+	return old;
+}
+
+static pthread_key_t s_threadIndexKey;
+static pthread_once_t s_threadIndexOnce = PTHREAD_ONCE_INIT;
+
+static void b2CreateThreadIndexKey()
+{
+	pthread_key_create(&s_threadIndexKey, NULL);
+}
+
+// The index is stored as the key's value, which is NULL (zero) for threads
+// that never set it.
+int32 b2GetThreadIndex()
+{
+	pthread_once(&s_threadIndexOnce, b2CreateThreadIndexKey);
+	return (int32)(size_t)pthread_getspecific(s_threadIndexKey);
+}
+
+void b2SetThreadIndex(int32 index)
+{
+	pthread_once(&s_threadIndexOnce, b2CreateThreadIndexKey);
+	pthread_setspecific(s_threadIndexKey, (void*)(size_t)index);
+}
+
+#endif
@@ -73,8 +73,21 @@ const float32 b2_pi = 3.14159265359f;
 // Collision
 const int32 b2_maxManifoldPoints = 2;
 const int32 b2_maxPolygonVertices = 8;
-const int32 b2_maxProxies = 512;				// this must be a power of two
-const int32 b2_maxPairs = 8 * b2_maxProxies;	// this must be a power of two
+
+/// The broad-phase starts with room for this many proxies and pairs and
+/// doubles its storage whenever it runs out.
+const int32 b2_initialProxyCapacity = 512;
+const int32 b2_initialPairCapacity = 8 * b2_initialProxyCapacity;	// this must be a power of two
+
+/// This is used to fatten AABBs in the dynamic tree broad-phase. This allows proxies
+/// to move by a small amount without triggering a tree adjustment.
+/// This is in meters.
+const float32 b2_aabbExtension = 0.1f;
+
+/// This is used to fatten AABBs in the dynamic tree broad-phase. The fat AABB is
+/// also extended in the direction of motion by this many times the displacement
+/// of the last step, so fast bodies are not reinserted every step.
+const float32 b2_aabbMultiplier = 2.0f;
 
 // Dynamics
 
@@ -94,6 +107,34 @@ const float32 b2_toiSlop = 8.0f * b2_linearSlop;
 /// Maximum number of contacts to be handled to solve a TOI island.
 const int32 b2_maxTOIContactsPerIsland = 32;
 
+/// Number of contact constraints the batched solver solves at once (SSE lanes).
+const int32 b2_solverLaneCount = 4;
+
+/// Number of colors the batched solver sorts the contacts of an island into.
+/// A contact whose bodies already use every color is solved on its own.
+const int32 b2_solverColorCount = 32;
+
+/// With several threads, the batched solver splits a color among the threads
+/// once it has this many batches per thread.
+const int32 b2_solverParallelBatches = 4;
+
+/// With several threads and the batched solver, an island with this many
+/// contacts is solved color by color on all threads instead of on one.
+const int32 b2_parallelIslandContacts = 256;
+
+/// With several threads, the narrow phase is split among the threads once
+/// this many contacts are awake.
+const int32 b2_parallelCollideContacts = 128;
+
+/// Number of contacts a thread of the parallel narrow phase updates at once.
+const int32 b2_collideBatchSize = 32;
+
+/// The manifold cache (b2World::SetManifoldCaching) keeps the manifold of a
+/// touching contact until its bodies have moved this far relative to each
+/// other since the manifold was computed.
+const float32 b2_manifoldCacheLinearTolerance = 0.1f * b2_linearSlop;
+const float32 b2_manifoldCacheAngularTolerance = 0.1f * b2_angularSlop;
+
 /// A velocity threshold for elastic collisions. Any collision with a relative linear
 /// velocity below this threshold will be treated as inelastic.
 const float32 b2_velocityThreshold = 1.0f;		// 1 m/s
@@ -140,6 +181,10 @@ const float32 b2_angularSleepTolerance = 2.0f / 180.0f;		// 2 degrees/s
 
 // Memory Allocation
 
+/// Memory from b2Alloc and b2Allocator is aligned to this many bytes, enough
+/// for SIMD data.
+const int32 b2_allocAlignment = 16;
+
 /// The current number of bytes allocated through b2Alloc.
 extern int32 b2_byteCount;
 
@@ -149,6 +194,60 @@ void* b2Alloc(int32 size);
 /// If you implement b2Alloc, you should also implement this function.
 void b2Free(void* mem);
 
+// Threads
+
+// Solving on several threads (b2World::SetThreadCount) needs POSIX threads.
+// Box2D uses atomic operations and thread local storage only through the
+// functions below. With GCC they map to the __sync builtins and __thread,
+// other compilers get a mutex and a pthread key.
+
+/// Add value to *p and return the old value, atomically.
+int32 b2AtomicAdd(volatile int32* p, int32 value);
+
+/// Set *p to value if it equals expected and return the old value, atomically.
+void* b2AtomicCompareAndSwap(void* volatile* p, void* expected, void* value);
+
+/// Set *p to value and return the old value, atomically.
+void* b2AtomicExchange(void* volatile* p, void* value);
+
+/// Get the index of the calling thread in its b2ThreadPool, zero for threads
+/// that are not pool workers.
+int32 b2GetThreadIndex();
+
+/// Set the index of the calling thread, see b2GetThreadIndex.
+void b2SetThreadIndex(int32 index);
+
+#if defined(__GNUC__)
+
+extern __thread int32 b2_threadIndex;
+
+inline int32 b2AtomicAdd(volatile int32* p, int32 value)
+{
+	return __sync_fetch_and_add(p, value);
+}
+
+inline void* b2AtomicCompareAndSwap(void* volatile* p, void* expected, void* value)
+{
+	return __sync_val_compare_and_swap(p, expected, value);
+}
+
+inline void* b2AtomicExchange(void* volatile* p, void* value)
+{
+	return __sync_lock_test_and_set(p, value);
+}
+
+inline int32 b2GetThreadIndex()
+{
+	return b2_threadIndex;
+}
+
+inline void b2SetThreadIndex(int32 index)
+{
+	b2_threadIndex = index;
+}
+
+#endif
+
 /// Version numbering scheme.
 /// See http://en.wikipedia.org/wiki/Software_versioning
 struct b2Version
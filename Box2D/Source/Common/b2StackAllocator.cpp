@@ -18,39 +18,106 @@
 
 #include "b2StackAllocator.h"
 #include "b2Math.h"
+#include "b2Allocator.h"
 
-b2StackAllocator::b2StackAllocator()
+#include <string.h>
+
+b2StackAllocator::b2StackAllocator(b2Allocator* allocator)
 {
+	m_allocator = allocator;
+	m_segmentCount = 0;
+	m_segment = 0;
 	m_index = 0;
 	m_allocation = 0;
 	m_maxAllocation = 0;
+	m_entries = NULL;
 	m_entryCount = 0;
+	m_entryCapacity = 0;
 }
 
 b2StackAllocator::~b2StackAllocator()
 {
-	b2Assert(m_index == 0);
+	b2Assert(m_allocation == 0);
 	b2Assert(m_entryCount == 0);
+
+	for (int32 i = 0; i < m_segmentCount; ++i)
+	{
+		m_allocator->Free(m_segments[i].data, m_segments[i].size);
+	}
+
+	m_allocator->Free(m_entries, m_entryCapacity * sizeof(b2StackEntry));
+}
+
+void b2StackAllocator::AddSegment(int32 size)
+{
+	b2Assert(m_segmentCount < b2_maxStackSegments);
+	b2StackSegment* segment = m_segments + m_segmentCount;
+	segment->data = (char*)m_allocator->Allocate(size);
+	segment->size = size;
+	++m_segmentCount;
+}
+
+void b2StackAllocator::MergeSegments()
+{
+	b2Assert(m_entryCount == 0);
+
+	for (int32 i = 0; i < m_segmentCount; ++i)
+	{
+		m_allocator->Free(m_segments[i].data, m_segments[i].size);
+	}
+
+	m_segmentCount = 0;
+	m_segment = 0;
+	m_index = 0;
+	AddSegment(b2Max(m_maxAllocation, b2_stackSize));
 }
 
 void* b2StackAllocator::Allocate(int32 size)
 {
-	b2Assert(m_entryCount < b2_maxStackEntries);
+	// Keep the next allocation aligned.
+	size = (size + b2_allocAlignment - 1) & ~(b2_allocAlignment - 1);
 
-	b2StackEntry* entry = m_entries + m_entryCount;
-	entry->size = size;
-	if (m_index + size > b2_stackSize)
+	if (m_entryCount == m_entryCapacity)
 	{
-		entry->data = (char*)b2Alloc(size);
-		entry->usedMalloc = true;
+		b2StackEntry* oldEntries = m_entries;
+		int32 oldCapacity = m_entryCapacity;
+		m_entryCapacity += b2_stackEntryIncrement;
+		m_entries = (b2StackEntry*)m_allocator->Allocate(m_entryCapacity * sizeof(b2StackEntry));
+		if (oldEntries)
+		{
+			memcpy(m_entries, oldEntries, m_entryCount * sizeof(b2StackEntry));
+			m_allocator->Free(oldEntries, oldCapacity * sizeof(b2StackEntry));
+		}
 	}
-	else
+
+	b2StackEntry* entry = m_entries + m_entryCount;
+	entry->size = size;
+	entry->segment = m_segment;
+	entry->index = m_index;
+
+	// Move on to the next segment with enough room, adding one at the end.
+	while (m_segment == m_segmentCount || m_index + size > m_segments[m_segment].size)
 	{
-		entry->data = m_data + m_index;
-		entry->usedMalloc = false;
-		m_index += size;
+		if (m_segment < m_segmentCount)
+		{
+			++m_segment;
+			m_index = 0;
+		}
+
+		if (m_segment == m_segmentCount)
+		{
+			int32 segmentSize = b2_stackSize;
+			if (m_segmentCount > 0)
+			{
+				segmentSize = 2 * m_segments[m_segmentCount - 1].size;
+			}
+			AddSegment(b2Max(segmentSize, size));
+		}
 	}
 
+	entry->data = m_segments[m_segment].data + m_index;
+	m_index += size;
+
 	m_allocation += size;
 	m_maxAllocation = b2Max(m_maxAllocation, m_allocation);
 	++m_entryCount;
@@ -63,17 +130,17 @@ void b2StackAllocator::Free(void* p)
 	b2Assert(m_entryCount > 0);
 	b2StackEntry* entry = m_entries + m_entryCount - 1;
 	b2Assert(p == entry->data);
-	if (entry->usedMalloc)
-	{
-		b2Free(p);
-	}
-	else
-	{
-		m_index -= entry->size;
-	}
+	m_segment = entry->segment;
+	m_index = entry->index;
 	m_allocation -= entry->size;
 	--m_entryCount;
 
+	// The next step gets all its memory from one segment.
+	if (m_entryCount == 0 && m_segmentCount > 1)
+	{
+		MergeSegments();
+	}
+
 	p = NULL;
 }
 
@@ -81,3 +148,13 @@ int32 b2StackAllocator::GetMaxAllocation() const
 {
 	return m_maxAllocation;
 }
+
+int32 b2StackAllocator::GetCapacity() const
+{
+	int32 capacity = 0;
+	for (int32 i = 0; i < m_segmentCount; ++i)
+	{
+		capacity += m_segments[i].size;
+	}
+	return capacity;
+}
@@ -21,40 +21,65 @@
 
 #include "b2Settings.h"
 
-const int32 b2_stackSize = 100 * 1024;	// 100k
-const int32 b2_maxStackEntries = 32;
+class b2Allocator;
+
+const int32 b2_stackSize = 100 * 1024;	// 100k, the first segment
+const int32 b2_maxStackSegments = 16;	// each twice as large as the one before
+const int32 b2_stackEntryIncrement = 32;
 
 struct b2StackEntry
 {
 	char* data;
 	int32 size;
-	bool usedMalloc;
+	int32 segment;	// where the stack was before this allocation
+	int32 index;
+};
+
+struct b2StackSegment
+{
+	char* data;
+	int32 size;
 };
 
 // This is a stack allocator used for fast per step allocations.
 // You must nest allocate/free pairs. The code will assert
 // if you try to interleave multiple allocate/free pairs.
+// The memory comes in segments from the given allocator. A full
+// segment is followed by one twice as large. The segments are kept
+// for the next step, merged into one once everything is freed.
 class b2StackAllocator
 {
 public:
-	b2StackAllocator();
+	b2StackAllocator(b2Allocator* allocator);
 	~b2StackAllocator();
 
 	void* Allocate(int32 size);
 	void Free(void* p);
 
+	// The most memory that was allocated at once.
 	int32 GetMaxAllocation() const;
 
+	// The memory held in segments.
+	int32 GetCapacity() const;
+
 private:
 
-	char m_data[b2_stackSize];
-	int32 m_index;
+	void AddSegment(int32 size);
+	void MergeSegments();
+
+	b2Allocator* m_allocator;
+
+	b2StackSegment m_segments[b2_maxStackSegments];
+	int32 m_segmentCount;
+	int32 m_segment;	// the segment allocations come from
+	int32 m_index;		// the free space in it
 
 	int32 m_allocation;
 	int32 m_maxAllocation;
 
-	b2StackEntry m_entries[b2_maxStackEntries];
+	b2StackEntry* m_entries;
 	int32 m_entryCount;
+	int32 m_entryCapacity;
 };
 
 #endif
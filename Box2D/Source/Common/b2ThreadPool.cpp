@@ -0,0 +1,183 @@
+/*
+* Copyright (c) 2006-2007 Erin Catto http://www.gphysics.com
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "b2ThreadPool.h"
+
+b2ThreadPool::b2ThreadPool(int32 threadCount)
+{
+	b2Assert(threadCount > 0);
+
+	m_threadCount = threadCount;
+	m_generation = 0;
+	m_busyCount = 0;
+	m_quit = false;
+	m_task = NULL;
+	m_count = 0;
+
+	pthread_mutex_init(&m_mutex, NULL);
+	pthread_cond_init(&m_start, NULL);
+	pthread_cond_init(&m_done, NULL);
+
+	m_queues = (b2TaskQueue*)b2Alloc(m_threadCount * sizeof(b2TaskQueue));
+	m_threads = (pthread_t*)b2Alloc(m_threadCount * sizeof(pthread_t));
+	m_args = (b2WorkerArgs*)b2Alloc(m_threadCount * sizeof(b2WorkerArgs));
+
+	for (int32 i = 0; i < m_threadCount; ++i)
+	{
+		m_queues[i].next = 0;
+		m_args[i].pool = this;
+		m_args[i].threadIndex = i;
+	}
+
+	// Thread zero is the caller of Run. If a thread cannot be started the
+	// pool keeps the threads it has, Run, Work and the destructor only use
+	// m_threadCount.
+	for (int32 i = 1; i < threadCount; ++i)
+	{
+		if (pthread_create(m_threads + i, NULL, ThreadMain, m_args + i) != 0)
+		{
+			m_threadCount = i;
+			break;
+		}
+	}
+}
+
+b2ThreadPool::~b2ThreadPool()
+{
+	pthread_mutex_lock(&m_mutex);
+	m_quit = true;
+	pthread_cond_broadcast(&m_start);
+	pthread_mutex_unlock(&m_mutex);
+
+	for (int32 i = 1; i < m_threadCount; ++i)
+	{
+		pthread_join(m_threads[i], NULL);
+	}
+
+	b2Free(m_args);
+	b2Free(m_threads);
+	b2Free(m_queues);
+
+	pthread_cond_destroy(&m_done);
+	pthread_cond_destroy(&m_start);
+	pthread_mutex_destroy(&m_mutex);
+}
+
+void* b2ThreadPool::ThreadMain(void* args)
+{
+	b2ThreadPool* pool = ((b2WorkerArgs*)args)->pool;
+	int32 threadIndex = ((b2WorkerArgs*)args)->threadIndex;
+	int32 generation = 0;
+
+	b2SetThreadIndex(threadIndex);
+
+	pthread_mutex_lock(&pool->m_mutex);
+	for (;;)
+	{
+		while (pool->m_generation == generation && pool->m_quit == false)
+		{
+			pthread_cond_wait(&pool->m_start, &pool->m_mutex);
+		}
+
+		if (pool->m_quit)
+		{
+			break;
+		}
+
+		generation = pool->m_generation;
+		pthread_mutex_unlock(&pool->m_mutex);
+
+		pool->Work(threadIndex);
+
+		pthread_mutex_lock(&pool->m_mutex);
+		--pool->m_busyCount;
+		if (pool->m_busyCount == 0)
+		{
+			pthread_cond_signal(&pool->m_done);
+		}
+	}
+	pthread_mutex_unlock(&pool->m_mutex);
+
+	return NULL;
+}
+
+void b2ThreadPool::Run(b2Task* task, int32 count)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	m_task = task;
+	m_count = count;
+	for (int32 i = 0; i < m_threadCount; ++i)
+	{
+		m_queues[i].next = 0;
+	}
+
+	// Waking the workers costs more than a single item.
+	if (m_threadCount == 1 || count == 1)
+	{
+		Work(0);
+		return;
+	}
+
+	pthread_mutex_lock(&m_mutex);
+	m_busyCount = m_threadCount - 1;
+	++m_generation;
+	pthread_cond_broadcast(&m_start);
+	pthread_mutex_unlock(&m_mutex);
+
+	Work(0);
+
+	pthread_mutex_lock(&m_mutex);
+	while (m_busyCount > 0)
+	{
+		pthread_cond_wait(&m_done, &m_mutex);
+	}
+	pthread_mutex_unlock(&m_mutex);
+}
+
+// Queue i holds the items i, i + threadCount, i + 2 * threadCount, ...
+bool b2ThreadPool::Take(int32 queueIndex, int32* index)
+{
+	// The counter may run past the end, it is reset by Run.
+	int32 next = b2AtomicAdd(&m_queues[queueIndex].next, 1);
+	*index = queueIndex + next * m_threadCount;
+	return *index < m_count;
+}
+
+void b2ThreadPool::Work(int32 threadIndex)
+{
+	int32 index;
+
+	while (Take(threadIndex, &index))
+	{
+		m_task->Execute(index, threadIndex);
+	}
+
+	// Steal from the others.
+	for (int32 i = 1; i < m_threadCount; ++i)
+	{
+		int32 victim = (threadIndex + i) % m_threadCount;
+		while (Take(victim, &index))
+		{
+			m_task->Execute(index, threadIndex);
+		}
+	}
+}
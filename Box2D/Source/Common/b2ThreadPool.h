@@ -0,0 +1,97 @@
+/*
+* Copyright (c) 2006-2007 Erin Catto http://www.gphysics.com
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef B2_THREAD_POOL_H
+#define B2_THREAD_POOL_H
+
+#include "b2Settings.h"
+
+#include <pthread.h>
+
+/// Work for the thread pool. Execute is called once for every index.
+class b2Task
+{
+public:
+	virtual ~b2Task() {}
+
+	/// @param index the work item, from zero to the count given to b2ThreadPool::Run.
+	/// @param threadIndex the thread running the item, zero is the thread that called Run.
+	virtual void Execute(int32 index, int32 threadIndex) = 0;
+};
+
+/// A fixed set of worker threads that share the items of one task at a time.
+/// The items are dealt to the threads round robin, so with items sorted by
+/// decreasing cost every thread starts with its largest item. A thread that
+/// runs out of items steals from the others, again taking the largest item
+/// that is left.
+class b2ThreadPool
+{
+public:
+	/// @param threadCount the number of threads including the calling thread.
+	/// Fewer threads are used if the system cannot start them all, see
+	/// GetThreadCount.
+	b2ThreadPool(int32 threadCount);
+	~b2ThreadPool();
+
+	int32 GetThreadCount() const { return m_threadCount; }
+
+	/// The index of the calling thread in its pool. Zero for threads that are
+	/// not pool workers, which includes the thread that calls Run.
+	static int32 GetThreadIndex() { return b2GetThreadIndex(); }
+
+	/// Execute task items 0 to count - 1 and wait until all are done. The
+	/// calling thread works as thread zero.
+	void Run(b2Task* task, int32 count);
+
+private:
+	struct b2TaskQueue
+	{
+		volatile int32 next;	// the next item to take is index + next * threadCount
+		char padding[60];		// keep queues in separate cache lines
+	};
+
+	struct b2WorkerArgs
+	{
+		b2ThreadPool* pool;
+		int32 threadIndex;
+	};
+
+	static void* ThreadMain(void* args);
+	void Work(int32 threadIndex);
+	bool Take(int32 queueIndex, int32* index);
+
+	b2ThreadPool(const b2ThreadPool&);
+	void operator=(const b2ThreadPool&);
+
+	int32 m_threadCount;
+	pthread_t* m_threads;
+	b2WorkerArgs* m_args;
+	b2TaskQueue* m_queues;
+
+	pthread_mutex_t m_mutex;
+	pthread_cond_t m_start;
+	pthread_cond_t m_done;
+	int32 m_generation;		// incremented for every task
+	int32 m_busyCount;		// worker threads still working on the task
+	bool m_quit;
+
+	b2Task* m_task;
+	int32 m_count;
+};
+
+#endif
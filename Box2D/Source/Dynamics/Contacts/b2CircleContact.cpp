@@ -46,7 +46,7 @@ b2CircleContact::b2CircleContact(b2Shape* s1, b2Shape* s2)
 	m_manifold.points[0].tangentImpulse = 0.0f;
 }
 
-void b2CircleContact::Evaluate(b2ContactListener* listener)
+void b2CircleContact::Evaluate(b2ContactListener* listener, float32 margin)
 {
 	b2Body* b1 = m_shape1->GetBody();
 	b2Body* b2 = m_shape2->GetBody();
@@ -54,7 +54,7 @@ void b2CircleContact::Evaluate(b2ContactListener* listener)
 	b2Manifold m0;
 	memcpy(&m0, &m_manifold, sizeof(b2Manifold));
 
-	b2CollideCircles(&m_manifold, (b2CircleShape*)m_shape1, b1->GetXForm(), (b2CircleShape*)m_shape2, b2->GetXForm());
+	b2CollideCircles(&m_manifold, (b2CircleShape*)m_shape1, b1->GetXForm(), (b2CircleShape*)m_shape2, b2->GetXForm(), margin);
 
 	b2ContactPoint cp;
 	cp.shape1 = m_shape1;
@@ -80,6 +80,7 @@ void b2CircleContact::Evaluate(b2ContactListener* listener)
 				cp.velocity = v2 - v1;
 				cp.normal = m_manifold.normal;
 				cp.separation = mp->separation;
+				cp.separation0 = mp->separation;
 				cp.id = mp->id;
 				listener->Add(&cp);
 			}
@@ -98,6 +99,7 @@ void b2CircleContact::Evaluate(b2ContactListener* listener)
 				cp.velocity = v2 - v1;
 				cp.normal = m_manifold.normal;
 				cp.separation = mp->separation;
+				cp.separation0 = mp0->separation;
 				cp.id = mp->id;
 				listener->Persist(&cp);
 			}
@@ -115,6 +117,7 @@ void b2CircleContact::Evaluate(b2ContactListener* listener)
 			cp.velocity = v2 - v1;
 			cp.normal = m0.normal;
 			cp.separation = mp0->separation;
+			cp.separation0 = mp0->separation;
 			cp.id = mp0->id;
 			listener->Remove(&cp);
 		}
@@ -34,7 +34,7 @@ public:
 	b2CircleContact(b2Shape* shape1, b2Shape* shape2);
 	~b2CircleContact() {}
 
-	void Evaluate(b2ContactListener* listener);
+	void Evaluate(b2ContactListener* listener, float32 margin);
 	b2Manifold* GetManifolds()
 	{
 		return &m_manifold;
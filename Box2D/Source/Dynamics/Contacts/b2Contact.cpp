@@ -27,9 +27,25 @@
 #include "../../Dynamics/b2World.h"
 #include "../../Dynamics/b2Body.h"
 
+#include <new>
+
 b2ContactRegister b2Contact::s_registers[e_shapeTypeCount][e_shapeTypeCount];
 bool b2Contact::s_initialized = false;
 
+// Register the contact types during static initialization so that worlds
+// living on different threads never race on the lazy initialization below.
+static struct b2ContactRegistersInit
+{
+	b2ContactRegistersInit()
+	{
+		if (b2Contact::s_initialized == false)
+		{
+			b2Contact::InitializeRegisters();
+			b2Contact::s_initialized = true;
+		}
+	}
+} s_contactRegistersInit;
+
 void b2Contact::InitializeRegisters()
 {
 	AddType(b2CircleContact::Create, b2CircleContact::Destroy, e_circleShape, e_circleShape);
@@ -113,9 +129,56 @@ void b2Contact::Destroy(b2Contact* contact, b2BlockAllocator* allocator)
 	destroyFcn(contact, allocator);
 }
 
+// Contacts always keep their shapes in the order of the primary register,
+// so the shape types identify the contact class.
+int32 b2Contact::GetByteSize(b2ShapeType type1, b2ShapeType type2)
+{
+	if (type1 == e_circleShape && type2 == e_circleShape)
+	{
+		return sizeof(b2CircleContact);
+	}
+	else if (type1 == e_polygonShape && type2 == e_circleShape)
+	{
+		return sizeof(b2PolyAndCircleContact);
+	}
+	else if (type1 == e_polygonShape && type2 == e_polygonShape)
+	{
+		return sizeof(b2PolygonContact);
+	}
+
+	b2Assert(false);
+	return 0;
+}
+
+b2Contact* b2Contact::Copy(const b2Contact* contact, b2ShapeType type1, b2ShapeType type2, void* mem)
+{
+	if (type1 == e_circleShape && type2 == e_circleShape)
+	{
+		return new (mem) b2CircleContact(*(const b2CircleContact*)contact);
+	}
+	else if (type1 == e_polygonShape && type2 == e_circleShape)
+	{
+		return new (mem) b2PolyAndCircleContact(*(const b2PolyAndCircleContact*)contact);
+	}
+	else if (type1 == e_polygonShape && type2 == e_polygonShape)
+	{
+		return new (mem) b2PolygonContact(*(const b2PolygonContact*)contact);
+	}
+
+	b2Assert(false);
+	return NULL;
+}
+
 b2Contact::b2Contact(b2Shape* s1, b2Shape* s2)
 {
 	m_flags = 0;
+	m_color = -1;
+
+	m_cachePosition.SetZero();
+	m_cacheAngle = 0.0f;
+	m_cacheNormal.SetZero();
+
+	m_simplexCache.count = 0;
 
 	if (s1->IsSensor() || s2->IsSensor())
 	{
@@ -143,21 +206,61 @@ b2Contact::b2Contact(b2Shape* s1, b2Shape* s2)
 	m_node2.other = NULL;
 }
 
-void b2Contact::Update(b2ContactListener* listener)
+void b2Contact::Update(b2ContactListener* listener, bool cacheManifolds, float32 speculativeTime)
 {
 	int32 oldCount = GetManifoldCount();
 
-	Evaluate(listener);
+	UpdateManifolds(listener, cacheManifolds, speculativeTime);
 
 	int32 newCount = GetManifoldCount();
 
+	if (newCount == 0 && oldCount > 0)
+	{
+		m_shape1->GetBody()->WakeUp();
+		m_shape2->GetBody()->WakeUp();
+	}
+}
+
+void b2Contact::UpdateManifolds(b2ContactListener* listener, bool cacheManifolds, float32 speculativeTime)
+{
 	b2Body* body1 = m_shape1->GetBody();
 	b2Body* body2 = m_shape2->GetBody();
 
-	if (newCount == 0 && oldCount > 0)
+	// No point of a shape moves faster than its body's center plus the
+	// angular velocity times the sweep radius. The L1 norm of the relative
+	// velocity bounds its length without a square root.
+	float32 margin = 0.0f;
+	b2Vec2 v1, v2;
+	float32 w1, w2;
+	if (speculativeTime > 0.0f)
 	{
-		body1->WakeUp();
-		body2->WakeUp();
+		const b2Vec2& gravity = body1->GetWorld()->GetGravity();
+		body1->PredictVelocity(speculativeTime, gravity, &v1, &w1);
+		body2->PredictVelocity(speculativeTime, gravity, &v2, &w2);
+		float32 speed = b2Abs(v2.x - v1.x) + b2Abs(v2.y - v1.y);
+		speed += b2Abs(w1) * m_shape1->GetSweepRadius() + b2Abs(w2) * m_shape2->GetSweepRadius();
+		margin = speculativeTime * speed;
+	}
+
+	if (cacheManifolds == false)
+	{
+		Evaluate(listener, margin);
+		m_flags &= ~e_cacheFlag;
+	}
+	else if (ReuseManifold(listener) == false)
+	{
+		Evaluate(listener, margin);
+		CacheManifold();
+	}
+
+	// A contact the bodies do not reach stays out of the islands.
+	if (speculativeTime > 0.0f && IsApart(speculativeTime, v1, w1, v2, w2))
+	{
+		m_flags |= e_apartFlag;
+	}
+	else
+	{
+		m_flags &= ~e_apartFlag;
 	}
 
 	// Slow contacts don't generate TOI events.
@@ -170,3 +273,134 @@ void b2Contact::Update(b2ContactListener* listener)
 		m_flags |= e_slowFlag;
 	}
 }
+
+// A point is reached if the bodies close more than its separation along the
+// normal. The velocities are those the step starts solving with.
+bool b2Contact::IsApart(float32 speculativeTime, const b2Vec2& v1, float32 w1, const b2Vec2& v2, float32 w2)
+{
+	b2Body* b1 = m_shape1->GetBody();
+	b2Body* b2 = m_shape2->GetBody();
+	b2Vec2 c1 = b1->GetWorldCenter();
+	b2Vec2 c2 = b2->GetWorldCenter();
+
+	int32 manifoldCount = GetManifoldCount();
+	b2Manifold* manifolds = GetManifolds();
+	for (int32 i = 0; i < manifoldCount; ++i)
+	{
+		b2Manifold* manifold = manifolds + i;
+		for (int32 j = 0; j < manifold->pointCount; ++j)
+		{
+			b2ManifoldPoint* mp = manifold->points + j;
+			if (mp->separation <= 0.0f)
+			{
+				return false;
+			}
+
+			b2Vec2 p = b1->GetWorldPoint(mp->localPoint1);
+			b2Vec2 dv = v2 + b2Cross(w2, p - c2) - v1 - b2Cross(w1, p - c1);
+			if (-speculativeTime * b2Dot(dv, manifold->normal) >= mp->separation)
+			{
+				return false;
+			}
+		}
+	}
+
+	return manifoldCount > 0;
+}
+
+// The manifold is reused while body 2 stays put relative to body 1. Its points
+// are in the bodies' frames, so only the normal changes. The separations stay
+// as computed, the solver adds the motion of the points since then itself.
+bool b2Contact::ReuseManifold(b2ContactListener* listener)
+{
+	if ((m_flags & e_cacheFlag) == 0)
+	{
+		return false;
+	}
+
+	b2Body* b1 = m_shape1->GetBody();
+	b2Body* b2 = m_shape2->GetBody();
+	const b2XForm& xf1 = b1->GetXForm();
+	const b2XForm& xf2 = b2->GetXForm();
+
+	b2Vec2 position = b2MulT(xf1.R, xf2.position - xf1.position);
+	float32 angle = b2->GetAngle() - b1->GetAngle();
+	if (b2DistanceSquared(position, m_cachePosition) > b2_manifoldCacheLinearTolerance * b2_manifoldCacheLinearTolerance ||
+		b2Abs(angle - m_cacheAngle) > b2_manifoldCacheAngularTolerance)
+	{
+		return false;
+	}
+
+	b2Manifold* manifold = GetManifolds();
+	manifold->normal = b2Mul(xf1.R, m_cacheNormal);
+
+	b2ContactPoint cp;
+	cp.shape1 = m_shape1;
+	cp.shape2 = m_shape2;
+	cp.friction = m_friction;
+	cp.restitution = m_restitution;
+	cp.normal = manifold->normal;
+
+	// Every point persists and keeps its impulses for warm starting.
+	for (int32 i = 0; i < manifold->pointCount; ++i)
+	{
+		b2ManifoldPoint* mp = manifold->points + i;
+		if (listener != NULL)
+		{
+			b2Vec2 p1 = b2Mul(xf1, mp->localPoint1);
+			b2Vec2 p2 = b2Mul(xf2, mp->localPoint2);
+			cp.position = p1;
+			b2Vec2 v1 = b1->GetLinearVelocityFromLocalPoint(mp->localPoint1);
+			b2Vec2 v2 = b2->GetLinearVelocityFromLocalPoint(mp->localPoint2);
+			cp.velocity = v2 - v1;
+			cp.separation = mp->separation + b2Dot(p2 - p1, manifold->normal);
+			cp.separation0 = mp->separation;	// when the manifold was computed
+			cp.id = mp->id;
+			listener->Persist(&cp);
+		}
+	}
+
+	return true;
+}
+
+// Only a single touching manifold is cached. A contact that does not touch
+// yet is evaluated every step so it starts touching on time. That includes
+// speculative manifolds (b2World::SetSpeculativeContacts) whose points all
+// have a positive separation.
+void b2Contact::CacheManifold()
+{
+	if (GetManifoldCount() != 1)
+	{
+		m_flags &= ~e_cacheFlag;
+		return;
+	}
+
+	const b2Manifold* manifold = GetManifolds();
+	bool touching = false;
+	for (int32 i = 0; i < manifold->pointCount; ++i)
+	{
+		if (manifold->points[i].separation <= 0.0f)
+		{
+			touching = true;
+			break;
+		}
+	}
+
+	if (touching == false)
+	{
+		m_flags &= ~e_cacheFlag;
+		return;
+	}
+
+	b2Body* b1 = m_shape1->GetBody();
+	b2Body* b2 = m_shape2->GetBody();
+	const b2XForm& xf1 = b1->GetXForm();
+	const b2XForm& xf2 = b2->GetXForm();
+
+	m_cachePosition = b2MulT(xf1.R, xf2.position - xf1.position);
+	m_cacheAngle = b2->GetAngle() - b1->GetAngle();
+
+	m_cacheNormal = b2MulT(xf1.R, manifold->normal);
+
+	m_flags |= e_cacheFlag;
+}
@@ -62,6 +62,7 @@ struct b2ContactPoint
 	b2Vec2 velocity;		///< velocity of point on body2 relative to point on body1 (pre-solver)
 	b2Vec2 normal;			///< points from shape1 to shape2
 	float32 separation;		///< the separation is negative when shapes are touching
+	float32 separation0;	///< the separation of a persisting point before this update, else separation
 	float32 friction;		///< the combined friction coefficient
 	float32 restitution;	///< the combined restitution coefficient
 	b2ContactID id;			///< the contact id identifies the features in contact
@@ -117,6 +118,8 @@ public:
 		e_slowFlag		= 0x0002,
 		e_islandFlag	= 0x0004,
 		e_toiFlag		= 0x0008,
+		e_cacheFlag		= 0x0010,	// the manifold cache below is valid
+		e_apartFlag		= 0x0020,	// only speculative points the bodies do not reach in this step
 	};
 
 	static void AddType(b2ContactCreateFcn* createFcn, b2ContactDestroyFcn* destroyFcn,
@@ -125,17 +128,44 @@ public:
 	static b2Contact* Create(b2Shape* shape1, b2Shape* shape2, b2BlockAllocator* allocator);
 	static void Destroy(b2Contact* contact, b2BlockAllocator* allocator);
 
+	// Used by world snapshots: the size of a contact between shapes of the
+	// given types and an exact copy of a contact constructed in place at mem.
+	static int32 GetByteSize(b2ShapeType type1, b2ShapeType type2);
+	static b2Contact* Copy(const b2Contact* contact, b2ShapeType type1, b2ShapeType type2, void* mem);
+
 	b2Contact() : m_shape1(NULL), m_shape2(NULL) {}
 	b2Contact(b2Shape* shape1, b2Shape* shape2);
 	virtual ~b2Contact() {}
 
-	void Update(b2ContactListener* listener);
-	virtual void Evaluate(b2ContactListener* listener) = 0;
+	void Update(b2ContactListener* listener, bool cacheManifolds = false, float32 speculativeTime = 0.0f);
+	virtual void Evaluate(b2ContactListener* listener, float32 margin) = 0;
+
+	// Update without waking the bodies. This only writes to the contact, so
+	// contacts can be updated on several threads at once. With a speculative
+	// time, the manifold also gets the points the shapes can reach by then.
+	void UpdateManifolds(b2ContactListener* listener, bool cacheManifolds, float32 speculativeTime);
+
+	// Whether the bodies stay apart at every point within the given time.
+	bool IsApart(float32 speculativeTime, const b2Vec2& v1, float32 w1, const b2Vec2& v2, float32 w2);
+
+	// Keep the manifold if the bodies have barely moved since it was computed.
+	bool ReuseManifold(b2ContactListener* listener);
+	void CacheManifold();
 	static b2ContactRegister s_registers[e_shapeTypeCount][e_shapeTypeCount];
 	static bool s_initialized;
 
 	uint32 m_flags;
 	int32 m_manifoldCount;
+	int32 m_color;	// batched solver color of the last step, -1 if none
+
+	// Manifold cache (b2World::SetManifoldCaching). Body 2 relative to body 1
+	// and the normal in body 1's frame when the manifold was computed.
+	b2Vec2 m_cachePosition;
+	float32 m_cacheAngle;
+	b2Vec2 m_cacheNormal;
+
+	// GJK warm start of the time of impact (b2World::SetSimplexCaching).
+	b2SimplexCache m_simplexCache;
 
 	// World pool and list pointers.
 	b2Contact* m_prev;
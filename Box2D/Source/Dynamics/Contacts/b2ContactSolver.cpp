@@ -21,11 +21,23 @@
 #include "../b2Body.h"
 #include "../b2World.h"
 #include "../../Common/b2StackAllocator.h"
+#include "../../Common/b2ThreadPool.h"
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define B2_SOLVER_SSE2
+#include <emmintrin.h>
+#endif
 
 b2ContactSolver::b2ContactSolver(const b2TimeStep& step, b2Contact** contacts, int32 contactCount, b2StackAllocator* allocator)
 {
 	m_step = step;
 	m_allocator = allocator;
+	m_order = NULL;
+	m_batchCount = 0;
+	m_overflowCount = 0;
+	m_batches = NULL;
+	m_threadPool = NULL;
 
 	m_constraintCount = 0;
 	for (int32 i = 0; i < contactCount; ++i)
@@ -71,6 +83,9 @@ b2ContactSolver::b2ContactSolver(const b2TimeStep& step, b2Contact** contacts, i
 			c->friction = friction;
 			c->restitution = restitution;
 
+			// Only one constraint of a contact can take its color.
+			c->color = j == 0 ? contact->m_color : -1;
+
 			for (int32 k = 0; k < c->pointCount; ++k)
 			{
 				b2ManifoldPoint* cp = manifold->points + k;
@@ -113,17 +128,20 @@ b2ContactSolver::b2ContactSolver(const b2TimeStep& step, b2Contact** contacts, i
 				b2Assert(kTangent > B2_FLT_EPSILON);
 				ccp->tangentMass = 1.0f /  kTangent;
 
-				// Setup a velocity bias for restitution.
+				// Setup a velocity bias for restitution. A speculative point
+				// lets the bodies close the gap in this step, but no more.
 				ccp->velocityBias = 0.0f;
 				if (ccp->separation > 0.0f)
 				{
-					ccp->velocityBias = -60.0f * ccp->separation; // TODO_ERIN b2TimeStep
+					ccp->velocityBias = -step.inv_dt * ccp->separation;
 				}
-
-				float32 vRel = b2Dot(c->normal, v2 + b2Cross(w2, ccp->r2) - v1 - b2Cross(w1, ccp->r1));
-				if (vRel < -b2_velocityThreshold)
+				else
 				{
-					ccp->velocityBias += -c->restitution * vRel;
+					float32 vRel = b2Dot(c->normal, v2 + b2Cross(w2, ccp->r2) - v1 - b2Cross(w1, ccp->r1));
+					if (vRel < -b2_velocityThreshold)
+					{
+						ccp->velocityBias = -c->restitution * vRel;
+					}
 				}
 			}
 
@@ -136,6 +154,14 @@ b2ContactSolver::b2ContactSolver(const b2TimeStep& step, b2Contact** contacts, i
 
 b2ContactSolver::~b2ContactSolver()
 {
+	if (m_batches)
+	{
+		m_allocator->Free(m_batches);
+	}
+	if (m_order)
+	{
+		m_allocator->Free(m_order);
+	}
 	m_allocator->Free(m_constraints);
 }
 
@@ -163,10 +189,20 @@ void b2ContactSolver::InitVelocityConstraints(const b2TimeStep& step)
 				ccp->normalImpulse *= step.dtRatio;
 				ccp->tangentImpulse *= step.dtRatio;
 				b2Vec2 P = ccp->normalImpulse * normal + ccp->tangentImpulse * tangent;
-				b1->m_angularVelocity -= invI1 * b2Cross(ccp->r1, P);
-				b1->m_linearVelocity -= invMass1 * P;
-				b2->m_angularVelocity += invI2 * b2Cross(ccp->r2, P);
-				b2->m_linearVelocity += invMass2 * P;
+
+				// Static bodies are shared by islands solved on other threads, so
+				// they are never written. Their mass is infinite anyway.
+				if (b1->IsStatic() == false)
+				{
+					b1->m_angularVelocity -= invI1 * b2Cross(ccp->r1, P);
+					b1->m_linearVelocity -= invMass1 * P;
+				}
+
+				if (b2->IsStatic() == false)
+				{
+					b2->m_angularVelocity += invI2 * b2Cross(ccp->r2, P);
+					b2->m_linearVelocity += invMass2 * P;
+				}
 			}
 		}
 		else
@@ -179,111 +215,658 @@ void b2ContactSolver::InitVelocityConstraints(const b2TimeStep& step)
 			}
 		}
 	}
+
+	if (step.batchedSolver)
+	{
+		BuildBatches();
+	}
 }
 
-void b2ContactSolver::SolveVelocityConstraints()
+void b2ContactSolver::BuildBatches()
 {
+	int32 colorCounts[b2_solverColorCount];
+	memset(colorCounts, 0, sizeof(colorCounts));
+
+	m_overflowCount = 0;
 	for (int32 i = 0; i < m_constraintCount; ++i)
 	{
-		b2ContactConstraint* c = m_constraints + i;
-		b2Body* b1 = c->body1;
-		b2Body* b2 = c->body2;
-		float32 w1 = b1->m_angularVelocity;
-		float32 w2 = b2->m_angularVelocity;
-		b2Vec2 v1 = b1->m_linearVelocity;
-		b2Vec2 v2 = b2->m_linearVelocity;
-		float32 invMass1 = b1->m_invMass;
-		float32 invI1 = b1->m_invI;
-		float32 invMass2 = b2->m_invMass;
-		float32 invI2 = b2->m_invI;
-		b2Vec2 normal = c->normal;
-		b2Vec2 tangent = b2Cross(normal, 1.0f);
-		float32 friction = c->friction;
+		int32 color = m_constraints[i].color;
+		if (color == -1)
+		{
+			++m_overflowCount;
+		}
+		else
+		{
+			++colorCounts[color];
+		}
+	}
+
+	// Lay out the batches of each color, then the overflow.
+	int32 colorStarts[b2_solverColorCount];
+	m_batchCount = 0;
+	for (int32 color = 0; color < b2_solverColorCount; ++color)
+	{
+		m_colorStarts[color] = m_batchCount;
+		colorStarts[color] = m_batchCount * b2_solverLaneCount;
+		m_batchCount += (colorCounts[color] + b2_solverLaneCount - 1) / b2_solverLaneCount;
+	}
+	m_colorStarts[b2_solverColorCount] = m_batchCount;
+
+	int32 overflowStart = m_batchCount * b2_solverLaneCount;
+	m_order = (int32*)m_allocator->Allocate((overflowStart + m_overflowCount) * sizeof(int32));
+	for (int32 i = 0; i < overflowStart; ++i)
+	{
+		m_order[i] = -1;
+	}
+
+	int32 overflowCount = 0;
+	for (int32 i = 0; i < m_constraintCount; ++i)
+	{
+		int32 color = m_constraints[i].color;
+		if (color == -1)
+		{
+			m_order[overflowStart + overflowCount++] = i;
+		}
+		else
+		{
+			m_order[colorStarts[color]++] = i;
+		}
+	}
+
+#ifdef B2_SOLVER_SSE2
+	m_batches = (b2ContactBatch*)m_allocator->Allocate(m_batchCount * sizeof(b2ContactBatch));
+	memset(m_batches, 0, m_batchCount * sizeof(b2ContactBatch));
+
+	for (int32 i = 0; i < m_batchCount; ++i)
+	{
+		b2ContactBatch* batch = m_batches + i;
+		for (int32 lane = 0; lane < b2_solverLaneCount; ++lane)
+		{
+			int32 index = m_order[i * b2_solverLaneCount + lane];
+			if (index == -1)
+			{
+				continue;
+			}
+
+			b2ContactConstraint* c = m_constraints + index;
+			b2Body* b1 = c->body1;
+			b2Body* b2 = c->body2;
+			batch->body1[lane] = b1;
+			batch->body2[lane] = b2;
+			batch->normalX[lane] = c->normal.x;
+			batch->normalY[lane] = c->normal.y;
+			batch->friction[lane] = c->friction;
+			batch->invMass1[lane] = b1->m_invMass;
+			batch->invI1[lane] = b1->m_invI;
+			batch->invMass2[lane] = b2->m_invMass;
+			batch->invI2[lane] = b2->m_invI;
+			batch->equalizedInvMass1[lane] = b1->m_mass * b1->m_invMass;
+			batch->equalizedInvI1[lane] = b1->m_mass * b1->m_invI;
+			batch->equalizedInvMass2[lane] = b2->m_mass * b2->m_invMass;
+			batch->equalizedInvI2[lane] = b2->m_mass * b2->m_invI;
+			batch->pointCount = b2Max(batch->pointCount, c->pointCount);
+
+			for (int32 j = 0; j < c->pointCount; ++j)
+			{
+				b2ContactConstraintPoint* ccp = c->points + j;
+				b2ContactBatchPoint* bp = batch->points + j;
+				b2Vec2 localR1 = ccp->localAnchor1 - b1->GetLocalCenter();
+				b2Vec2 localR2 = ccp->localAnchor2 - b2->GetLocalCenter();
+				bp->localR1X[lane] = localR1.x;
+				bp->localR1Y[lane] = localR1.y;
+				bp->localR2X[lane] = localR2.x;
+				bp->localR2Y[lane] = localR2.y;
+				bp->r1X[lane] = ccp->r1.x;
+				bp->r1Y[lane] = ccp->r1.y;
+				bp->r2X[lane] = ccp->r2.x;
+				bp->r2Y[lane] = ccp->r2.y;
+				bp->normalImpulse[lane] = ccp->normalImpulse;
+				bp->tangentImpulse[lane] = ccp->tangentImpulse;
+				bp->positionImpulse[lane] = ccp->positionImpulse;
+				bp->normalMass[lane] = ccp->normalMass;
+				bp->tangentMass[lane] = ccp->tangentMass;
+				bp->equalizedMass[lane] = ccp->equalizedMass;
+				bp->separation[lane] = ccp->separation;
+				bp->velocityBias[lane] = ccp->velocityBias;
+				bp->active[lane] = 1.0f;
+			}
+		}
+	}
+#endif
+}
+
+// Solves the batches of one color on the threads of a pool. The batches of
+// a color share no dynamic body, so their order does not matter.
+class b2ContactBatchTask : public b2Task
+{
+public:
+	void Execute(int32 index, int32 threadIndex)
+	{
+		if (minSeparations)
+		{
+			float32 separation = solver->SolvePositionBatch(firstBatch + index, baumgarte);
+			minSeparations[threadIndex] = b2Min(minSeparations[threadIndex], separation);
+		}
+		else
+		{
+			solver->SolveVelocityBatch(firstBatch + index);
+		}
+	}
+
+	b2ContactSolver* solver;
+	int32 firstBatch;
+	float32 baumgarte;
+	float32* minSeparations;	// one per thread, NULL to solve velocities
+};
+
+bool b2ContactSolver::UseThreads(int32 batchCount) const
+{
+	return m_threadPool && batchCount >= b2_solverParallelBatches * m_threadPool->GetThreadCount();
+}
+
+void b2ContactSolver::SolveVelocityConstraints()
+{
+	if (m_order == NULL)
+	{
+		for (int32 i = 0; i < m_constraintCount; ++i)
+		{
+			SolveVelocityConstraint(m_constraints + i);
+		}
+		return;
+	}
+
+	for (int32 color = 0; color < b2_solverColorCount; ++color)
+	{
+		int32 first = m_colorStarts[color];
+		int32 count = m_colorStarts[color + 1] - first;
+		if (UseThreads(count))
+		{
+			b2ContactBatchTask task;
+			task.solver = this;
+			task.firstBatch = first;
+			task.baumgarte = 0.0f;
+			task.minSeparations = NULL;
+			m_threadPool->Run(&task, count);
+		}
+		else
+		{
+			for (int32 i = 0; i < count; ++i)
+			{
+				SolveVelocityBatch(first + i);
+			}
+		}
+	}
+
+	int32 overflowStart = m_batchCount * b2_solverLaneCount;
+	for (int32 i = 0; i < m_overflowCount; ++i)
+	{
+		SolveVelocityConstraint(m_constraints + m_order[overflowStart + i]);
+	}
+}
+
+void b2ContactSolver::SolveVelocityConstraint(b2ContactConstraint* c)
+{
+	b2Body* b1 = c->body1;
+	b2Body* b2 = c->body2;
+	float32 w1 = b1->m_angularVelocity;
+	float32 w2 = b2->m_angularVelocity;
+	b2Vec2 v1 = b1->m_linearVelocity;
+	b2Vec2 v2 = b2->m_linearVelocity;
+	float32 invMass1 = b1->m_invMass;
+	float32 invI1 = b1->m_invI;
+	float32 invMass2 = b2->m_invMass;
+	float32 invI2 = b2->m_invI;
+	b2Vec2 normal = c->normal;
+	b2Vec2 tangent = b2Cross(normal, 1.0f);
+	float32 friction = c->friction;
 //#define DEFERRED_UPDATE
 #ifdef DEFERRED_UPDATE
-		b2Vec2 b1_linearVelocity = b1->m_linearVelocity;
-		float32 b1_angularVelocity = b1->m_angularVelocity;
-		b2Vec2 b2_linearVelocity = b2->m_linearVelocity;
-		float32 b2_angularVelocity = b2->m_angularVelocity;
+	b2Vec2 b1_linearVelocity = b1->m_linearVelocity;
+	float32 b1_angularVelocity = b1->m_angularVelocity;
+	b2Vec2 b2_linearVelocity = b2->m_linearVelocity;
+	float32 b2_angularVelocity = b2->m_angularVelocity;
 #endif
-		// Solve normal constraints
-		for (int32 j = 0; j < c->pointCount; ++j)
-		{
-			b2ContactConstraintPoint* ccp = c->points + j;
+	// Solve normal constraints
+	for (int32 j = 0; j < c->pointCount; ++j)
+	{
+		b2ContactConstraintPoint* ccp = c->points + j;
 
-			// Relative velocity at contact
-			b2Vec2 dv = v2 + b2Cross(w2, ccp->r2) - v1 - b2Cross(w1, ccp->r1);
+		// Relative velocity at contact
+		b2Vec2 dv = v2 + b2Cross(w2, ccp->r2) - v1 - b2Cross(w1, ccp->r1);
 
-			// Compute normal impulse
-			float32 vn = b2Dot(dv, normal);
-			float32 lambda = -ccp->normalMass * (vn - ccp->velocityBias);
+		// Compute normal impulse
+		float32 vn = b2Dot(dv, normal);
+		float32 lambda = -ccp->normalMass * (vn - ccp->velocityBias);
 
-			// b2Clamp the accumulated impulse
-			float32 newImpulse = b2Max(ccp->normalImpulse + lambda, 0.0f);
-			lambda = newImpulse - ccp->normalImpulse;
+		// b2Clamp the accumulated impulse
+		float32 newImpulse = b2Max(ccp->normalImpulse + lambda, 0.0f);
+		lambda = newImpulse - ccp->normalImpulse;
 
-			// Apply contact impulse
-			b2Vec2 P = lambda * normal;
+		// Apply contact impulse
+		b2Vec2 P = lambda * normal;
 #ifdef DEFERRED_UPDATE
-			b1_linearVelocity -= invMass1 * P;
-			b1_angularVelocity -= invI1 * b2Cross(r1, P);
+		b1_linearVelocity -= invMass1 * P;
+		b1_angularVelocity -= invI1 * b2Cross(r1, P);
 
-			b2_linearVelocity += invMass2 * P;
-			b2_angularVelocity += invI2 * b2Cross(r2, P);
+		b2_linearVelocity += invMass2 * P;
+		b2_angularVelocity += invI2 * b2Cross(r2, P);
 #else
-			v1 -= invMass1 * P;
-			w1 -= invI1 * b2Cross(ccp->r1, P);
+		v1 -= invMass1 * P;
+		w1 -= invI1 * b2Cross(ccp->r1, P);
 
-			v2 += invMass2 * P;
-			w2 += invI2 * b2Cross(ccp->r2, P);
+		v2 += invMass2 * P;
+		w2 += invI2 * b2Cross(ccp->r2, P);
 #endif
-			ccp->normalImpulse = newImpulse;
-		}
+		ccp->normalImpulse = newImpulse;
+	}
 
 #ifdef DEFERRED_UPDATE
-		b1->m_linearVelocity = b1_linearVelocity;
-		b1->m_angularVelocity = b1_angularVelocity;
-		b2->m_linearVelocity = b2_linearVelocity;
-		b2->m_angularVelocity = b2_angularVelocity;
+	b1->m_linearVelocity = b1_linearVelocity;
+	b1->m_angularVelocity = b1_angularVelocity;
+	b2->m_linearVelocity = b2_linearVelocity;
+	b2->m_angularVelocity = b2_angularVelocity;
 #endif
-		// Solve tangent constraints
-		for (int32 j = 0; j < c->pointCount; ++j)
-		{
-			b2ContactConstraintPoint* ccp = c->points + j;
+	// Solve tangent constraints
+	for (int32 j = 0; j < c->pointCount; ++j)
+	{
+		b2ContactConstraintPoint* ccp = c->points + j;
 
-			// Relative velocity at contact
-			b2Vec2 dv = v2 + b2Cross(w2, ccp->r2) - v1 - b2Cross(w1, ccp->r1);
+		// Relative velocity at contact
+		b2Vec2 dv = v2 + b2Cross(w2, ccp->r2) - v1 - b2Cross(w1, ccp->r1);
 
-			// Compute tangent force
-			float32 vt = b2Dot(dv, tangent);
-			float32 lambda = ccp->tangentMass * (-vt);
+		// Compute tangent force
+		float32 vt = b2Dot(dv, tangent);
+		float32 lambda = ccp->tangentMass * (-vt);
 
-			// b2Clamp the accumulated force
-			float32 maxFriction = friction * ccp->normalImpulse;
-			float32 newImpulse = b2Clamp(ccp->tangentImpulse + lambda, -maxFriction, maxFriction);
-			lambda = newImpulse - ccp->tangentImpulse;
+		// b2Clamp the accumulated force
+		float32 maxFriction = friction * ccp->normalImpulse;
+		float32 newImpulse = b2Clamp(ccp->tangentImpulse + lambda, -maxFriction, maxFriction);
+		lambda = newImpulse - ccp->tangentImpulse;
 
-			// Apply contact impulse
-			b2Vec2 P = lambda * tangent;
+		// Apply contact impulse
+		b2Vec2 P = lambda * tangent;
 
-			v1 -= invMass1 * P;
-			w1 -= invI1 * b2Cross(ccp->r1, P);
+		v1 -= invMass1 * P;
+		w1 -= invI1 * b2Cross(ccp->r1, P);
 
-			v2 += invMass2 * P;
-			w2 += invI2 * b2Cross(ccp->r2, P);
+		v2 += invMass2 * P;
+		w2 += invI2 * b2Cross(ccp->r2, P);
 
-			ccp->tangentImpulse = newImpulse;
-		}
+		ccp->tangentImpulse = newImpulse;
+	}
 
+	if (b1->IsStatic() == false)
+	{
 		b1->m_linearVelocity = v1;
 		b1->m_angularVelocity = w1;
+	}
+
+	if (b2->IsStatic() == false)
+	{
 		b2->m_linearVelocity = v2;
 		b2->m_angularVelocity = w2;
 	}
 }
 
+#ifdef B2_SOLVER_SSE2
+
+// The batch solvers do exactly the floating point operations of the scalar
+// solvers, lane by lane, so both give the same bits.
+
+static inline __m128 b2Neg(__m128 a)
+{
+	return _mm_xor_ps(a, _mm_set1_ps(-0.0f));
+}
+
+// Lanes of a where mask is set, else lanes of b.
+static inline __m128 b2Select(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+void b2ContactSolver::SolveVelocityBatch(int32 index)
+{
+	b2ContactBatch* batch = m_batches + index;
+	float32 x[b2_solverLaneCount], y[b2_solverLaneCount], w[b2_solverLaneCount];
+	GatherVelocities(batch->body1, x, y, w);
+	__m128 v1X = _mm_loadu_ps(x);
+	__m128 v1Y = _mm_loadu_ps(y);
+	__m128 w1 = _mm_loadu_ps(w);
+	GatherVelocities(batch->body2, x, y, w);
+	__m128 v2X = _mm_loadu_ps(x);
+	__m128 v2Y = _mm_loadu_ps(y);
+	__m128 w2 = _mm_loadu_ps(w);
+
+	const __m128 zero = _mm_setzero_ps();
+	__m128 invMass1 = _mm_loadu_ps(batch->invMass1);
+	__m128 invI1 = _mm_loadu_ps(batch->invI1);
+	__m128 invMass2 = _mm_loadu_ps(batch->invMass2);
+	__m128 invI2 = _mm_loadu_ps(batch->invI2);
+	__m128 normalX = _mm_loadu_ps(batch->normalX);
+	__m128 normalY = _mm_loadu_ps(batch->normalY);
+	__m128 tangentX = normalY;
+	__m128 tangentY = b2Neg(normalX);
+	__m128 friction = _mm_loadu_ps(batch->friction);
+
+	// Solve normal constraints
+	for (int32 j = 0; j < batch->pointCount; ++j)
+	{
+		b2ContactBatchPoint* bp = batch->points + j;
+		__m128 active = _mm_cmpgt_ps(_mm_loadu_ps(bp->active), zero);
+		__m128 r1X = _mm_loadu_ps(bp->r1X);
+		__m128 r1Y = _mm_loadu_ps(bp->r1Y);
+		__m128 r2X = _mm_loadu_ps(bp->r2X);
+		__m128 r2Y = _mm_loadu_ps(bp->r2Y);
+		__m128 normalImpulse = _mm_loadu_ps(bp->normalImpulse);
+
+		// Relative velocity at contact
+		__m128 dvX = _mm_add_ps(_mm_sub_ps(_mm_sub_ps(v2X, _mm_mul_ps(w2, r2Y)), v1X), _mm_mul_ps(w1, r1Y));
+		__m128 dvY = _mm_sub_ps(_mm_sub_ps(_mm_add_ps(v2Y, _mm_mul_ps(w2, r2X)), v1Y), _mm_mul_ps(w1, r1X));
+
+		// Compute normal impulse
+		__m128 vn = _mm_add_ps(_mm_mul_ps(dvX, normalX), _mm_mul_ps(dvY, normalY));
+		__m128 lambda = b2Neg(_mm_mul_ps(_mm_loadu_ps(bp->normalMass), _mm_sub_ps(vn, _mm_loadu_ps(bp->velocityBias))));
+
+		// b2Clamp the accumulated impulse
+		__m128 newImpulse = _mm_max_ps(_mm_add_ps(normalImpulse, lambda), zero);
+		lambda = _mm_sub_ps(newImpulse, normalImpulse);
+
+		// Apply contact impulse
+		__m128 PX = _mm_mul_ps(lambda, normalX);
+		__m128 PY = _mm_mul_ps(lambda, normalY);
+
+		v1X = b2Select(active, _mm_sub_ps(v1X, _mm_mul_ps(invMass1, PX)), v1X);
+		v1Y = b2Select(active, _mm_sub_ps(v1Y, _mm_mul_ps(invMass1, PY)), v1Y);
+		w1 = b2Select(active, _mm_sub_ps(w1, _mm_mul_ps(invI1, _mm_sub_ps(_mm_mul_ps(r1X, PY), _mm_mul_ps(r1Y, PX)))), w1);
+
+		v2X = b2Select(active, _mm_add_ps(v2X, _mm_mul_ps(invMass2, PX)), v2X);
+		v2Y = b2Select(active, _mm_add_ps(v2Y, _mm_mul_ps(invMass2, PY)), v2Y);
+		w2 = b2Select(active, _mm_add_ps(w2, _mm_mul_ps(invI2, _mm_sub_ps(_mm_mul_ps(r2X, PY), _mm_mul_ps(r2Y, PX)))), w2);
+
+		_mm_storeu_ps(bp->normalImpulse, b2Select(active, newImpulse, normalImpulse));
+	}
+
+	// Solve tangent constraints
+	for (int32 j = 0; j < batch->pointCount; ++j)
+	{
+		b2ContactBatchPoint* bp = batch->points + j;
+		__m128 active = _mm_cmpgt_ps(_mm_loadu_ps(bp->active), zero);
+		__m128 r1X = _mm_loadu_ps(bp->r1X);
+		__m128 r1Y = _mm_loadu_ps(bp->r1Y);
+		__m128 r2X = _mm_loadu_ps(bp->r2X);
+		__m128 r2Y = _mm_loadu_ps(bp->r2Y);
+		__m128 tangentImpulse = _mm_loadu_ps(bp->tangentImpulse);
+
+		// Relative velocity at contact
+		__m128 dvX = _mm_add_ps(_mm_sub_ps(_mm_sub_ps(v2X, _mm_mul_ps(w2, r2Y)), v1X), _mm_mul_ps(w1, r1Y));
+		__m128 dvY = _mm_sub_ps(_mm_sub_ps(_mm_add_ps(v2Y, _mm_mul_ps(w2, r2X)), v1Y), _mm_mul_ps(w1, r1X));
+
+		// Compute tangent force
+		__m128 vt = _mm_add_ps(_mm_mul_ps(dvX, tangentX), _mm_mul_ps(dvY, tangentY));
+		__m128 lambda = _mm_mul_ps(_mm_loadu_ps(bp->tangentMass), b2Neg(vt));
+
+		// b2Clamp the accumulated force
+		__m128 maxFriction = _mm_mul_ps(friction, _mm_loadu_ps(bp->normalImpulse));
+		__m128 newImpulse = _mm_max_ps(b2Neg(maxFriction), _mm_min_ps(_mm_add_ps(tangentImpulse, lambda), maxFriction));
+		lambda = _mm_sub_ps(newImpulse, tangentImpulse);
+
+		// Apply contact impulse
+		__m128 PX = _mm_mul_ps(lambda, tangentX);
+		__m128 PY = _mm_mul_ps(lambda, tangentY);
+
+		v1X = b2Select(active, _mm_sub_ps(v1X, _mm_mul_ps(invMass1, PX)), v1X);
+		v1Y = b2Select(active, _mm_sub_ps(v1Y, _mm_mul_ps(invMass1, PY)), v1Y);
+		w1 = b2Select(active, _mm_sub_ps(w1, _mm_mul_ps(invI1, _mm_sub_ps(_mm_mul_ps(r1X, PY), _mm_mul_ps(r1Y, PX)))), w1);
+
+		v2X = b2Select(active, _mm_add_ps(v2X, _mm_mul_ps(invMass2, PX)), v2X);
+		v2Y = b2Select(active, _mm_add_ps(v2Y, _mm_mul_ps(invMass2, PY)), v2Y);
+		w2 = b2Select(active, _mm_add_ps(w2, _mm_mul_ps(invI2, _mm_sub_ps(_mm_mul_ps(r2X, PY), _mm_mul_ps(r2Y, PX)))), w2);
+
+		_mm_storeu_ps(bp->tangentImpulse, b2Select(active, newImpulse, tangentImpulse));
+	}
+
+	_mm_storeu_ps(x, v1X);
+	_mm_storeu_ps(y, v1Y);
+	_mm_storeu_ps(w, w1);
+	ScatterVelocities(batch->body1, x, y, w);
+	_mm_storeu_ps(x, v2X);
+	_mm_storeu_ps(y, v2Y);
+	_mm_storeu_ps(w, w2);
+	ScatterVelocities(batch->body2, x, y, w);
+}
+
+struct b2BatchPositions
+{
+	__m128 cX, cY, a;
+	__m128 col1X, col1Y, col2X, col2Y;
+};
+
+static inline void b2LoadPositions(const float32* values, b2BatchPositions* p)
+{
+	p->cX = _mm_loadu_ps(values);
+	p->cY = _mm_loadu_ps(values + b2_solverLaneCount);
+	p->a = _mm_loadu_ps(values + 2 * b2_solverLaneCount);
+	p->col1X = _mm_loadu_ps(values + 3 * b2_solverLaneCount);
+	p->col1Y = _mm_loadu_ps(values + 4 * b2_solverLaneCount);
+	p->col2X = _mm_loadu_ps(values + 5 * b2_solverLaneCount);
+	p->col2Y = _mm_loadu_ps(values + 6 * b2_solverLaneCount);
+}
+
+// Returns the smallest separation of the batch, at most zero.
+float32 b2ContactSolver::SolvePositionBatch(int32 index, float32 baumgarte)
+{
+	b2ContactBatch* batch = m_batches + index;
+	const __m128 zero = _mm_setzero_ps();
+	__m128 minSeparation = zero;
+	__m128 invMass1 = _mm_loadu_ps(batch->equalizedInvMass1);
+	__m128 invI1 = _mm_loadu_ps(batch->equalizedInvI1);
+	__m128 invMass2 = _mm_loadu_ps(batch->equalizedInvMass2);
+	__m128 invI2 = _mm_loadu_ps(batch->equalizedInvI2);
+	__m128 normalX = _mm_loadu_ps(batch->normalX);
+	__m128 normalY = _mm_loadu_ps(batch->normalY);
+	float32 values[7 * b2_solverLaneCount];
+	float32 x[b2_solverLaneCount], y[b2_solverLaneCount], a[b2_solverLaneCount];
+
+	// Solver normal constraints
+	for (int32 j = 0; j < batch->pointCount; ++j)
+	{
+		b2ContactBatchPoint* bp = batch->points + j;
+		__m128 active = _mm_cmpgt_ps(_mm_loadu_ps(bp->active), zero);
+
+		// Each point sees the bodies moved by the previous one.
+		b2BatchPositions p1, p2;
+		GatherPositions(batch->body1, values);
+		b2LoadPositions(values, &p1);
+		GatherPositions(batch->body2, values);
+		b2LoadPositions(values, &p2);
+
+		__m128 localR1X = _mm_loadu_ps(bp->localR1X);
+		__m128 localR1Y = _mm_loadu_ps(bp->localR1Y);
+		__m128 localR2X = _mm_loadu_ps(bp->localR2X);
+		__m128 localR2Y = _mm_loadu_ps(bp->localR2Y);
+		__m128 r1X = _mm_add_ps(_mm_mul_ps(p1.col1X, localR1X), _mm_mul_ps(p1.col2X, localR1Y));
+		__m128 r1Y = _mm_add_ps(_mm_mul_ps(p1.col1Y, localR1X), _mm_mul_ps(p1.col2Y, localR1Y));
+		__m128 r2X = _mm_add_ps(_mm_mul_ps(p2.col1X, localR2X), _mm_mul_ps(p2.col2X, localR2Y));
+		__m128 r2Y = _mm_add_ps(_mm_mul_ps(p2.col1Y, localR2X), _mm_mul_ps(p2.col2Y, localR2Y));
+
+		__m128 dpX = _mm_sub_ps(_mm_add_ps(p2.cX, r2X), _mm_add_ps(p1.cX, r1X));
+		__m128 dpY = _mm_sub_ps(_mm_add_ps(p2.cY, r2Y), _mm_add_ps(p1.cY, r1Y));
+
+		// Approximate the current separation.
+		__m128 separation = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dpX, normalX), _mm_mul_ps(dpY, normalY)), _mm_loadu_ps(bp->separation));
+
+		// Track max constraint error.
+		minSeparation = _mm_min_ps(minSeparation, b2Select(active, separation, zero));
+
+		// Prevent large corrections and allow slop.
+		__m128 C = _mm_mul_ps(_mm_set1_ps(baumgarte), _mm_max_ps(_mm_set1_ps(-b2_maxLinearCorrection),
+			_mm_min_ps(_mm_add_ps(separation, _mm_set1_ps(b2_linearSlop)), zero)));
+
+		// Compute normal impulse
+		__m128 dImpulse = b2Neg(_mm_mul_ps(_mm_loadu_ps(bp->equalizedMass), C));
+
+		// b2Clamp the accumulated impulse
+		__m128 impulse0 = _mm_loadu_ps(bp->positionImpulse);
+		__m128 positionImpulse = _mm_max_ps(_mm_add_ps(impulse0, dImpulse), zero);
+		dImpulse = _mm_sub_ps(positionImpulse, impulse0);
+		_mm_storeu_ps(bp->positionImpulse, b2Select(active, positionImpulse, impulse0));
+
+		__m128 impulseX = _mm_mul_ps(dImpulse, normalX);
+		__m128 impulseY = _mm_mul_ps(dImpulse, normalY);
+
+		__m128 c1X = _mm_sub_ps(p1.cX, _mm_mul_ps(invMass1, impulseX));
+		__m128 c1Y = _mm_sub_ps(p1.cY, _mm_mul_ps(invMass1, impulseY));
+		__m128 a1 = _mm_sub_ps(p1.a, _mm_mul_ps(invI1, _mm_sub_ps(_mm_mul_ps(r1X, impulseY), _mm_mul_ps(r1Y, impulseX))));
+		_mm_storeu_ps(x, c1X);
+		_mm_storeu_ps(y, c1Y);
+		_mm_storeu_ps(a, a1);
+		ScatterPositions(batch->body1, bp->active, x, y, a);
+
+		__m128 c2X = _mm_add_ps(p2.cX, _mm_mul_ps(invMass2, impulseX));
+		__m128 c2Y = _mm_add_ps(p2.cY, _mm_mul_ps(invMass2, impulseY));
+		__m128 a2 = _mm_add_ps(p2.a, _mm_mul_ps(invI2, _mm_sub_ps(_mm_mul_ps(r2X, impulseY), _mm_mul_ps(r2Y, impulseX))));
+		_mm_storeu_ps(x, c2X);
+		_mm_storeu_ps(y, c2Y);
+		_mm_storeu_ps(a, a2);
+		ScatterPositions(batch->body2, bp->active, x, y, a);
+	}
+
+	float32 separations[b2_solverLaneCount];
+	_mm_storeu_ps(separations, minSeparation);
+	float32 result = 0.0f;
+	for (int32 i = 0; i < b2_solverLaneCount; ++i)
+	{
+		result = b2Min(result, separations[i]);
+	}
+	return result;
+}
+
+#else
+
+void b2ContactSolver::SolveVelocityBatch(int32 index)
+{
+	for (int32 lane = 0; lane < b2_solverLaneCount; ++lane)
+	{
+		int32 constraint = m_order[index * b2_solverLaneCount + lane];
+		if (constraint != -1)
+		{
+			SolveVelocityConstraint(m_constraints + constraint);
+		}
+	}
+}
+
+float32 b2ContactSolver::SolvePositionBatch(int32 index, float32 baumgarte)
+{
+	return SolvePositionLanes(index, baumgarte);
+}
+
+#endif
+
+// Solves the lanes of a batch one by one, without SIMD.
+float32 b2ContactSolver::SolvePositionLanes(int32 index, float32 baumgarte)
+{
+	float32 minSeparation = 0.0f;
+	for (int32 lane = 0; lane < b2_solverLaneCount; ++lane)
+	{
+		int32 constraint = m_order[index * b2_solverLaneCount + lane];
+		if (constraint != -1)
+		{
+			minSeparation = b2Min(minSeparation, SolvePositionConstraint(m_constraints + constraint, baumgarte));
+		}
+	}
+	return minSeparation;
+}
+
+void b2ContactSolver::GatherVelocities(b2Body* const* bodies, float32* x, float32* y, float32* w)
+{
+	for (int32 i = 0; i < b2_solverLaneCount; ++i)
+	{
+		const b2Body* b = bodies[i];
+		x[i] = b ? b->m_linearVelocity.x : 0.0f;
+		y[i] = b ? b->m_linearVelocity.y : 0.0f;
+		w[i] = b ? b->m_angularVelocity : 0.0f;
+	}
+}
+
+void b2ContactSolver::ScatterVelocities(b2Body* const* bodies, const float32* x, const float32* y, const float32* w)
+{
+	for (int32 i = 0; i < b2_solverLaneCount; ++i)
+	{
+		b2Body* b = bodies[i];
+		if (b && b->IsStatic() == false)
+		{
+			b->m_linearVelocity.Set(x[i], y[i]);
+			b->m_angularVelocity = w[i];
+		}
+	}
+}
+
+// Center x, center y, angle and rotation columns, b2_solverLaneCount values each.
+void b2ContactSolver::GatherPositions(b2Body* const* bodies, float32* values)
+{
+	for (int32 i = 0; i < b2_solverLaneCount; ++i)
+	{
+		const b2Body* b = bodies[i];
+		if (b)
+		{
+			const b2Mat22& R = b->m_xf.R;
+			values[i] = b->m_sweep.c.x;
+			values[b2_solverLaneCount + i] = b->m_sweep.c.y;
+			values[2 * b2_solverLaneCount + i] = b->m_sweep.a;
+			values[3 * b2_solverLaneCount + i] = R.col1.x;
+			values[4 * b2_solverLaneCount + i] = R.col1.y;
+			values[5 * b2_solverLaneCount + i] = R.col2.x;
+			values[6 * b2_solverLaneCount + i] = R.col2.y;
+		}
+		else
+		{
+			for (int32 k = 0; k < 7; ++k)
+			{
+				values[k * b2_solverLaneCount + i] = 0.0f;
+			}
+		}
+	}
+}
+
+void b2ContactSolver::ScatterPositions(b2Body* const* bodies, const float32* active, const float32* x, const float32* y, const float32* a)
+{
+	for (int32 i = 0; i < b2_solverLaneCount; ++i)
+	{
+		b2Body* b = bodies[i];
+		if (b && active[i] > 0.0f && b->IsStatic() == false)
+		{
+			b->m_sweep.c.Set(x[i], y[i]);
+			b->m_sweep.a = a[i];
+			b->SynchronizeTransform();
+		}
+	}
+}
+
 void b2ContactSolver::FinalizeVelocityConstraints()
 {
+	if (m_batches)
+	{
+		for (int32 i = 0; i < m_batchCount; ++i)
+		{
+			b2ContactBatch* batch = m_batches + i;
+			for (int32 lane = 0; lane < b2_solverLaneCount; ++lane)
+			{
+				int32 index = m_order[i * b2_solverLaneCount + lane];
+				if (index == -1)
+				{
+					continue;
+				}
+
+				b2ContactConstraint* c = m_constraints + index;
+				for (int32 j = 0; j < c->pointCount; ++j)
+				{
+					c->points[j].normalImpulse = batch->points[j].normalImpulse[lane];
+					c->points[j].tangentImpulse = batch->points[j].tangentImpulse[lane];
+				}
+			}
+		}
+	}
+
 	for (int32 i = 0; i < m_constraintCount; ++i)
 	{
 		b2ContactConstraint* c = m_constraints + i;
@@ -301,60 +884,121 @@ bool b2ContactSolver::SolvePositionConstraints(float32 baumgarte)
 {
 	float32 minSeparation = 0.0f;
 
-	for (int32 i = 0; i < m_constraintCount; ++i)
+	if (m_order == NULL)
 	{
-		b2ContactConstraint* c = m_constraints + i;
-		b2Body* b1 = c->body1;
-		b2Body* b2 = c->body2;
-		float32 invMass1 = b1->m_mass * b1->m_invMass;
-		float32 invI1 = b1->m_mass * b1->m_invI;
-		float32 invMass2 = b2->m_mass * b2->m_invMass;
-		float32 invI2 = b2->m_mass * b2->m_invI;
-		
-		b2Vec2 normal = c->normal;
+		for (int32 i = 0; i < m_constraintCount; ++i)
+		{
+			minSeparation = b2Min(minSeparation, SolvePositionConstraint(m_constraints + i, baumgarte));
+		}
+	}
+	else
+	{
+		for (int32 color = 0; color < b2_solverColorCount; ++color)
+		{
+			int32 first = m_colorStarts[color];
+			int32 count = m_colorStarts[color + 1] - first;
+			if (UseThreads(count))
+			{
+				int32 threadCount = m_threadPool->GetThreadCount();
+				float32* minSeparations = (float32*)m_allocator->Allocate(threadCount * sizeof(float32));
+				for (int32 i = 0; i < threadCount; ++i)
+				{
+					minSeparations[i] = 0.0f;
+				}
 
-		// Solver normal constraints
-		for (int32 j = 0; j < c->pointCount; ++j)
+				b2ContactBatchTask task;
+				task.solver = this;
+				task.firstBatch = first;
+				task.baumgarte = baumgarte;
+				task.minSeparations = minSeparations;
+				m_threadPool->Run(&task, count);
+
+				for (int32 i = 0; i < threadCount; ++i)
+				{
+					minSeparation = b2Min(minSeparation, minSeparations[i]);
+				}
+				m_allocator->Free(minSeparations);
+			}
+			else
+			{
+				for (int32 i = 0; i < count; ++i)
+				{
+					minSeparation = b2Min(minSeparation, SolvePositionBatch(first + i, baumgarte));
+				}
+			}
+		}
+
+		int32 overflowStart = m_batchCount * b2_solverLaneCount;
+		for (int32 i = 0; i < m_overflowCount; ++i)
 		{
-			b2ContactConstraintPoint* ccp = c->points + j;
+			minSeparation = b2Min(minSeparation, SolvePositionConstraint(m_constraints + m_order[overflowStart + i], baumgarte));
+		}
+	}
 
-			b2Vec2 r1 = b2Mul(b1->GetXForm().R, ccp->localAnchor1 - b1->GetLocalCenter());
-			b2Vec2 r2 = b2Mul(b2->GetXForm().R, ccp->localAnchor2 - b2->GetLocalCenter());
+	// We can't expect minSpeparation >= -b2_linearSlop because we don't
+	// push the separation above -b2_linearSlop.
+	return minSeparation >= -1.5f * b2_linearSlop;
+}
+
+// Returns the smallest separation of the constraint, at most zero.
+float32 b2ContactSolver::SolvePositionConstraint(b2ContactConstraint* c, float32 baumgarte)
+{
+	float32 minSeparation = 0.0f;
+
+	b2Body* b1 = c->body1;
+	b2Body* b2 = c->body2;
+	float32 invMass1 = b1->m_mass * b1->m_invMass;
+	float32 invI1 = b1->m_mass * b1->m_invI;
+	float32 invMass2 = b2->m_mass * b2->m_invMass;
+	float32 invI2 = b2->m_mass * b2->m_invI;
+	
+	b2Vec2 normal = c->normal;
+
+	// Solver normal constraints
+	for (int32 j = 0; j < c->pointCount; ++j)
+	{
+		b2ContactConstraintPoint* ccp = c->points + j;
+
+		b2Vec2 r1 = b2Mul(b1->GetXForm().R, ccp->localAnchor1 - b1->GetLocalCenter());
+		b2Vec2 r2 = b2Mul(b2->GetXForm().R, ccp->localAnchor2 - b2->GetLocalCenter());
 
-			b2Vec2 p1 = b1->m_sweep.c + r1;
-			b2Vec2 p2 = b2->m_sweep.c + r2;
-			b2Vec2 dp = p2 - p1;
+		b2Vec2 p1 = b1->m_sweep.c + r1;
+		b2Vec2 p2 = b2->m_sweep.c + r2;
+		b2Vec2 dp = p2 - p1;
 
-			// Approximate the current separation.
-			float32 separation = b2Dot(dp, normal) + ccp->separation;
+		// Approximate the current separation.
+		float32 separation = b2Dot(dp, normal) + ccp->separation;
 
-			// Track max constraint error.
-			minSeparation = b2Min(minSeparation, separation);
+		// Track max constraint error.
+		minSeparation = b2Min(minSeparation, separation);
 
-			// Prevent large corrections and allow slop.
-			float32 C = baumgarte * b2Clamp(separation + b2_linearSlop, -b2_maxLinearCorrection, 0.0f);
+		// Prevent large corrections and allow slop.
+		float32 C = baumgarte * b2Clamp(separation + b2_linearSlop, -b2_maxLinearCorrection, 0.0f);
 
-			// Compute normal impulse
-			float32 dImpulse = -ccp->equalizedMass * C;
+		// Compute normal impulse
+		float32 dImpulse = -ccp->equalizedMass * C;
 
-			// b2Clamp the accumulated impulse
-			float32 impulse0 = ccp->positionImpulse;
-			ccp->positionImpulse = b2Max(impulse0 + dImpulse, 0.0f);
-			dImpulse = ccp->positionImpulse - impulse0;
+		// b2Clamp the accumulated impulse
+		float32 impulse0 = ccp->positionImpulse;
+		ccp->positionImpulse = b2Max(impulse0 + dImpulse, 0.0f);
+		dImpulse = ccp->positionImpulse - impulse0;
 
-			b2Vec2 impulse = dImpulse * normal;
+		b2Vec2 impulse = dImpulse * normal;
 
+		if (b1->IsStatic() == false)
+		{
 			b1->m_sweep.c -= invMass1 * impulse;
 			b1->m_sweep.a -= invI1 * b2Cross(r1, impulse);
 			b1->SynchronizeTransform();
+		}
 
+		if (b2->IsStatic() == false)
+		{
 			b2->m_sweep.c += invMass2 * impulse;
 			b2->m_sweep.a += invI2 * b2Cross(r2, impulse);
 			b2->SynchronizeTransform();
 		}
 	}
 
-	// We can't expect minSpeparation >= -b2_linearSlop because we don't
-	// push the separation above -b2_linearSlop.
-	return minSeparation >= -1.5f * b2_linearSlop;
+	return minSeparation;
 }
@@ -27,6 +27,7 @@ class b2Contact;
 class b2Body;
 class b2Island;
 class b2StackAllocator;
+class b2ThreadPool;
 
 struct b2ContactConstraintPoint
 {
@@ -54,6 +55,50 @@ struct b2ContactConstraint
 	float32 friction;
 	float32 restitution;
 	int32 pointCount;
+	int32 color;	// batched solver color, -1 to be solved on its own
+};
+
+/// One contact point of each constraint in a batch, stored lane by lane.
+struct b2ContactBatchPoint
+{
+	float32 localR1X[b2_solverLaneCount];	// anchor relative to the center of mass, body frame
+	float32 localR1Y[b2_solverLaneCount];
+	float32 localR2X[b2_solverLaneCount];
+	float32 localR2Y[b2_solverLaneCount];
+	float32 r1X[b2_solverLaneCount];
+	float32 r1Y[b2_solverLaneCount];
+	float32 r2X[b2_solverLaneCount];
+	float32 r2Y[b2_solverLaneCount];
+	float32 normalImpulse[b2_solverLaneCount];
+	float32 tangentImpulse[b2_solverLaneCount];
+	float32 positionImpulse[b2_solverLaneCount];
+	float32 normalMass[b2_solverLaneCount];
+	float32 tangentMass[b2_solverLaneCount];
+	float32 equalizedMass[b2_solverLaneCount];
+	float32 separation[b2_solverLaneCount];
+	float32 velocityBias[b2_solverLaneCount];
+	float32 active[b2_solverLaneCount];		// 1 if the lane has this point, else 0
+};
+
+/// Up to b2_solverLaneCount contact constraints that share no dynamic body,
+/// so they can be solved at once. Empty lanes have NULL bodies.
+struct b2ContactBatch
+{
+	b2ContactBatchPoint points[b2_maxManifoldPoints];
+	b2Body* body1[b2_solverLaneCount];
+	b2Body* body2[b2_solverLaneCount];
+	float32 normalX[b2_solverLaneCount];
+	float32 normalY[b2_solverLaneCount];
+	float32 friction[b2_solverLaneCount];
+	float32 invMass1[b2_solverLaneCount];
+	float32 invI1[b2_solverLaneCount];
+	float32 invMass2[b2_solverLaneCount];
+	float32 invI2[b2_solverLaneCount];
+	float32 equalizedInvMass1[b2_solverLaneCount];	// m_mass * m_invMass, for position correction
+	float32 equalizedInvI1[b2_solverLaneCount];
+	float32 equalizedInvMass2[b2_solverLaneCount];
+	float32 equalizedInvI2[b2_solverLaneCount];
+	int32 pointCount;	// most points of any lane
 };
 
 class b2ContactSolver
@@ -72,6 +117,37 @@ public:
 	b2StackAllocator* m_allocator;
 	b2ContactConstraint* m_constraints;
 	int m_constraintCount;
+
+	// Batched solver (b2TimeStep::batchedSolver), built by InitVelocityConstraints
+	// from the colors of b2Island::Color. The constraints are solved in the order
+	// of m_order: b2_solverLaneCount entries per batch (-1 for an empty lane),
+	// then the constraints that did not fit into any color.
+	int32* m_order;
+	int32 m_batchCount;
+	int32 m_overflowCount;
+	int32 m_colorStarts[b2_solverColorCount + 1];	// first batch of each color
+	b2ContactBatch* m_batches;	// NULL without SIMD support, m_order is then solved one by one
+
+	// If set, the batches of large colors are split among the threads of the pool.
+	b2ThreadPool* m_threadPool;
+
+private:
+	friend class b2ContactBatchTask;
+
+	void BuildBatches();
+	void SolveVelocityConstraint(b2ContactConstraint* c);
+	float32 SolvePositionConstraint(b2ContactConstraint* c, float32 baumgarte);
+	void SolveVelocityBatch(int32 index);
+	float32 SolvePositionBatch(int32 index, float32 baumgarte);
+	float32 SolvePositionLanes(int32 index, float32 baumgarte);
+	bool UseThreads(int32 batchCount) const;
+
+	// Copy body state of a batch lane by lane. Empty lanes read zero, static
+	// bodies and inactive lanes are not written.
+	static void GatherVelocities(b2Body* const* bodies, float32* x, float32* y, float32* w);
+	static void ScatterVelocities(b2Body* const* bodies, const float32* x, const float32* y, const float32* w);
+	static void GatherPositions(b2Body* const* bodies, float32* values);
+	static void ScatterPositions(b2Body* const* bodies, const float32* active, const float32* x, const float32* y, const float32* a);
 };
 
 #endif
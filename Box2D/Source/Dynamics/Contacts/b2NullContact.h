@@ -26,7 +26,7 @@ class b2NullContact : public b2Contact
 {
 public:
 	b2NullContact() {}
-	void Evaluate(b2ContactListener*) {}
+	void Evaluate(b2ContactListener*, float32) {}
 	b2Manifold* GetManifolds() { return NULL; }
 };
 
@@ -46,7 +46,7 @@ b2PolyAndCircleContact::b2PolyAndCircleContact(b2Shape* s1, b2Shape* s2)
 	m_manifold.points[0].tangentImpulse = 0.0f;
 }
 
-void b2PolyAndCircleContact::Evaluate(b2ContactListener* listener)
+void b2PolyAndCircleContact::Evaluate(b2ContactListener* listener, float32 margin)
 {
 	b2Body* b1 = m_shape1->GetBody();
 	b2Body* b2 = m_shape2->GetBody();
@@ -54,7 +54,7 @@ void b2PolyAndCircleContact::Evaluate(b2ContactListener* listener)
 	b2Manifold m0;
 	memcpy(&m0, &m_manifold, sizeof(b2Manifold));
 
-	b2CollidePolygonAndCircle(&m_manifold, (b2PolygonShape*)m_shape1, b1->GetXForm(), (b2CircleShape*)m_shape2, b2->GetXForm());
+	b2CollidePolygonAndCircle(&m_manifold, (b2PolygonShape*)m_shape1, b1->GetXForm(), (b2CircleShape*)m_shape2, b2->GetXForm(), margin);
 
 	bool persisted[b2_maxManifoldPoints] = {false, false};
 
@@ -104,6 +104,7 @@ void b2PolyAndCircleContact::Evaluate(b2ContactListener* listener)
 						cp.velocity = v2 - v1;
 						cp.normal = m_manifold.normal;
 						cp.separation = mp->separation;
+						cp.separation0 = mp0->separation;
 						cp.id = id;
 						listener->Persist(&cp);
 					}
@@ -120,6 +121,7 @@ void b2PolyAndCircleContact::Evaluate(b2ContactListener* listener)
 				cp.velocity = v2 - v1;
 				cp.normal = m_manifold.normal;
 				cp.separation = mp->separation;
+				cp.separation0 = mp->separation;
 				cp.id = id;
 				listener->Add(&cp);
 			}
@@ -152,6 +154,7 @@ void b2PolyAndCircleContact::Evaluate(b2ContactListener* listener)
 		cp.velocity = v2 - v1;
 		cp.normal = m0.normal;
 		cp.separation = mp0->separation;
+		cp.separation0 = mp0->separation;
 		cp.id = mp0->id;
 		listener->Remove(&cp);
 	}
@@ -32,7 +32,7 @@ public:
 	b2PolyAndCircleContact(b2Shape* shape1, b2Shape* shape2);
 	~b2PolyAndCircleContact() {}
 
-	void Evaluate(b2ContactListener* listener);
+	void Evaluate(b2ContactListener* listener, float32 margin);
 	b2Manifold* GetManifolds()
 	{
 		return &m_manifold;
@@ -45,7 +45,7 @@ b2PolygonContact::b2PolygonContact(b2Shape* s1, b2Shape* s2)
 	m_manifold.pointCount = 0;
 }
 
-void b2PolygonContact::Evaluate(b2ContactListener* listener)
+void b2PolygonContact::Evaluate(b2ContactListener* listener, float32 margin)
 {
 	b2Body* b1 = m_shape1->GetBody();
 	b2Body* b2 = m_shape2->GetBody();
@@ -53,7 +53,7 @@ void b2PolygonContact::Evaluate(b2ContactListener* listener)
 	b2Manifold m0;
 	memcpy(&m0, &m_manifold, sizeof(b2Manifold));
 
-	b2CollidePolygons(&m_manifold, (b2PolygonShape*)m_shape1, b1->GetXForm(), (b2PolygonShape*)m_shape2, b2->GetXForm());
+	b2CollidePolygons(&m_manifold, (b2PolygonShape*)m_shape1, b1->GetXForm(), (b2PolygonShape*)m_shape2, b2->GetXForm(), margin);
 
 	bool persisted[b2_maxManifoldPoints] = {false, false};
 
@@ -103,6 +103,7 @@ void b2PolygonContact::Evaluate(b2ContactListener* listener)
 						cp.velocity = v2 - v1;
 						cp.normal = m_manifold.normal;
 						cp.separation = mp->separation;
+						cp.separation0 = mp0->separation;
 						cp.id = id;
 						listener->Persist(&cp);
 					}
@@ -119,6 +120,7 @@ void b2PolygonContact::Evaluate(b2ContactListener* listener)
 				cp.velocity = v2 - v1;
 				cp.normal = m_manifold.normal;
 				cp.separation = mp->separation;
+				cp.separation0 = mp->separation;
 				cp.id = id;
 				listener->Add(&cp);
 			}
@@ -151,6 +153,7 @@ void b2PolygonContact::Evaluate(b2ContactListener* listener)
 		cp.velocity = v2 - v1;
 		cp.normal = m0.normal;
 		cp.separation = mp0->separation;
+		cp.separation0 = mp0->separation;
 		cp.id = mp0->id;
 		listener->Remove(&cp);
 	}
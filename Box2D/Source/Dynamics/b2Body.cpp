@@ -183,6 +183,8 @@ void b2Body::SetMass(const b2MassData* massData)
 		return;
 	}
 
+	m_world->m_asleep = false;
+
 	m_invMass = 0.0f;
 	m_I = 0.0f;
 	m_invI = 0.0f;
@@ -243,6 +245,8 @@ void b2Body::SetMassFromShapes()
 		return;
 	}
 
+	m_world->m_asleep = false;
+
 	// Compute mass data from shapes. Each shape has its own density.
 	m_mass = 0.0f;
 	m_invMass = 0.0f;
@@ -324,6 +328,7 @@ bool b2Body::SetXForm(const b2Vec2& position, float32 angle)
 
 	m_xf.R.Set(angle);
 	m_xf.position = position;
+	m_world->m_asleep = false;
 
 	m_sweep.c0 = m_sweep.c = b2Mul(m_xf, m_sweep.localCenter);
 	m_sweep.a0 = m_sweep.a = angle;
@@ -359,11 +364,32 @@ bool b2Body::SetXForm(const b2Vec2& position, float32 angle)
 	return true;
 }
 
-bool b2Body::SynchronizeShapes()
+void b2Body::WakeUp()
 {
+	if (m_flags & e_sleepFlag)
+	{
+		m_world->m_asleep = false;
+	}
+
+	m_flags &= ~e_sleepFlag;
+	m_sleepTime = 0.0f;
+}
+
+bool b2Body::SynchronizeShapes(float32 speculativeTime)
+{
+	// The proxies cover the sweep of the step, or the motion over the
+	// speculative time at the current velocity.
 	b2XForm xf1;
-	xf1.R.Set(m_sweep.a0);
-	xf1.position = m_sweep.c0 - b2Mul(xf1.R, m_sweep.localCenter);
+	if (speculativeTime > 0.0f)
+	{
+		xf1.R.Set(m_sweep.a + speculativeTime * m_angularVelocity);
+		xf1.position = m_sweep.c + speculativeTime * m_linearVelocity - b2Mul(xf1.R, m_sweep.localCenter);
+	}
+	else
+	{
+		xf1.R.Set(m_sweep.a0);
+		xf1.position = m_sweep.c0 - b2Mul(xf1.R, m_sweep.localCenter);
+	}
 
 	bool inRange = true;
 	for (b2Shape* s = m_shapeList; s; s = s->m_next)
@@ -392,3 +418,4 @@ bool b2Body::SynchronizeShapes()
 	// Success
 	return true;
 }
+
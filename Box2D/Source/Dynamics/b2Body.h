@@ -274,6 +274,7 @@ private:
 	friend class b2Island;
 	friend class b2ContactManager;
 	friend class b2ContactSolver;
+	friend class b2Contact;
 	
 	friend class b2DistanceJoint;
 	friend class b2GearJoint;
@@ -304,7 +305,11 @@ private:
 	b2Body(const b2BodyDef* bd, b2World* world);
 	~b2Body();
 
-	bool SynchronizeShapes();
+	bool SynchronizeShapes(float32 speculativeTime = 0.0f);
+
+	// The velocities the next step of length dt starts solving with: gravity
+	// and the applied forces integrated, damping left out.
+	void PredictVelocity(float32 dt, const b2Vec2& gravity, b2Vec2* v, float32* w) const;
 
 	void SynchronizeTransform();
 
@@ -343,6 +348,8 @@ private:
 	float32 m_linearDamping;
 	float32 m_angularDamping;
 
+	int32 m_islandIndex;	// index in the island being solved, not set for static bodies
+
 	float32 m_sleepTime;
 
 	void* m_userData;
@@ -423,6 +430,20 @@ inline b2Vec2 b2Body::GetLocalVector(const b2Vec2& worldVector) const
 	return b2MulT(m_xf.R, worldVector);
 }
 
+inline void b2Body::PredictVelocity(float32 dt, const b2Vec2& gravity, b2Vec2* v, float32* w) const
+{
+	*v = m_linearVelocity;
+	*w = m_angularVelocity;
+
+	if (IsStatic())
+	{
+		return;
+	}
+
+	*v += dt * (gravity + m_invMass * m_force);
+	*w += dt * m_invI * m_torque;
+}
+
 inline b2Vec2 b2Body::GetLinearVelocityFromWorldPoint(const b2Vec2& worldPoint) const
 {
 	return m_linearVelocity + b2Cross(m_angularVelocity, worldPoint - m_sweep.c);
@@ -483,12 +504,6 @@ inline void b2Body::AllowSleeping(bool flag)
 	}
 }
 
-inline void b2Body::WakeUp()
-{
-	m_flags &= ~e_sleepFlag;
-	m_sleepTime = 0.0f;
-}
-
 inline void b2Body::PutToSleep()
 {
 	m_flags |= e_sleepFlag;
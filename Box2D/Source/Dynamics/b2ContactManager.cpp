@@ -19,6 +19,9 @@
 #include "b2ContactManager.h"
 #include "b2World.h"
 #include "b2Body.h"
+#include "../Common/b2StackAllocator.h"
+#include "../Common/b2ThreadPool.h"
+#include <string.h>
 
 // This is a callback from the broadphase when two AABB proxies begin
 // to overlap. We create a b2Contact to manage the narrow phase.
@@ -58,6 +61,9 @@ void* b2ContactManager::PairAdded(void* proxyUserData1, void* proxyUserData2)
 		return &m_nullContact;
 	}
 
+	// The new contact is evaluated by the next step.
+	m_world->m_asleep = false;
+
 	// Contact creation may swap shapes.
 	shape1 = c->GetShape1();
 	shape2 = c->GetShape2();
@@ -131,6 +137,8 @@ void b2ContactManager::Destroy(b2Contact* c)
 	b2Shape* shape1 = c->GetShape1();
 	b2Shape* shape2 = c->GetShape2();
 
+	m_world->m_asleep = false;
+
 	// Inform the user that this contact is ending.
 	int32 manifoldCount = c->GetManifoldCount();
 	if (manifoldCount > 0 && m_world->m_contactListener)
@@ -158,6 +166,7 @@ void b2ContactManager::Destroy(b2Contact* c)
 				b2Vec2 v2 = b2->GetLinearVelocityFromLocalPoint(mp->localPoint2);
 				cp.velocity = v2 - v1;
 				cp.separation = mp->separation;
+				cp.separation0 = mp->separation;
 				cp.id = mp->id;
 				m_world->m_contactListener->Remove(&cp);
 			}
@@ -220,21 +229,232 @@ void b2ContactManager::Destroy(b2Contact* c)
 	--m_world->m_contactCount;
 }
 
+// Update a contact unless both bodies sleep.
+void b2ContactManager::Update(b2Contact* c, float32 speculativeTime)
+{
+	b2Body* body1 = c->GetShape1()->GetBody();
+	b2Body* body2 = c->GetShape2()->GetBody();
+	if (body1->IsSleeping() && body2->IsSleeping())
+	{
+		return;
+	}
+
+	// A contact between bodies at rest gets the same manifold again,
+	// unless it has just started or stopped touching.
+	int32 oldCount = c->GetManifoldCount();
+	c->Update(m_world->m_contactListener, m_world->m_manifoldCaching, speculativeTime);
+	if (c->GetManifoldCount() != oldCount)
+	{
+		m_world->m_asleep = false;
+	}
+}
+
+// An awake contact updated by the parallel narrow phase.
+struct b2CollideItem
+{
+	b2Contact* contact;
+	int32 oldManifoldCount;
+	int32 eventCount;
+};
+
+// The items of a batch are updated by one thread, so their contact point
+// events follow each other in the buffer of that thread.
+struct b2CollideBatch
+{
+	int32 threadIndex;
+	int32 eventStart;
+};
+
+// Updates batches of b2_collideBatchSize contacts on the threads of the
+// world's pool. The contact points go to the buffer of the thread.
+class b2CollideTask : public b2Task
+{
+public:
+	void Execute(int32 index, int32 threadIndex)
+	{
+		b2CollideBatch* batch = batches + index;
+		b2ContactPointBuffer* buffer = points + threadIndex;
+		b2ContactListener* bufferListener = listener ? buffer : NULL;
+
+		batch->threadIndex = threadIndex;
+		batch->eventStart = buffer->m_count;
+
+		int32 end = b2Min(itemCount, (index + 1) * b2_collideBatchSize);
+		for (int32 i = index * b2_collideBatchSize; i < end; ++i)
+		{
+			b2CollideItem* item = items + i;
+			int32 eventStart = buffer->m_count;
+			item->oldManifoldCount = item->contact->GetManifoldCount();
+			item->contact->UpdateManifolds(bufferListener, cacheManifolds, speculativeTime);
+			item->eventCount = buffer->m_count - eventStart;
+		}
+	}
+
+	b2CollideItem* items;
+	int32 itemCount;
+	b2CollideBatch* batches;
+	b2ContactPointBuffer* points;
+	b2ContactListener* listener;
+	bool cacheManifolds;
+	float32 speculativeTime;
+};
+
 // This is the top level collision call for the time step. Here
 // all the narrow phase collision is processed for the world
 // contact list.
-void b2ContactManager::Collide()
+void b2ContactManager::Collide(const b2TimeStep& step)
 {
-	// Update awake contacts.
+	// Speculative contacts look one step ahead.
+	float32 speculativeTime = m_world->m_speculativeContacts ? step.dt : 0.0f;
+
+	if (m_world->m_threadPool == NULL || m_world->m_contactCount < b2_parallelCollideContacts)
+	{
+		for (b2Contact* c = m_world->m_contactList; c; c = c->GetNext())
+		{
+			Update(c, speculativeTime);
+		}
+		return;
+	}
+
+	// Gather the awake contacts.
+	b2StackAllocator* allocator = &m_world->m_stackAllocator;
+	b2CollideItem* items = (b2CollideItem*)allocator->Allocate(m_world->m_contactCount * sizeof(b2CollideItem));
+	int32 itemCount = 0;
 	for (b2Contact* c = m_world->m_contactList; c; c = c->GetNext())
 	{
 		b2Body* body1 = c->GetShape1()->GetBody();
 		b2Body* body2 = c->GetShape2()->GetBody();
-		if (body1->IsSleeping() && body2->IsSleeping())
+		if (body1->IsSleeping() == false || body2->IsSleeping() == false)
+		{
+			items[itemCount++].contact = c;
+		}
+	}
+
+	if (itemCount < b2_parallelCollideContacts)
+	{
+		allocator->Free(items);
+		for (b2Contact* c = m_world->m_contactList; c; c = c->GetNext())
 		{
+			Update(c, speculativeTime);
+		}
+		return;
+	}
+
+	int32 batchCount = (itemCount + b2_collideBatchSize - 1) / b2_collideBatchSize;
+	b2CollideBatch* batches = (b2CollideBatch*)allocator->Allocate(batchCount * sizeof(b2CollideBatch));
+
+	b2ContactPointBuffer* points = m_world->m_threadPoints;
+	for (int32 i = 0; i < m_world->m_threadPool->GetThreadCount(); ++i)
+	{
+		points[i].Clear();
+	}
+
+	b2CollideTask task;
+	task.items = items;
+	task.itemCount = itemCount;
+	task.batches = batches;
+	task.points = points;
+	task.listener = m_world->m_contactListener;
+	task.cacheManifolds = m_world->m_manifoldCaching;
+	task.speculativeTime = speculativeTime;
+	m_world->m_threadPool->Run(&task, batchCount);
+
+	// Report the contact points and wake the bodies in contact list order,
+	// as a single thread would. A contact between sleeping bodies may get
+	// woken by an earlier contact, it is updated here.
+	int32 itemIndex = 0;
+	int32 eventIndex = 0;
+	for (b2Contact* c = m_world->m_contactList; c; c = c->GetNext())
+	{
+		if (itemIndex == itemCount || items[itemIndex].contact != c)
+		{
+			Update(c, speculativeTime);
 			continue;
 		}
 
-		c->Update(m_world->m_contactListener);
+		const b2CollideItem* item = items + itemIndex;
+		const b2CollideBatch* batch = batches + itemIndex / b2_collideBatchSize;
+		if (itemIndex % b2_collideBatchSize == 0)
+		{
+			eventIndex = batch->eventStart;
+		}
+		++itemIndex;
+
+		if (item->eventCount > 0)
+		{
+			points[batch->threadIndex].Report(m_world->m_contactListener, eventIndex, item->eventCount);
+			eventIndex += item->eventCount;
+		}
+
+		int32 newCount = c->GetManifoldCount();
+		if (newCount == 0 && item->oldManifoldCount > 0)
+		{
+			c->GetShape1()->GetBody()->WakeUp();
+			c->GetShape2()->GetBody()->WakeUp();
+		}
+
+		if (newCount != item->oldManifoldCount)
+		{
+			m_world->m_asleep = false;
+		}
+	}
+
+	allocator->Free(batches);
+	allocator->Free(items);
+}
+
+b2ContactPointBuffer::b2ContactPointBuffer()
+{
+	m_events = NULL;
+	m_count = 0;
+	m_capacity = 0;
+}
+
+b2ContactPointBuffer::~b2ContactPointBuffer()
+{
+	b2Free(m_events);
+}
+
+void b2ContactPointBuffer::Push(b2EventType type, const b2ContactPoint* point)
+{
+	if (m_count == m_capacity)
+	{
+		int32 capacity = b2Max(2 * m_capacity, 256);
+		b2Event* events = (b2Event*)b2Alloc(capacity * sizeof(b2Event));
+		if (m_events)
+		{
+			memcpy(events, m_events, m_count * sizeof(b2Event));
+			b2Free(m_events);
+		}
+		m_events = events;
+		m_capacity = capacity;
+	}
+
+	b2Event* event = m_events + m_count;
+	event->type = type;
+	event->point = *point;
+	++m_count;
+}
+
+void b2ContactPointBuffer::Report(b2ContactListener* listener, int32 start, int32 count) const
+{
+	b2Assert(0 <= start && start + count <= m_count);
+	for (int32 i = start; i < start + count; ++i)
+	{
+		const b2Event* event = m_events + i;
+		switch (event->type)
+		{
+		case e_addEvent:
+			listener->Add(&event->point);
+			break;
+
+		case e_persistEvent:
+			listener->Persist(&event->point);
+			break;
+
+		case e_removeEvent:
+			listener->Remove(&event->point);
+			break;
+		}
 	}
 }
@@ -21,11 +21,53 @@
 
 #include "../Collision/b2BroadPhase.h"
 #include "../Dynamics/Contacts/b2NullContact.h"
+#include "b2WorldCallbacks.h"
 
 class b2World;
 class b2Contact;
 struct b2TimeStep;
 
+/// Contact points reported by contacts updated on worker threads. The contact
+/// manager hands them to the contact listener once all contacts are updated,
+/// in contact list order.
+class b2ContactPointBuffer : public b2ContactListener
+{
+public:
+	enum b2EventType
+	{
+		e_addEvent,
+		e_persistEvent,
+		e_removeEvent
+	};
+
+	struct b2Event
+	{
+		b2EventType type;
+		b2ContactPoint point;
+	};
+
+	b2ContactPointBuffer();
+	~b2ContactPointBuffer();
+
+	void Add(const b2ContactPoint* point) { Push(e_addEvent, point); }
+	void Persist(const b2ContactPoint* point) { Push(e_persistEvent, point); }
+	void Remove(const b2ContactPoint* point) { Push(e_removeEvent, point); }
+
+	// Results come from the solver, never from the narrow phase.
+	void Result(const b2ContactResult* point) { B2_NOT_USED(point); b2Assert(false); }
+
+	/// Report count events from start on to the listener.
+	void Report(b2ContactListener* listener, int32 start, int32 count) const;
+
+	void Clear() { m_count = 0; }
+
+	void Push(b2EventType type, const b2ContactPoint* point);
+
+	b2Event* m_events;
+	int32 m_count;
+	int32 m_capacity;
+};
+
 // Delegate of b2World.
 class b2ContactManager : public b2PairCallback
 {
@@ -40,7 +82,9 @@ public:
 
 	void Destroy(b2Contact* c);
 
-	void Collide();
+	void Collide(const b2TimeStep& step);
+
+	void Update(b2Contact* c, float32 speculativeTime);
 
 	b2World* m_world;
 
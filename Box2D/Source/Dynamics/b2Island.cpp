@@ -24,6 +24,8 @@
 #include "Joints/b2Joint.h"
 #include "../Common/b2StackAllocator.h"
 
+#include <string.h>
+
 /*
 Position Correction Notes
 =========================
@@ -125,6 +127,11 @@ b2Island::b2Island(
 	m_joints = (b2Joint**)m_allocator->Allocate(jointCapacity * sizeof(b2Joint*));
 
 	m_positionIterationCount = 0;
+	m_sleeping = false;
+	m_results = NULL;
+	m_threadPool = NULL;
+	m_colorCount = 0;
+	m_overflowCount = 0;
 }
 
 b2Island::~b2Island()
@@ -135,8 +142,79 @@ b2Island::~b2Island()
 	m_allocator->Free(m_bodies);
 }
 
+// Give every contact a color so that no two contacts of a color share a
+// dynamic body. A contact keeps its color from the last step when it can, so
+// the batches of the solver change little from step to step.
+void b2Island::Color()
+{
+	uint32* bodyColors = (uint32*)m_allocator->Allocate(m_bodyCount * sizeof(uint32));
+	memset(bodyColors, 0, m_bodyCount * sizeof(uint32));
+
+	uint32 usedColors = 0;
+	m_overflowCount = 0;
+	for (int32 i = 0; i < m_contactCount; ++i)
+	{
+		b2Contact* c = m_contacts[i];
+		b2Body* b1 = c->m_shape1->GetBody();
+		b2Body* b2 = c->m_shape2->GetBody();
+
+		// Static bodies are never written by the solver, so any
+		// number of contacts of a color may share one.
+		uint32* colors1 = b1->IsStatic() ? NULL : bodyColors + b1->m_islandIndex;
+		uint32* colors2 = b2->IsStatic() ? NULL : bodyColors + b2->m_islandIndex;
+		uint32 used = (colors1 ? *colors1 : 0) | (colors2 ? *colors2 : 0);
+
+		int32 color = c->m_color;
+		if (color == -1 || (used & (1u << color)) != 0)
+		{
+			color = -1;
+			for (int32 j = 0; j < b2_solverColorCount; ++j)
+			{
+				if ((used & (1u << j)) == 0)
+				{
+					color = j;
+					break;
+				}
+			}
+		}
+
+		c->m_color = color;
+		if (color == -1)
+		{
+			++m_overflowCount;
+			continue;
+		}
+
+		uint32 bit = 1u << color;
+		usedColors |= bit;
+		if (colors1)
+		{
+			*colors1 |= bit;
+		}
+		if (colors2)
+		{
+			*colors2 |= bit;
+		}
+	}
+
+	m_colorCount = 0;
+	for (int32 i = 0; i < b2_solverColorCount; ++i)
+	{
+		if (usedColors & (1u << i))
+		{
+			++m_colorCount;
+		}
+	}
+
+	m_allocator->Free(bodyColors);
+}
+
 void b2Island::Solve(const b2TimeStep& step, const b2Vec2& gravity, bool correctPositions, bool allowSleep)
 {
+	m_sleeping = false;
+	m_colorCount = 0;
+	m_overflowCount = 0;
+
 	// Integrate velocities and apply damping.
 	for (int32 i = 0; i < m_bodyCount; ++i)
 	{
@@ -197,7 +275,13 @@ void b2Island::Solve(const b2TimeStep& step, const b2Vec2& gravity, bool correct
 
 	}
 
+	if (step.batchedSolver)
+	{
+		Color();
+	}
+
 	b2ContactSolver contactSolver(step, m_contacts, m_contactCount, m_allocator);
+	contactSolver.m_threadPool = m_threadPool;
 
 	// Initialize velocity constraints.
 	contactSolver.InitVelocityConstraints(step);
@@ -316,11 +400,18 @@ void b2Island::Solve(const b2TimeStep& step, const b2Vec2& gravity, bool correct
 			}
 		}
 
-		if (minSleepTime >= b2_timeToSleep)
+		// Static bodies are left to the world, they may be in other islands.
+		m_sleeping = minSleepTime >= b2_timeToSleep;
+		if (m_sleeping)
 		{
 			for (int32 i = 0; i < m_bodyCount; ++i)
 			{
 				b2Body* b = m_bodies[i];
+				if (b->IsStatic())
+				{
+					continue;
+				}
+
 				b->m_flags |= b2Body::e_sleepFlag;
 				b->m_linearVelocity = b2Vec2_zero;
 				b->m_angularVelocity = 0.0f;
@@ -413,8 +504,46 @@ void b2Island::Report(b2ContactConstraint* constraints)
 				cr.tangentImpulse = ccp->tangentImpulse;
 				cr.id = point->id;
 
-				m_listener->Result(&cr);
+				if (m_results)
+				{
+					m_results->Add(cr);
+				}
+				else
+				{
+					m_listener->Result(&cr);
+				}
 			}
 		}
 	}
 }
+
+b2ContactResultBuffer::b2ContactResultBuffer()
+{
+	m_results = NULL;
+	m_count = 0;
+	m_capacity = 0;
+}
+
+b2ContactResultBuffer::~b2ContactResultBuffer()
+{
+	b2Free(m_results);
+}
+
+void b2ContactResultBuffer::Add(const b2ContactResult& result)
+{
+	if (m_count == m_capacity)
+	{
+		int32 capacity = b2Max(2 * m_capacity, 256);
+		b2ContactResult* results = (b2ContactResult*)b2Alloc(capacity * sizeof(b2ContactResult));
+		if (m_results)
+		{
+			memcpy(results, m_results, m_count * sizeof(b2ContactResult));
+			b2Free(m_results);
+		}
+		m_results = results;
+		m_capacity = capacity;
+	}
+
+	m_results[m_count] = result;
+	++m_count;
+}
@@ -20,15 +20,33 @@
 #define B2_ISLAND_H
 
 #include "../Common/b2Math.h"
+#include "b2Body.h"
 
 class b2Contact;
-class b2Body;
 class b2Joint;
 class b2StackAllocator;
 class b2ContactListener;
+class b2ThreadPool;
 struct b2ContactConstraint;
+struct b2ContactResult;
 struct b2TimeStep;
 
+/// Contact results of islands solved on worker threads. The world reports
+/// them to the contact listener once all islands are solved, in island order.
+class b2ContactResultBuffer
+{
+public:
+	b2ContactResultBuffer();
+	~b2ContactResultBuffer();
+
+	void Add(const b2ContactResult& result);
+	void Clear() { m_count = 0; }
+
+	b2ContactResult* m_results;
+	int32 m_count;
+	int32 m_capacity;
+};
+
 class b2Island
 {
 public:
@@ -50,6 +68,11 @@ public:
 	void Add(b2Body* body)
 	{
 		b2Assert(m_bodyCount < m_bodyCapacity);
+		// Static bodies may be in islands solved on other threads at the same time.
+		if (body->IsStatic() == false)
+		{
+			body->m_islandIndex = m_bodyCount;
+		}
 		m_bodies[m_bodyCount++] = body;
 	}
 
@@ -67,8 +90,12 @@ public:
 
 	void Report(b2ContactConstraint* constraints);
 
+	void Color();
+
 	b2StackAllocator* m_allocator;
 	b2ContactListener* m_listener;
+	b2ContactResultBuffer* m_results;	// if set, results are stored instead of reported
+	b2ThreadPool* m_threadPool;			// if set, the batched solver splits large colors among its threads
 
 	b2Body** m_bodies;
 	b2Contact** m_contacts;
@@ -83,6 +110,10 @@ public:
 	int32 m_jointCapacity;
 
 	int32 m_positionIterationCount;
+	bool m_sleeping;	// set by Solve, the non-static bodies were put to sleep
+
+	int32 m_colorCount;		// colors used by the batched solver
+	int32 m_overflowCount;	// contacts that fit into no color
 };
 
 #endif
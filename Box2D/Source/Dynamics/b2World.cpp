@@ -19,6 +19,9 @@
 #include "b2World.h"
 #include "b2Body.h"
 #include "b2Island.h"
+#include "b2WorldSnapshot.h"
+#include "../Common/b2Timer.h"
+#include "../Common/b2ThreadPool.h"
 #include "Joints/b2PulleyJoint.h"
 #include "Contacts/b2Contact.h"
 #include "Contacts/b2ContactSolver.h"
@@ -26,8 +29,14 @@
 #include "../Collision/Shapes/b2CircleShape.h"
 #include "../Collision/Shapes/b2PolygonShape.h"
 #include <new>
-
-b2World::b2World(const b2AABB& worldAABB, const b2Vec2& gravity, bool doSleep)
+#include <string.h>
+#include <algorithm>
+
+b2World::b2World(const b2AABB& worldAABB, const b2Vec2& gravity, bool doSleep, b2BroadPhaseType broadPhaseType,
+				 b2Allocator* allocator)
+: m_allocator(allocator ? allocator : &m_heapAllocator),
+  m_blockAllocator(m_allocator),
+  m_stackAllocator(m_allocator)
 {
 	m_destructionListener = NULL;
 	m_boundaryListener = NULL;
@@ -46,17 +55,29 @@ b2World::b2World(const b2AABB& worldAABB, const b2Vec2& gravity, bool doSleep)
 	m_positionCorrection = true;
 	m_warmStarting = true;
 	m_continuousPhysics = true;
+	m_batchedSolver = false;
+	m_manifoldCaching = false;
+	m_speculativeContacts = false;
+	m_simplexCaching = false;
 
 	m_allowSleep = doSleep;
 	m_gravity = gravity;
 
 	m_lock = false;
+	m_asleep = false;
 
 	m_inv_dt0 = 0.0f;
 
+	memset(&m_profile, 0, sizeof(b2Profile));
+
+	m_threadPool = NULL;
+	m_threadAllocators = NULL;
+	m_threadResults = NULL;
+	m_threadPoints = NULL;
+
 	m_contactManager.m_world = this;
 	void* mem = b2Alloc(sizeof(b2BroadPhase));
-	m_broadPhase = new (mem) b2BroadPhase(worldAABB, &m_contactManager);
+	m_broadPhase = new (mem) b2BroadPhase(worldAABB, &m_contactManager, broadPhaseType);
 
 	b2BodyDef bd;
 	m_groundBody = CreateBody(&bd);
@@ -64,11 +85,101 @@ b2World::b2World(const b2AABB& worldAABB, const b2Vec2& gravity, bool doSleep)
 
 b2World::~b2World()
 {
+	SetThreadCount(1);
 	DestroyBody(m_groundBody);
 	m_broadPhase->~b2BroadPhase();
 	b2Free(m_broadPhase);
 }
 
+void b2World::SetThreadCount(int32 count)
+{
+	b2Assert(m_lock == false);
+	if (m_lock == true)
+	{
+		return;
+	}
+
+	if (count < 1)
+	{
+		count = 1;
+	}
+
+	if (count == GetThreadCount())
+	{
+		return;
+	}
+
+	if (m_threadPool)
+	{
+		int32 oldCount = m_threadPool->GetThreadCount();
+		for (int32 i = 0; i < oldCount; ++i)
+		{
+			m_threadResults[i].~b2ContactResultBuffer();
+			m_threadPoints[i].~b2ContactPointBuffer();
+		}
+		for (int32 i = 0; i < oldCount - 1; ++i)
+		{
+			m_threadAllocators[i].~b2StackAllocator();
+		}
+		b2Free(m_threadPoints);
+		b2Free(m_threadResults);
+		b2Free(m_threadAllocators);
+		m_threadPool->~b2ThreadPool();
+		b2Free(m_threadPool);
+
+		m_threadPool = NULL;
+		m_threadAllocators = NULL;
+		m_threadResults = NULL;
+		m_threadPoints = NULL;
+	}
+
+	if (count > 1)
+	{
+		void* mem = b2Alloc(sizeof(b2ThreadPool));
+		m_threadPool = new (mem) b2ThreadPool(count);
+
+		// The pool may have started fewer threads.
+		count = m_threadPool->GetThreadCount();
+		if (count == 1)
+		{
+			m_threadPool->~b2ThreadPool();
+			b2Free(m_threadPool);
+			m_threadPool = NULL;
+		}
+	}
+
+	if (count > 1)
+	{
+		m_threadAllocators = (b2StackAllocator*)b2Alloc((count - 1) * sizeof(b2StackAllocator));
+		for (int32 i = 0; i < count - 1; ++i)
+		{
+			// The world allocator need not be thread safe.
+			new (m_threadAllocators + i) b2StackAllocator(&m_heapAllocator);
+		}
+
+		m_threadResults = (b2ContactResultBuffer*)b2Alloc(count * sizeof(b2ContactResultBuffer));
+		for (int32 i = 0; i < count; ++i)
+		{
+			new (m_threadResults + i) b2ContactResultBuffer;
+		}
+
+		m_threadPoints = (b2ContactPointBuffer*)b2Alloc(count * sizeof(b2ContactPointBuffer));
+		for (int32 i = 0; i < count; ++i)
+		{
+			new (m_threadPoints + i) b2ContactPointBuffer;
+		}
+	}
+
+	// The worker caches take their chunks from the heap allocator, like the
+	// worker stack allocators.
+	m_blockAllocator.SetThreadCount(count, &m_heapAllocator);
+}
+
+int32 b2World::GetThreadCount() const
+{
+	return m_threadPool ? m_threadPool->GetThreadCount() : 1;
+}
+
 void b2World::SetDestructionListener(b2DestructionListener* listener)
 {
 	m_destructionListener = listener;
@@ -114,6 +225,7 @@ b2Body* b2World::CreateBody(const b2BodyDef* def)
 	}
 	m_bodyList = b;
 	++m_bodyCount;
+	m_asleep = false;
 
 	return b;
 }
@@ -127,6 +239,8 @@ void b2World::DestroyBody(b2Body* b)
 		return;
 	}
 
+	m_asleep = false;
+
 	// Delete the attached joints.
 	b2JointEdge* jn = b->m_jointList;
 	while (jn)
@@ -185,6 +299,7 @@ b2Joint* b2World::CreateJoint(const b2JointDef* def)
 	b2Assert(m_lock == false);
 
 	b2Joint* j = b2Joint::Create(def, &m_blockAllocator);
+	m_asleep = false;
 
 	// Connect to the world list.
 	j->m_prev = NULL;
@@ -230,6 +345,7 @@ void b2World::DestroyJoint(b2Joint* j)
 	b2Assert(m_lock == false);
 
 	bool collideConnected = j->m_collideConnected;
+	m_asleep = false;
 
 	// Remove from the doubly linked list.
 	if (j->m_prev)
@@ -313,16 +429,121 @@ void b2World::DestroyJoint(b2Joint* j)
 void b2World::Refilter(b2Shape* shape)
 {
 	shape->RefilterProxy(m_broadPhase, shape->GetBody()->GetXForm());
+	m_asleep = false;
 }
 
 // Find islands, integrate and solve constraints, solve position constraints
+// An island found by b2World::Solve. Its bodies, contacts and joints are
+// ranges of arrays shared by all islands of the step.
+struct b2IslandRange
+{
+	int32 bodyStart;
+	int32 bodyCount;
+	int32 contactStart;
+	int32 contactCount;
+	int32 jointStart;
+	int32 jointCount;
+
+	// Filled in when the island is solved.
+	int32 threadIndex;
+	int32 resultStart;
+	int32 resultCount;
+	int32 positionIterationCount;
+	int32 colorCount;
+	int32 overflowCount;
+	bool sleeping;
+};
+
+// Largest islands first so the pool does not end on a big one. Ties are
+// broken by island order.
+struct b2IslandOrder
+{
+	bool operator()(int32 a, int32 b) const
+	{
+		int32 sizeA = islands[a].bodyCount + islands[a].contactCount;
+		int32 sizeB = islands[b].bodyCount + islands[b].contactCount;
+		if (sizeA != sizeB)
+		{
+			return sizeA > sizeB;
+		}
+		return a < b;
+	}
+
+	const b2IslandRange* islands;
+};
+
+// Solves islands on the threads of the world's pool. Each thread has its own
+// stack allocator and contact result buffer.
+class b2IslandTask : public b2Task
+{
+public:
+	void Execute(int32 index, int32 threadIndex)
+	{
+		Solve(order[index], threadIndex, false);
+	}
+
+	// With useThreads the island is solved on the calling thread, which
+	// lends the pool to the contact solver.
+	void Solve(int32 islandIndex, int32 threadIndex, bool useThreads)
+	{
+		b2IslandRange* range = islands + islandIndex;
+
+		b2StackAllocator* allocator = &world->m_stackAllocator;
+		b2ContactResultBuffer* results = NULL;
+		if (world->m_threadPool)
+		{
+			if (threadIndex > 0)
+			{
+				allocator = world->m_threadAllocators + threadIndex - 1;
+			}
+			results = world->m_threadResults + threadIndex;
+		}
+
+		b2Island island(range->bodyCount, range->contactCount, range->jointCount, allocator, world->m_contactListener);
+		island.m_results = results;
+		if (useThreads)
+		{
+			island.m_threadPool = world->m_threadPool;
+		}
+
+		for (int32 i = 0; i < range->bodyCount; ++i)
+		{
+			island.Add(bodies[range->bodyStart + i]);
+		}
+		for (int32 i = 0; i < range->contactCount; ++i)
+		{
+			island.Add(contacts[range->contactStart + i]);
+		}
+		for (int32 i = 0; i < range->jointCount; ++i)
+		{
+			island.Add(joints[range->jointStart + i]);
+		}
+
+		range->threadIndex = threadIndex;
+		range->resultStart = results ? results->m_count : 0;
+
+		island.Solve(*step, world->m_gravity, world->m_positionCorrection, world->m_allowSleep);
+
+		range->resultCount = results ? results->m_count - range->resultStart : 0;
+		range->positionIterationCount = island.m_positionIterationCount;
+		range->colorCount = island.m_colorCount;
+		range->overflowCount = island.m_overflowCount;
+		range->sleeping = island.m_sleeping;
+	}
+
+	b2World* world;
+	const b2TimeStep* step;
+	b2Body** bodies;
+	b2Contact** contacts;
+	b2Joint** joints;
+	b2IslandRange* islands;
+	const int32* order;
+};
+
 void b2World::Solve(const b2TimeStep& step)
 {
 	m_positionIterationCount = 0;
 
-	// Size the island for the worst case.
-	b2Island island(m_bodyCount, m_contactCount, m_jointCount, &m_stackAllocator, m_contactListener);
-
 	// Clear all the island flags.
 	for (b2Body* b = m_bodyList; b; b = b->m_next)
 	{
@@ -337,7 +558,19 @@ void b2World::Solve(const b2TimeStep& step)
 		j->m_islandFlag = false;
 	}
 
-	// Build and simulate all awake islands.
+	// Find all awake islands before solving any of them. A static body is
+	// added once for every contact or joint that reaches it, so the worst case
+	// is the same as for a single island of everything.
+	int32 bodyCapacity = m_bodyCount + m_contactCount + m_jointCount;
+	b2Body** bodies = (b2Body**)m_stackAllocator.Allocate(bodyCapacity * sizeof(b2Body*));
+	b2Contact** contacts = (b2Contact**)m_stackAllocator.Allocate(m_contactCount * sizeof(b2Contact*));
+	b2Joint** joints = (b2Joint**)m_stackAllocator.Allocate(m_jointCount * sizeof(b2Joint*));
+	b2IslandRange* islands = (b2IslandRange*)m_stackAllocator.Allocate(m_bodyCount * sizeof(b2IslandRange));
+	int32 islandCount = 0;
+	int32 bodyCount = 0;
+	int32 contactCount = 0;
+	int32 jointCount = 0;
+
 	int32 stackSize = m_bodyCount;
 	b2Body** stack = (b2Body**)m_stackAllocator.Allocate(stackSize * sizeof(b2Body*));
 	for (b2Body* seed = m_bodyList; seed; seed = seed->m_next)
@@ -352,8 +585,12 @@ void b2World::Solve(const b2TimeStep& step)
 			continue;
 		}
 
-		// Reset island and stack.
-		island.Clear();
+		b2IslandRange* island = islands + islandCount++;
+		island->bodyStart = bodyCount;
+		island->contactStart = contactCount;
+		island->jointStart = jointCount;
+
+		// Reset stack.
 		int32 stackCount = 0;
 		stack[stackCount++] = seed;
 		seed->m_flags |= b2Body::e_islandFlag;
@@ -363,7 +600,8 @@ void b2World::Solve(const b2TimeStep& step)
 		{
 			// Grab the next body off the stack and add it to the island.
 			b2Body* b = stack[--stackCount];
-			island.Add(b);
+			b2Assert(bodyCount < bodyCapacity);
+			bodies[bodyCount++] = b;
 
 			// Make sure the body is awake.
 			b->m_flags &= ~b2Body::e_sleepFlag;
@@ -379,7 +617,7 @@ void b2World::Solve(const b2TimeStep& step)
 			for (b2ContactEdge* cn = b->m_contactList; cn; cn = cn->next)
 			{
 				// Has this contact already been added to an island?
-				if (cn->contact->m_flags & (b2Contact::e_islandFlag | b2Contact::e_nonSolidFlag))
+				if (cn->contact->m_flags & (b2Contact::e_islandFlag | b2Contact::e_nonSolidFlag | b2Contact::e_apartFlag))
 				{
 					continue;
 				}
@@ -390,7 +628,7 @@ void b2World::Solve(const b2TimeStep& step)
 					continue;
 				}
 
-				island.Add(cn->contact);
+				contacts[contactCount++] = cn->contact;
 				cn->contact->m_flags |= b2Contact::e_islandFlag;
 
 				b2Body* other = cn->other;
@@ -414,7 +652,7 @@ void b2World::Solve(const b2TimeStep& step)
 					continue;
 				}
 
-				island.Add(jn->joint);
+				joints[jointCount++] = jn->joint;
 				jn->joint->m_islandFlag = true;
 
 				b2Body* other = jn->other;
@@ -429,23 +667,132 @@ void b2World::Solve(const b2TimeStep& step)
 			}
 		}
 
-		island.Solve(step, m_gravity, m_positionCorrection, m_allowSleep);
-		m_positionIterationCount = b2Max(m_positionIterationCount, island.m_positionIterationCount);
+		island->bodyCount = bodyCount - island->bodyStart;
+		island->contactCount = contactCount - island->contactStart;
+		island->jointCount = jointCount - island->jointStart;
 
-		// Post solve cleanup.
-		for (int32 i = 0; i < island.m_bodyCount; ++i)
+		// Allow static bodies to participate in other islands.
+		for (int32 i = island->bodyStart; i < bodyCount; ++i)
 		{
-			// Allow static bodies to participate in other islands.
-			b2Body* b = island.m_bodies[i];
-			if (b->IsStatic())
+			if (bodies[i]->IsStatic())
 			{
-				b->m_flags &= ~b2Body::e_islandFlag;
+				bodies[i]->m_flags &= ~b2Body::e_islandFlag;
 			}
 		}
 	}
 
 	m_stackAllocator.Free(stack);
 
+	b2IslandTask task;
+	task.world = this;
+	task.step = &step;
+	task.bodies = bodies;
+	task.contacts = contacts;
+	task.joints = joints;
+	task.islands = islands;
+	task.order = NULL;
+
+	if (m_threadPool == NULL)
+	{
+		for (int32 i = 0; i < islandCount; ++i)
+		{
+			task.Solve(i, 0, false);
+		}
+	}
+	else
+	{
+		// Joints may write to static bodies, so islands with joints are
+		// solved here once the pool is done. So are large islands with the
+		// batched solver, which solves their colors on all threads.
+		int32* order = (int32*)m_stackAllocator.Allocate(islandCount * sizeof(int32));
+		bool* serial = (bool*)m_stackAllocator.Allocate(islandCount * sizeof(bool));
+		int32 orderCount = 0;
+		for (int32 i = 0; i < islandCount; ++i)
+		{
+			serial[i] = islands[i].jointCount > 0 ||
+				(step.batchedSolver && islands[i].contactCount >= b2_parallelIslandContacts);
+			if (serial[i] == false)
+			{
+				order[orderCount++] = i;
+			}
+		}
+
+		b2IslandOrder islandOrder;
+		islandOrder.islands = islands;
+		std::sort(order, order + orderCount, islandOrder);
+
+		for (int32 i = 0; i < m_threadPool->GetThreadCount(); ++i)
+		{
+			m_threadResults[i].Clear();
+		}
+
+		task.order = order;
+		m_threadPool->Run(&task, orderCount);
+
+		for (int32 i = 0; i < islandCount; ++i)
+		{
+			if (serial[i])
+			{
+				task.Solve(i, 0, step.batchedSolver);
+			}
+		}
+
+		m_stackAllocator.Free(serial);
+		m_stackAllocator.Free(order);
+
+		// Report the contact results in island order, as a single thread would.
+		if (m_contactListener)
+		{
+			for (int32 i = 0; i < islandCount; ++i)
+			{
+				const b2IslandRange* island = islands + i;
+				const b2ContactResult* results = m_threadResults[island->threadIndex].m_results + island->resultStart;
+				for (int32 j = 0; j < island->resultCount; ++j)
+				{
+					m_contactListener->Result(results + j);
+				}
+			}
+		}
+	}
+
+	// Post solve cleanup.
+	for (int32 i = 0; i < islandCount; ++i)
+	{
+		const b2IslandRange* island = islands + i;
+		++m_profile.islandCount;
+		m_profile.colorCount = b2Max(m_profile.colorCount, island->colorCount);
+		m_profile.uncoloredCount += island->overflowCount;
+		if (island->sleeping)
+		{
+			++m_profile.sleepIslandCount;
+		}
+		m_positionIterationCount = b2Max(m_positionIterationCount, island->positionIterationCount);
+
+		// The solver leaves static bodies alone. They sleep
+		// with the last island they are part of.
+		for (int32 j = 0; j < island->bodyCount; ++j)
+		{
+			b2Body* b = bodies[island->bodyStart + j];
+			if (b->IsStatic() == false)
+			{
+				continue;
+			}
+
+			b->m_flags &= ~b2Body::e_sleepFlag;
+			if (island->sleeping)
+			{
+				b->m_flags |= b2Body::e_sleepFlag;
+				b->m_linearVelocity = b2Vec2_zero;
+				b->m_angularVelocity = 0.0f;
+			}
+		}
+	}
+
+	m_stackAllocator.Free(islands);
+	m_stackAllocator.Free(joints);
+	m_stackAllocator.Free(contacts);
+	m_stackAllocator.Free(bodies);
+
 	// Synchronize shapes, check for out of range bodies.
 	for (b2Body* b = m_bodyList; b; b = b->GetNext())
 	{
@@ -458,11 +805,15 @@ void b2World::Solve(const b2TimeStep& step)
 		{
 			continue;
 		}
+
+		++m_profile.awakeBodyCount;
 		
 		// Update shapes (for broad-phase). If the shapes go out of
 		// the world AABB then shapes and contacts may be destroyed,
 		// including contacts that are
-		bool inRange = b->SynchronizeShapes();
+		// With speculative contacts, the proxies cover where the body will be
+		// after the next step instead of where it was.
+		bool inRange = b->SynchronizeShapes(m_speculativeContacts ? step.dt : 0.0f);
 
 		// Did the body's shapes leave the world?
 		if (inRange == false && m_boundaryListener != NULL)
@@ -484,6 +835,12 @@ void b2World::SolveTOI(const b2TimeStep& step)
 	int32 stackSize = m_bodyCount;
 	b2Body** stack = (b2Body**)m_stackAllocator.Allocate(stackSize * sizeof(b2Body*));
 
+	// Everything here runs on the calling thread, so these are all the GJK
+	// queries of the step.
+	b2DistanceStats gjkStats;
+	gjkStats.callCount = 0;
+	gjkStats.iterationCount = 0;
+
 	for (b2Body* b = m_bodyList; b; b = b->m_next)
 	{
 		b->m_flags &= ~b2Body::e_islandFlag;
@@ -548,7 +905,8 @@ void b2World::SolveTOI(const b2TimeStep& step)
 				b2Assert(t0 < 1.0f);
 
 				// Compute the time of impact.
-				toi = b2TimeOfImpact(c->m_shape1, b1->m_sweep, c->m_shape2, b2->m_sweep);
+				b2SimplexCache* cache = m_simplexCaching ? &c->m_simplexCache : NULL;
+				toi = b2TimeOfImpact(c->m_shape1, b1->m_sweep, c->m_shape2, b2->m_sweep, cache, &gjkStats);
 
 				b2Assert(0.0f <= toi && toi <= 1.0f);
 
@@ -676,8 +1034,10 @@ void b2World::SolveTOI(const b2TimeStep& step)
 		b2Assert(subStep.dt > B2_FLT_EPSILON);
 		subStep.inv_dt = 1.0f / subStep.dt;
 		subStep.maxIterations = step.maxIterations;
+		subStep.batchedSolver = false;
 
 		island.SolveTOI(subStep);
+		++m_profile.toiIslandCount;
 
 		// Post solve cleanup.
 		for (int32 i = 0; i < island.m_bodyCount; ++i)
@@ -727,6 +1087,9 @@ void b2World::SolveTOI(const b2TimeStep& step)
 		m_broadPhase->Commit();
 	}
 
+	m_profile.toiGJKCallCount = gjkStats.callCount;
+	m_profile.toiGJKIterationCount = gjkStats.iterationCount;
+
 	m_stackAllocator.Free(stack);
 }
 
@@ -750,27 +1113,61 @@ void b2World::Step(float32 dt, int32 iterations)
 
 	step.positionCorrection = m_positionCorrection;
 	step.warmStarting = m_warmStarting;
+	step.batchedSolver = m_batchedSolver;
+
+	// Anything that moves a body or changes a contact during the step
+	// clears this again.
+	m_asleep = step.dt > 0.0f;
+
+	b2Timer stepTimer;
+	m_profile.islandCount = 0;
+	m_profile.toiIslandCount = 0;
+	m_profile.colorCount = 0;
+	m_profile.uncoloredCount = 0;
+	m_profile.sleepIslandCount = 0;
+	m_profile.awakeBodyCount = 0;
+	m_profile.toiGJKCallCount = 0;
+	m_profile.toiGJKIterationCount = 0;
+	m_profile.solve = 0.0f;
+	m_profile.solveTOI = 0.0f;
 	
 	// Update contacts.
-	m_contactManager.Collide();
+	{
+		b2Timer timer;
+		m_contactManager.Collide(step);
+		m_profile.collide = timer.GetMilliseconds();
+	}
 
 	// Integrate velocities, solve velocity constraints, and integrate positions.
 	if (step.dt > 0.0f)
 	{
+		b2Timer timer;
 		Solve(step);
+		m_profile.solve = timer.GetMilliseconds();
 	}
 
-	// Handle TOI events.
-	if (m_continuousPhysics && step.dt > 0.0f)
+	// Handle TOI events. Speculative contacts have already been solved.
+	if (m_continuousPhysics && m_speculativeContacts == false && step.dt > 0.0f)
 	{
+		b2Timer timer;
 		SolveTOI(step);
+		m_profile.solveTOI = timer.GetMilliseconds();
 	}
 
 	// Draw debug information.
 	DrawDebugData();
 
+	// Islands are seeded by every awake dynamic body, so without any island
+	// and TOI event no body has moved.
+	if (m_profile.islandCount > 0 || m_profile.toiIslandCount > 0)
+	{
+		m_asleep = false;
+	}
+
 	m_inv_dt0 = step.inv_dt;
 	m_lock = false;
+
+	m_profile.step = stepTimer.GetMilliseconds();
 }
 
 int32 b2World::Query(const b2AABB& aabb, b2Shape** shapes, int32 maxCount)
@@ -930,36 +1327,23 @@ void b2World::DrawDebugData()
 	if (flags & b2DebugDraw::e_pairBit)
 	{
 		b2BroadPhase* bp = m_broadPhase;
-		b2Vec2 invQ;
-		invQ.Set(1.0f / bp->m_quantizationFactor.x, 1.0f / bp->m_quantizationFactor.y);
 		b2Color color(0.9f, 0.9f, 0.3f);
 
-		for (int32 i = 0; i < b2_tableCapacity; ++i)
+		for (int32 i = 0; i < bp->m_pairManager.m_pairCapacity; ++i)
 		{
-			uint16 index = bp->m_pairManager.m_hashTable[i];
-			while (index != b2_nullPair)
+			b2Pair* pair = bp->m_pairManager.m_pairs + i;
+			if (pair->proxyId1 == b2_nullProxy)
 			{
-				b2Pair* pair = bp->m_pairManager.m_pairs + index;
-				b2Proxy* p1 = bp->m_proxyPool + pair->proxyId1;
-				b2Proxy* p2 = bp->m_proxyPool + pair->proxyId2;
-
-				b2AABB b1, b2;
-				b1.lowerBound.x = bp->m_worldAABB.lowerBound.x + invQ.x * bp->m_bounds[0][p1->lowerBounds[0]].value;
-				b1.lowerBound.y = bp->m_worldAABB.lowerBound.y + invQ.y * bp->m_bounds[1][p1->lowerBounds[1]].value;
-				b1.upperBound.x = bp->m_worldAABB.lowerBound.x + invQ.x * bp->m_bounds[0][p1->upperBounds[0]].value;
-				b1.upperBound.y = bp->m_worldAABB.lowerBound.y + invQ.y * bp->m_bounds[1][p1->upperBounds[1]].value;
-				b2.lowerBound.x = bp->m_worldAABB.lowerBound.x + invQ.x * bp->m_bounds[0][p2->lowerBounds[0]].value;
-				b2.lowerBound.y = bp->m_worldAABB.lowerBound.y + invQ.y * bp->m_bounds[1][p2->lowerBounds[1]].value;
-				b2.upperBound.x = bp->m_worldAABB.lowerBound.x + invQ.x * bp->m_bounds[0][p2->upperBounds[0]].value;
-				b2.upperBound.y = bp->m_worldAABB.lowerBound.y + invQ.y * bp->m_bounds[1][p2->upperBounds[1]].value;
-
-				b2Vec2 x1 = 0.5f * (b1.lowerBound + b1.upperBound);
-				b2Vec2 x2 = 0.5f * (b2.lowerBound + b2.upperBound);
-
-				m_debugDraw->DrawSegment(x1, x2, color);
-
-				index = pair->next;
+				continue;
 			}
+
+			b2AABB b1 = bp->GetAABB(pair->proxyId1);
+			b2AABB b2 = bp->GetAABB(pair->proxyId2);
+
+			b2Vec2 x1 = 0.5f * (b1.lowerBound + b1.upperBound);
+			b2Vec2 x2 = 0.5f * (b2.lowerBound + b2.upperBound);
+
+			m_debugDraw->DrawSegment(x1, x2, color);
 		}
 	}
 
@@ -969,10 +1353,8 @@ void b2World::DrawDebugData()
 		b2Vec2 worldLower = bp->m_worldAABB.lowerBound;
 		b2Vec2 worldUpper = bp->m_worldAABB.upperBound;
 
-		b2Vec2 invQ;
-		invQ.Set(1.0f / bp->m_quantizationFactor.x, 1.0f / bp->m_quantizationFactor.y);
 		b2Color color(0.9f, 0.3f, 0.9f);
-		for (int32 i = 0; i < b2_maxProxies; ++i)
+		for (int32 i = 0; i < bp->m_proxyCapacity; ++i)
 		{
 			b2Proxy* p = bp->m_proxyPool + i;
 			if (p->IsValid() == false)
@@ -980,11 +1362,7 @@ void b2World::DrawDebugData()
 				continue;
 			}
 
-			b2AABB b;
-			b.lowerBound.x = worldLower.x + invQ.x * bp->m_bounds[0][p->lowerBounds[0]].value;
-			b.lowerBound.y = worldLower.y + invQ.y * bp->m_bounds[1][p->lowerBounds[1]].value;
-			b.upperBound.x = worldLower.x + invQ.x * bp->m_bounds[0][p->upperBounds[0]].value;
-			b.upperBound.y = worldLower.y + invQ.y * bp->m_bounds[1][p->upperBounds[1]].value;
+			b2AABB b = bp->GetAABB(i);
 
 			b2Vec2 vs[4];
 			vs[0].Set(b.lowerBound.x, b.lowerBound.y);
@@ -1062,3 +1440,538 @@ int32 b2World::GetPairCount() const
 {
 	return m_broadPhase->m_pairManager.m_pairCount;
 }
+
+// Snapshots store indices in place of pointers. They are shifted by one so
+// that NULL stays NULL.
+template <typename T>
+inline T* b2EncodeIndex(int32 index)
+{
+	return (T*)(size_t)(index + 1);
+}
+
+inline int32 b2DecodeIndex(const void* pointer)
+{
+	return (int32)(size_t)pointer - 1;
+}
+
+template <typename T>
+inline T* b2DecodePointer(T** table, const void* pointer)
+{
+	int32 index = b2DecodeIndex(pointer);
+	return index < 0 ? NULL : table[index];
+}
+
+inline int32 b2SnapshotAlign(int32 size)
+{
+	return (size + 15) & ~15;
+}
+
+// Sorted pointer to index table used while saving a snapshot.
+struct b2SnapshotIndex
+{
+	bool operator < (const b2SnapshotIndex& other) const
+	{
+		return (size_t)pointer < (size_t)other.pointer;
+	}
+
+	const void* pointer;
+	int32 index;
+};
+
+static int32 b2FindIndex(const b2SnapshotIndex* table, int32 count, const void* pointer)
+{
+	b2SnapshotIndex key;
+	key.pointer = pointer;
+	const b2SnapshotIndex* found = std::lower_bound(table, table + count, key);
+	if (found != table + count && found->pointer == pointer)
+	{
+		return found->index;
+	}
+	return -1;
+}
+
+// A contact edge is stored as 2 * contact index + node.
+static b2ContactEdge* b2EncodeEdge(const b2SnapshotIndex* contacts, int32 count, const b2ContactEdge* edge)
+{
+	if (edge == NULL)
+	{
+		return NULL;
+	}
+
+	int32 index = b2FindIndex(contacts, count, edge->contact);
+	b2Assert(index >= 0);
+	int32 node = edge == &edge->contact->m_node1 ? 0 : 1;
+	return b2EncodeIndex<b2ContactEdge>(2 * index + node);
+}
+
+static b2ContactEdge* b2DecodeEdge(b2Contact** contacts, const b2ContactEdge* edge)
+{
+	int32 index = b2DecodeIndex(edge);
+	if (index < 0)
+	{
+		return NULL;
+	}
+
+	b2Contact* c = contacts[index >> 1];
+	return (index & 1) ? &c->m_node2 : &c->m_node1;
+}
+
+bool b2World::Save(b2WorldSnapshot* snapshot)
+{
+	b2Assert(m_lock == false);
+	if (m_lock == true)
+	{
+		return false;
+	}
+
+	// Joints are not stored and a snapshot without them would restore a
+	// corrupt world, so store nothing.
+	if (m_jointCount > 0)
+	{
+		snapshot->Reset(0);
+		return false;
+	}
+
+	int32 shapeCount = 0;
+	for (b2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		shapeCount += b->m_shapeCount;
+	}
+
+	b2SnapshotIndex* bodyTable = (b2SnapshotIndex*)m_stackAllocator.Allocate(m_bodyCount * sizeof(b2SnapshotIndex));
+	b2SnapshotIndex* shapeTable = (b2SnapshotIndex*)m_stackAllocator.Allocate(shapeCount * sizeof(b2SnapshotIndex));
+	b2SnapshotIndex* contactTable = (b2SnapshotIndex*)m_stackAllocator.Allocate(m_contactCount * sizeof(b2SnapshotIndex));
+
+	// Pairs and queries are committed between steps, so the pair buffer, the
+	// move buffer and the query results are empty and need not be stored.
+	b2BroadPhase* bp = m_broadPhase;
+	b2PairManager* pm = &bp->m_pairManager;
+	b2DynamicTree* tree = &bp->m_tree;
+	b2Assert(pm->m_pairBufferCount == 0 && bp->m_queryResultCount == 0 && bp->m_moveCount == 0);
+	bool sweepAndPrune = bp->m_type == e_sweepAndPruneBroadPhase;
+
+	// Compute the layout and build the lookup tables.
+	int32 size = b2SnapshotAlign(sizeof(b2WorldSnapshotHeader));
+	int32 proxyOffset = size;
+	size += b2SnapshotAlign(bp->m_proxyCapacity * sizeof(b2Proxy));
+	int32 boundOffsets[2];
+	for (int32 axis = 0; axis < 2; ++axis)
+	{
+		boundOffsets[axis] = size;
+		size += sweepAndPrune ? b2SnapshotAlign(2 * bp->m_proxyCount * sizeof(b2Bound)) : 0;
+	}
+	int32 treeNodeOffset = size;
+	size += sweepAndPrune ? 0 : b2SnapshotAlign(tree->m_nodeCapacity * sizeof(b2TreeNode));
+	int32 pairOffset = size;
+	size += b2SnapshotAlign(pm->m_pairCapacity * sizeof(b2Pair));
+	int32 controlOffset = size;
+	size += b2SnapshotAlign(pm->m_tableCapacity * sizeof(int8));
+	int32 tableOffset = size;
+	size += b2SnapshotAlign(pm->m_tableCapacity * sizeof(int32));
+	int32 bodyOffsets = size;
+	size += b2SnapshotAlign(m_bodyCount * sizeof(int32));
+	int32 shapeOffsets = size;
+	size += b2SnapshotAlign(shapeCount * sizeof(int32));
+	int32 contactOffsets = size;
+	size += b2SnapshotAlign(m_contactCount * sizeof(int32));
+	int32 objects = size;
+
+	int32 bodyIndex = 0;
+	int32 shapeIndex = 0;
+	for (b2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		bodyTable[bodyIndex].pointer = b;
+		bodyTable[bodyIndex].index = bodyIndex;
+		++bodyIndex;
+		size += b2SnapshotAlign(sizeof(b2Body));
+
+		for (b2Shape* s = b->m_shapeList; s; s = s->m_next)
+		{
+			shapeTable[shapeIndex].pointer = s;
+			shapeTable[shapeIndex].index = shapeIndex;
+			++shapeIndex;
+			size += b2SnapshotAlign(b2Shape::GetByteSize(s->m_type));
+		}
+	}
+
+	int32 contactIndex = 0;
+	for (b2Contact* c = m_contactList; c; c = c->m_next)
+	{
+		contactTable[contactIndex].pointer = c;
+		contactTable[contactIndex].index = contactIndex;
+		++contactIndex;
+		size += b2SnapshotAlign(b2Contact::GetByteSize(c->m_shape1->m_type, c->m_shape2->m_type));
+	}
+
+	std::sort(bodyTable, bodyTable + m_bodyCount);
+	std::sort(shapeTable, shapeTable + shapeCount);
+	std::sort(contactTable, contactTable + m_contactCount);
+
+	snapshot->Reset(size);
+
+	b2WorldSnapshotHeader* header = snapshot->GetHeader();
+	header->bodyCount = m_bodyCount;
+	header->shapeCount = shapeCount;
+	header->contactCount = m_contactCount;
+	header->groundBody = b2FindIndex(bodyTable, m_bodyCount, m_groundBody);
+	header->worldAABB = bp->m_worldAABB;
+	header->gravity = m_gravity;
+	header->allowSleep = m_allowSleep;
+	header->inv_dt0 = m_inv_dt0;
+	header->positionIterationCount = m_positionIterationCount;
+	header->positionCorrection = m_positionCorrection;
+	header->warmStarting = m_warmStarting;
+	header->continuousPhysics = m_continuousPhysics;
+	header->broadPhaseType = bp->m_type;
+	header->proxyCapacity = bp->m_proxyCapacity;
+	header->proxyCount = bp->m_proxyCount;
+	header->freeProxy = bp->m_freeProxy;
+	header->timeStamp = bp->m_timeStamp;
+	header->pairCapacity = pm->m_pairCapacity;
+	header->pairCount = pm->m_pairCount;
+	header->freePair = pm->m_freePair;
+	header->deletedSlotCount = pm->m_deletedCount;
+	header->treeRoot = tree->m_root;
+	header->treeNodeCount = tree->m_nodeCount;
+	header->treeNodeCapacity = tree->m_nodeCapacity;
+	header->treeFreeList = tree->m_freeList;
+	header->proxyOffset = proxyOffset;
+	header->boundOffsets[0] = boundOffsets[0];
+	header->boundOffsets[1] = boundOffsets[1];
+	header->treeNodeOffset = treeNodeOffset;
+	header->pairOffset = pairOffset;
+	header->controlOffset = controlOffset;
+	header->tableOffset = tableOffset;
+	header->bodyOffsets = bodyOffsets;
+	header->shapeOffsets = shapeOffsets;
+	header->contactOffsets = contactOffsets;
+
+	int32* bodyOffset = (int32*)snapshot->GetData(bodyOffsets);
+	int32* shapeOffset = (int32*)snapshot->GetData(shapeOffsets);
+	int32* contactOffset = (int32*)snapshot->GetData(contactOffsets);
+	int32 offset = objects;
+
+	// Bodies, each followed by its shapes.
+	bodyIndex = 0;
+	shapeIndex = 0;
+	for (b2Body* b = m_bodyList; b; b = b->m_next, ++bodyIndex)
+	{
+		bodyOffset[bodyIndex] = offset;
+		b2Body* body = new (snapshot->GetData(offset)) b2Body(*b);
+		offset += b2SnapshotAlign(sizeof(b2Body));
+
+		body->m_world = NULL;
+		body->m_prev = b2EncodeIndex<b2Body>(bodyIndex - 1);
+		body->m_next = b->m_next ? b2EncodeIndex<b2Body>(bodyIndex + 1) : NULL;
+		body->m_shapeList = b->m_shapeList ? b2EncodeIndex<b2Shape>(shapeIndex) : NULL;
+		body->m_jointList = NULL;
+		body->m_contactList = b2EncodeEdge(contactTable, m_contactCount, b->m_contactList);
+
+		for (b2Shape* s = b->m_shapeList; s; s = s->m_next, ++shapeIndex)
+		{
+			shapeOffset[shapeIndex] = offset;
+			b2Shape* shape = b2Shape::Copy(s, snapshot->GetData(offset));
+			offset += b2SnapshotAlign(b2Shape::GetByteSize(s->m_type));
+
+			shape->m_next = s->m_next ? b2EncodeIndex<b2Shape>(shapeIndex + 1) : NULL;
+			shape->m_body = b2EncodeIndex<b2Body>(bodyIndex);
+		}
+	}
+
+	// Contacts with their manifolds.
+	contactIndex = 0;
+	for (b2Contact* c = m_contactList; c; c = c->m_next, ++contactIndex)
+	{
+		b2ShapeType type1 = c->m_shape1->m_type;
+		b2ShapeType type2 = c->m_shape2->m_type;
+
+		contactOffset[contactIndex] = offset;
+		b2Contact* contact = b2Contact::Copy(c, type1, type2, snapshot->GetData(offset));
+		offset += b2SnapshotAlign(b2Contact::GetByteSize(type1, type2));
+
+		contact->m_prev = b2EncodeIndex<b2Contact>(contactIndex - 1);
+		contact->m_next = c->m_next ? b2EncodeIndex<b2Contact>(contactIndex + 1) : NULL;
+		contact->m_shape1 = b2EncodeIndex<b2Shape>(b2FindIndex(shapeTable, shapeCount, c->m_shape1));
+		contact->m_shape2 = b2EncodeIndex<b2Shape>(b2FindIndex(shapeTable, shapeCount, c->m_shape2));
+
+		contact->m_node1.other = b2EncodeIndex<b2Body>(b2FindIndex(bodyTable, m_bodyCount, c->m_node1.other));
+		contact->m_node1.contact = b2EncodeIndex<b2Contact>(contactIndex);
+		contact->m_node1.prev = b2EncodeEdge(contactTable, m_contactCount, c->m_node1.prev);
+		contact->m_node1.next = b2EncodeEdge(contactTable, m_contactCount, c->m_node1.next);
+
+		contact->m_node2.other = b2EncodeIndex<b2Body>(b2FindIndex(bodyTable, m_bodyCount, c->m_node2.other));
+		contact->m_node2.contact = b2EncodeIndex<b2Contact>(contactIndex);
+		contact->m_node2.prev = b2EncodeEdge(contactTable, m_contactCount, c->m_node2.prev);
+		contact->m_node2.next = b2EncodeEdge(contactTable, m_contactCount, c->m_node2.next);
+	}
+
+	b2Assert(offset == size);
+
+	// The broad-phase. Proxy user data is rebuilt from the shapes on restore,
+	// pair user data is stored as a contact index (the null contact is stored
+	// as one past the last contact).
+	b2Proxy* proxies = (b2Proxy*)snapshot->GetData(proxyOffset);
+	memcpy(proxies, bp->m_proxyPool, bp->m_proxyCapacity * sizeof(b2Proxy));
+	for (int32 i = 0; i < bp->m_proxyCapacity; ++i)
+	{
+		proxies[i].userData = NULL;
+	}
+
+	if (sweepAndPrune)
+	{
+		for (int32 axis = 0; axis < 2; ++axis)
+		{
+			memcpy(snapshot->GetData(boundOffsets[axis]), bp->m_bounds[axis], 2 * bp->m_proxyCount * sizeof(b2Bound));
+		}
+	}
+	else
+	{
+		memcpy(snapshot->GetData(treeNodeOffset), tree->m_nodes, tree->m_nodeCapacity * sizeof(b2TreeNode));
+	}
+
+	memcpy(snapshot->GetData(controlOffset), pm->m_control, pm->m_tableCapacity * sizeof(int8));
+	memcpy(snapshot->GetData(tableOffset), pm->m_table, pm->m_tableCapacity * sizeof(int32));
+
+	b2Pair* pairs = (b2Pair*)snapshot->GetData(pairOffset);
+	memcpy(pairs, pm->m_pairs, pm->m_pairCapacity * sizeof(b2Pair));
+	for (int32 i = 0; i < pm->m_pairCapacity; ++i)
+	{
+		b2Pair* pair = pairs + i;
+		if (pair->userData == &m_contactManager.m_nullContact)
+		{
+			pair->userData = b2EncodeIndex<void>(m_contactCount);
+		}
+		else
+		{
+			pair->userData = b2EncodeIndex<void>(b2FindIndex(contactTable, m_contactCount, pair->userData));
+		}
+	}
+
+	m_stackAllocator.Free(contactTable);
+	m_stackAllocator.Free(shapeTable);
+	m_stackAllocator.Free(bodyTable);
+	return true;
+}
+
+bool b2World::Restore(const b2WorldSnapshot* snapshot)
+{
+	b2Assert(m_lock == false);
+	if (m_lock == true)
+	{
+		return false;
+	}
+
+	// The joints would be left attached to freed bodies.
+	if (m_jointCount > 0 || snapshot->IsEmpty())
+	{
+		return false;
+	}
+
+	const b2WorldSnapshotHeader* header = snapshot->GetHeader();
+
+	b2Assert(header->worldAABB.lowerBound.x == m_broadPhase->m_worldAABB.lowerBound.x);
+	b2Assert(header->worldAABB.lowerBound.y == m_broadPhase->m_worldAABB.lowerBound.y);
+	b2Assert(header->worldAABB.upperBound.x == m_broadPhase->m_worldAABB.upperBound.x);
+	b2Assert(header->worldAABB.upperBound.y == m_broadPhase->m_worldAABB.upperBound.y);
+
+	// Free the current contents. The broad-phase is overwritten below, so the
+	// proxies are dropped without any pair callback.
+	b2Contact* c = m_contactList;
+	while (c)
+	{
+		b2Contact* c0 = c;
+		c = c->m_next;
+		b2Contact::Destroy(c0, &m_blockAllocator);
+	}
+
+	b2Body* b = m_bodyList;
+	while (b)
+	{
+		b2Body* b0 = b;
+		b = b->m_next;
+
+		b2Shape* s = b0->m_shapeList;
+		while (s)
+		{
+			b2Shape* s0 = s;
+			s = s->m_next;
+			s0->m_proxyId = b2_nullProxy;
+			b2Shape::Destroy(s0, &m_blockAllocator);
+		}
+
+		b0->~b2Body();
+		m_blockAllocator.Free(b0, sizeof(b2Body));
+	}
+
+	int32 bodyCount = header->bodyCount;
+	int32 shapeCount = header->shapeCount;
+	int32 contactCount = header->contactCount;
+
+	b2Body** bodies = (b2Body**)m_stackAllocator.Allocate(bodyCount * sizeof(b2Body*));
+	b2Shape** shapes = (b2Shape**)m_stackAllocator.Allocate(shapeCount * sizeof(b2Shape*));
+	b2Contact** contacts = (b2Contact**)m_stackAllocator.Allocate(contactCount * sizeof(b2Contact*));
+
+	const int32* bodyOffset = (const int32*)snapshot->GetData(header->bodyOffsets);
+	const int32* shapeOffset = (const int32*)snapshot->GetData(header->shapeOffsets);
+	const int32* contactOffset = (const int32*)snapshot->GetData(header->contactOffsets);
+
+	// Copy the objects.
+	for (int32 i = 0; i < bodyCount; ++i)
+	{
+		const b2Body* image = (const b2Body*)snapshot->GetData(bodyOffset[i]);
+		void* mem = m_blockAllocator.Allocate(sizeof(b2Body));
+		bodies[i] = new (mem) b2Body(*image);
+	}
+
+	for (int32 i = 0; i < shapeCount; ++i)
+	{
+		const b2Shape* image = (const b2Shape*)snapshot->GetData(shapeOffset[i]);
+		void* mem = m_blockAllocator.Allocate(b2Shape::GetByteSize(image->m_type));
+		shapes[i] = b2Shape::Copy(image, mem);
+	}
+
+	for (int32 i = 0; i < contactCount; ++i)
+	{
+		const b2Contact* image = (const b2Contact*)snapshot->GetData(contactOffset[i]);
+		b2ShapeType type1 = b2DecodePointer(shapes, image->m_shape1)->m_type;
+		b2ShapeType type2 = b2DecodePointer(shapes, image->m_shape2)->m_type;
+		void* mem = m_blockAllocator.Allocate(b2Contact::GetByteSize(type1, type2));
+		contacts[i] = b2Contact::Copy(image, type1, type2, mem);
+	}
+
+	// Turn the stored indices back into pointers.
+	for (int32 i = 0; i < bodyCount; ++i)
+	{
+		b2Body* body = bodies[i];
+		body->m_world = this;
+		body->m_prev = b2DecodePointer(bodies, body->m_prev);
+		body->m_next = b2DecodePointer(bodies, body->m_next);
+		body->m_shapeList = b2DecodePointer(shapes, body->m_shapeList);
+		body->m_contactList = b2DecodeEdge(contacts, body->m_contactList);
+	}
+
+	for (int32 i = 0; i < shapeCount; ++i)
+	{
+		b2Shape* shape = shapes[i];
+		shape->m_next = b2DecodePointer(shapes, shape->m_next);
+		shape->m_body = b2DecodePointer(bodies, shape->m_body);
+	}
+
+	for (int32 i = 0; i < contactCount; ++i)
+	{
+		b2Contact* contact = contacts[i];
+		contact->m_prev = b2DecodePointer(contacts, contact->m_prev);
+		contact->m_next = b2DecodePointer(contacts, contact->m_next);
+		contact->m_shape1 = b2DecodePointer(shapes, contact->m_shape1);
+		contact->m_shape2 = b2DecodePointer(shapes, contact->m_shape2);
+
+		contact->m_node1.other = b2DecodePointer(bodies, contact->m_node1.other);
+		contact->m_node1.contact = contact;
+		contact->m_node1.prev = b2DecodeEdge(contacts, contact->m_node1.prev);
+		contact->m_node1.next = b2DecodeEdge(contacts, contact->m_node1.next);
+
+		contact->m_node2.other = b2DecodePointer(bodies, contact->m_node2.other);
+		contact->m_node2.contact = contact;
+		contact->m_node2.prev = b2DecodeEdge(contacts, contact->m_node2.prev);
+		contact->m_node2.next = b2DecodeEdge(contacts, contact->m_node2.next);
+	}
+
+	// Restore the broad-phase. Its storage is only reallocated when the world
+	// has grown since the snapshot was taken (or the other way round), or
+	// when the snapshot comes from a world with the other broad-phase type.
+	b2BroadPhase* bp = m_broadPhase;
+	b2BroadPhaseType broadPhaseType = (b2BroadPhaseType)header->broadPhaseType;
+	if (bp->m_type != broadPhaseType ||
+		bp->m_proxyCapacity != header->proxyCapacity ||
+		bp->m_pairManager.m_pairCapacity != header->pairCapacity)
+	{
+		bp->~b2BroadPhase();
+		bp = new (bp) b2BroadPhase(header->worldAABB, &m_contactManager, broadPhaseType,
+								   header->proxyCapacity, header->pairCapacity);
+	}
+
+	b2PairManager* pm = &bp->m_pairManager;
+	b2DynamicTree* tree = &bp->m_tree;
+	memcpy(bp->m_proxyPool, snapshot->GetData(header->proxyOffset), header->proxyCapacity * sizeof(b2Proxy));
+	if (broadPhaseType == e_sweepAndPruneBroadPhase)
+	{
+		for (int32 axis = 0; axis < 2; ++axis)
+		{
+			memcpy(bp->m_bounds[axis], snapshot->GetData(header->boundOffsets[axis]), 2 * header->proxyCount * sizeof(b2Bound));
+		}
+	}
+	else
+	{
+		if (tree->m_nodeCapacity != header->treeNodeCapacity)
+		{
+			b2Free(tree->m_nodes);
+			tree->m_nodeCapacity = header->treeNodeCapacity;
+			tree->m_nodes = (b2TreeNode*)b2Alloc(tree->m_nodeCapacity * sizeof(b2TreeNode));
+		}
+
+		memcpy(tree->m_nodes, snapshot->GetData(header->treeNodeOffset), header->treeNodeCapacity * sizeof(b2TreeNode));
+		tree->m_root = header->treeRoot;
+		tree->m_nodeCount = header->treeNodeCount;
+		tree->m_freeList = header->treeFreeList;
+	}
+	memcpy(pm->m_pairs, snapshot->GetData(header->pairOffset), header->pairCapacity * sizeof(b2Pair));
+	memcpy(pm->m_control, snapshot->GetData(header->controlOffset), pm->m_tableCapacity * sizeof(int8));
+	memcpy(pm->m_table, snapshot->GetData(header->tableOffset), pm->m_tableCapacity * sizeof(int32));
+
+	bp->m_proxyCount = header->proxyCount;
+	bp->m_freeProxy = header->freeProxy;
+	bp->m_timeStamp = header->timeStamp;
+	bp->m_queryResultCount = 0;
+	bp->m_moveCount = 0;
+	pm->m_pairCount = header->pairCount;
+	pm->m_freePair = header->freePair;
+	pm->m_deletedCount = header->deletedSlotCount;
+	pm->m_pairBufferCount = 0;
+
+	for (int32 i = 0; i < shapeCount; ++i)
+	{
+		b2Shape* shape = shapes[i];
+		if (shape->m_proxyId != b2_nullProxy)
+		{
+			bp->m_proxyPool[shape->m_proxyId].userData = shape;
+		}
+	}
+
+	for (int32 i = 0; i < pm->m_pairCapacity; ++i)
+	{
+		b2Pair* pair = pm->m_pairs + i;
+		int32 index = b2DecodeIndex(pair->userData);
+		if (index < 0)
+		{
+			pair->userData = NULL;
+		}
+		else if (index == contactCount)
+		{
+			pair->userData = &m_contactManager.m_nullContact;
+		}
+		else
+		{
+			pair->userData = contacts[index];
+		}
+	}
+
+	m_bodyList = bodyCount > 0 ? bodies[0] : NULL;
+	m_contactList = contactCount > 0 ? contacts[0] : NULL;
+	m_bodyCount = bodyCount;
+	m_contactCount = contactCount;
+	m_groundBody = bodies[header->groundBody];
+
+	m_gravity = header->gravity;
+	m_allowSleep = header->allowSleep;
+	m_inv_dt0 = header->inv_dt0;
+	m_positionIterationCount = header->positionIterationCount;
+	m_positionCorrection = header->positionCorrection;
+	m_warmStarting = header->warmStarting;
+	m_continuousPhysics = header->continuousPhysics;
+	m_asleep = false;
+
+	m_stackAllocator.Free(contacts);
+	m_stackAllocator.Free(shapes);
+	m_stackAllocator.Free(bodies);
+	return true;
+}
@@ -20,6 +20,7 @@
 #define B2_WORLD_H
 
 #include "../Common/b2Math.h"
+#include "../Common/b2Allocator.h"
 #include "../Common/b2BlockAllocator.h"
 #include "../Common/b2StackAllocator.h"
 #include "b2ContactManager.h"
@@ -34,6 +35,26 @@ class b2Joint;
 class b2Shape;
 class b2Contact;
 class b2BroadPhase;
+class b2WorldSnapshot;
+class b2ThreadPool;
+class b2ContactResultBuffer;
+
+/// Profiling data of the last time step. Times are in milliseconds.
+struct b2Profile
+{
+	float32 step;
+	float32 collide;
+	float32 solve;
+	float32 solveTOI;
+	int32 islandCount;		///< islands solved by Solve
+	int32 toiIslandCount;	///< islands solved by SolveTOI
+	int32 colorCount;		///< most colors used by an island (batched solver)
+	int32 uncoloredCount;	///< contacts that fit into no color (batched solver)
+	int32 sleepIslandCount;	///< islands put to sleep by Solve
+	int32 awakeBodyCount;	///< dynamic bodies still awake after the step
+	int32 toiGJKCallCount;	///< GJK distance queries made by SolveTOI
+	int32 toiGJKIterationCount;	///< GJK support points evaluated by those queries
+};
 
 struct b2TimeStep
 {
@@ -43,6 +64,7 @@ struct b2TimeStep
 	int32 maxIterations;
 	bool warmStarting;
 	bool positionCorrection;
+	bool batchedSolver;
 };
 
 /// The world class manages all physics entities, dynamic simulation,
@@ -55,7 +77,14 @@ public:
 	/// @param worldAABB a bounding box that completely encompasses all your shapes.
 	/// @param gravity the world gravity vector.
 	/// @param doSleep improve performance by not simulating inactive bodies.
-	b2World(const b2AABB& worldAABB, const b2Vec2& gravity, bool doSleep);
+	/// @param broadPhaseType sweep and prune suits mostly resting scenes, the
+	/// dynamic tree scenes where many bodies move far each step.
+	/// @param allocator the memory of bodies, shapes, contacts and joints and
+	/// of large per step allocations. It must outlive the world. NULL uses the
+	/// heap through b2Alloc.
+	b2World(const b2AABB& worldAABB, const b2Vec2& gravity, bool doSleep,
+			b2BroadPhaseType broadPhaseType = e_sweepAndPruneBroadPhase,
+			b2Allocator* allocator = NULL);
 
 	/// Destruct the world. All physics entities are destroyed and all heap memory is released.
 	~b2World();
@@ -139,6 +168,45 @@ public:
 	/// Enable/disable continuous physics. For testing.
 	void SetContinuousPhysics(bool flag) { m_continuousPhysics = flag; }
 
+	/// Enable/disable the batched contact solver. It sorts the contact constraints
+	/// of an island into colors whose constraints share no dynamic body and solves
+	/// them four at a time with SIMD. The constraints are solved in a different
+	/// order than by the sequential solver, so the simulation differs, but it is
+	/// still deterministic and the same with or without SIMD support.
+	void SetBatchedSolver(bool flag) { m_batchedSolver = flag; }
+
+	/// Enable/disable the manifold cache. A touching contact keeps its manifold,
+	/// feature ids and warm starting impulses while its bodies move less than
+	/// b2_manifoldCacheLinearTolerance and b2_manifoldCacheAngularTolerance
+	/// relative to each other, only the normal and separations follow the
+	/// bodies. This makes resting stacks cheaper, but the simulation differs
+	/// slightly from the one without the cache. It is still deterministic.
+	void SetManifoldCaching(bool flag) { m_manifoldCaching = flag; }
+
+	/// Enable/disable speculative contacts. Instead of moving bodies back to
+	/// their time of impact after the step (SolveTOI), a contact also gets the
+	/// points its shapes can reach within the step, at their velocities with
+	/// gravity and the applied forces integrated. Such a point has a positive
+	/// separation and only keeps the bodies from closing more than the gap, so
+	/// fast bodies are stopped in the regular solve. A contact whose bodies do
+	/// not reach any of its points is left out of the islands. Contact
+	/// listeners get these points too, check the separation to tell them from
+	/// touching points. Restitution only applies to touching points. The
+	/// simulation differs from the one with time of impact, but it is still
+	/// deterministic.
+	void SetSpeculativeContacts(bool flag) { m_speculativeContacts = flag; }
+
+	/// Are speculative contacts enabled?
+	bool GetSpeculativeContacts() const { return m_speculativeContacts; }
+
+	/// Enable/disable the simplex cache of the time of impact. Each contact
+	/// keeps the vertices GJK ended with and the next distance query on the
+	/// contact starts from them, which usually converges on the first support
+	/// point. The times of impact are as precise as without the cache, but
+	/// they differ slightly, so the simulation differs too. It is still
+	/// deterministic.
+	void SetSimplexCaching(bool flag) { m_simplexCaching = flag; }
+
 	/// Perform validation of internal data structures.
 	void Validate();
 
@@ -157,13 +225,65 @@ public:
 	/// Get the number of contacts (each may have 0 or more contact points).
 	int32 GetContactCount() const;
 
+	/// Get the profiling data of the last time step.
+	const b2Profile& GetProfile() const;
+
+	/// Get the allocator given to the constructor, or the heap allocator of
+	/// the world.
+	b2Allocator* GetAllocator();
+
+	/// Get the number of bytes the world has allocated and not yet freed from
+	/// its allocator, including the per step allocations of worker threads.
+	int32 GetByteCount() const;
+
+	/// Is the whole world at rest? This is true when the last time step moved
+	/// no body and changed no contact, so another step with the same time step
+	/// would change nothing either and may be skipped. Waking a body, moving it,
+	/// changing its mass, creating or destroying bodies, shapes or joints and
+	/// refiltering clear it until the next step.
+	bool IsAsleep() const;
+
 	/// Change the global gravity vector.
 	void SetGravity(const b2Vec2& gravity);
 
+	/// Get the global gravity vector.
+	const b2Vec2& GetGravity() const;
+
+	/// Solve the islands of a time step on this many threads, counting the
+	/// calling thread. Islands only share static bodies, which are never
+	/// written while solving, so the simulation does not depend on the count.
+	/// With more than one thread, contact results are reported once all
+	/// islands are solved (still in island order) and islands with joints are
+	/// solved on the calling thread. If the system cannot start all threads,
+	/// the world uses the ones that did start, see GetThreadCount.
+	/// @warning This function is locked during callbacks.
+	void SetThreadCount(int32 count);
+
+	/// Get the number of threads solving islands.
+	int32 GetThreadCount() const;
+
+	/// Save the simulation state of all bodies, shapes, contacts and the
+	/// broad-phase into a snapshot. The snapshot memory is reused if possible.
+	/// Joints are not supported: a world with joints leaves the snapshot empty.
+	/// @warning This function is locked during callbacks.
+	/// @return false if nothing was saved (joints, or called during a callback).
+	bool Save(b2WorldSnapshot* snapshot);
+
+	/// Replace all bodies, shapes and contacts by the ones stored in a snapshot.
+	/// The current bodies and shapes are freed without calling any listener, so
+	/// all pointers to them become invalid. The restored bodies keep the order
+	/// and user data they had when the snapshot was saved.
+	/// @warning The snapshot must come from a world with the same world AABB.
+	/// @warning This function is locked during callbacks.
+	/// @return false if the world was left unchanged because it has joints, the
+	/// snapshot is empty or it was called during a callback.
+	bool Restore(const b2WorldSnapshot* snapshot);
+
 private:
 
 	friend class b2Body;
 	friend class b2ContactManager;
+	friend class b2IslandTask;
 
 	void Solve(const b2TimeStep& step);
 	void SolveTOI(const b2TimeStep& step);
@@ -172,9 +292,16 @@ private:
 	void DrawShape(b2Shape* shape, const b2XForm& xf, const b2Color& color, bool core);
 	void DrawDebugData();
 
+	b2HeapAllocator m_heapAllocator;				// also used by the worker threads
+	b2Allocator* m_allocator;
 	b2BlockAllocator m_blockAllocator;
 	b2StackAllocator m_stackAllocator;
 
+	b2ThreadPool* m_threadPool;					// NULL when solving on one thread
+	b2StackAllocator* m_threadAllocators;		// one per worker, thread zero uses m_stackAllocator
+	b2ContactResultBuffer* m_threadResults;		// one per thread
+	b2ContactPointBuffer* m_threadPoints;		// one per thread
+
 	bool m_lock;
 
 	b2BroadPhase* m_broadPhase;
@@ -205,6 +332,11 @@ private:
 
 	int32 m_positionIterationCount;
 
+	// Nothing moved in the last step and nothing changed since.
+	bool m_asleep;
+
+	b2Profile m_profile;
+
 	// This is for debugging the solver.
 	bool m_positionCorrection;
 
@@ -213,6 +345,10 @@ private:
 
 	// This is for debugging the solver.
 	bool m_continuousPhysics;
+	bool m_batchedSolver;
+	bool m_manifoldCaching;
+	bool m_speculativeContacts;
+	bool m_simplexCaching;
 };
 
 inline b2Body* b2World::GetGroundBody()
@@ -245,9 +381,39 @@ inline int32 b2World::GetContactCount() const
 	return m_contactCount;
 }
 
+inline const b2Profile& b2World::GetProfile() const
+{
+	return m_profile;
+}
+
+inline bool b2World::IsAsleep() const
+{
+	return m_asleep;
+}
+
+inline b2Allocator* b2World::GetAllocator()
+{
+	return m_allocator;
+}
+
+inline int32 b2World::GetByteCount() const
+{
+	int32 byteCount = m_heapAllocator.GetByteCount();
+	if (m_allocator != &m_heapAllocator)
+	{
+		byteCount += m_allocator->GetByteCount();
+	}
+	return byteCount;
+}
+
 inline void b2World::SetGravity(const b2Vec2& gravity)
 {
 	m_gravity = gravity;
 }
 
+inline const b2Vec2& b2World::GetGravity() const
+{
+	return m_gravity;
+}
+
 #endif
@@ -0,0 +1,50 @@
+/*
+* Copyright (c) 2006-2007 Erin Catto http://www.gphysics.com
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "b2WorldSnapshot.h"
+
+b2WorldSnapshot::b2WorldSnapshot()
+{
+	m_data = NULL;
+	m_size = 0;
+	m_capacity = 0;
+}
+
+b2WorldSnapshot::~b2WorldSnapshot()
+{
+	if (m_data)
+	{
+		b2Free(m_data);
+	}
+}
+
+void b2WorldSnapshot::Reset(int32 size)
+{
+	if (size > m_capacity)
+	{
+		if (m_data)
+		{
+			b2Free(m_data);
+		}
+
+		m_capacity = size;
+		m_data = (char*)b2Alloc(m_capacity);
+	}
+
+	m_size = size;
+}
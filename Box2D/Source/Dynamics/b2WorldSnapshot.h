@@ -0,0 +1,138 @@
+/*
+* Copyright (c) 2006-2007 Erin Catto http://www.gphysics.com
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef B2_WORLD_SNAPSHOT_H
+#define B2_WORLD_SNAPSHOT_H
+
+#include "../Common/b2Math.h"
+#include "../Collision/b2Collision.h"
+
+// Layout of a snapshot buffer. All offsets are in bytes from the start of
+// the buffer. Pointers inside the stored objects are replaced by indices.
+struct b2WorldSnapshotHeader
+{
+	int32 bodyCount;
+	int32 shapeCount;
+	int32 contactCount;
+	int32 groundBody;
+
+	b2AABB worldAABB;
+	b2Vec2 gravity;
+	bool allowSleep;
+	float32 inv_dt0;
+	int32 positionIterationCount;
+	bool positionCorrection;
+	bool warmStarting;
+	bool continuousPhysics;
+
+	int32 broadPhaseType;
+	int32 proxyCapacity;
+	int32 proxyCount;
+	int32 freeProxy;
+	uint16 timeStamp;
+	int32 pairCapacity;
+	int32 pairCount;
+	int32 freePair;
+	int32 deletedSlotCount;
+	int32 treeRoot;
+	int32 treeNodeCount;
+	int32 treeNodeCapacity;
+	int32 treeFreeList;
+
+	int32 proxyOffset;		// b2Proxy[proxyCapacity]
+	int32 boundOffsets[2];	// b2Bound[2 * proxyCount], sweep and prune only
+	int32 treeNodeOffset;	// b2TreeNode[treeNodeCapacity], dynamic tree only
+	int32 pairOffset;		// b2Pair[pairCapacity]
+	int32 controlOffset;	// int8[2 * pairCapacity]
+	int32 tableOffset;		// int32[2 * pairCapacity]
+	int32 bodyOffsets;		// int32[bodyCount]
+	int32 shapeOffsets;		// int32[shapeCount]
+	int32 contactOffsets;	// int32[contactCount]
+};
+
+/// A flat copy of the complete simulation state of a world: bodies, shapes,
+/// contacts with their warm starting impulses and the broad-phase. Saving and
+/// restoring only copies memory; no shape, proxy or pair is recomputed and no
+/// callback is invoked, so a restored world steps exactly like the original.
+/// A snapshot may be restored any number of times, into the world it was
+/// taken from or into another world built with the same world AABB.
+/// User data pointers are stored as they are.
+/// @warning Joints are not supported. b2World::Save leaves the snapshot empty
+/// and returns false for a world with joints, and b2World::Restore returns
+/// false without touching a world that has joints. This holds in release
+/// builds too.
+/// @see b2World::Save, b2World::Restore
+class b2WorldSnapshot
+{
+public:
+	b2WorldSnapshot();
+	~b2WorldSnapshot();
+
+	/// Get the number of bytes used by the snapshot.
+	int32 GetByteCount() const;
+
+	/// Get the number of bodies stored, in world body list order.
+	int32 GetBodyCount() const;
+
+	/// Is there anything stored?
+	bool IsEmpty() const;
+
+private:
+	friend class b2World;
+
+	// Snapshots are big, copy the world instead.
+	b2WorldSnapshot(const b2WorldSnapshot&);
+	void operator=(const b2WorldSnapshot&);
+
+	// Make room for size bytes, discarding the current contents.
+	void Reset(int32 size);
+
+	b2WorldSnapshotHeader* GetHeader() const;
+	void* GetData(int32 offset) const;
+
+	char* m_data;
+	int32 m_size;
+	int32 m_capacity;
+};
+
+inline int32 b2WorldSnapshot::GetByteCount() const
+{
+	return m_size;
+}
+
+inline bool b2WorldSnapshot::IsEmpty() const
+{
+	return m_size == 0;
+}
+
+inline b2WorldSnapshotHeader* b2WorldSnapshot::GetHeader() const
+{
+	return (b2WorldSnapshotHeader*)m_data;
+}
+
+inline void* b2WorldSnapshot::GetData(int32 offset) const
+{
+	return m_data + offset;
+}
+
+inline int32 b2WorldSnapshot::GetBodyCount() const
+{
+	return m_size == 0 ? 0 : GetHeader()->bodyCount;
+}
+
+#endif
@@ -4,14 +4,13 @@
  * @brief Specifikace tridy Color
  * @see Color
  */
-#include <SDL_opengl.h>
 #include <guichan.hpp>
 
 /** Barva (pro OpenGL) */
 struct Color {
-	GLfloat r; ///< Cervena
-	GLfloat g; ///< Zelena
-	GLfloat b; ///< Modra
+	float r; ///< Cervena
+	float g; ///< Zelena
+	float b; ///< Modra
 
 	/** Inicializace z jednotlivych slozek.
 	 *
@@ -19,7 +18,7 @@ struct Color {
 	 * @param g Zelena slozka v rozsahu [0..1]
 	 * @param b Modra slozka v rozsahu [0..1]
 	 */
-	Color(GLfloat r, GLfloat g, GLfloat b): r(r), g(g), b(b) { }
+	Color(float r, float g, float b): r(r), g(g), b(b) { }
 
 	/** Incializace z jednotlivych slozek.
 	 *
@@ -10,7 +10,7 @@
 #include "objects.hpp"
 #include "contacts.hpp"
 
-void ContactListener::Add(const b2ContactPoint *point)
+void ContactListener::touch(const b2ContactPoint *point)
 {
 	try {
 		GameObject *obj1 = static_cast<GameObject*>(point->shape1->GetBody()->GetUserData());
@@ -22,7 +22,7 @@ void ContactListener::Add(const b2ContactPoint *point)
 		if((typeid(*obj1) == typeid(Idol) and typeid(*obj2) == typeid(Ground)) or
 			(typeid(*obj2) == typeid(Idol) and typeid(*obj1) == typeid(Ground))) {
 			/* kdyz se buzek dotkne zeme tak hra konci */
-			mGame->lost();
+			mLevel->lose();
 		} else if(typeid(*obj1) == typeid(Brick) and typeid(*obj2) == typeid(Brick)) {
 			/* dve kosticky */
 			Brick *b1 = static_cast<Brick*>(obj1);
@@ -33,25 +33,37 @@ void ContactListener::Add(const b2ContactPoint *point)
 				/* nemuzou se znicit hned, protoze ted jsme v b2World.Step(), tak se
 				 * pridaji do pole komb ktera se maji znici (pokud uz v nem nejsou) */
 
-				if(std::find(mGame->mCombosToDestroy.begin(),
-										 mGame->mCombosToDestroy.end(),
-										 b1) == mGame->mCombosToDestroy.end())
-					mGame->mCombosToDestroy.push_back(b1);
+				if(std::find(mLevel->mCombosToDestroy.begin(),
+										 mLevel->mCombosToDestroy.end(),
+										 b1) == mLevel->mCombosToDestroy.end())
+					mLevel->mCombosToDestroy.push_back(b1);
 
-				if(std::find(mGame->mCombosToDestroy.begin(),
-										 mGame->mCombosToDestroy.end(),
-										 b2) == mGame->mCombosToDestroy.end())
-					mGame->mCombosToDestroy.push_back(b2);
+				if(std::find(mLevel->mCombosToDestroy.begin(),
+										 mLevel->mCombosToDestroy.end(),
+										 b2) == mLevel->mCombosToDestroy.end())
+					mLevel->mCombosToDestroy.push_back(b2);
 			}
 		}
 	} catch(std::bad_typeid& e) {
-		std::cerr << "ContactListener::Add: " << e.what() << std::endl;
+		std::cerr << "ContactListener::touch: " << e.what() << std::endl;
 	}
 }
 
-void ContactListener::Persist(const b2ContactPoint *point) 
+void ContactListener::Add(const b2ContactPoint *point)
 {
+	/* spekulativni bod (b2World::SetSpeculativeContacts) se jeste nedotyka,
+	 * dotkne se az nekdy pozdeji jako pretrvavajici bod */
+	if(point->separation <= 0.0f)
+		touch(point);
+}
 
+void ContactListener::Persist(const b2ContactPoint *point) 
+{
+	/* bez spekulativnich kontaktu se kazdy bod dotkl uz v Add(), jinak se
+	 * hlasi jen bod ktery se od minuleho kroku prave dotkl */
+	if(mLevel->mWorld->GetSpeculativeContacts() and point->separation <= 0.0f
+			and point->separation0 > 0.0f)
+		touch(point);
 }
 
 void ContactListener::Remove(const b2ContactPoint* point)
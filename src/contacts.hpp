@@ -4,17 +4,24 @@
  * @brief Hlavickovy soubor pro posluchac kontaktu
  */
 #include <Box2D.h>
-#include "game.hpp"
+#include "level.hpp"
 #include "objects.hpp"
 
-class Game;
+class Level;
 
 /** Posluchac kontaktu */
 class ContactListener: public b2ContactListener {
-	Game *mGame; ///< Hra ktere tento posluchac prislusi
+	Level *mLevel; ///< Uroven ktere tento posluchac prislusi
+
+	/** Telesa se dotkla.
+	 * Buzek na zemi prohrava, dve komba se zniceji. Muze se volat
+	 * opakovane pro stejny dotyk.
+	 * @param point Kontaktni bod se zapornou (nebo nulovou) vzdalenosti
+	 */
+	void touch(const b2ContactPoint *point);
 public:
-	/** Nastavi hru */
-	ContactListener(Game *game): mGame(game) { }
+	/** Nastavi uroven */
+	ContactListener(Level *level): mLevel(level) { }
 
 	/** Volano pri pridani noveho kontaktniho bodu.
 	 * @param point Novy kontaktni bod
@@ -0,0 +1,94 @@
+/** @file frameclock.cpp
+ * @brief Implementace tridy FrameClock
+ * @see FrameClock
+ */
+#include <iostream>
+#include <iomanip>
+#include <cerrno>
+#include <cmath>
+#include <time.h>
+#include <unistd.h>
+#include "frameclock.hpp"
+
+/** Uspi vlakno az do casu t (podle FrameClock::now()) */
+static void sleepUntil(double t)
+{
+	struct timespec ts;
+	ts.tv_sec = (time_t)std::floor(t);
+	ts.tv_nsec = (long)((t - std::floor(t)) * 1e9);
+	if(ts.tv_nsec >= 1000000000L)
+		ts.tv_nsec = 999999999L;
+
+#if defined(_POSIX_TIMERS) && _POSIX_TIMERS > 0 && defined(TIMER_ABSTIME)
+	/* signal spanek prerusi, termin ale zustava stejny */
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+		;
+#else
+	/* bez clock_nanosleep se spi relativne, zbytek se dospi */
+	double left;
+	while((left = t - FrameClock::now()) > 0.0) {
+		struct timespec rel;
+		rel.tv_sec = (time_t)left;
+		rel.tv_nsec = (long)((left - rel.tv_sec) * 1e9);
+		nanosleep(&rel, NULL);
+	}
+#endif
+}
+
+FrameClock::FrameClock(double period):
+	mPeriod(period),
+	mDeadline(0.0),
+	mFrames(0),
+	mMissed(0),
+	mWorstLateness(0.0)
+{
+	reset();
+}
+
+double FrameClock::now()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+void FrameClock::reset()
+{
+	mDeadline = now() + mPeriod;
+}
+
+bool FrameClock::wait()
+{
+	double t = now();
+	mFrames++;
+
+	if(t < mDeadline) {
+		sleepUntil(mDeadline);
+		mDeadline += mPeriod;
+		return true;
+	}
+
+	double late = t - mDeadline;
+	if(late <= mPeriod) {
+		/* mirne zpozdeni se dozene v dalsim snimku */
+		mDeadline += mPeriod;
+		return true;
+	}
+
+	/* vypadl cely snimek */
+	mMissed++;
+	if(late > mWorstLateness)
+		mWorstLateness = late;
+	mDeadline = t + mPeriod;
+	return false;
+}
+
+void FrameClock::report(std::ostream &out, const char *name) const
+{
+	if(!mMissed)
+		return;
+
+	out << name << ": missed " << mMissed << " of " << mFrames
+		<< " frame deadlines (worst " << std::fixed << std::setprecision(1)
+		<< mWorstLateness * 1000.0 << " ms late)" << std::endl;
+}
@@ -0,0 +1,67 @@
+#ifndef have_frameclock_hpp
+#define have_frameclock_hpp
+/** @file frameclock.hpp
+ * @brief Hlavickovy soubor pro tridu FrameClock
+ * @see FrameClock
+ */
+#include <ostream>
+
+/** Casovac snimku.
+ * Uspava hlavni smycku do pevne danych okamziku (termin = predchozi termin +
+ * perioda). Spi se az do absolutniho casu na monotonnich hodinach, takze se
+ * chyby nescitaji a neni potreba aktivne cekat.
+ *
+ * Pokud smycka termin nestihne o vic nez celou periodu (vypadl snimek),
+ * zapocita se zmeskany termin a dalsi termin se pocita od ted, aby se
+ * zmeskane snimky nedohanely najednou.
+ */
+class FrameClock {
+	double mPeriod; ///< Perioda v sekundach
+	double mDeadline; ///< Dalsi termin (cas podle now())
+	unsigned mFrames; ///< Pocet volani wait()
+	unsigned mMissed; ///< Pocet zmeskanych terminu
+	double mWorstLateness; ///< Nejvetsi zpozdeni zmeskaneho terminu
+
+public:
+	/** Vytvori casovac, prvni termin je za jednu periodu.
+	 * @param period Perioda v sekundach
+	 */
+	FrameClock(double period);
+
+	/** Aktualni cas v sekundach (monotonni hodiny) */
+	static double now();
+
+	/** Perioda v sekundach */
+	double period() const { return mPeriod; }
+
+	/** Nastavi periodu, plati od dalsiho terminu */
+	void period(double p) { mPeriod = p; }
+
+	/** Zacne pocitat terminy znovu od ted.
+	 * Vola se po dobe kdy smycka zamerne nebezela (cekani na udalost, hra
+	 * spustena z menu), aby se to nepocitalo jako zmeskane terminy.
+	 */
+	void reset();
+
+	/** Pocka na dalsi termin.
+	 * @return false pokud byl termin zmeskan
+	 */
+	bool wait();
+
+	/** Pocet volani wait() */
+	unsigned frames() const { return mFrames; }
+
+	/** Pocet zmeskanych terminu */
+	unsigned missed() const { return mMissed; }
+
+	/** Nejvetsi zpozdeni zmeskaneho terminu (v sekundach) */
+	double worstLateness() const { return mWorstLateness; }
+
+	/** Vypise kolik terminu bylo zmeskano (pokud nejaky).
+	 * @param out Kam se vypisuje
+	 * @param name Jmeno smycky (napr. "game")
+	 */
+	void report(std::ostream &out, const char *name) const;
+};
+
+#endif
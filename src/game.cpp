@@ -8,21 +8,21 @@
 #include <SDL_opengl.h>
 #include <iostream>
 #include <sstream>
+#include <iomanip>
 #include <string>
 #include <fstream>
 #include <stdexcept>
 #include <typeinfo>
+#include <cmath>
 #include "config.h"
 #include "game.hpp"
+#include "level.hpp"
 #include "objects.hpp"
-#include "json/parser.hpp"
-#include "json/exceptions.hpp"
+#include "stats.hpp"
 
 float Game::GameOverTime = 2.0;
 float Game::SuccesTime = 2.0;
-float Game::ChargingTime = 1.0;
-float Game::ExplosionForce = 200.0;
-float Game::ExplosionLimit = 0.5;
+int Game::MaxCatchUpSteps = 5;
 
 bool Game::setupGL()
 {
@@ -56,9 +56,10 @@ bool Game::setupGL()
 	glViewport(0, 0, mScreen->w, mScreen->h);
 	glMatrixMode(GL_PROJECTION);
 	glLoadIdentity();
-	/* obrazovka se nastavi tak aby souhlasila s mCamera */
-	glOrtho(mCamera.lowerBound.x, mCamera.upperBound.x,
-					mCamera.lowerBound.y, mCamera.upperBound.y,
+	/* obrazovka se nastavi tak aby souhlasila s kamerou urovne */
+	const b2AABB &camera = mLevel.camera();
+	glOrtho(camera.lowerBound.x, camera.upperBound.x,
+					camera.lowerBound.y, camera.upperBound.y,
 					-1, 1);
 	glMatrixMode(GL_MODELVIEW);
 
@@ -81,15 +82,73 @@ void Game::restoreGL()
 
 b2Vec2 Game::windowToWorld(int x, int y)
 {
-	const float xscale = (mCamera.upperBound.x - mCamera.lowerBound.x) / mScreen->w;
-	const float yscale = (mCamera.upperBound.y - mCamera.lowerBound.y) / mScreen->h;
+	const b2AABB &camera = mLevel.camera();
+	const float xscale = (camera.upperBound.x - camera.lowerBound.x) / mScreen->w;
+	const float yscale = (camera.upperBound.y - camera.lowerBound.y) / mScreen->h;
 	b2Vec2 pos;
-	pos.x = x*xscale + mCamera.lowerBound.x;
-	pos.y = (mScreen->h - y)*yscale + mCamera.lowerBound.y;
+	pos.x = x*xscale + camera.lowerBound.x;
+	pos.y = (mScreen->h - y)*yscale + camera.lowerBound.y;
 	return pos;
 }
 
-void Game::draw()
+void Game::drawVertices(const b2Body *body)
+{
+	const b2Shape *shape = const_cast<b2Body*>(body)->GetShapeList();
+
+	/* teleso bez tvaru se ignoruje */
+	if(!shape)
+		return;
+
+	if(shape->GetType() == e_polygonShape) {
+		/* polygon se zpracuje jednoduse */
+		const b2PolygonShape *poly;
+		poly = dynamic_cast<const b2PolygonShape*>(shape);
+		assert(poly);
+
+		for(int i=0; i!=poly->GetVertexCount(); i++)
+			glVertex2f(poly->GetVertices()[i].x, poly->GetVertices()[i].y);
+	} else {
+		assert(shape->GetType() == e_circleShape);
+		const b2CircleShape *circle;
+		circle = dynamic_cast<const b2CircleShape*>(shape);
+		assert(circle);
+		/* kruh se musi spocitat */
+		const int segs = 32; 
+		const float step = 2*M_PI/segs;
+		const float radius = circle->GetRadius();
+
+		for(int i=0; i!=segs; i++)
+			glVertex2f(std::cos(step*i)*radius, std::sin(step*i)*radius);
+	}
+}
+
+void Game::drawObject(GameObject *object, float alpha)
+{
+	const b2Body *body = object->body();
+	Color c = object->color();
+	b2Vec2 position = object->position(alpha);
+
+	glPushMatrix();
+	glTranslatef(position.x, position.y, 0.0f);
+	glRotatef(object->angle(alpha)/M_PI*180.0, 0.0f, 0.0f, 1.0f);
+
+	/* nejprve se nakresli obrys */
+	glColor3f(c.r, c.g, c.b);
+	glBegin(GL_LINE_LOOP);
+		drawVertices(body);
+	glEnd();
+
+	/* a pak vypln */
+	glColor4f(c.r, c.g, c.b, 0.7);
+	glBegin(GL_POLYGON);
+		drawVertices(body);
+	glEnd();
+
+
+	glPopMatrix();
+}
+
+void Game::draw(float alpha)
 {
 	glClear(GL_COLOR_BUFFER_BIT);
 	glMatrixMode(GL_MODELVIEW);
@@ -97,19 +156,19 @@ void Game::draw()
 
 	/* kresleni teles ve svete */
 	b2Body *body;
-	for(body = mWorld->GetBodyList(); body != NULL; body = body->GetNext()) {
+	for(body = mLevel.world()->GetBodyList(); body != NULL; body = body->GetNext()) {
 		GameObject *obj = static_cast<GameObject*>(body->GetUserData());
 		if(obj)
-			obj->draw();
+			drawObject(obj, alpha);
 	}
 
 	/* kresleni pripadne zpravy */
 	SDL_Surface *msg;
-	if(mLost)
+	if(mLevel.lost())
 		msg = mGameOver;
-	else if(mChecking)
+	else if(mLevel.checking())
 		msg = mCheckingVictory;
-	else if(mWin)
+	else if(mLevel.won())
 		msg = mSuccess;
 	else
 		msg = NULL;
@@ -134,13 +193,13 @@ void Game::draw()
 	glDrawPixels(mRenderedMapName->w, mRenderedMapName->h, format, GL_UNSIGNED_BYTE, mRenderedMapName->pixels);
 
 	/* kresleni poctu zbyvajicich kosticek */
-	if(mToDestroy > 0) {
+	if(mLevel.toDestroy() > 0) {
 		SDL_Surface *toDestroy;
 		SDL_Color c;
 		c.r = 29; c.g = 77; c.b = 26;
 		std::stringstream s;
 
-		s << "Destroy: " << mToDestroy;
+		s << "Destroy: " << mLevel.toDestroy();
 		toDestroy = TTF_RenderUTF8_Blended(mLittleFont, s.str().c_str(), c);
 		glRasterPos2f(-(toDestroy->w / 2)*mPixelToMeter, -0.5);
 		glDrawPixels(toDestroy->w, toDestroy->h, format, GL_UNSIGNED_BYTE, toDestroy->pixels);
@@ -148,15 +207,65 @@ void Game::draw()
 		SDL_FreeSurface(toDestroy);
 	}
 
+	if(mShowStats)
+		drawStats();
+
 	glFlush();
 	SDL_GL_SwapBuffers();
 }
 
+void Game::drawStats()
+{
+	GLenum format;
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+	format = GL_RGBA;
+#else
+	format = GL_BGRA;
+#endif
+
+	const FrameStats &s = mLastStats;
+	std::stringstream lines[4];
+	lines[0] << std::fixed << std::setprecision(2)
+		<< "steps " << s.steps << "  collide " << s.collide << "  solve " << s.solve
+		<< "  toi " << s.solveTOI << " ms";
+	lines[1] << std::fixed << std::setprecision(2)
+		<< "delete " << s.deleteInvisible << "  events " << s.events
+		<< "  draw " << s.draw << " ms";
+	lines[2] << "bodies " << s.bodies << "  contacts " << s.contacts
+		<< "  islands " << s.islands << "  colors " << s.colors;
+	lines[3] << "proxies " << s.proxies << "  pairs " << s.pairs
+		<< "  memory " << s.bytes / 1024 << " kB";
+
+	SDL_Color c;
+	c.r = 64; c.g = 64; c.b = 64;
+	const b2AABB &camera = mLevel.camera();
+	float y = camera.upperBound.y - 4*mPixelToMeter;
+
+	for(int i = 0; i != 4; i++) {
+		SDL_Surface *line = TTF_RenderUTF8_Blended(mLittleFont, lines[i].str().c_str(), c);
+		glRasterPos2f(camera.lowerBound.x + 4*mPixelToMeter, y);
+		glDrawPixels(line->w, line->h, format, GL_UNSIGNED_BYTE, line->pixels);
+		y -= line->h * mPixelToMeter;
+		SDL_FreeSurface(line);
+	}
+}
+
+void Game::statsFile(const std::string &file)
+{
+	delete mStatsWriter;
+	mStatsWriter = NULL;
+	mStatsWriter = new StatsWriter(file);
+}
+
 void Game::processEvents()
 {
 	SDL_Event event;
 
 	while(SDL_PollEvent(&event)) {
+		/* kurzor kresli SDL, pohyb mysi nic nemeni */
+		if(event.type != SDL_MOUSEMOTION)
+			mRedraw = true;
+
 		switch(event.type) {
 			case SDL_QUIT:
 				mRunning = false;
@@ -181,22 +290,28 @@ void Game::keyPressed(SDLKey key)
 	switch(key) {
 		case SDLK_PAUSE:
 		case SDLK_p:
-			mPaused = !mPaused;
+			if(mLevel.paused()) {
+				mLevel.play();
+				mReplay.played(mLevel);
+			} else {
+				mLevel.pause();
+				mReplay.paused(mLevel);
+			}
+			break;
+		case SDLK_F3:
+			mShowStats = !mShowStats;
 			break;
 		case SDLK_ESCAPE:
 		case SDLK_q:
 			mRunning = false;
 			break;
 		case SDLK_r:
-			mWin = false;
-			mLost = false;
-			mChecking = false;
 			mRunning = true;
 			mLostTime = 0.0;
 			mWinTime = 0.0;
 
-			deleteMap();
-			loadMap();
+			mReplay.reset(mLevel);
+			mLevel.reset();
 			break;
 		default:
 			break;
@@ -213,230 +328,12 @@ void Game::keyReleased(SDLKey key)
 
 void Game::mouseClicked(Uint8 button, int x, int y)
 {
-	b2Vec2 pos = windowToWorld(x, y);
-
-	/* kostky se nici levym tlacitkem a jen kdyz se nenabiji */
-	if(button == SDL_BUTTON_LEFT and !mCharging) {
-		/* tento kousek kodu je prevzat z prikladu k Box2D (TestBed) */
-		/* hledani prvniho telesa na pozici pos */
-		b2AABB aabb;
-		b2Vec2 a;
-		a.Set(b2_linearSlop, b2_linearSlop);
-		aabb.lowerBound = pos - a;
-		aabb.upperBound = pos + a;
-
-		b2Body *body = NULL;
-		const size_t maxCount = 10;
-		b2Shape *shapes[maxCount];
-		int32 count = mWorld->Query(aabb, shapes, maxCount);
-		for (int32 i = 0; i < count; ++i) {
-			b2Body *shapeBody = shapes[i]->GetBody();
-			if(!shapeBody->IsStatic()) {
-				if(shapes[i]->TestPoint(shapeBody->GetXForm(), pos)) {
-					body = shapes[i]->GetBody();
-					break;
-				}
-			}
-		}
-
-		if(body) {
-			/* nici se jen kostky a jen ty u kterych muzeme */
-			GameObject *object = static_cast<GameObject*>(body->GetUserData());
-			Brick *brick = dynamic_cast<Brick*>(object);
-			if(brick) {
-				if(brick->canDestroy()) {
-					destroyBrick(brick);
-					mCharging = true;
-				}
-			}
-		}
-	}
-}
-
-void Game::loadMap()
-{
-	/* inicializace sveta */
-	b2AABB worldAABB;
-	worldAABB.lowerBound.Set(-100.0, -100.0);
-	worldAABB.upperBound.Set(100.0, 100.0);
-	b2Vec2 gravity(0.0f, -10.0f);
-	mWorld = new b2World(worldAABB, gravity, true);
-	mContactListener = new ContactListener(this);
-	mWorld->SetContactListener(mContactListener);
-
-	/* podlozka */
-	new Ground(mWorld, b2Vec2(0.0, -2.5), 80.0, 5.0);
-
-	/* nacteni dat z JSON */
-	std::ifstream mapFile(mMapFile.c_str());
-	if(!mapFile) {
-		std::stringstream s;
-		s << "Unable to open file " << mMapFile;
-		throw std::runtime_error(s.str());
-	}
-
-	json::Value root = mParser.parse(mapFile);
-	mMapName = root["name"].str();
-	mToDestroy = root["destroy"].num();
-
-	/* kostky */
-	json::Array bricks = root["bricks"].ary();
-	json::Array::const_iterator brick;
-	/* pro kazdou kosticku v poli kosticek */
-	for(brick = bricks.begin(); brick != bricks.end(); brick++) {
-		json::Array b = brick->ary();
-
-		/* pozice a rozmery kosticky */
-		float x = b[1].num();
-		float y = b[2].num();
-		float w = b[3].num();
-		float h = b[4].num();
-
-		/* typ kosticky (pismenko) */
-		json::String typeId = b[0].str();
-		Brick::Type type;
-		if(typeId == "n")
-			type = Brick::Normal;
-		else if(typeId == "d")
-			type = Brick::Dark;
-		else if(typeId == "c")
-			type = Brick::Combo;
-		else if(typeId == "s")
-			type = Brick::Slippy;
-		else if(typeId == "g")
-			type = Brick::Gummy;
-		else if(typeId == "x")
-			type = Brick::TNT;
-		else {
-			std::stringstream s;
-			s << "Bad brick type '" << typeId << "'";
-			throw json::DataError(s.str());
-		}
-
-		new Brick(mWorld, b2Vec2(x, y), w, h, type);
-	}
-
-	/* buzci */
-	json::Array idols = root["idols"].ary();
-	json::Array::const_iterator idol;
-	for(idol = idols.begin(); idol != idols.end(); idol++) {
-		/* prvni prvek pole s buzkem je pozice */
-		b2Vec2 pos;
-		pos.x = (*idol)[0][0].num();
-		pos.y = (*idol)[0][1].num();
-
-		/* ostatni jsou vertexy */
-		std::vector<b2Vec2> vertices;
-		json::Array::size_type i;
-		for(i = 1; i != idol->ary().size(); i++) {
-			b2Vec2 vertex;
-			vertex.x = (*idol)[i][0].num();
-			vertex.y = (*idol)[i][1].num();
-			vertices.push_back(vertex);
-		}
-
-		mIdols.push_back(new Idol(mWorld, pos, vertices));
-	}
-}
-
-void Game::deleteMap()
-{
-	/* smazani vsech objektu */
-	b2Body *body;
-	b2Body *next;
-	for(body = mWorld->GetBodyList(); body != NULL; body = next) {
-		next = body->GetNext();
-		delete static_cast<GameObject*>(body->GetUserData());
-	}
-
-	delete mWorld;
-	delete mContactListener;
-	mIdols.clear();
-
-	mWorld = NULL;
-	mContactListener = NULL;
-}
-
-void Game::deleteInvisible()
-{
-	static int maxShapes = 64;
-	b2Shape *shapes[maxShapes];
-
-	int shapeCount = mWorld->Query(mCamera, shapes, maxShapes);
-
-	/* s velikou pravdepodobnosti se do pole nevesly vsechny tvary */
-	if(shapeCount == maxShapes) {
-		maxShapes *= 2; // proto se musi predpokladat ze jich je vic 
-		deleteInvisible();
-	} else {
-		/* oznaceni vsech viditelnych */
-		register int i;
-		for(i=0; i!=shapeCount; i++) {
-			GameObject *object = static_cast<GameObject*>(shapes[i]->GetBody()->GetUserData());
-			object->isVisible = true;
-		}
-
-		/* smazani neviditelnych */
-		b2Body *body;
-		for(body = mWorld->GetBodyList(); body != NULL; ) {
-			GameObject *object = static_cast<GameObject*>(body->GetUserData());
-			body = body->GetNext(); // pozdeji by uz teleso mohlo byt smazane
-
-			if(!object) {
-				continue; // preskocime neznama telesa
-			}
-
-			if(!object->isVisible) {
-				Brick *brick = dynamic_cast<Brick*>(object);
-				if(brick) {
-					/* znici se i kosticka kterou uzivatel znicit nesmi, ale nebude se
-					 * pocitat (vyjimka je kombo, to na canDestroy() vraci false ale
-					 * budeme ho nicit) */
-					if(brick->canDestroy() or brick->type() == Brick::Combo) {
-						destroyBrick(brick);
-						continue;
-					}
-				} else if(dynamic_cast<Idol*>(object)) {
-					/* buzek smazan - prohra */
-					mLost = true;
-				}
-
-				delete object;
-			} else {
-				object->isVisible = false; // kvuli dalsi kontrole
-			}
-		}
-	}
-}
-
-void Game::destroyBrick(Brick *brick)
-{
-	b2Vec2 pos = brick->body()->GetWorldCenter();
-	float bombMass = brick->body()->GetMass();
-	Brick::Type brickType = brick->type();
-
-	delete brick;
-	if(--mToDestroy <= 0) {
-		mChecking = true;
-	}
-
-	if(brickType == Brick::TNT) {
-		makeExplosion(pos, bombMass);
-	}
-}
-
-void Game::makeExplosion(const b2Vec2 &position, float bombMass)
-{
-	const float size = ExplosionForce * bombMass;
-
-	b2Body *body;
-	for(body = mWorld->GetBodyList(); body != NULL; body = body->GetNext() ) {
-		b2Vec2 force = body->GetWorldCenter() - position;
-		float len = force.Length();
-		force.Normalize();
-		force *= size / len;
-
-		body->ApplyForce(force, body->GetWorldCenter());
+	/* kostky se nici levym tlacitkem */
+	if(button == SDL_BUTTON_LEFT) {
+		b2Vec2 pos = windowToWorld(x, y);
+		/* zaznamenavaji se jen kliknuti ktera neco znicila */
+		if(mLevel.destroyAt(pos))
+			mReplay.destroyed(mLevel, pos);
 	}
 }
 
@@ -448,24 +345,19 @@ Game::Game(SDL_Surface *screen, std::string dataDir, std::string font, std::stri
 	mCheckingVictory(NULL),
 	mSuccess(NULL),
 
-	mWorld(NULL),
-	mContactListener(NULL),
-	mStepTime(1.0/60.0),
-	mIterations(15),
+	mLevel(map),
 
-	mLost(false),
-	mChecking(false),
-	mWin(false),
-	mPaused(false),
 	mRunning(false),
-	mCharging(false),
 	mLostTime(0.0),
 	mWinTime(0.0),
-	mChargingTime(0.0),
+	mFrameRate(0.0),
+	mSettled(false),
+	mRedraw(true),
+
+	mShowStats(false),
+	mStatsWriter(NULL),
 
 	mDataDir(dataDir),
-	mMapFile(map),
-	mToDestroy(0),
 
 	mNormalCursor(NULL),
 	mChargingCursor(NULL)
@@ -485,15 +377,6 @@ Game::Game(SDL_Surface *screen, std::string dataDir, std::string font, std::stri
 		throw std::runtime_error(s.str());
 	}
 
-	try {
-		loadMap();
-	} catch(json::Exception e) {
-		/* chyba v jsonu se jen vyhodi vys */
-		std::stringstream s;
-		s << "Error in file " << map << ": " << e.what() << std::endl;
-		throw std::runtime_error(s.str());
-	}
-
 	/* vykreslovani hlasek */
 	SDL_Color c;
 	c.r = 255; c.g = 16; c.b = 16;
@@ -504,13 +387,10 @@ Game::Game(SDL_Surface *screen, std::string dataDir, std::string font, std::stri
 	mCheckingVictory = TTF_RenderUTF8_Blended(mBigFont, "Checking victory...", c);
 
 	c.r = 29; c.g = 77; c.b = 26;
-	mRenderedMapName = TTF_RenderUTF8_Blended(mLittleFont, mMapName.c_str(), c);
+	mRenderedMapName = TTF_RenderUTF8_Blended(mLittleFont, mLevel.mapName().c_str(), c);
 
-	/* nastaveni kamery */
-	mCamera.lowerBound.Set(-16.0, -2.0);
-	mCamera.upperBound.Set(16.0, 20.0);
-
-	mPixelToMeter = (mCamera.upperBound.x - mCamera.lowerBound.x) / mScreen->w;
+	const b2AABB &camera = mLevel.camera();
+	mPixelToMeter = (camera.upperBound.x - camera.lowerBound.x) / mScreen->w;
 
 	/* kurzory */
 	mNormalCursor = SDL_GetCursor(); // normalni kurzor je vychozi
@@ -569,85 +449,123 @@ Game::~Game()
 	TTF_CloseFont(mLittleFont);
 	TTF_CloseFont(mBigFont);
 	SDL_FreeCursor(mChargingCursor);
+	delete mStatsWriter;
 
 	glLineWidth(1.0f);
 }
 
-void Game::run()
+bool Game::step()
 {
-	Uint32 ntime = SDL_GetTicks(); // cas dalsiho ramce v ms
-	mRunning = true;
+	if(mLevel.lost()) {
+		mLostTime += mLevel.stepTime();
+		if(mLostTime > GameOverTime) 
+			return false;
+	} else if(mLevel.won()) {
+		mWinTime += mLevel.stepTime();
+		if(mWinTime > SuccesTime)
+			return false;
+	}
 
-	setupGL();
+	/* ve spicim svete se nic nehybe, pozice staci zapamatovat jednou aby se
+	 * uz nic neinterpolovalo */
+	bool asleep = mLevel.world()->IsAsleep();
+	if(!asleep or !mSettled) {
+		b2Body *body;
+		for(body = mLevel.world()->GetBodyList(); body != NULL; body = body->GetNext()) {
+			GameObject *obj = static_cast<GameObject*>(body->GetUserData());
+			if(obj)
+				obj->rememberPosition();
+		}
+		mRedraw = true;
+	}
+	mSettled = asleep;
 
-	while(mRunning) {
-		while(SDL_GetTicks() < ntime)
-			SDL_Delay(1);
-		ntime += mStepTime * 1000;
+	/* jedina zmena, ktera muze prijit i ve spicim svete */
+	bool won = mLevel.won();
 
-		if(mLost) {
-			mLostTime += mStepTime;
-			if(mLostTime > GameOverTime) 
-				break;
-		} else if(mChecking) {
-			/* pokud jsou vsichni buzci v klidu, skonci se kontrola */
-			std::vector<Idol*>::const_iterator id;
-			mChecking = false;
-			for(id = mIdols.begin(); id != mIdols.end(); id++) {
-				if(!(*id)->body()->IsSleeping()) {
-					mChecking = true;
-					break;
-				}
-			}
+	mLevel.step();
+	mStats.addStep(mLevel);
 
-			if(!mChecking) {
-				mWin = true;
-				mWinTime = 0.0;
-			}
-		} else if(mWin) {
-			mWinTime += mStepTime;
-			if(mWinTime > SuccesTime)
-				break;
-		}
+	if(mLevel.won() != won)
+		mRedraw = true;
+	return true;
+}
 
-		if(mCharging and not mPaused) {
-			mChargingTime += mStepTime;
-			if(mChargingTime > ChargingTime) {
-				mCharging = false;
-				mChargingTime = 0.0;
-			}
+void Game::run(bool paced)
+{
+	/* bez nastavene frekvence casuje snimky synchronizace s monitorem, pokud
+	 * ji ovladac opravdu zapnul */
+	int swapControl = 0;
+	bool vsync = mFrameRate <= 0.0 and SDL_GL_GetAttribute(SDL_GL_SWAP_CONTROL, &swapControl) == 0
+		and swapControl > 0;
+	FrameClock clock(1.0 / (mFrameRate > 0.0 ? mFrameRate : fps()));
+	double last = FrameClock::now(); // cas minuleho snimku
+	float accumulator = 0.0; // cas ktery jeste fyzika nedohnala
+	bool drawn = false; // vykreslil se minuly snimek?
+	int frame = 0;
+	mRunning = true;
+	mRedraw = true;
+	mReplay.start(mLevel);
+
+	setupGL();
+
+	while(mRunning) {
+		const float dt = mLevel.stepTime();
+
+		if(paced) {
+			/* po vykreslenem snimku uz pockalo SDL_GL_SwapBuffers() */
+			if(!vsync or !drawn)
+				clock.wait();
+			double now = FrameClock::now();
+			accumulator += now - last;
+			last = now;
+			/* po dlouhem zaseknuti se nedohani vsechno, jinak by se hra
+			 * zasekavala cim dal vic */
+			if(accumulator > MaxCatchUpSteps * dt)
+				accumulator = MaxCatchUpSteps * dt;
+		} else {
+			accumulator = dt;
 		}
 
 		/* nastaveni odpovidajiciho kurzoru */
 		SDL_Cursor *actual = SDL_GetCursor();
-		if(mCharging and actual != mChargingCursor) {
+		if(mLevel.charging() and actual != mChargingCursor) {
 			SDL_SetCursor(mChargingCursor);
-		} else if(!mCharging and actual != mNormalCursor) {
+		} else if(!mLevel.charging() and actual != mNormalCursor) {
 			SDL_SetCursor(mNormalCursor);
 		}
 
+		mStats.clear(frame++);
+
+		b2Timer timer;
 		processEvents();
-		if(!mPaused) {
-			mWorld->Step(mStepTime, mIterations);
-
-			/* znici se kombo kostky ktere se znicit maji */
-			if(mCombosToDestroy.size() > 0) {
-				std::vector<Brick*>::iterator combo;
-				for(combo = mCombosToDestroy.begin();
-						combo != mCombosToDestroy.end();
-						combo++) {
-					delete *combo;
-					if(--mToDestroy <= 0) 
-						mChecking = true;
-				}
-				mCombosToDestroy.clear();
-			}
+		mStats.events = timer.GetMilliseconds();
+
+		for(; accumulator >= dt and mRunning; accumulator -= dt) {
+			if(!step())
+				mRunning = false;
+		}
 
-			deleteInvisible();
+		/* dokud se nic nedeje, zustava na obrazovce posledni snimek */
+		drawn = mRedraw;
+		if(mRedraw) {
+			timer.Reset();
+			draw(paced ? accumulator / dt : 1.0);
+			mStats.draw = timer.GetMilliseconds();
+			mRedraw = false;
+			/* pristi nevykresleny snimek se uspi periodu od ted */
+			if(vsync)
+				clock.reset();
 		}
-		draw();
+
+		mLastStats = mStats;
+		if(mStatsWriter)
+			mStatsWriter->write(mStats);
 	}
 
+	mReplay.finish(mLevel);
 	restoreGL();
-}
 
+	if(paced)
+		clock.report(std::cerr, "game");
+}
@@ -9,18 +9,17 @@
 #include <SDL_ttf.h>
 #include <vector>
 #include <string>
-#include "contacts.hpp"
-#include "json/parser.hpp"
-
-class ContactListener;
+#include "level.hpp"
+#include "objects.hpp"
+#include "replay.hpp"
+#include "frameclock.hpp"
+#include "stats.hpp"
 
 /** Hra (uroven).
- * Tato trida obaluje implementaci jedne urovne hry
+ * Tato trida obaluje vykreslovani a ovladani jedne urovne hry. Samotna
+ * pravidla a fyzika jsou v tride Level.
  */
 class Game {
-	friend class ContactListener;
-
-	b2AABB mCamera; ///< Box ktery udava co se zobrazuje
 	float mPixelToMeter; ///< Kolik metru je jeden pixel?
 
 	SDL_Surface *mScreen; ///< Obrazovka
@@ -31,37 +30,29 @@ class Game {
 	SDL_Surface *mSuccess; ///< Vykreslena hlaska Success
 	SDL_Surface *mRenderedMapName; ///< Vykresleny nazev mapy
 
-	b2World *mWorld; ///< Svet
-	ContactListener *mContactListener; ///< Posluchac kontaktu
-	float mStepTime; ///< Cas jednoho kroku
-	int mIterations; ///< Pocet iteraci pro Box2D
+	Level mLevel; ///< Hrana uroven
+	Replay mReplay; ///< Zaznam vstupu hrace
 
-	bool mLost; ///< Prohral hrac?
-	bool mChecking; ///< Kontroluje se vyhra?
-	bool mWin; ///< Vyhral hrac?
-	bool mPaused; ///< Je hra pozastavena?
 	bool mRunning; ///< Bezi hra?
-	bool mCharging; ///< Nabiji se?
 	float mLostTime; ///< Cas ktery uplynul od prohry hrace (v sekundach)
 	float mWinTime; ///< Cas ktery uplynul od vyhry hrace
-	float mChargingTime; ///< Jak dlouho se uz nabiji
-	std::vector<Idol*> mIdols; ///< Vsichni buzci ve hre
+	float mFrameRate; ///< Frekvence vykreslovani (0 = frekvence monitoru)
+	bool mSettled; ///< Spi cely svet a zapamatovane pozice objektu uz jsou aktualni?
+	bool mRedraw; ///< Zmenilo se neco od posledniho vykresleni?
+
+	bool mShowStats; ///< Zobrazuji se statistiky snimku?
+	FrameStats mStats; ///< Statistiky prave probihajiciho snimku
+	FrameStats mLastStats; ///< Statistiky posledniho dokonceneho snimku
+	StatsWriter *mStatsWriter; ///< Kam se zapisuji statistiky (nebo NULL)
 
-	json::Parser mParser; ///< Parser na JSON
 	std::string mDataDir; ///< Adresar s daty
-	std::string mMapName; ///< Jmeno mapy
-	std::string mMapFile; ///< Soubor s mapou
-	int mToDestroy; ///< Pocet kosticek ktere se jeste musi znicit
-	std::vector<Brick*> mCombosToDestroy; ///< Komba ktera se maji znicit (nemuzou se znicit v posluchaci)
 
 	SDL_Cursor *mNormalCursor; ///< Normalni kurzor
 	SDL_Cursor *mChargingCursor; ///< Kurzor pri nabijeni
 
 	static float GameOverTime; ///< Cas po ktery se zobrazuje hlaska Game over
 	static float SuccesTime; ///< Cas po ktery se zobrazuje Succes
-	static float ChargingTime; ///< Cas po ktery se nabiji
-	static float ExplosionForce; ///< Sila vybuchu TNT
-	static float ExplosionLimit; ///< Pri jake sile vybuchu vybuchne dalsi krabice
+	static int MaxCatchUpSteps; ///< Nejvic kroku fyziky na jeden snimek
 
 	/** Nastavi OpenGL.
 	* Nastavi OpenGL podle mScreen.
@@ -84,10 +75,44 @@ class Game {
 	*/
 	b2Vec2 windowToWorld(int x, int y);
 
+	/** Zavola glVertex2f pro vsechny vertexy v prvnim tvaru telesa (uzitecne
+	 * pri kresleni)
+	 *
+	 * @param body Teleso
+	 * @warning Je nutno nejdrive zavolat glBegin()!
+	 */
+	void drawVertices(const b2Body *body);
+
+	/** Nakresli pekne objekt.
+	 * Nakresli prvni tvar v telese objektu barvou GameObject::color()
+	 *
+	 * @param object Objekt ktery se ma nakreslit
+	 * @param alpha Kde mezi poslednimi dvema kroky fyziky se ma objekt nakreslit
+	 * (viz GameObject::position())
+	 */
+	void drawObject(GameObject *object, float alpha);
+
 	/** Vykreslovani.
-	* Vykresli vsechna telesa pomoci jejich metod draw()
+	* Vykresli vsechna telesa pomoci drawObject()
+	*
+	* @param alpha Kolik casu z dalsiho kroku fyziky uz ubehlo (0 az 1)
 	*/
-	void draw();
+	void draw(float alpha);
+
+	/** Vykresli statistiky posledniho snimku (mLastStats) do leveho horniho
+	 * rohu.
+	 */
+	void drawStats();
+
+	/** Krok fyziky.
+	 * Zapamatuje si pozice vsech objektu (pro vykreslovani mezi kroky) a
+	 * provede jeden krok urovne. Dokud cely svet spi, pozice se nezapamatovavaji
+	 * a snimek se nemusi znovu vykreslit.
+	 *
+	 * @return false pokud uz hra skoncila (hlaska o vyhre nebo prohre se
+	 * zobrazovala dost dlouho)
+	 */
+	bool step();
 
 	/** Zpracovani udalosti.
 	* Zpracuje vsechny udalosti 
@@ -119,36 +144,6 @@ class Game {
 	 */
 	void mouseClicked(Uint8 button, int x, int y);
 
-	/** Nacteni mapy.
-	 * Nacte mapu z JSON souboru v mMapName a vytvori svet (mWorld)
-	 */
-	void loadMap();
-
-	/** Smazani mapy.
-	 * Smaze celou mapu
-	 */
-	void deleteMap();
-
-	/** Znici kostky ktere nejdou videt.
-	 * Znici vsechny kostky ktere nejdou videt
-	 */
-	void deleteInvisible();
-
-	/** Znici kostku.
-	 * Znici kostku, pokud je to TNT tak ji i odpali.
-	 */
-	void destroyBrick(Brick *brick);
-
-	/** Udela vybuch.
-	 * Udela vybuch predane kostky (mela by mit type() == Brick::TNT). Nemaze ji,
-	 * o to se postara volajici.
-	 *
-	 * @param position Pozice vybuchu
-	 * @param bombMass Hmotnost vybusniny (sila vybuchu)
-	 * @warning Muzou vybouchnout i jine kostky!
-	 */
-	void makeExplosion(const b2Vec2 &position, float bombMass);
-
 public:
 	/** Inicializuje hru.
 		* 
@@ -164,44 +159,91 @@ public:
 	~Game();
 
 	/** Rozbehne hru.
-	* Rozbehne hlavni herni smycku
+	* Rozbehne hlavni herni smycku. Fyzika bezi pevnym krokem (fps()) nezavisle
+	* na vykreslovani: kazdy snimek se provede tolik kroku, kolik jich od
+	* minuleho snimku melo probehnout (nejvys MaxCatchUpSteps, zbytek se
+	* zahodi), a telesa se vykresli mezi poslednimi dvema kroky. Pokud neni
+	* smycka casovana, kazdy snimek je jeden krok a provadi se tak rychle jak
+	* to jde (uzitecne pro mereni vykonu).
+	*
+	* Casovana smycka vykresluje s frekvenci monitoru, snimky casuje cekani na
+	* synchronizaci (SDL_GL_SWAP_CONTROL) v SDL_GL_SwapBuffers(). Pokud je
+	* nastavena frameRate() nebo synchronizace neni zapnuta, spi (FrameClock)
+	* do dalsiho snimku podle frameRate(), pripadne fps(). Snimky ktere se
+	* nevykresluji (nic se nedeje) vzdy uspava FrameClock. Na konci vypise
+	* zmeskane snimky.
+	*
+	* @param paced Ma se smycka casovat podle fps()?
 	*/
-	void run();
+	void run(bool paced = true);
 
 	/** Frekvence herni smycky.
 	 * @return Frekvenci herni smycky (hz)
 	 */
-	float fps() { return 1.0/mStepTime; }
+	float fps() { return 1.0/mLevel.stepTime(); }
 
 	/** Nastavi frekvenci herni smycky.
 	 * @param f Nova frekvence herni smycky (hz)
 	 */ 
-	void fps(float f) { mStepTime = 1.0/f; }
+	void fps(float f) { mLevel.stepTime(1.0/f); }
+
+	/** Frekvence vykreslovani.
+	 * @return Kolikrat za sekundu se vykresli snimek (hz), 0 = s frekvenci
+	 * monitoru
+	 */
+	float frameRate() { return mFrameRate; }
+
+	/** Nastavi frekvenci vykreslovani.
+	 * Fyzika bezi dal s frekvenci fps(), vykresluje se interpolovane.
+	 *
+	 * @param f Nova frekvence (hz), 0 = s frekvenci monitoru
+	 */
+	void frameRate(float f) { mFrameRate = f; }
+
+	/** Zapisuje statistiky kazdeho snimku do souboru.
+	 * @param file Soubor (.csv nebo .json, viz StatsWriter)
+	 * @throw std::runtime_error Soubor nejde otevrit
+	 */
+	void statsFile(const std::string &file);
+
+	/** Zobrazi nebo skryje statistiky snimku (prepina se i klavesou F3) */
+	void showStats(bool show) { mShowStats = show; }
 
 	/** Vrati pocet iteraci ktere se maji pouzit v Box2D.
 	 * @return Pocet iteraci
 	 */
-	int iterations() { return mIterations; }
+	int iterations() { return mLevel.iterations(); }
 
 	/** Nastavi pocet iteraci ktere se maji pouzit v Box2D.
 	 * @param i Novy pocet iteraci
 	 */
-	void iterations(int i) { mIterations = i; }
+	void iterations(int i) { mLevel.iterations(i); }
+
+	/** Vrati pocet vlaken pro reseni fyziky (Level::threads()) */
+	int threads() { return mLevel.threads(); }
+
+	/** Nastavi pocet vlaken pro reseni fyziky (Level::threads()) */
+	void threads(int count) { mLevel.threads(count); }
 
 	/** Hrac prohral.
 	 * Hra zobrazi upozorneni a skonci protoze hrac prohral 
 	 */
-	void lost() { mLost = true; }
+	void lost() { mLevel.lose(); }
 
 	/** Pozastaveni hry.
 	 * Hra se pozastavi - vykresluje se, ale nehybe
 	 */
-	void pause() { mPaused = true; }
+	void pause() { mLevel.pause(); }
 
 	/** Rozbehnuti hry.
 	 * Pokud je hra pozastavena, rozbehne se
 	 */
-	void play() { mPaused = false; }
+	void play() { mLevel.play(); }
+
+	/** Zaznam posledni hry.
+	 * Zaznamenava se od zacatku run() do jeho konce.
+	 */
+	const Replay &replay() const { return mReplay; }
 };
 
 #endif
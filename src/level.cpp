@@ -0,0 +1,473 @@
+/** @file level.cpp
+ * @brief Implementace tridy Level
+ * @see Level
+ */
+#include <cassert>
+#include <Box2D.h>
+#include <sstream>
+#include <string>
+#include <fstream>
+#include <stdexcept>
+#include "level.hpp"
+#include "contacts.hpp"
+#include "objects.hpp"
+#include "json/parser.hpp"
+#include "json/exceptions.hpp"
+
+float Level::ChargingTime = 1.0;
+float Level::ExplosionForce = 200.0;
+float Level::ExplosionLimit = 0.5;
+
+void Level::loadMap()
+{
+	/* inicializace sveta */
+	b2AABB worldAABB;
+	worldAABB.lowerBound.Set(-100.0, -100.0);
+	worldAABB.upperBound.Set(100.0, 100.0);
+	b2Vec2 gravity(0.0f, -10.0f);
+	mWorld = new b2World(worldAABB, gravity, true, e_sweepAndPruneBroadPhase, &mArena);
+	mContactListener = new ContactListener(this);
+	mWorld->SetContactListener(mContactListener);
+
+	/* podlozka */
+	new Ground(mWorld, b2Vec2(0.0, -2.5), 80.0, 5.0);
+
+	/* nacteni dat z JSON */
+	std::ifstream mapFile(mMapFile.c_str());
+	if(!mapFile) {
+		std::stringstream s;
+		s << "Unable to open file " << mMapFile;
+		throw std::runtime_error(s.str());
+	}
+
+	json::Value root = mParser.parse(mapFile);
+	mMapName = root["name"].str();
+	mToDestroy = root["destroy"].num();
+
+	/* kostky */
+	json::Array bricks = root["bricks"].ary();
+	json::Array::const_iterator brick;
+	/* pro kazdou kosticku v poli kosticek */
+	for(brick = bricks.begin(); brick != bricks.end(); brick++) {
+		json::Array b = brick->ary();
+
+		/* pozice a rozmery kosticky */
+		float x = b[1].num();
+		float y = b[2].num();
+		float w = b[3].num();
+		float h = b[4].num();
+
+		/* typ kosticky (pismenko) */
+		json::String typeId = b[0].str();
+		Brick::Type type;
+		if(typeId == "n")
+			type = Brick::Normal;
+		else if(typeId == "d")
+			type = Brick::Dark;
+		else if(typeId == "c")
+			type = Brick::Combo;
+		else if(typeId == "s")
+			type = Brick::Slippy;
+		else if(typeId == "g")
+			type = Brick::Gummy;
+		else if(typeId == "x")
+			type = Brick::TNT;
+		else {
+			std::stringstream s;
+			s << "Bad brick type '" << typeId << "'";
+			throw json::DataError(s.str());
+		}
+
+		new Brick(mWorld, b2Vec2(x, y), w, h, type);
+	}
+
+	/* buzci */
+	json::Array idols = root["idols"].ary();
+	json::Array::const_iterator idol;
+	for(idol = idols.begin(); idol != idols.end(); idol++) {
+		/* prvni prvek pole s buzkem je pozice */
+		b2Vec2 pos;
+		pos.x = (*idol)[0][0].num();
+		pos.y = (*idol)[0][1].num();
+
+		/* ostatni jsou vertexy */
+		std::vector<b2Vec2> vertices;
+		json::Array::size_type i;
+		for(i = 1; i != idol->ary().size(); i++) {
+			b2Vec2 vertex;
+			vertex.x = (*idol)[i][0].num();
+			vertex.y = (*idol)[i][1].num();
+			vertices.push_back(vertex);
+		}
+
+		mIdols.push_back(new Idol(mWorld, pos, vertices));
+	}
+}
+
+void Level::deleteMap()
+{
+	/* smazani vsech objektu */
+	b2Body *body;
+	b2Body *next;
+	for(body = mWorld->GetBodyList(); body != NULL; body = next) {
+		next = body->GetNext();
+		delete static_cast<GameObject*>(body->GetUserData());
+	}
+
+	delete mWorld;
+	delete mContactListener;
+	mArena.Reset();
+	mIdols.clear();
+	mCombosToDestroy.clear();
+
+	mWorld = NULL;
+	mContactListener = NULL;
+}
+
+void Level::deleteInvisible()
+{
+	b2Shape *shapes[mMaxShapes];
+
+	int shapeCount = mWorld->Query(mCamera, shapes, mMaxShapes);
+
+	/* s velikou pravdepodobnosti se do pole nevesly vsechny tvary */
+	if(shapeCount == mMaxShapes) {
+		mMaxShapes *= 2; // proto se musi predpokladat ze jich je vic
+		deleteInvisible();
+	} else {
+		/* oznaceni vsech viditelnych */
+		register int i;
+		for(i=0; i!=shapeCount; i++) {
+			GameObject *object = static_cast<GameObject*>(shapes[i]->GetBody()->GetUserData());
+			object->isVisible = true;
+		}
+
+		/* smazani neviditelnych */
+		b2Body *body;
+		for(body = mWorld->GetBodyList(); body != NULL; ) {
+			GameObject *object = static_cast<GameObject*>(body->GetUserData());
+			body = body->GetNext(); // pozdeji by uz teleso mohlo byt smazane
+
+			if(!object) {
+				continue; // preskocime neznama telesa
+			}
+
+			if(!object->isVisible) {
+				Brick *brick = dynamic_cast<Brick*>(object);
+				if(brick) {
+					/* znici se i kosticka kterou uzivatel znicit nesmi, ale nebude se
+					 * pocitat (vyjimka je kombo, to na canDestroy() vraci false ale
+					 * budeme ho nicit) */
+					if(brick->canDestroy() or brick->type() == Brick::Combo) {
+						destroyBrick(brick);
+						continue;
+					}
+				} else if(dynamic_cast<Idol*>(object)) {
+					/* buzek smazan - prohra */
+					mLost = true;
+				}
+
+				delete object;
+			} else {
+				object->isVisible = false; // kvuli dalsi kontrole
+			}
+		}
+	}
+}
+
+void Level::destroyBrick(Brick *brick)
+{
+	b2Vec2 pos = brick->body()->GetWorldCenter();
+	float bombMass = brick->body()->GetMass();
+	Brick::Type brickType = brick->type();
+
+	delete brick;
+	if(--mToDestroy <= 0) {
+		mChecking = true;
+	}
+
+	if(brickType == Brick::TNT) {
+		makeExplosion(pos, bombMass);
+	}
+}
+
+void Level::makeExplosion(const b2Vec2 &position, float bombMass)
+{
+	const float size = ExplosionForce * bombMass;
+
+	b2Body *body;
+	for(body = mWorld->GetBodyList(); body != NULL; body = body->GetNext() ) {
+		b2Vec2 force = body->GetWorldCenter() - position;
+		float len = force.Length();
+		force.Normalize();
+		force *= size / len;
+
+		body->ApplyForce(force, body->GetWorldCenter());
+	}
+}
+
+void Level::checkVictory()
+{
+	if(!mChecking or mLost)
+		return;
+
+	/* pokud jsou vsichni buzci v klidu, skonci se kontrola */
+	if(idolsSleeping()) {
+		mChecking = false;
+		mWin = true;
+	}
+}
+
+bool Level::idolsSleeping() const
+{
+	/* spici svet nema ani zadne vzhuru buzky */
+	if(mWorld->IsAsleep())
+		return true;
+
+	std::vector<Idol*>::const_iterator id;
+	for(id = mIdols.begin(); id != mIdols.end(); id++) {
+		if(!(*id)->body()->IsSleeping())
+			return false;
+	}
+	return true;
+}
+
+Level::Level(std::string map):
+	mWorld(NULL),
+	mContactListener(NULL),
+	mStepTime(1.0/60.0),
+	mIterations(15),
+
+	mLost(false),
+	mChecking(false),
+	mWin(false),
+	mPaused(false),
+	mCharging(false),
+	mChargingTime(0.0),
+	mSteps(0),
+	mDeleteInvisibleTime(0.0),
+	mIdle(false),
+
+	mMapFile(map),
+	mToDestroy(0),
+	mMaxShapes(64)
+{
+	/* viditelna oblast */
+	mCamera.lowerBound.Set(-16.0, -2.0);
+	mCamera.upperBound.Set(16.0, 20.0);
+
+	try {
+		loadMap();
+	} catch(json::Exception e) {
+		/* chyba v jsonu se jen vyhodi vys */
+		std::stringstream s;
+		s << "Error in file " << map << ": " << e.what() << std::endl;
+		throw std::runtime_error(s.str());
+	}
+
+	save(mInitial);
+}
+
+Level::~Level()
+{
+	if(mWorld)
+		deleteMap();
+}
+
+void Level::reset()
+{
+	/* pozastaveni neni soucasti mapy, restart ho nemeni */
+	bool paused = mPaused;
+	restore(mInitial);
+	mPaused = paused;
+}
+
+void Level::save(LevelState &state)
+{
+	if(!mWorld->Save(&state.mWorld))
+		throw std::runtime_error("Unable to save the world (joints are not supported)");
+
+	/* zapamatuje se co je ktere teleso, userData po obnoveni neplati */
+	state.mObjects.clear();
+	b2Body *body;
+	for(body = mWorld->GetBodyList(); body != NULL; body = body->GetNext()) {
+		GameObject *object = static_cast<GameObject*>(body->GetUserData());
+		LevelState::Object info;
+		info.kind = LevelState::Object::None;
+		info.type = Brick::Normal;
+
+		if(Brick *brick = dynamic_cast<Brick*>(object)) {
+			info.kind = LevelState::Object::BrickObject;
+			info.type = brick->type();
+		} else if(dynamic_cast<Idol*>(object)) {
+			info.kind = LevelState::Object::IdolObject;
+		} else if(dynamic_cast<Ground*>(object)) {
+			info.kind = LevelState::Object::GroundObject;
+		}
+
+		state.mObjects.push_back(info);
+	}
+
+	state.mLost = mLost;
+	state.mChecking = mChecking;
+	state.mWin = mWin;
+	state.mPaused = mPaused;
+	state.mCharging = mCharging;
+	state.mChargingTime = mChargingTime;
+	state.mToDestroy = mToDestroy;
+	state.mSteps = mSteps;
+}
+
+void Level::restore(const LevelState &state)
+{
+	/* stare objekty se smazou, telesa smaze az b2World::Restore() */
+	b2Body *body;
+	for(body = mWorld->GetBodyList(); body != NULL; body = body->GetNext()) {
+		GameObject *object = static_cast<GameObject*>(body->GetUserData());
+		if(object) {
+			object->detach();
+			delete object;
+		}
+	}
+	mIdols.clear();
+	mCombosToDestroy.clear();
+
+	if(!mWorld->Restore(&state.mWorld))
+		throw std::runtime_error("Unable to restore the world (empty state or joints)");
+
+	/* a k obnovenym telesum se vytvori nove objekty */
+	std::vector<LevelState::Object>::const_iterator info = state.mObjects.begin();
+	for(body = mWorld->GetBodyList(); body != NULL; body = body->GetNext(), info++) {
+		switch(info->kind) {
+			case LevelState::Object::BrickObject:
+				new Brick(body, info->type);
+				break;
+			case LevelState::Object::IdolObject:
+				mIdols.push_back(new Idol(body));
+				break;
+			case LevelState::Object::GroundObject:
+				new Ground(body);
+				break;
+			default:
+				body->SetUserData(NULL);
+		}
+	}
+
+	mLost = state.mLost;
+	mChecking = state.mChecking;
+	mWin = state.mWin;
+	mPaused = state.mPaused;
+	mCharging = state.mCharging;
+	mChargingTime = state.mChargingTime;
+	mToDestroy = state.mToDestroy;
+	mSteps = state.mSteps;
+	mIdle = false;
+}
+
+bool Level::destroyAt(const b2Vec2 &pos)
+{
+	/* kostky se nici jen kdyz se nenabiji */
+	if(mCharging)
+		return false;
+
+	/* tento kousek kodu je prevzat z prikladu k Box2D (TestBed) */
+	/* hledani prvniho telesa na pozici pos */
+	b2AABB aabb;
+	b2Vec2 a;
+	a.Set(b2_linearSlop, b2_linearSlop);
+	aabb.lowerBound = pos - a;
+	aabb.upperBound = pos + a;
+
+	b2Body *body = NULL;
+	const size_t maxCount = 10;
+	b2Shape *shapes[maxCount];
+	int32 count = mWorld->Query(aabb, shapes, maxCount);
+	for (int32 i = 0; i < count; ++i) {
+		b2Body *shapeBody = shapes[i]->GetBody();
+		if(!shapeBody->IsStatic()) {
+			if(shapes[i]->TestPoint(shapeBody->GetXForm(), pos)) {
+				body = shapes[i]->GetBody();
+				break;
+			}
+		}
+	}
+
+	if(!body)
+		return false;
+
+	/* nici se jen kostky a jen ty u kterych muzeme */
+	GameObject *object = static_cast<GameObject*>(body->GetUserData());
+	Brick *brick = dynamic_cast<Brick*>(object);
+	if(!brick or !brick->canDestroy())
+		return false;
+
+	destroyBrick(brick);
+	mCharging = true;
+	return true;
+}
+
+std::vector<b2Vec2> Level::destroyableBricks()
+{
+	std::vector<b2Vec2> positions;
+
+	b2Body *body;
+	for(body = mWorld->GetBodyList(); body != NULL; body = body->GetNext()) {
+		GameObject *object = static_cast<GameObject*>(body->GetUserData());
+		Brick *brick = dynamic_cast<Brick*>(object);
+		if(brick and brick->canDestroy())
+			positions.push_back(body->GetWorldCenter());
+	}
+
+	return positions;
+}
+
+void Level::step()
+{
+	mSteps++;
+	checkVictory();
+
+	if(mCharging and not mPaused) {
+		mChargingTime += mStepTime;
+		if(mChargingTime > ChargingTime) {
+			mCharging = false;
+			mChargingTime = 0.0;
+		}
+	}
+
+	if(mPaused)
+		return;
+
+	/* kdyz vsechno spi, nic se nepohne ani nedostane mimo obrazovku */
+	mIdle = mWorld->IsAsleep();
+	if(mIdle) {
+		mDeleteInvisibleTime = 0.0;
+		return;
+	}
+
+	mWorld->Step(mStepTime, mIterations);
+
+	/* znici se kombo kostky ktere se znicit maji */
+	if(mCombosToDestroy.size() > 0) {
+		std::vector<Brick*>::iterator combo;
+		for(combo = mCombosToDestroy.begin();
+				combo != mCombosToDestroy.end();
+				combo++) {
+			delete *combo;
+			if(--mToDestroy <= 0)
+				mChecking = true;
+		}
+		mCombosToDestroy.clear();
+	}
+
+	b2Timer timer;
+	deleteInvisible();
+	mDeleteInvisibleTime = timer.GetMilliseconds();
+}
+
+int Level::simulate(int maxSteps)
+{
+	int steps;
+	for(steps = 0; steps < maxSteps and not finished(); steps++)
+		step();
+	return steps;
+}
@@ -0,0 +1,292 @@
+#ifndef have_level_hpp
+#define have_level_hpp
+/** @file level.hpp
+ * @brief Hlavickovy soubor pro tridu Level
+ * @see Level
+ */
+#include <Box2D.h>
+#include <vector>
+#include <string>
+#include "objects.hpp"
+#include "json/parser.hpp"
+
+class ContactListener;
+
+/** Ulozeny stav urovne.
+ * Obsahuje stav fyziky (b2WorldSnapshot) i pravidel (nabijeni, pocet kosticek
+ * ke zniceni, ...). Vytvari se pomoci Level::save() a obnovuje pomoci
+ * Level::restore(). Jeden stav jde obnovit kolikrat je potreba a do kterekoli
+ * instance stejne mapy, proto se hodi napr. pro vetveni pri hledani reseni.
+ */
+class LevelState {
+	friend class Level;
+
+	/** Co predstavuje jedno teleso ve svete */
+	struct Object {
+		/** Druh objektu */
+		enum Kind {
+			None, ///< Teleso bez objektu (zemske teleso Box2D)
+			GroundObject, ///< Ground
+			BrickObject, ///< Brick
+			IdolObject ///< Idol
+		};
+
+		Kind kind; ///< Druh objektu
+		Brick::Type type; ///< Typ kosticky (jen pro BrickObject)
+	};
+
+	b2WorldSnapshot mWorld; ///< Stav sveta
+	std::vector<Object> mObjects; ///< Objekty v poradi seznamu teles
+
+	bool mLost; ///< Prohral hrac?
+	bool mChecking; ///< Kontroluje se vyhra?
+	bool mWin; ///< Vyhral hrac?
+	bool mPaused; ///< Je hra pozastavena?
+	bool mCharging; ///< Nabiji se?
+	float mChargingTime; ///< Jak dlouho se uz nabiji
+	int mToDestroy; ///< Pocet kosticek ktere se jeste musi znicit
+	int mSteps; ///< Pocet kroku od nacteni nebo restartu
+
+	/* stav je velky, kopirovat se nema */
+	LevelState(const LevelState &);
+	void operator=(const LevelState &);
+
+public:
+	/** Prazdny stav, naplni ho Level::save() */
+	LevelState() { }
+
+	/** Velikost stavu v bajtech */
+	int size() const { return mWorld.GetByteCount() + mObjects.size() * sizeof(Object); }
+};
+
+/** Jadro urovne.
+ * Obsahuje fyziku a pravidla jedne urovne (nacteni mapy, krokovani sveta,
+ * niceni kosticek, komba, kontrolu vyhry), ale nic nevykresluje a nepotrebuje
+ * SDL ani OpenGL. Da se tak simulovat i bez obrazovky, napr. pri davkove
+ * kontrole map.
+ */
+class Level {
+	friend class ContactListener;
+
+	b2AABB mCamera; ///< Viditelna oblast, kostky mimo ni se nici
+
+	b2ArenaAllocator mArena; ///< Pamet sveta, po smazani sveta se uvolni naraz
+	b2World *mWorld; ///< Svet
+	ContactListener *mContactListener; ///< Posluchac kontaktu
+	float mStepTime; ///< Cas jednoho kroku
+	int mIterations; ///< Pocet iteraci pro Box2D
+
+	bool mLost; ///< Prohral hrac?
+	bool mChecking; ///< Kontroluje se vyhra?
+	bool mWin; ///< Vyhral hrac?
+	bool mPaused; ///< Je hra pozastavena?
+	bool mCharging; ///< Nabiji se?
+	float mChargingTime; ///< Jak dlouho se uz nabiji
+	int mSteps; ///< Pocet kroku od nacteni nebo restartu
+	float mDeleteInvisibleTime; ///< Jak dlouho trvalo deleteInvisible() v poslednim kroku (ms)
+	bool mIdle; ///< Preskocil posledni krok fyziku, protoze cely svet spal?
+	LevelState mInitial; ///< Stav hned po nacteni mapy, obnovuje ho reset()
+	std::vector<Idol*> mIdols; ///< Vsichni buzci ve hre
+
+	json::Parser mParser; ///< Parser na JSON
+	std::string mMapName; ///< Jmeno mapy
+	std::string mMapFile; ///< Soubor s mapou
+	int mToDestroy; ///< Pocet kosticek ktere se jeste musi znicit
+	std::vector<Brick*> mCombosToDestroy; ///< Komba ktera se maji znicit (nemuzou se znicit v posluchaci)
+	int mMaxShapes; ///< Velikost pole pro dotaz v deleteInvisible()
+
+	/** Nacteni mapy.
+	 * Nacte mapu z JSON souboru v mMapFile a vytvori svet (mWorld)
+	 */
+	void loadMap();
+
+	/** Smazani mapy.
+	 * Smaze celou mapu
+	 */
+	void deleteMap();
+
+	/** Znici kostky ktere nejdou videt.
+	 * Znici vsechny kostky ktere jsou mimo mCamera
+	 */
+	void deleteInvisible();
+
+	/** Znici kostku.
+	 * Znici kostku, pokud je to TNT tak ji i odpali.
+	 */
+	void destroyBrick(Brick *brick);
+
+	/** Udela vybuch.
+	 * Udela vybuch predane kostky (mela by mit type() == Brick::TNT). Nemaze ji,
+	 * o to se postara volajici.
+	 *
+	 * @param position Pozice vybuchu
+	 * @param bombMass Hmotnost vybusniny (sila vybuchu)
+	 * @warning Muzou vybouchnout i jine kostky!
+	 */
+	void makeExplosion(const b2Vec2 &position, float bombMass);
+
+	/** Kontrola vyhry.
+	 * Pokud se kontroluje vyhra a vsichni buzci jsou v klidu, hrac vyhral
+	 */
+	void checkVictory();
+
+public:
+	static float ChargingTime; ///< Cas po ktery se nabiji
+	static float ExplosionForce; ///< Sila vybuchu TNT
+	static float ExplosionLimit; ///< Pri jake sile vybuchu vybuchne dalsi krabice
+
+	/** Nacte uroven.
+	 *
+	 * @param map Cesta k JSON souboru s mapou
+	 * @throw std::runtime_error Chyba pri nacitani mapy
+	 */
+	Level(std::string map);
+
+	/** Smaze uroven */
+	~Level();
+
+	/** Jeden krok hry.
+	 * Zkontroluje vyhru, posune nabijeni a pokud neni hra pozastavena, posune
+	 * svet o mStepTime a znici komba a neviditelne kostky.
+	 */
+	void step();
+
+	/** Simulace bez vykreslovani.
+	 * Krokuje uroven tak rychle jak to jde, dokud hrac nevyhraje, neprohraje
+	 * nebo neubehne maxSteps kroku.
+	 *
+	 * @param maxSteps Nejvetsi pocet kroku
+	 * @return Pocet provedenych kroku
+	 */
+	int simulate(int maxSteps);
+
+	/** Zniceni kosticky na pozici.
+	 * Znici kosticku na dane pozici ve svete, pokud to jde (neni nabijeni a
+	 * kosticka je znicitelna).
+	 *
+	 * @param pos Pozice ve svete
+	 * @return true pokud se kosticka znicila
+	 */
+	bool destroyAt(const b2Vec2 &pos);
+
+	/** Pozice kosticek ktere muze hrac znicit.
+	 * Vrati stred kazde kosticky, kterou by slo znicit pomoci destroyAt(), v
+	 * poradi seznamu teles ve svete.
+	 */
+	std::vector<b2Vec2> destroyableBricks();
+
+	/** Ulozi stav urovne.
+	 * Nesmi se volat behem step() (napr. z posluchace kontaktu).
+	 *
+	 * @param state Kam se stav ulozi (jeho pamet se pouzije znovu)
+	 * @throw std::runtime_error Svet nejde ulozit (ma klouby)
+	 */
+	void save(LevelState &state);
+
+	/** Obnovi stav urovne.
+	 * Vsechny objekty se vytvori znovu, takze drive ziskane ukazatele (napr.
+	 * z idols()) prestanou platit.
+	 *
+	 * @param state Stav ulozeny pomoci save() z teto nebo jine instance stejne
+	 * mapy
+	 * @throw std::runtime_error Prazdny stav nebo svet s klouby
+	 */
+	void restore(const LevelState &state);
+
+	/** Restart urovne.
+	 * Obnovi stav ulozeny hned po nacteni mapy. Soubor s mapou se znovu
+	 * necte a svet se nevytvari znovu, pouzije se pamet kterou uz ma
+	 * (viz b2World::Restore()). Pozastaveni hry (paused()) zustava.
+	 */
+	void reset();
+
+	/** Svet */
+	b2World *world() { return mWorld; }
+
+	/** Viditelna oblast */
+	const b2AABB &camera() const { return mCamera; }
+
+	/** Jmeno mapy */
+	const std::string &mapName() const { return mMapName; }
+
+	/** Soubor s mapou */
+	const std::string &mapFile() const { return mMapFile; }
+
+	/** Pocet volani step() od nacteni nebo restartu urovne.
+	 * Podle nej se radi udalosti v zaznamu hry (Replay).
+	 */
+	int steps() const { return mSteps; }
+
+	/** Jak dlouho v poslednim kroku trvalo mazani teles mimo obrazovku (ms).
+	 * Cas samotne fyziky je v b2World::GetProfile().
+	 */
+	float deleteInvisibleTime() const { return mDeleteInvisibleTime; }
+
+	/** Preskocil posledni krok fyziku?
+	 * Kdyz cely svet spi (b2World::IsAsleep()), krok by nic nezmenil, takze
+	 * se pocitaji jen pravidla (nabijeni, kontrola vyhry).
+	 */
+	bool idle() const { return mIdle; }
+
+	/** Pocet kosticek ktere se jeste musi znicit */
+	int toDestroy() const { return mToDestroy; }
+
+	/** Vsichni buzci ve hre */
+	const std::vector<Idol*> &idols() const { return mIdols; }
+
+	/** Cas jednoho kroku (v sekundach) */
+	float stepTime() const { return mStepTime; }
+
+	/** Nastavi cas jednoho kroku (v sekundach) */
+	void stepTime(float t) { mStepTime = t; }
+
+	/** Vrati pocet iteraci ktere se maji pouzit v Box2D. */
+	int iterations() const { return mIterations; }
+
+	/** Nastavi pocet iteraci ktere se maji pouzit v Box2D. */
+	void iterations(int i) { mIterations = i; }
+
+	/** Pocet vlaken na kterych Box2D resi ostrovy teles */
+	int threads() const { return mWorld->GetThreadCount(); }
+
+	/** Nastavi pocet vlaken na kterych Box2D resi ostrovy teles.
+	 * Simulace na poctu vlaken nezavisi, zaznamy her se prehraji stejne.
+	 */
+	void threads(int count) { mWorld->SetThreadCount(count); }
+
+	/** Prohral hrac? */
+	bool lost() const { return mLost; }
+
+	/** Vyhral hrac? */
+	bool won() const { return mWin; }
+
+	/** Kontroluje se vyhra? */
+	bool checking() const { return mChecking; }
+
+	/** Nabiji se? */
+	bool charging() const { return mCharging; }
+
+	/** Je hra pozastavena? */
+	bool paused() const { return mPaused; }
+
+	/** Jsou vsichni buzci v klidu (spi)? */
+	bool idolsSleeping() const;
+
+	/** Skoncila uroven (vyhrou nebo prohrou)? */
+	bool finished() const { return mLost or mWin; }
+
+	/** Hrac prohral. */
+	void lose() { mLost = true; }
+
+	/** Pozastaveni hry.
+	 * Hra se pozastavi - vykresluje se, ale nehybe
+	 */
+	void pause() { mPaused = true; }
+
+	/** Rozbehnuti hry.
+	 * Pokud je hra pozastavena, rozbehne se
+	 */
+	void play() { mPaused = false; }
+};
+
+#endif
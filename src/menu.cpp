@@ -8,6 +8,7 @@
 #include <dirent.h>
 //#include <errno.h>
 #include <cerrno>
+#include <iostream>
 #include <string>
 #include <sstream>
 #include <stdexcept>
@@ -168,7 +169,28 @@ void Menu::runGame()
 	if(mLevelList->getSelected() >= 0) {
 		Game game(mScreen, mDataDir, mDataDir + "/DejaVuSans.ttf", 
 							mLevelsDir + "/" + mLevelListModel->getElementAt(mLevelList->getSelected()));
+		if(std::getenv("TOTEM_DESTROYER_FRAMERATE"))
+			game.frameRate(std::atof(std::getenv("TOTEM_DESTROYER_FRAMERATE")));
+		if(std::getenv("TOTEM_DESTROYER_THREADS"))
+			game.threads(std::atoi(std::getenv("TOTEM_DESTROYER_THREADS")));
+		if(std::getenv("TOTEM_DESTROYER_STATS")) {
+			try {
+				game.statsFile(std::getenv("TOTEM_DESTROYER_STATS"));
+			} catch(std::exception &e) {
+				std::cerr << e.what() << std::endl;
+			}
+		}
 		game.run();
+		mClock.reset(); // doba hry neni zmeskany snimek menu
+
+		/* zaznam hry pro totem-replay */
+		if(std::getenv("TOTEM_DESTROYER_RECORD")) {
+			try {
+				game.replay().save(std::getenv("TOTEM_DESTROYER_RECORD"));
+			} catch(std::exception &e) {
+				std::cerr << e.what() << std::endl;
+			}
+		}
 	}
 }
 
@@ -181,7 +203,7 @@ Menu::Menu():
 	mScreenHeight(600),
 
 	mRunning(false),
-	mFrametime(1000/30),
+	mClock(1.0/30),
 
 	mTop(NULL),
 	mPlay(NULL),
@@ -226,6 +248,7 @@ Menu::Menu():
 
 	/* okno */
 	SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+	SDL_GL_SetAttribute(SDL_GL_SWAP_CONTROL, 1); // hra se vykresluje s frekvenci monitoru
 	mScreen = SDL_SetVideoMode(mScreenWidth, mScreenHeight, 0, SDL_OPENGL | SDL_HWSURFACE | SDL_HWACCEL);
 	if(mScreen == NULL) 
 		throw std::runtime_error(std::string("Unable to set video mode: ") + SDL_GetError());
@@ -281,26 +304,41 @@ Menu::~Menu()
 	TTF_Quit();
 }
 
+void Menu::processEvent(const SDL_Event &event)
+{
+	if(event.type == SDL_QUIT)
+		mRunning = false;
+	else
+		mInput->pushInput(event);
+}
+
 void Menu::run()
 {
 	mRunning = true;
 
-	Uint32 nextTime = SDL_GetTicks();
+	bool first = true; // prvni snimek se vykresli hned, dalsi az po udalosti
 	while(mRunning) {
-		while(SDL_GetTicks() < nextTime)
-			SDL_Delay(1);
-		nextTime += mFrametime;
-
 		SDL_Event event;
-		while(SDL_PollEvent(&event)) {
-			if(event.type == SDL_QUIT)
-				mRunning = false;
-			else
-				mInput->pushInput(event);
+
+		/* kdyz se nic nedeje, nic se neprekresluje a ceka se na udalost */
+		if(!first) {
+			if(!SDL_WaitEvent(&event))
+				throw std::runtime_error(std::string("Error waiting for event: ") + SDL_GetError());
+			processEvent(event);
+			mClock.reset(); // cekani neni zmeskany snimek
 		}
 
-		draw();
+		while(SDL_PollEvent(&event))
+			processEvent(event);
+
 		logic();
+		draw();
 		SDL_GL_SwapBuffers();
+		first = false;
+
+		/* behem pohybu mysi apod. se prekresluje nejvys mClock.period() */
+		mClock.wait();
 	}
+
+	mClock.report(std::cerr, "menu");
 }
@@ -8,6 +8,7 @@
 #include <string>
 #include <vector>
 #include "objects.hpp"
+#include "frameclock.hpp"
 
 /** Trida menu */
 class Menu: protected gcn::Gui, public gcn::ActionListener {
@@ -41,7 +42,10 @@ class Menu: protected gcn::Gui, public gcn::ActionListener {
 	std::string mLevelsDir; ///< Adresar s mapami
 
 	bool mRunning; ///< Bezi menu?
-	Uint32 mFrametime; ///< Cas na jeden ramec v ms
+	FrameClock mClock; ///< Casovani prekreslovani (nejvys 30 snimku za sekundu)
+
+	/** Zpracuje jednu udalost SDL */
+	void processEvent(const SDL_Event &event);
 
 	gcn::Container *mTop; ///< Hlavni kontejner
 	gcn::Button *mPlay; ///< Tlacitko hrat
@@ -77,7 +81,8 @@ public:
 
 	/** Hlavni smycka.
 	 * Spusti hlavni smycku menu, spousti hru kdyz ma a skonci kdyz si to uzivatel
-	 * preje
+	 * preje. Menu se prekresluje jen po nejake udalosti; kdyz se nic nedeje,
+	 * spi v SDL_WaitEvent().
 	 * @throw gcn::Exception Pri chybe v Guichanu
 	 * @throw std::runtime_error Pri jine chybe
 	 */
@@ -12,60 +12,6 @@
 /* Pro komentare viz objects.hpp */
 
 
-void GameObject::drawVertices()
-{
-	b2Shape *shape = mBody->GetShapeList();
-
-	/* teleso bez tvaru se ignoruje */
-	if(!shape)
-		return;
-
-	if(shape->GetType() == e_polygonShape) {
-		/* polygon se zpracuje jednoduse */
-		b2PolygonShape *poly;
-		poly = dynamic_cast<b2PolygonShape*>(shape);
-		assert(poly);
-
-		for(int i=0; i!=poly->GetVertexCount(); i++)
-			glVertex2f(poly->GetVertices()[i].x, poly->GetVertices()[i].y);
-	} else {
-		assert(shape->GetType() == e_circleShape);
-		b2CircleShape *circle;
-		circle = dynamic_cast<b2CircleShape*>(shape);
-		assert(circle);
-		/* kruh se musi spocitat */
-		const int segs = 32; 
-		const float step = 2*M_PI/segs;
-		const float radius = circle->GetRadius();
-
-		for(int i=0; i!=segs; i++)
-			glVertex2f(std::cos(step*i)*radius, std::sin(step*i)*radius);
-	}
-}
-
-void GameObject::drawShape(Color c)
-{
-	glPushMatrix();
-	glTranslatef(mBody->GetPosition().x, mBody->GetPosition().y, 0.0f);
-	glRotatef(mBody->GetAngle()/M_PI*180.0, 0.0f, 0.0f, 1.0f);
-
-	/* nejprve se nakresli obrys */
-	glColor3f(c.r, c.g, c.b);
-	glBegin(GL_LINE_LOOP);
-		drawVertices();
-	glEnd();
-
-	/* a pak vypln */
-	glColor4f(c.r, c.g, c.b, 0.7);
-	glBegin(GL_POLYGON);
-		drawVertices();
-	glEnd();
-
-
-	glPopMatrix();
-}
-
-
 GameObject::GameObject(b2World *world, b2Vec2 position):
 	mWorld(world),
 	isVisible(false)
@@ -76,11 +22,38 @@ GameObject::GameObject(b2World *world, b2Vec2 position):
 	bodyDef.linearDamping = 0.1;
 	bodyDef.angularDamping = 0.1;
 	mBody = mWorld->CreateBody(&bodyDef);
+	rememberPosition();
+}
+
+GameObject::GameObject(b2Body *body):
+	mBody(body),
+	mWorld(body->GetWorld()),
+	isVisible(false)
+{
+	mBody->SetUserData(this);
+	rememberPosition();
 }
 
 GameObject::~GameObject()
 {
-	mWorld->DestroyBody(mBody);
+	if(mBody)
+		mWorld->DestroyBody(mBody);
+}
+
+void GameObject::rememberPosition()
+{
+	mLastPosition = mBody->GetPosition();
+	mLastAngle = mBody->GetAngle();
+}
+
+b2Vec2 GameObject::position(float alpha) const
+{
+	return (1.0f - alpha) * mLastPosition + alpha * mBody->GetPosition();
+}
+
+float GameObject::angle(float alpha) const
+{
+	return (1.0f - alpha) * mLastAngle + alpha * mBody->GetAngle();
 }
 
 float Brick::friction[BricksCount] = {
@@ -129,9 +102,9 @@ Brick::Brick(b2World *world, b2Vec2 position, float width, float height, Type ty
 	mBody->SetMassFromShapes();
 }
 
-void Brick::draw()
+Color Brick::color()
 {
-	drawShape(colors[mType]);
+	return colors[mType];
 }
 
 Ground::Ground(b2World *world, b2Vec2 position, float width, float height):
@@ -144,9 +117,9 @@ Ground::Ground(b2World *world, b2Vec2 position, float width, float height):
 	mBody->CreateShape(&poly);
 }
 
-void Ground::draw()
+Color Ground::color()
 {
-	drawShape(Color(59, 154, 52));
+	return Color(59, 154, 52);
 }
 
 Idol::Idol(b2World *world, b2Vec2 position, const std::vector<b2Vec2> &vertices):
@@ -165,7 +138,7 @@ Idol::Idol(b2World *world, b2Vec2 position, const std::vector<b2Vec2> &vertices)
 	mBody->SetMassFromShapes();
 }
 
-void Idol::draw()
+Color Idol::color()
 {
-	drawShape(Color(244, 224, 0));
+	return Color(244, 224, 0);
 }
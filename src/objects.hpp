@@ -16,18 +16,8 @@ class GameObject {
 protected:
 	b2Body *mBody; ///< prislusne teleso
 	b2World *mWorld; ///< prislusny svet ve kterem teleso je
-
-	/** Zavola glVertex2f pro vsechny vertexy v prvnim tvaru telesa mBody (uzitecne
-	 * pri kresleni)
-	 *
-	 * @warning Je nutno nejdrive zavolat glBegin()!
-	 */
-	void drawVertices();
-
-	/** Nakresli pekne prvni tvar v telese.
-	 * @param c Barva kterou se ma tvar nakreslit
-	 */
-	void drawShape(Color c);
+	b2Vec2 mLastPosition; ///< Pozice telesa pred poslednim krokem
+	float mLastAngle; ///< Natoceni telesa pred poslednim krokem
 public:
 	/** Umisteni telesa do sveta.
 	 * Umisti teleso na urcenou pozici do sveta.
@@ -37,20 +27,50 @@ public:
 	 */
 	GameObject(b2World *world, b2Vec2 position);
 
+	/** Obaleni existujiciho telesa.
+	 * Objekt si prevezme teleso ktere uz ve svete je (napr. po obnoveni stavu
+	 * urovne pomoci b2World::Restore()) a nastavi mu userData.
+	 *
+	 * @param body Teleso
+	 */
+	GameObject(b2Body *body);
+
 	/** Smaze teleso ze sveta.
 	 * Smaze se vcetne sveho b2Body ze sveta
 	 */
 	virtual ~GameObject();
 
-	/** Nakresli teleso.
-	 * Pomoci OpenGL nakresli teleso. Predpoklada ze vzdalenost 1 v OpenGL je 1
-	 * metr
+	/** Barva telesa.
+	 * Barva kterou se teleso vykresluje. Objekty samy nic nekresli, aby se hra
+	 * dala simulovat i bez OpenGL (viz Game::drawObject())
 	 */
-	virtual void draw() = 0;
+	virtual Color color() = 0;
 
 	/** Vrati teleso */
 	const b2Body *body() { return mBody; }
 
+	/** Zapamatuje si pozici telesa.
+	 * Vola se pred kazdym krokem fyziky, aby slo vykreslovat mezi dvema kroky
+	 * (viz position(), angle()).
+	 */
+	void rememberPosition();
+
+	/** Pozice telesa mezi poslednimi dvema kroky.
+	 * @param alpha Kde mezi kroky (0 = pred poslednim krokem, 1 = ted)
+	 */
+	b2Vec2 position(float alpha) const;
+
+	/** Natoceni telesa mezi poslednimi dvema kroky.
+	 * @param alpha Kde mezi kroky (0 = pred poslednim krokem, 1 = ted)
+	 */
+	float angle(float alpha) const;
+
+	/** Odpoji objekt od telesa.
+	 * Destruktor pak teleso ze sveta nemaze, o to se musi postarat nekdo jiny
+	 * (napr. b2World::Restore()).
+	 */
+	void detach() { mBody = NULL; }
+
 	/** Pouzito v Game k mazani neviditelnych teles */
 	bool isVisible; 
 };
@@ -95,13 +115,18 @@ public:
 	 */
 	Brick(b2World *world, b2Vec2 position, float width, float height, Type type);
 
+	/** Obali existujici teleso kosticky.
+	 * @see GameObject::GameObject(b2Body*)
+	 */
+	Brick(b2Body *body, Type type): GameObject(body), mType(type) { }
+
 	/** Je tuto kosticku mozno znicit?
 	 * @return true pokud je kosticka znicitelna, false pokud neni
 	 */
 	bool canDestroy() { return Brick::canDestruct[mType]; }
 
-	/** Nakresli teleso */
-	virtual void draw();
+	/** Barva podle typu kosticky */
+	virtual Color color();
 
 	/** Ziska typ kosticky */
 	Type type() { return mType; }
@@ -120,8 +145,13 @@ public:
 	 */
 	Ground(b2World *world, b2Vec2 position, float width, float height);
 
-	/** Nakresli zem */
-	virtual void draw();
+	/** Obali existujici teleso zeme.
+	 * @see GameObject::GameObject(b2Body*)
+	 */
+	Ground(b2Body *body): GameObject(body) { }
+
+	/** Zelena barva zeme */
+	virtual Color color();
 };
 
 /** Buzek.
@@ -140,8 +170,13 @@ public:
 	 */
 	Idol(b2World *world, b2Vec2 position, const std::vector<b2Vec2> &vertices);
 
-	/** Nakresli buzka */
-	virtual void draw();
+	/** Obali existujici teleso buzka.
+	 * @see GameObject::GameObject(b2Body*)
+	 */
+	Idol(b2Body *body): GameObject(body) { }
+
+	/** Zluta barva buzka */
+	virtual Color color();
 };
 
 #endif
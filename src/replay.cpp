@@ -0,0 +1,313 @@
+/** @file replay.cpp
+ * @brief Implementace tridy Replay
+ * @see Replay
+ */
+#include <Box2D.h>
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <stdexcept>
+#include "replay.hpp"
+#include "level.hpp"
+
+/** Pocatecni hodnota FNV-1a */
+static const unsigned FnvOffset = 2166136261u;
+
+/** Nasobitel FNV-1a */
+static const unsigned FnvPrime = 16777619u;
+
+/** Prida byty do kontrolniho souctu */
+static unsigned hash(unsigned h, const void *data, size_t size)
+{
+	const unsigned char *bytes = static_cast<const unsigned char*>(data);
+	for(size_t i = 0; i != size; i++) {
+		h ^= bytes[i];
+		h *= FnvPrime;
+	}
+	return h;
+}
+
+/** Prida cislo do kontrolniho souctu (bit po bitu, ne hodnotu) */
+static unsigned hash(unsigned h, float f)
+{
+	return hash(h, &f, sizeof(f));
+}
+
+static unsigned hash(unsigned h, int i)
+{
+	return hash(h, &i, sizeof(i));
+}
+
+Replay::Replay():
+	mStepTime(1.0/60.0),
+	mIterations(10),
+	mSteps(0),
+	mChecksum(0)
+{
+}
+
+void Replay::add(Event::Type type, const Level &level, const b2Vec2 &pos)
+{
+	Event event;
+	event.type = type;
+	event.step = level.steps();
+	event.pos = pos;
+	mEvents.push_back(event);
+}
+
+void Replay::start(const Level &level)
+{
+	mMap = level.mapFile();
+	mStepTime = level.stepTime();
+	mIterations = level.iterations();
+	mEvents.clear();
+	mSteps = 0;
+	mChecksum = 0;
+}
+
+void Replay::destroyed(const Level &level, const b2Vec2 &pos)
+{
+	add(Event::Destroy, level, pos);
+}
+
+void Replay::paused(const Level &level)
+{
+	add(Event::Pause, level);
+}
+
+void Replay::played(const Level &level)
+{
+	add(Event::Play, level);
+}
+
+void Replay::reset(const Level &level)
+{
+	add(Event::Reset, level);
+}
+
+void Replay::finish(Level &level)
+{
+	mSteps = level.steps();
+	mChecksum = checksum(level);
+}
+
+bool Replay::play(Level &level) const
+{
+	/* uroven se vrati do stavu po nacteni, stejne jako v Game */
+	level.reset();
+	level.play();
+	level.stepTime(mStepTime);
+	level.iterations(mIterations);
+
+	std::vector<Event>::const_iterator event = mEvents.begin();
+	for(;;) {
+		/* vstupy prisly pred krokem, stejne jako v Game::run() */
+		for(; event != mEvents.end() and event->step == level.steps(); event++) {
+			switch(event->type) {
+				case Event::Destroy:
+					if(!level.destroyAt(event->pos)) {
+						std::stringstream s;
+						s << "Replay diverged at step " << event->step
+							<< ": nothing to destroy at " << event->pos.x << " " << event->pos.y;
+						throw std::runtime_error(s.str());
+					}
+					break;
+				case Event::Pause:
+					level.pause();
+					break;
+				case Event::Play:
+					level.play();
+					break;
+				case Event::Reset:
+					level.reset();
+					break;
+			}
+		}
+
+		if(event != mEvents.end() and event->step < level.steps()) {
+			std::stringstream s;
+			s << "Replay event at step " << event->step << " is out of order";
+			throw std::runtime_error(s.str());
+		}
+
+		if(event == mEvents.end() and level.steps() >= mSteps)
+			break;
+
+		level.step();
+	}
+
+	return checksum(level) == mChecksum;
+}
+
+void Replay::save(const std::string &file) const
+{
+	std::ofstream out(file.c_str());
+	if(!out) {
+		std::stringstream s;
+		s << "Unable to open file " << file;
+		throw std::runtime_error(s.str());
+	}
+
+	save(out);
+
+	if(!out) {
+		std::stringstream s;
+		s << "Error writing file " << file;
+		throw std::runtime_error(s.str());
+	}
+}
+
+void Replay::save(std::ostream &out) const
+{
+	/* 9 platnych cislic staci na presne obnoveni floatu */
+	out << std::setprecision(9);
+	out << "totem-replay 1\n";
+	out << "map " << mMap << "\n";
+	out << "steptime " << mStepTime << "\n";
+	out << "iterations " << mIterations << "\n";
+
+	std::vector<Event>::const_iterator event;
+	for(event = mEvents.begin(); event != mEvents.end(); event++) {
+		out << event->step << " ";
+		switch(event->type) {
+			case Event::Destroy:
+				out << "destroy " << event->pos.x << " " << event->pos.y;
+				break;
+			case Event::Pause:
+				out << "pause";
+				break;
+			case Event::Play:
+				out << "play";
+				break;
+			case Event::Reset:
+				out << "reset";
+				break;
+		}
+		out << "\n";
+	}
+
+	out << "end " << mSteps << " " << std::hex << std::setw(8) << std::setfill('0')
+		<< mChecksum << std::dec << "\n";
+}
+
+void Replay::load(const std::string &file)
+{
+	std::ifstream in(file.c_str());
+	if(!in) {
+		std::stringstream s;
+		s << "Unable to open file " << file;
+		throw std::runtime_error(s.str());
+	}
+
+	try {
+		load(in);
+	} catch(std::runtime_error &e) {
+		std::stringstream s;
+		s << "Error in file " << file << ": " << e.what();
+		throw std::runtime_error(s.str());
+	}
+}
+
+void Replay::load(std::istream &in)
+{
+	std::string line, word;
+	int version = 0;
+
+	std::getline(in, line);
+	std::istringstream header(line);
+	if(!(header >> word >> version) or word != "totem-replay" or version != 1)
+		throw std::runtime_error("not a replay (version 1)");
+
+	mMap.clear();
+	mEvents.clear();
+	mSteps = 0;
+	mChecksum = 0;
+
+	int lineNumber = 1;
+	bool end = false;
+	while(std::getline(in, line)) {
+		lineNumber++;
+		if(line.empty())
+			continue;
+		if(end)
+			throw std::runtime_error("data after end");
+
+		std::istringstream s(line);
+		std::stringstream error;
+		error << "line " << lineNumber << ": " << line;
+
+		if(!(s >> word))
+			continue;
+
+		if(word == "map") {
+			/* jmeno souboru muze obsahovat mezery */
+			std::getline(s >> std::ws, mMap);
+		} else if(word == "steptime") {
+			if(!(s >> mStepTime))
+				throw std::runtime_error(error.str());
+		} else if(word == "iterations") {
+			if(!(s >> mIterations))
+				throw std::runtime_error(error.str());
+		} else if(word == "end") {
+			if(!(s >> mSteps >> std::hex >> mChecksum))
+				throw std::runtime_error(error.str());
+			end = true;
+		} else {
+			Event event;
+			event.pos.SetZero();
+			std::istringstream step(word);
+			if(!(step >> event.step) or !(s >> word))
+				throw std::runtime_error(error.str());
+
+			if(word == "destroy") {
+				event.type = Event::Destroy;
+				if(!(s >> event.pos.x >> event.pos.y))
+					throw std::runtime_error(error.str());
+			} else if(word == "pause") {
+				event.type = Event::Pause;
+			} else if(word == "play") {
+				event.type = Event::Play;
+			} else if(word == "reset") {
+				event.type = Event::Reset;
+			} else {
+				throw std::runtime_error(error.str());
+			}
+
+			mEvents.push_back(event);
+		}
+	}
+
+	if(!end)
+		throw std::runtime_error("missing end");
+	if(mMap.empty())
+		throw std::runtime_error("missing map");
+}
+
+unsigned Replay::checksum(Level &level)
+{
+	unsigned h = FnvOffset;
+
+	b2Body *body;
+	for(body = level.world()->GetBodyList(); body != NULL; body = body->GetNext()) {
+		const b2Vec2 &pos = body->GetPosition();
+		b2Vec2 v = body->GetLinearVelocity();
+		h = hash(h, pos.x);
+		h = hash(h, pos.y);
+		h = hash(h, body->GetAngle());
+		h = hash(h, v.x);
+		h = hash(h, v.y);
+		h = hash(h, body->GetAngularVelocity());
+		h = hash(h, body->IsSleeping() ? 1 : 0);
+	}
+
+	h = hash(h, level.steps());
+	h = hash(h, level.toDestroy());
+	h = hash(h, level.lost() ? 1 : 0);
+	h = hash(h, level.won() ? 1 : 0);
+	h = hash(h, level.checking() ? 1 : 0);
+	h = hash(h, level.charging() ? 1 : 0);
+
+	return h;
+}
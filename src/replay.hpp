@@ -0,0 +1,138 @@
+#ifndef have_replay_hpp
+#define have_replay_hpp
+/** @file replay.hpp
+ * @brief Hlavickovy soubor pro tridu Replay
+ * @see Replay
+ */
+#include <Box2D.h>
+#include <vector>
+#include <string>
+#include <istream>
+#include <ostream>
+#include "level.hpp"
+
+/** Zaznam hry.
+ * Uroven se krokuje pevnym krokem (Level::stepTime()) a je deterministicka,
+ * proto staci zaznamenat jen vstupy hrace: v kterem kroku (Level::steps()) a
+ * kam se kliklo, kdy se hra pozastavila, rozbehla nebo restartovala. Prehrani
+ * zaznamu (play()) pak probehne bez vykreslovani tak rychle jak to jde a na
+ * konci se porovna kontrolni soucet stavu sveta s tim zaznamenanym.
+ *
+ * Zaznam se uklada jako text:
+ * @code
+ * totem-replay 1
+ * map maps/basic.json
+ * steptime 0.016666668
+ * iterations 10
+ * 120 destroy 1.25 3.5
+ * 300 pause
+ * 420 play
+ * 900 reset
+ * end 1500 3a1f09c2
+ * @endcode
+ * Cisla s plovouci carkou se zapisuji na 9 platnych cislic, takze se po
+ * nacteni obnovi bit po bitu.
+ */
+class Replay {
+public:
+	/** Vstup hrace */
+	struct Event {
+		/** Druh vstupu */
+		enum Type {
+			Destroy, ///< Zniceni kosticky (Level::destroyAt())
+			Pause, ///< Pozastaveni hry
+			Play, ///< Rozbehnuti hry
+			Reset ///< Restart urovne
+		};
+
+		Type type; ///< Druh vstupu
+		int step; ///< Krok (Level::steps()) pred kterym vstup prisel
+		b2Vec2 pos; ///< Pozice kliknuti ve svete (jen pro Destroy)
+	};
+
+	Replay();
+
+	/** Zacne novy zaznam.
+	 * Zapamatuje si mapu a parametry simulace urovne a smaze vsechny vstupy.
+	 *
+	 * @param level Zaznamenavana uroven (v pocatecnim stavu)
+	 */
+	void start(const Level &level);
+
+	/** Zaznamena zniceni kosticky.
+	 * Vola se jen pokud Level::destroyAt() kosticku opravdu znicil.
+	 */
+	void destroyed(const Level &level, const b2Vec2 &pos);
+
+	/** Zaznamena pozastaveni hry */
+	void paused(const Level &level);
+
+	/** Zaznamena rozbehnuti hry */
+	void played(const Level &level);
+
+	/** Zaznamena restart urovne. Vola se pred Level::reset(). */
+	void reset(const Level &level);
+
+	/** Ukonci zaznam.
+	 * Zapamatuje si posledni krok a kontrolni soucet stavu urovne.
+	 */
+	void finish(Level &level);
+
+	/** Prehraje zaznam.
+	 * Uroven se restartuje, nastavi se ji parametry ze zaznamu a krokuje se
+	 * (bez vykreslovani) az do posledniho zaznamenaneho kroku.
+	 *
+	 * @param level Uroven se stejnou mapou jako v zaznamu
+	 * @return true pokud kontrolni soucet souhlasi se zaznamem
+	 * @throw std::runtime_error Zaznam neodpovida urovni (kliknuti nic
+	 * neznicilo, kroky nejdou po sobe)
+	 */
+	bool play(Level &level) const;
+
+	/** Ulozi zaznam.
+	 * @throw std::runtime_error Chyba pri zapisu
+	 */
+	void save(const std::string &file) const;
+	void save(std::ostream &out) const;
+
+	/** Nacte zaznam.
+	 * @throw std::runtime_error Chyba pri cteni nebo spatny format
+	 */
+	void load(const std::string &file);
+	void load(std::istream &in);
+
+	/** Kontrolni soucet stavu urovne.
+	 * FNV-1a pres pozice, natoceni a rychlosti vsech teles (v poradi seznamu
+	 * teles) a stav pravidel. Dve urovne se stejnym souctem jsou (skoro jiste)
+	 * bit po bitu stejne.
+	 */
+	static unsigned checksum(Level &level);
+
+	/** Soubor s mapou */
+	const std::string &map() const { return mMap; }
+
+	/** Zmeni soubor s mapou (napr. pri prehravani z jineho adresare) */
+	void map(const std::string &file) { mMap = file; }
+
+	/** Vstupy hrace v poradi v jakem prisly */
+	const std::vector<Event> &events() const { return mEvents; }
+
+	/** Posledni krok zaznamu */
+	int steps() const { return mSteps; }
+
+	/** Kontrolni soucet na konci zaznamu */
+	unsigned finalChecksum() const { return mChecksum; }
+
+private:
+	std::string mMap; ///< Soubor s mapou
+	float mStepTime; ///< Delka kroku simulace
+	int mIterations; ///< Pocet iteraci Box2D
+	std::vector<Event> mEvents; ///< Vstupy hrace
+	int mSteps; ///< Krok (Level::steps()) na konci zaznamu
+	unsigned mChecksum; ///< Kontrolni soucet na konci zaznamu
+
+	/** Prida vstup do zaznamu */
+	void add(Event::Type type, const Level &level, const b2Vec2 &pos = b2Vec2(0.0f, 0.0f));
+};
+
+#endif
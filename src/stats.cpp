@@ -0,0 +1,108 @@
+/** @file stats.cpp
+ * @brief Implementace statistik snimku
+ * @see FrameStats, StatsWriter
+ */
+#include <Box2D.h>
+#include <sstream>
+#include <string>
+#include <stdexcept>
+#include "stats.hpp"
+#include "level.hpp"
+
+FrameStats::FrameStats()
+{
+	clear(0);
+}
+
+void FrameStats::clear(int f)
+{
+	frame = f;
+	steps = idle = 0;
+	collide = solve = solveTOI = deleteInvisible = events = draw = 0.0;
+	bodies = contacts = islands = sleepIslands = awake = colors = uncolored = 0;
+	proxies = pairs = bytes = 0;
+}
+
+void FrameStats::addStep(Level &level)
+{
+	b2World *world = level.world();
+
+	if(level.paused()) {
+		/* pozastavena hra se nepocita */
+	} else if(level.idle()) {
+		idle++;
+		islands = sleepIslands = awake = 0;
+	} else {
+		const b2Profile &profile = world->GetProfile();
+		steps++;
+		collide += profile.collide;
+		solve += profile.solve;
+		solveTOI += profile.solveTOI;
+		deleteInvisible += level.deleteInvisibleTime();
+		islands = profile.islandCount;
+		sleepIslands = profile.sleepIslandCount;
+		awake = profile.awakeBodyCount;
+		colors = profile.colorCount;
+		uncolored = profile.uncoloredCount;
+	}
+
+	bodies = world->GetBodyCount();
+	contacts = world->GetContactCount();
+	proxies = world->GetProxyCount();
+	pairs = world->GetPairCount();
+	bytes = world->GetByteCount();
+}
+
+StatsWriter::StatsWriter(const std::string &file):
+	mOut(file.c_str()),
+	mJson(false),
+	mEmpty(true)
+{
+	if(!mOut) {
+		std::stringstream s;
+		s << "Unable to open file " << file;
+		throw std::runtime_error(s.str());
+	}
+
+	const std::string suffix = ".json";
+	mJson = file.size() >= suffix.size()
+		and file.compare(file.size() - suffix.size(), suffix.size(), suffix) == 0;
+
+	if(mJson)
+		mOut << "[";
+	else
+		mOut << "frame,steps,idle,collide,solve,solveTOI,deleteInvisible,events,draw,"
+			"bodies,contacts,islands,sleepIslands,awake,colors,uncolored,proxies,pairs,bytes\n";
+}
+
+StatsWriter::~StatsWriter()
+{
+	if(mJson)
+		mOut << "\n]\n";
+}
+
+void StatsWriter::write(const FrameStats &s)
+{
+	if(mJson) {
+		mOut << (mEmpty ? "\n" : ",\n")
+			<< "{\"frame\": " << s.frame << ", \"steps\": " << s.steps
+			<< ", \"idle\": " << s.idle
+			<< ", \"collide\": " << s.collide << ", \"solve\": " << s.solve
+			<< ", \"solveTOI\": " << s.solveTOI
+			<< ", \"deleteInvisible\": " << s.deleteInvisible
+			<< ", \"events\": " << s.events << ", \"draw\": " << s.draw
+			<< ", \"bodies\": " << s.bodies << ", \"contacts\": " << s.contacts
+			<< ", \"islands\": " << s.islands << ", \"sleepIslands\": " << s.sleepIslands
+			<< ", \"awake\": " << s.awake << ", \"colors\": " << s.colors
+			<< ", \"uncolored\": " << s.uncolored << ", \"proxies\": " << s.proxies
+			<< ", \"pairs\": " << s.pairs << ", \"bytes\": " << s.bytes << "}";
+	} else {
+		mOut << s.frame << "," << s.steps << "," << s.idle << "," << s.collide << "," << s.solve
+			<< "," << s.solveTOI << "," << s.deleteInvisible << "," << s.events
+			<< "," << s.draw << "," << s.bodies << "," << s.contacts << ","
+			<< s.islands << "," << s.sleepIslands << "," << s.awake << ","
+			<< s.colors << "," << s.uncolored << ","
+			<< s.proxies << "," << s.pairs << "," << s.bytes << "\n";
+	}
+	mEmpty = false;
+}
@@ -0,0 +1,77 @@
+#ifndef have_stats_hpp
+#define have_stats_hpp
+/** @file stats.hpp
+ * @brief Hlavickovy soubor pro statistiky snimku
+ * @see FrameStats, StatsWriter
+ */
+#include <string>
+#include <fstream>
+#include "level.hpp"
+
+/** Statistiky jednoho snimku hry.
+ * Casy fyziky se scitaji pres vsechny kroky provedene v tomto snimku, pocty
+ * (teles, kontaktu, ...) jsou po poslednim kroku. Vsechny casy jsou v ms.
+ */
+struct FrameStats {
+	int frame; ///< Cislo snimku
+	int steps; ///< Pocet kroku fyziky v tomto snimku
+	int idle; ///< Pocet kroku preskocenych protoze cely svet spal (Level::idle())
+
+	float collide; ///< b2ContactManager::Collide()
+	float solve; ///< b2World::Solve()
+	float solveTOI; ///< b2World::SolveTOI()
+	float deleteInvisible; ///< Level::deleteInvisible()
+	float events; ///< Zpracovani udalosti
+	float draw; ///< Vykreslovani
+
+	int bodies; ///< Pocet teles
+	int contacts; ///< Pocet kontaktu
+	int islands; ///< Pocet ostrovu v b2World::Solve()
+	int sleepIslands; ///< Pocet ostrovu ktere usnuly
+	int awake; ///< Pocet bdelych teles
+	int colors; ///< Nejvic barev kontaktu v jednom ostrovu (b2World::SetBatchedSolver())
+	int uncolored; ///< Pocet kontaktu ktere se nevesly do zadne barvy
+	int proxies; ///< Pocet proxy v broadphase
+	int pairs; ///< Pocet paru v broadphase
+	int bytes; ///< Pamet sveta (b2World::GetByteCount())
+
+	FrameStats();
+
+	/** Zacne novy snimek (vynuluje casy a pocty) */
+	void clear(int frame);
+
+	/** Pricte krok ktery uroven prave provedla.
+	 * Pozastavene kroky (bez fyziky) se nepocitaji, preskocene kroky spiciho
+	 * sveta se pocitaji jen v idle.
+	 */
+	void addStep(Level &level);
+};
+
+/** Zapisuje statistiky snimku do souboru.
+ * Podle pripony souboru se zapisuje CSV (jeden radek na snimek, prvni radek
+ * jsou nazvy sloupcu) nebo JSON (pole objektu, ".json").
+ */
+class StatsWriter {
+	std::ofstream mOut; ///< Vystupni soubor
+	bool mJson; ///< Zapisuje se JSON?
+	bool mEmpty; ///< Nebyl jeste zapsan zadny snimek?
+
+	/* soubor se neda kopirovat */
+	StatsWriter(const StatsWriter&);
+	void operator=(const StatsWriter&);
+
+public:
+	/** Otevre soubor.
+	 * @param file Jmeno souboru
+	 * @throw std::runtime_error Soubor nejde otevrit
+	 */
+	StatsWriter(const std::string &file);
+
+	/** Dokonci a zavre soubor */
+	~StatsWriter();
+
+	/** Zapise jeden snimek */
+	void write(const FrameStats &stats);
+};
+
+#endif
@@ -0,0 +1,767 @@
+/** @file bench.cpp
+ * @brief Mereni vykonu fyziky (Box2D)
+ *
+ * Postavi nekolik typickych scen o zadanem poctu teles a meri jak dlouho
+ * trva b2World::Step(). Kazda scena se nejdriv nekolik kroku zahriva (cache,
+ * alokatory, prvni kontakty), pak se meri kazdy krok zvlast a vypisi se
+ * percentily. Vysledky jdou vypsat i jako CSV nebo JSON, aby se dalo
+ * sledovat jak se vykon meni se zmenami v Box2D.
+ *
+ * Sceny:
+ *  - pyramid: pyramida kosticek
+ *  - maps: totemy z map v data/maps postavene vedle sebe
+ *  - tnt: zed z TNT kosticek ktere postupne vybuchuji (jako Level)
+ *  - blast: pyramida ktera se v prvnim merenem kroku cela rozleti do stran,
+ *    vsechna telesa se pak pohybuji najednou
+ *  - sleeping: spousta malych kominku ktere pred merenim usnou
+ *
+ * Kazda scena se meri s obema broadphase (sweep and prune a dynamicky strom),
+ * viz b2BroadPhaseType, a s kazdym zadanym poctem vlaken (b2World::SetThreadCount)
+ * a resicem kontaktu (b2World::SetBatchedSolver), pripadne i s cache kontaktu
+ * (b2World::SetManifoldCaching) a se spekulativnimi kontakty misto TOI
+ * (b2World::SetSpeculativeContacts) nebo s TOI zahrivanym z cache simplexu
+ * (b2World::SetSimplexCaching). Krome casu se meri i nejvetsi prunik teles,
+ * aby slo porovnat jak dobre obe kontinualni kolize chrani pred propadanim,
+ * a kolik iteraci GJK v prumeru potrebuje jeden dotaz na vzdalenost v TOI.
+ *
+ * S prepinacem -k se misto mereni scen porovna b2CollidePolygons (ktery pro
+ * kvadry pouziva SSE2) s b2CollidePolygonsGeneric na nahodnych dvojicich
+ * mnohouhelniku. Manifoldy se musi shodovat do posledniho bajtu.
+ */
+#include <Box2D.h>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <cerrno>
+#include <sys/types.h>
+#include <dirent.h>
+#include <unistd.h>
+#include "config.h"
+#include "level.hpp"
+#include "objects.hpp"
+#include "json/parser.hpp"
+
+/** Kosticka nebo buzek z mapy */
+struct MapShape {
+	bool idol; ///< Je to buzek?
+	Brick::Type type; ///< Typ kosticky
+	b2Vec2 pos; ///< Pozice
+	float width; ///< Sirka kosticky
+	float height; ///< Vyska kosticky
+	std::vector<b2Vec2> vertices; ///< Tvar buzka
+};
+
+/** Vsechny tvary jedne mapy */
+struct Map {
+	std::vector<MapShape> shapes; ///< Kosticky a buzci
+	float left; ///< Nejlevejsi x
+	float right; ///< Nejpravejsi x
+};
+
+/** Posluchac kontaktu ktery si pamatuje nejvetsi prunik */
+struct DepthListener: public b2ContactListener {
+	float depth; ///< Nejvetsi prunik (kladny)
+
+	DepthListener(): depth(0.0) { }
+
+	void Add(const b2ContactPoint *point) { depth = std::max(depth, -point->separation); }
+	void Persist(const b2ContactPoint *point) { depth = std::max(depth, -point->separation); }
+	void Remove(const b2ContactPoint *point) { }
+	void Result(const b2ContactResult *result) { }
+};
+
+/** Scena pripravena k mereni */
+struct Scene {
+	b2World *world; ///< Svet
+	DepthListener depth; ///< Posluchac kontaktu sveta
+	std::vector<GameObject*> objects; ///< Objekty ve svete (podle poradi vytvoreni)
+	size_t next; ///< Dalsi TNT kosticka ktera vybuchne (scena tnt)
+
+	Scene(): world(NULL), next(0) { }
+
+	~Scene()
+	{
+		std::vector<GameObject*>::iterator obj;
+		for(obj = objects.begin(); obj != objects.end(); obj++)
+			delete *obj;
+		delete world;
+	}
+};
+
+/** Vysledek mereni jedne sceny */
+struct Result {
+	std::string scene; ///< Jmeno sceny
+	std::string broadPhase; ///< Broadphase (sap nebo tree)
+	int threads; ///< Pocet vlaken pro reseni ostrovu
+	std::string solver; ///< Resic kontaktu (seq nebo batch)
+	std::string cache; ///< Cache kontaktu (off nebo on)
+	std::string ccd; ///< Kontinualni kolize (toi, warm nebo spec)
+	int requested; ///< Pozadovany pocet teles
+	int bodies; ///< Skutecny pocet teles
+	int contacts; ///< Pocet kontaktu na konci mereni
+	int pairs; ///< Pocet paru v broadphase na konci mereni
+	int warmup; ///< Pocet kroku zahrivani
+	float depth; ///< Nejvetsi prunik teles behem mereni (m)
+	long gjkCalls; ///< Dotazy GJK v TOI behem mereni
+	long gjkIterations; ///< Iterace (podpurne body) techto dotazu
+	std::vector<float> times; ///< Doba kazdeho mereneho kroku (ms)
+
+	Result(): threads(1), requested(0), bodies(0), contacts(0), pairs(0), warmup(0), depth(0.0), gjkCalls(0), gjkIterations(0) { }
+
+	/** Prumerny pocet iteraci GJK na dotaz, 0 pokud nebyl zadny */
+	float gjk() const
+	{
+		return gjkCalls > 0 ? float(gjkIterations) / gjkCalls : 0.0;
+	}
+
+	/** Percentil q (0 az 1) doby kroku, metoda nejblizsiho poradi */
+	float percentile(float q) const
+	{
+		std::vector<float> sorted(times);
+		std::sort(sorted.begin(), sorted.end());
+		int i = (int)std::ceil(q * sorted.size()) - 1;
+		if(i < 0)
+			i = 0;
+		return sorted[i];
+	}
+
+	/** Prumerna doba kroku */
+	float mean() const
+	{
+		double sum = 0.0;
+		for(size_t i = 0; i != times.size(); i++)
+			sum += times[i];
+		return sum / times.size();
+	}
+};
+
+/** Delka kroku, stejne jako ve hre */
+static const float StepTime = 1.0 / 60.0;
+
+/** Pocet iteraci, stejne jako ve hre */
+static const int Iterations = 15;
+
+/** Vytvori prazdny svet se zemi.
+ * Svet je dost siroky na tisice totemu z map postavenych vedle sebe.
+ */
+static void createWorld(Scene &scene, b2BroadPhaseType broadPhase)
+{
+	b2AABB worldAABB;
+	worldAABB.lowerBound.Set(-20000.0, -100.0);
+	worldAABB.upperBound.Set(20000.0, 1000.0);
+	scene.world = new b2World(worldAABB, b2Vec2(0.0f, -10.0f), true, broadPhase);
+	scene.objects.push_back(new Ground(scene.world, b2Vec2(0.0, -2.5), 39000.0, 5.0));
+}
+
+/** Pyramida z kosticek 1x1 */
+static void buildPyramid(Scene &scene, int bodies)
+{
+	int rows = 1;
+	while(rows * (rows + 1) / 2 < bodies)
+		rows++;
+
+	int count = 0;
+	for(int row = 0; row != rows and count != bodies; row++) {
+		int width = rows - row;
+		for(int i = 0; i != width and count != bodies; i++, count++) {
+			b2Vec2 pos(-width / 2.0 + i + 0.5, row + 0.5);
+			scene.objects.push_back(new Brick(scene.world, pos, 1.0, 1.0, Brick::Normal));
+		}
+	}
+}
+
+/** Totemy z map postavene vedle sebe, dokud nemaji dost teles */
+static void buildMaps(Scene &scene, int bodies, const std::vector<Map> &maps)
+{
+	if(maps.empty())
+		throw std::runtime_error("no maps");
+
+	int count = 0;
+	float x = 0.0; // levy okraj dalsiho totemu
+	for(size_t m = 0; count != bodies; m = (m + 1) % maps.size()) {
+		const Map &map = maps[m];
+		b2Vec2 offset(x - map.left, 0.0);
+
+		std::vector<MapShape>::const_iterator shape;
+		for(shape = map.shapes.begin(); shape != map.shapes.end() and count != bodies; shape++, count++) {
+			if(shape->idol)
+				scene.objects.push_back(new Idol(scene.world, shape->pos + offset, shape->vertices));
+			else
+				scene.objects.push_back(new Brick(scene.world, shape->pos + offset,
+							shape->width, shape->height, shape->type));
+		}
+
+		x += map.right - map.left + 2.0;
+	}
+}
+
+/** Zed z TNT kosticek 1x0.5 */
+static void buildTnt(Scene &scene, int bodies)
+{
+	int columns = (int)std::ceil(std::sqrt(bodies * 2.0));
+	for(int count = 0; count != bodies; count++) {
+		b2Vec2 pos(-columns / 2.0 + count % columns + 0.5, count / columns * 0.5 + 0.25);
+		scene.objects.push_back(new Brick(scene.world, pos, 1.0, 0.5, Brick::TNT));
+	}
+	scene.next = 1; // prvni objekt je zeme
+}
+
+/** Kazdych 20 kroku vybuchne dalsi TNT kosticka (stejne jako v Level) */
+static void tickTnt(Scene &scene, int step)
+{
+	if(step % 20 != 0)
+		return;
+
+	/* vybuchuje se na preskacku, aby to nebylo porad na stejnem miste */
+	const size_t stride = 37;
+	for(size_t tries = 0; tries != scene.objects.size(); tries++) {
+		size_t i = 1 + (scene.next + tries * stride) % (scene.objects.size() - 1);
+		if(!scene.objects[i])
+			continue;
+
+		const b2Body *bomb = scene.objects[i]->body();
+		b2Vec2 position = bomb->GetWorldCenter();
+		const float size = Level::ExplosionForce * bomb->GetMass();
+		delete scene.objects[i];
+		scene.objects[i] = NULL;
+		scene.next = i + stride;
+
+		b2Body *body;
+		for(body = scene.world->GetBodyList(); body != NULL; body = body->GetNext()) {
+			b2Vec2 force = body->GetWorldCenter() - position;
+			float len = force.Length();
+			force.Normalize();
+			force *= size / len;
+			body->ApplyForce(force, body->GetWorldCenter());
+		}
+		return;
+	}
+}
+
+/** Jeden velky vybuch pod stredem pyramidy.
+ * Vsechna telesa dostanou impuls od stredu, takze se vsechna najednou pohnou
+ * daleko od svych AABB.
+ */
+static void blast(Scene &scene)
+{
+	const b2Vec2 center(0.0, -1.0);
+	b2Body *body;
+	for(body = scene.world->GetBodyList(); body != NULL; body = body->GetNext()) {
+		if(body->IsStatic())
+			continue;
+		b2Vec2 impulse = body->GetWorldCenter() - center;
+		impulse.Normalize();
+		impulse *= 30.0 * body->GetMass();
+		body->WakeUp();
+		body->ApplyImpulse(impulse, body->GetWorldCenter());
+	}
+}
+
+/** Kominky po peti kostickach vedle sebe */
+static void buildSleeping(Scene &scene, int bodies)
+{
+	const int height = 5;
+	int stacks = (bodies + height - 1) / height;
+	int count = 0;
+	for(int stack = 0; stack != stacks; stack++) {
+		for(int i = 0; i != height and count != bodies; i++, count++) {
+			b2Vec2 pos(-stacks * 1.0 + stack * 2.0, i * 1.0 + 0.5);
+			scene.objects.push_back(new Brick(scene.world, pos, 1.0, 1.0, Brick::Normal));
+		}
+	}
+}
+
+/** Spi vsechna telesa? */
+static bool asleep(b2World *world)
+{
+	b2Body *body;
+	for(body = world->GetBodyList(); body != NULL; body = body->GetNext()) {
+		if(!body->IsStatic() and !body->IsSleeping())
+			return false;
+	}
+	return true;
+}
+
+/** Nacte tvary z mapy (stejne jako Level) */
+static Map loadMap(const std::string &file)
+{
+	std::ifstream in(file.c_str());
+	if(!in) {
+		std::stringstream s;
+		s << "Unable to open file " << file;
+		throw std::runtime_error(s.str());
+	}
+
+	json::Parser parser;
+	json::Value root = parser.parse(in);
+	Map map;
+	map.left = 1e6;
+	map.right = -1e6;
+
+	const std::string types = "ndcsgx"; // poradi jako Brick::Type
+	json::Array bricks = root["bricks"].ary();
+	json::Array::const_iterator brick;
+	for(brick = bricks.begin(); brick != bricks.end(); brick++) {
+		json::Array b = brick->ary();
+		MapShape shape;
+		shape.idol = false;
+		size_t type = types.find(b[0].str());
+		if(type == std::string::npos or b[0].str().size() != 1)
+			throw std::runtime_error("Bad brick type in " + file);
+		shape.type = (Brick::Type)type;
+		shape.pos.Set(b[1].num(), b[2].num());
+		shape.width = b[3].num();
+		shape.height = b[4].num();
+		map.left = std::min(map.left, shape.pos.x - shape.width / 2);
+		map.right = std::max(map.right, shape.pos.x + shape.width / 2);
+		map.shapes.push_back(shape);
+	}
+
+	json::Array idols = root["idols"].ary();
+	json::Array::const_iterator idol;
+	for(idol = idols.begin(); idol != idols.end(); idol++) {
+		MapShape shape;
+		shape.idol = true;
+		shape.type = Brick::Normal;
+		shape.width = shape.height = 0.0;
+		shape.pos.Set((*idol)[0][0].num(), (*idol)[0][1].num());
+		for(json::Array::size_type i = 1; i != idol->ary().size(); i++) {
+			b2Vec2 vertex((*idol)[i][0].num(), (*idol)[i][1].num());
+			map.left = std::min(map.left, shape.pos.x + vertex.x);
+			map.right = std::max(map.right, shape.pos.x + vertex.x);
+			shape.vertices.push_back(vertex);
+		}
+		map.shapes.push_back(shape);
+	}
+
+	return map;
+}
+
+/** Nacte vsechny mapy v adresari (serazene podle jmena) */
+static std::vector<Map> loadMaps(const std::string &dir)
+{
+	std::vector<std::string> files;
+	DIR *dp;
+	struct dirent *dirp;
+
+	if((dp = opendir(dir.c_str())) == NULL) {
+		std::stringstream s;
+		s << "Error(" << errno << ") opening " << dir;
+		throw std::runtime_error(s.str());
+	}
+	while((dirp = readdir(dp)) != NULL) {
+		std::string file = dirp->d_name;
+		if(file[0] != '.')
+			files.push_back(dir + "/" + file);
+	}
+	closedir(dp);
+	std::sort(files.begin(), files.end());
+
+	std::vector<Map> maps;
+	for(size_t i = 0; i != files.size(); i++)
+		maps.push_back(loadMap(files[i]));
+	return maps;
+}
+
+/** Postavi a zmeri jednu scenu */
+static Result measure(const std::string &name, const std::string &broadPhase, int threads,
+		const std::string &solver, const std::string &cache, const std::string &ccd,
+		int bodies, int warmup, int steps,
+		const std::vector<Map> &maps)
+{
+	Result result;
+	result.scene = name;
+	result.broadPhase = broadPhase;
+	result.threads = threads;
+	result.solver = solver;
+	result.cache = cache;
+	result.ccd = ccd;
+	result.requested = bodies;
+
+	Scene scene;
+	if(broadPhase == "sap")
+		createWorld(scene, e_sweepAndPruneBroadPhase);
+	else if(broadPhase == "tree")
+		createWorld(scene, e_dynamicTreeBroadPhase);
+	else
+		throw std::runtime_error("Unknown broadphase " + broadPhase);
+	scene.world->SetThreadCount(threads);
+	if(solver == "batch")
+		scene.world->SetBatchedSolver(true);
+	else if(solver != "seq")
+		throw std::runtime_error("Unknown solver " + solver);
+	if(cache == "on")
+		scene.world->SetManifoldCaching(true);
+	else if(cache != "off")
+		throw std::runtime_error("Unknown cache " + cache);
+	if(ccd == "spec")
+		scene.world->SetSpeculativeContacts(true);
+	else if(ccd == "warm")
+		scene.world->SetSimplexCaching(true);
+	else if(ccd != "toi")
+		throw std::runtime_error("Unknown ccd " + ccd);
+	scene.world->SetContactListener(&scene.depth);
+
+	bool tnt = false;
+	if(name == "pyramid" or name == "blast") {
+		buildPyramid(scene, bodies);
+	} else if(name == "maps") {
+		buildMaps(scene, bodies, maps);
+	} else if(name == "tnt") {
+		buildTnt(scene, bodies);
+		tnt = true;
+	} else if(name == "sleeping") {
+		buildSleeping(scene, bodies);
+	} else {
+		throw std::runtime_error("Unknown scene " + name);
+	}
+
+	result.bodies = scene.world->GetBodyCount() - 2; // bez zeme a zemskeho telesa Box2D
+
+	/* zahrivani, spici scena se zahriva dokud vsechno neusne */
+	int step = 0;
+	for(; step < warmup or (name == "sleeping" and step < 3000 and !asleep(scene.world)); step++) {
+		if(tnt)
+			tickTnt(scene, step);
+		scene.world->Step(StepTime, Iterations);
+	}
+	result.warmup = step;
+
+	scene.depth.depth = 0.0;
+	result.times.reserve(steps);
+	for(int i = 0; i != steps; i++, step++) {
+		if(tnt)
+			tickTnt(scene, step);
+		if(i == 0 and name == "blast")
+			blast(scene);
+		b2Timer timer;
+		scene.world->Step(StepTime, Iterations);
+		result.times.push_back(timer.GetMilliseconds());
+		result.gjkCalls += scene.world->GetProfile().toiGJKCallCount;
+		result.gjkIterations += scene.world->GetProfile().toiGJKIterationCount;
+	}
+
+	result.depth = scene.depth.depth;
+	result.contacts = scene.world->GetContactCount();
+	result.pairs = scene.world->GetPairCount();
+	return result;
+}
+
+/** Nahodne cislo z intervalu [a, b] */
+static float random(float a, float b)
+{
+	return a + (b - a) * (std::rand() / float(RAND_MAX));
+}
+
+/** Porovna b2CollidePolygons s b2CollidePolygonsGeneric na nahodnych dvojicich.
+ * Tvary jsou kvadry (osove zarovnane i otocene) a nepravidelne ctyr- a
+ * petiuhelniky, kazda jedenacta dvojice jsou dve neotocene kosticky nad sebou
+ * jako v totemu. Vypise pocet lisicich se manifoldu a cas obou funkci.
+ * @return Shoduji se vsechny manifoldy?
+ */
+static bool checkCollide(long pairs)
+{
+	b2AABB aabb;
+	aabb.lowerBound.Set(-100.0, -100.0);
+	aabb.upperBound.Set(100.0, 100.0);
+	b2World world(aabb, b2Vec2(0.0, -10.0), true);
+
+	std::srand(1);
+	const int count = 64;
+	std::vector<b2PolygonShape*> shapes;
+	for(int i = 0; i != count; i++) {
+		b2BodyDef bodyDef;
+		b2Body *body = world.CreateBody(&bodyDef);
+		b2PolygonDef def;
+		if(i % 3 == 0) {
+			def.SetAsBox(random(0.1, 2.0), random(0.1, 2.0));
+		} else if(i % 3 == 1) {
+			def.SetAsBox(random(0.1, 2.0), random(0.1, 2.0),
+					b2Vec2(random(-1.0, 1.0), random(-1.0, 1.0)), random(-3.0, 3.0));
+		} else {
+			def.vertexCount = i % 5 == 0 ? 5 : 4;
+			float radius = random(0.3, 2.0);
+			for(int k = 0; k != def.vertexCount; k++) {
+				float angle = 2.0 * b2_pi * k / def.vertexCount + random(-0.3, 0.3);
+				float r = radius * random(0.7, 1.3);
+				def.vertices[k].Set(r * std::cos(angle), r * std::sin(angle));
+			}
+		}
+		shapes.push_back((b2PolygonShape*)body->CreateShape(&def));
+	}
+
+	std::vector<b2XForm> xf1(pairs), xf2(pairs);
+	std::vector<int> shape1(pairs), shape2(pairs);
+	for(long i = 0; i != pairs; i++) {
+		shape1[i] = std::rand() % count;
+		shape2[i] = std::rand() % count;
+		xf1[i].position.Set(random(-1.0, 1.0), random(-1.0, 1.0));
+		xf1[i].R.Set(random(-4.0, 4.0));
+		xf2[i].position.Set(random(-3.0, 3.0), random(-3.0, 3.0));
+		xf2[i].R.Set(i % 7 == 0 ? 0.0 : random(-4.0, 4.0));
+		if(i % 11 == 0) {
+			xf1[i].R.Set(0.0);
+			xf2[i].R.Set(0.0);
+			xf2[i].position.y = xf1[i].position.y + random(0.5, 2.5);
+		}
+	}
+
+	long touching = 0, different = 0;
+	for(long i = 0; i != pairs; i++) {
+		b2Manifold simd, generic;
+		std::memset((void*)&simd, 0, sizeof(simd));
+		std::memset((void*)&generic, 0, sizeof(generic));
+		b2CollidePolygons(&simd, shapes[shape1[i]], xf1[i], shapes[shape2[i]], xf2[i]);
+		b2CollidePolygonsGeneric(&generic, shapes[shape1[i]], xf1[i], shapes[shape2[i]], xf2[i]);
+		if(simd.pointCount > 0)
+			touching++;
+		if(std::memcmp(&simd, &generic, sizeof(simd)) != 0)
+			different++;
+	}
+
+	/* cas jen pro dvojice kvadru, jine tvary SSE2 nepouzivaji */
+	b2Manifold manifold;
+	b2Timer timer;
+	long boxes = 0;
+	for(long i = 0; i != pairs; i++) {
+		if(shapes[shape1[i]]->GetVertexCount() == 4 and shapes[shape2[i]]->GetVertexCount() == 4) {
+			b2CollidePolygons(&manifold, shapes[shape1[i]], xf1[i], shapes[shape2[i]], xf2[i]);
+			boxes++;
+		}
+	}
+	float simdTime = timer.GetMilliseconds();
+	timer.Reset();
+	for(long i = 0; i != pairs; i++) {
+		if(shapes[shape1[i]]->GetVertexCount() == 4 and shapes[shape2[i]]->GetVertexCount() == 4)
+			b2CollidePolygonsGeneric(&manifold, shapes[shape1[i]], xf1[i], shapes[shape2[i]], xf2[i]);
+	}
+	float genericTime = timer.GetMilliseconds();
+
+	std::cout << "pairs " << pairs << ", touching " << touching << ", different " << different << std::endl;
+	if(boxes > 0) {
+		std::cout << std::fixed << std::setprecision(1)
+			<< "boxes: b2CollidePolygons " << simdTime * 1e6 / boxes << " ns, "
+			<< "b2CollidePolygonsGeneric " << genericTime * 1e6 / boxes << " ns" << std::endl;
+	}
+	return different == 0;
+}
+
+/** Rozdeli seznam oddeleny carkami */
+static std::vector<std::string> split(const std::string &list)
+{
+	std::vector<std::string> items;
+	std::stringstream s(list);
+	std::string item;
+	while(std::getline(s, item, ','))
+		if(!item.empty())
+			items.push_back(item);
+	return items;
+}
+
+static void printTable(const std::vector<Result> &results)
+{
+	std::cout << std::left << std::setw(10) << "scene" << std::setw(6) << "bp" << std::right
+		<< std::setw(4) << "thr" << std::setw(6) << "solv" << std::setw(6) << "cache" << std::setw(5) << "ccd" << std::setw(7) << "bodies" << std::setw(9) << "contacts"
+		<< std::setw(8) << "warmup" << std::setw(7) << "steps"
+		<< std::setw(9) << "min" << std::setw(9) << "mean" << std::setw(9) << "p50"
+		<< std::setw(9) << "p90" << std::setw(9) << "p99" << std::setw(9) << "max"
+		<< std::setw(8) << "depth" << std::setw(6) << "gjk" << "  (ms, m)" << std::endl;
+
+	std::vector<Result>::const_iterator r;
+	for(r = results.begin(); r != results.end(); r++) {
+		std::cout << std::left << std::setw(10) << r->scene << std::setw(6) << r->broadPhase
+			<< std::right << std::setw(4) << r->threads << std::setw(6) << r->solver << std::setw(6) << r->cache << std::setw(5) << r->ccd;
+		std::cout << std::setw(7) << r->bodies << std::setw(9) << r->contacts
+			<< std::setw(8) << r->warmup << std::setw(7) << r->times.size()
+			<< std::fixed << std::setprecision(3)
+			<< std::setw(9) << r->percentile(0.0) << std::setw(9) << r->mean()
+			<< std::setw(9) << r->percentile(0.5) << std::setw(9) << r->percentile(0.9)
+			<< std::setw(9) << r->percentile(0.99) << std::setw(9) << r->percentile(1.0)
+			<< std::setw(8) << r->depth << std::setw(6) << std::setprecision(2) << r->gjk() << std::endl;
+	}
+}
+
+static void printCsv(const std::vector<Result> &results)
+{
+	std::cout << "scene,broadphase,threads,solver,cache,ccd,requested,bodies,contacts,pairs,warmup,steps,min,mean,p50,p90,p99,max,depth,gjk"
+		<< std::endl;
+
+	std::vector<Result>::const_iterator r;
+	for(r = results.begin(); r != results.end(); r++) {
+		std::cout << r->scene << "," << r->broadPhase << "," << r->threads << "," << r->solver << "," << r->cache << "," << r->ccd << "," << r->requested << "," << r->bodies << ","
+			<< r->contacts << "," << r->pairs << "," << r->warmup << "," << r->times.size();
+		std::cout << "," << r->percentile(0.0) << "," << r->mean() << ","
+			<< r->percentile(0.5) << "," << r->percentile(0.9) << ","
+			<< r->percentile(0.99) << "," << r->percentile(1.0) << "," << r->depth << "," << r->gjk() << std::endl;
+	}
+}
+
+static void printJson(const std::vector<Result> &results)
+{
+	std::cout << "[";
+	std::vector<Result>::const_iterator r;
+	for(r = results.begin(); r != results.end(); r++) {
+		std::cout << (r == results.begin() ? "\n" : ",\n")
+			<< "{\"scene\": \"" << r->scene << "\", \"broadphase\": \"" << r->broadPhase
+			<< "\", \"threads\": " << r->threads << ", \"solver\": \"" << r->solver
+			<< "\", \"cache\": \"" << r->cache << "\", \"ccd\": \"" << r->ccd
+			<< "\", \"requested\": " << r->requested;
+		std::cout << ", \"bodies\": " << r->bodies << ", \"contacts\": " << r->contacts
+			<< ", \"pairs\": " << r->pairs << ", \"warmup\": " << r->warmup
+			<< ", \"steps\": " << r->times.size()
+			<< ", \"min\": " << r->percentile(0.0) << ", \"mean\": " << r->mean()
+			<< ", \"p50\": " << r->percentile(0.5) << ", \"p90\": " << r->percentile(0.9)
+			<< ", \"p99\": " << r->percentile(0.99) << ", \"max\": " << r->percentile(1.0)
+			<< ", \"depth\": " << r->depth << ", \"gjk\": " << r->gjk() << "}";
+	}
+	std::cout << "\n]" << std::endl;
+}
+
+static void usage(const char *name)
+{
+	std::cerr << "Usage: " << name << " [-w warmup-steps] [-n steps] [-b bodies,...]"
+		<< " [-S scene,...] [-p broadphase,...] [-j threads,...]"
+		<< " [-s solver,...] [-c cache,...] [-C ccd,...]"
+		<< " [-f table|csv|json] [-m maps-dir]" << std::endl
+		<< "       " << name << " -k pairs" << std::endl
+		<< "Scenes: pyramid, maps, tnt, blast, sleeping (all by default)." << std::endl
+		<< "Broadphases: sap, tree (both by default)." << std::endl
+		<< "Threads: number of threads solving islands (1 by default)." << std::endl
+		<< "Solvers: seq, batch (both by default)." << std::endl
+		<< "Manifold cache: off, on (off by default)." << std::endl
+		<< "Continuous collision: toi, warm (toi with GJK warm start), spec (toi by default)." << std::endl
+		<< "-k compares the SSE2 box collider with the generic one on random polygon pairs," << std::endl
+		<< "exit status is 1 if any manifold differs." << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+	int warmup = 60;
+	int steps = 600;
+	std::string sizes = "10,100,500,1000,5000";
+	std::string scenes = "pyramid,maps,tnt,blast,sleeping";
+	std::string broadPhases = "sap,tree";
+	std::string threads = "1";
+	std::string solvers = "seq,batch";
+	std::string caches = "off";
+	std::string ccds = "toi";
+	std::string format = "table";
+	std::string mapsDir;
+	long checkPairs = 0;
+	int opt;
+
+	while((opt = getopt(argc, argv, "w:n:b:S:p:j:s:c:C:f:m:k:h")) != -1) {
+		switch(opt) {
+			case 'w':
+				warmup = std::atoi(optarg);
+				break;
+			case 'n':
+				steps = std::atoi(optarg);
+				break;
+			case 'b':
+				sizes = optarg;
+				break;
+			case 'S':
+				scenes = optarg;
+				break;
+			case 'p':
+				broadPhases = optarg;
+				break;
+			case 'j':
+				threads = optarg;
+				break;
+			case 's':
+				solvers = optarg;
+				break;
+			case 'c':
+				caches = optarg;
+				break;
+			case 'C':
+				ccds = optarg;
+				break;
+			case 'f':
+				format = optarg;
+				break;
+			case 'm':
+				mapsDir = optarg;
+				break;
+			case 'k':
+				checkPairs = std::atol(optarg);
+				break;
+			default:
+				usage(argv[0]);
+				return opt == 'h' ? 0 : 2;
+		}
+	}
+
+	if(optind != argc or steps < 1 or (format != "table" and format != "csv" and format != "json")) {
+		usage(argv[0]);
+		return 2;
+	}
+
+	if(checkPairs > 0)
+		return checkCollide(checkPairs) ? 0 : 1;
+
+	std::vector<Result> results;
+	try {
+		std::vector<std::string> sceneList = split(scenes);
+
+		std::vector<Map> maps;
+		if(std::find(sceneList.begin(), sceneList.end(), "maps") != sceneList.end()) {
+			/* stejne jako v Menu */
+			if(mapsDir.empty() and std::getenv("TOTEM_DESTROYER_MAPS"))
+				mapsDir = std::getenv("TOTEM_DESTROYER_MAPS");
+			if(mapsDir.empty()) {
+				std::string dataDir = INSTALL_DATADIR;
+				if(std::getenv("TOTEM_DESTROYER_DATADIR"))
+					dataDir = std::getenv("TOTEM_DESTROYER_DATADIR");
+				mapsDir = dataDir + "/maps";
+			}
+			maps = loadMaps(mapsDir);
+		}
+
+		std::vector<std::string> sizeList = split(sizes);
+		std::vector<std::string> broadPhaseList = split(broadPhases);
+		std::vector<std::string> threadList = split(threads);
+		std::vector<std::string> solverList = split(solvers);
+		std::vector<std::string> cacheList = split(caches);
+		std::vector<std::string> ccdList = split(ccds);
+		for(size_t s = 0; s != sceneList.size(); s++) {
+			for(size_t b = 0; b != sizeList.size(); b++) {
+				for(size_t p = 0; p != broadPhaseList.size(); p++) {
+					for(size_t t = 0; t != threadList.size(); t++) {
+						for(size_t v = 0; v != solverList.size(); v++) {
+							for(size_t c = 0; c != cacheList.size(); c++) {
+								for(size_t d = 0; d != ccdList.size(); d++) {
+									results.push_back(measure(sceneList[s], broadPhaseList[p],
+												std::atoi(threadList[t].c_str()), solverList[v], cacheList[c],
+												ccdList[d], std::atoi(sizeList[b].c_str()), warmup, steps, maps));
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+	} catch(std::exception &e) {
+		std::cerr << e.what() << std::endl;
+		return 2;
+	}
+
+	if(format == "csv")
+		printCsv(results);
+	else if(format == "json")
+		printJson(results);
+	else
+		printTable(results);
+
+	return 0;
+}
@@ -0,0 +1,89 @@
+/** @file replay.cpp
+ * @brief Prehravani zaznamu hry
+ *
+ * Prehraje zaznamy her (Replay) bez vykreslovani tak rychle jak to jde a
+ * zkontroluje, ze se stav sveta na konci shoduje bit po bitu se zaznamem.
+ * Zaznam hry se porizuje nastavenim TOTEM_DESTROYER_RECORD na jmeno souboru.
+ */
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <stdexcept>
+#include <cstdlib>
+#include <ctime>
+#include <unistd.h>
+#include "level.hpp"
+#include "replay.hpp"
+
+/** Aktualni cas v sekundach (monotonni) */
+static double now()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void usage(const char *name)
+{
+	std::cerr << "Usage: " << name << " [-m map.json] replay..." << std::endl
+		<< "  -m  play every replay on this map instead of the recorded one" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+	std::string map;
+	int opt;
+
+	while((opt = getopt(argc, argv, "m:h")) != -1) {
+		switch(opt) {
+			case 'm':
+				map = optarg;
+				break;
+			default:
+				usage(argv[0]);
+				return opt == 'h' ? 0 : 2;
+		}
+	}
+
+	if(optind >= argc) {
+		usage(argv[0]);
+		return 2;
+	}
+
+	int failed = 0;
+	for(int i = optind; i != argc; i++) {
+		std::cout << argv[i] << "  ";
+		try {
+			Replay replay;
+			replay.load(argv[i]);
+			if(!map.empty())
+				replay.map(map);
+
+			Level level(replay.map());
+			double start = now();
+			bool ok = replay.play(level);
+			double time = now() - start;
+
+			std::cout << (ok ? "OK" : "MISMATCH") << "  steps=" << level.steps()
+				<< "  events=" << replay.events().size()
+				<< "  time=" << std::fixed << std::setprecision(3) << time * 1000.0
+				<< "ms  checksum=" << std::hex << std::setw(8) << std::setfill('0')
+				<< Replay::checksum(level) << std::dec << std::setfill(' ');
+			if(!ok) {
+				std::cout << " expected=" << std::hex << std::setw(8) << std::setfill('0')
+					<< replay.finalChecksum() << std::dec << std::setfill(' ');
+				failed++;
+			}
+			std::cout << std::endl;
+		} catch(std::exception &e) {
+			/* chybove hlasky z Level konci novym radkem */
+			std::string error = e.what();
+			if(!error.empty() and error[error.size() - 1] == '\n')
+				error.erase(error.size() - 1);
+			std::cout << "ERROR  " << error << std::endl;
+			failed++;
+		}
+	}
+
+	return failed ? 1 : 0;
+}
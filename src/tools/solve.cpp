@@ -0,0 +1,418 @@
+/** @file solve.cpp
+ * @brief Automaticky resitel urovni
+ *
+ * Hleda poradi kliknuti (niceni kosticek), po kterem hrac vyhraje: znici se
+ * dost kosticek (toDestroy() <= 0) a vsichni buzci se uklidni aniz by se
+ * dotkli zeme. Mezi dvema kliknutimi se vzdy ceka nez skonci nabijeni
+ * (Level::ChargingTime) a nez se buzci uklidni.
+ *
+ * Stavovy prostor se prochazi do hloubky. Uklidneny stav po kazdem kliknuti
+ * se ulozi (LevelState) a vsechny vetve z nej se rozbehnou obnovenim tohoto
+ * stavu, nic se neprehrava od zacatku. Kazda vetev je jeden ukol v zasobniku
+ * vlakna, ktere ji vytvorilo; vlakno ktere nema co delat si ukol ukradne od
+ * jineho (work stealing), a pokud neni co ukrast, spi dokud nejaky ukol
+ * nepribude. Kazde vlakno ma svou vlastni uroven (a svet).
+ *
+ * Prohledava se jen omezeny prostor: klika se vzdy doprostred kosticky a az
+ * po uklidneni. Pokud se v nem reseni nenajde, neznamena to, ze uroven
+ * nejde vyhrat (napr. kliknutim behem padani).
+ */
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <stdexcept>
+#include <cstdlib>
+#include <ctime>
+#include <unistd.h>
+#include <pthread.h>
+#include "level.hpp"
+
+/** Jedno kliknuti */
+struct Click {
+	int step; ///< Krok ve kterem se kliklo
+	b2Vec2 pos; ///< Pozice kliknuti ve svete
+};
+
+/** Kliknuti od zacatku urovne */
+typedef std::vector<Click> Path;
+
+/** Uzel prohledavani - uklidneny stav po nekolika kliknutich.
+ * Sdili ho vsechny vetve ktere z nej vychazeji, smaze ho posledni z nich.
+ */
+struct Node {
+	LevelState state; ///< Stav urovne
+	Path path; ///< Kliknuti ktera do stavu vedou
+	int step; ///< Krok od zacatku urovne
+	volatile int refs; ///< Pocet ukolu ktere z uzlu vychazeji
+};
+
+/** Ukol - jedno kliknuti ve stavu uzlu */
+struct Task {
+	Node *node; ///< Vychozi stav
+	b2Vec2 pos; ///< Kam se klikne
+};
+
+/** Zasobnik ukolu jednoho vlakna */
+struct TaskQueue {
+	std::deque<Task> tasks; ///< Ukoly, vlastnik bere ze zadu, zlodeji zepredu
+	pthread_mutex_t mutex; ///< Zamek pro tasks
+};
+
+/** Stav prohledavani sdileny vsemi vlakny */
+struct Search {
+	std::string map; ///< Soubor s mapou
+	int settleSteps; ///< Jak dlouho se nejvys ceka na uklidneni po kliknuti
+	long maxNodes; ///< Nejvetsi pocet prozkoumanych vetvi
+
+	std::vector<TaskQueue> queues; ///< Zasobnik pro kazde vlakno
+	volatile long pending; ///< Pocet ukolu ktere jeste nejsou hotove
+	volatile long nodes; ///< Pocet prozkoumanych vetvi
+	volatile long steals; ///< Pocet ukradenych ukolu
+	volatile int solved; ///< Nasel uz nekdo reseni?
+
+	pthread_mutex_t waitMutex; ///< Zamek pro posted a cekani na praci
+	pthread_cond_t workAvailable; ///< Pribyl ukol, nebo uz neni na co cekat
+	long posted; ///< Pocet vsech pridanych ukolu (kvuli cekani)
+
+	pthread_mutex_t solutionMutex; ///< Zamek pro solution
+	Path solution; ///< Nalezene reseni
+	int solutionSteps; ///< Po kolika krocich od zacatku hrac vyhral
+};
+
+/** Parametry pracovniho vlakna */
+struct Worker {
+	Search *search; ///< Spolecny stav
+	size_t id; ///< Cislo vlakna (index do Search::queues)
+};
+
+/** Aktualni cas v sekundach (monotonni) */
+static double now()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+/** Pocka nez skonci nabijeni a buzci se uklidni.
+ * Pokud uz se znicilo dost kosticek, ceka se rovnou na vyhru.
+ *
+ * @return Pocet provedenych kroku
+ */
+static int settle(Level &level, int maxSteps)
+{
+	int steps;
+	for(steps = 0; steps < maxSteps and not level.finished(); steps++) {
+		if(!level.charging() and !level.checking() and level.toDestroy() > 0
+				and level.idolsSleeping())
+			break;
+		level.step();
+	}
+	return steps;
+}
+
+/** Je jeste co hledat? (reseni nenalezeno a nejaky ukol neni hotovy) */
+static bool searching(Search &search)
+{
+	return __sync_fetch_and_add(&search.solved, 0) == 0
+		and __sync_fetch_and_add(&search.pending, 0) > 0;
+}
+
+/** Probudi vsechna cekajici vlakna (reseni nalezeno nebo vse hotovo) */
+static void wakeAll(Search &search)
+{
+	pthread_mutex_lock(&search.waitMutex);
+	pthread_cond_broadcast(&search.workAvailable);
+	pthread_mutex_unlock(&search.waitMutex);
+}
+
+/** Prida ukol do zasobniku vlakna a probudi jedno cekajici vlakno */
+static void push(Search &search, size_t id, const Task &task)
+{
+	__sync_fetch_and_add(&search.pending, 1);
+	__sync_fetch_and_add(&task.node->refs, 1);
+
+	TaskQueue &queue = search.queues[id];
+	pthread_mutex_lock(&queue.mutex);
+	queue.tasks.push_back(task);
+	pthread_mutex_unlock(&queue.mutex);
+
+	/* az po pridani do zasobniku, viz worker() */
+	pthread_mutex_lock(&search.waitMutex);
+	search.posted++;
+	pthread_cond_signal(&search.workAvailable);
+	pthread_mutex_unlock(&search.waitMutex);
+}
+
+/** Ukol je hotovy, uzel se smaze pokud uz z nej nic nevychazi */
+static void release(Node *node)
+{
+	if(__sync_sub_and_fetch(&node->refs, 1) == 0)
+		delete node;
+}
+
+/** Vezme ukol z vlastniho zasobniku, nebo ho ukradne jinemu vlaknu.
+ * @return false pokud neni zadny ukol
+ */
+static bool pop(Search &search, size_t id, Task &task)
+{
+	TaskQueue &own = search.queues[id];
+	pthread_mutex_lock(&own.mutex);
+	if(!own.tasks.empty()) {
+		task = own.tasks.back();
+		own.tasks.pop_back();
+		pthread_mutex_unlock(&own.mutex);
+		return true;
+	}
+	pthread_mutex_unlock(&own.mutex);
+
+	/* krade se nejstarsi ukol (nejbliz koreni, nejvic prace) */
+	size_t count = search.queues.size();
+	for(size_t i = 1; i != count; i++) {
+		TaskQueue &victim = search.queues[(id + i) % count];
+		pthread_mutex_lock(&victim.mutex);
+		if(!victim.tasks.empty()) {
+			task = victim.tasks.front();
+			victim.tasks.pop_front();
+			pthread_mutex_unlock(&victim.mutex);
+			__sync_fetch_and_add(&search.steals, 1);
+			return true;
+		}
+		pthread_mutex_unlock(&victim.mutex);
+	}
+
+	return false;
+}
+
+/** Ulozi uklidneny stav a prida do zasobniku vsechna dalsi mozna kliknuti.
+ * Pokud hrac uz vyhral, ohlasi reseni.
+ */
+static void expand(Search &search, size_t id, Level &level, const Path &path, int step)
+{
+	if(level.won()) {
+		pthread_mutex_lock(&search.solutionMutex);
+		if(!search.solved) {
+			search.solution = path;
+			search.solutionSteps = step;
+			__sync_lock_test_and_set(&search.solved, 1);
+		}
+		pthread_mutex_unlock(&search.solutionMutex);
+		wakeAll(search);
+		return;
+	}
+
+	/* prohra nebo se nestihl uklidnit */
+	if(level.finished() or level.checking() or level.charging())
+		return;
+
+	std::vector<b2Vec2> bricks = level.destroyableBricks();
+	if(bricks.empty())
+		return;
+
+	Node *node = new Node;
+	level.save(node->state);
+	node->path = path;
+	node->step = step;
+	node->refs = 1; // drzi ho tato funkce, aby ho nesmazal hotovy potomek
+
+	/* pridavaji se pozpatku aby se jako prvni zkousela kosticka ktera je v
+	 * seznamu teles prvni */
+	std::vector<b2Vec2>::reverse_iterator brick;
+	for(brick = bricks.rbegin(); brick != bricks.rend(); brick++) {
+		Task task;
+		task.node = node;
+		task.pos = *brick;
+		push(search, id, task);
+	}
+
+	release(node);
+}
+
+/** Prozkouma jednu vetev.
+ * Obnovi stav uzlu, klikne a pocka na uklidneni.
+ */
+static void run(Search &search, size_t id, Level &level, const Task &task)
+{
+	level.restore(task.node->state);
+	if(!level.destroyAt(task.pos))
+		throw std::logic_error("click did not destroy a brick");
+
+	Path path(task.node->path);
+	Click click;
+	click.step = task.node->step;
+	click.pos = task.pos;
+	path.push_back(click);
+
+	int step = task.node->step + settle(level, search.settleSteps);
+	expand(search, id, level, path, step);
+}
+
+/** Pracovni vlakno */
+static void *worker(void *arg)
+{
+	Worker *self = static_cast<Worker*>(arg);
+	Search &search = *self->search;
+	Level level(search.map); // stav se bude jen obnovovat
+	Task task;
+
+	while(searching(search)) {
+		/* pocet pridanych ukolu se precte pred hledanim, takze se nezmeska
+		 * ukol pridany mezi neuspesnym pop() a cekanim */
+		pthread_mutex_lock(&search.waitMutex);
+		long posted = search.posted;
+		pthread_mutex_unlock(&search.waitMutex);
+
+		if(!pop(search, self->id, task)) {
+			/* ostatni jeste pracuji a muzou pridat ukoly */
+			pthread_mutex_lock(&search.waitMutex);
+			while(search.posted == posted and searching(search))
+				pthread_cond_wait(&search.workAvailable, &search.waitMutex);
+			pthread_mutex_unlock(&search.waitMutex);
+			continue;
+		}
+
+		if(__sync_add_and_fetch(&search.nodes, 1) <= search.maxNodes) {
+			try {
+				run(search, self->id, level, task);
+			} catch(std::exception &e) {
+				std::cerr << e.what() << std::endl;
+			}
+		}
+
+		release(task.node);
+		if(__sync_sub_and_fetch(&search.pending, 1) == 0)
+			wakeAll(search);
+	}
+
+	/* po nalezeni reseni muzou v zasobnicich zbyt ukoly */
+	pthread_mutex_lock(&search.queues[self->id].mutex);
+	std::deque<Task> &tasks = search.queues[self->id].tasks;
+	for(; !tasks.empty(); tasks.pop_back())
+		release(tasks.back().node);
+	pthread_mutex_unlock(&search.queues[self->id].mutex);
+
+	return NULL;
+}
+
+static void usage(const char *name)
+{
+	std::cerr << "Usage: " << name
+		<< " [-j threads] [-n max-nodes] [-s settle-steps] map.json" << std::endl
+		<< "Searches click orders where every click hits the center of a brick" << std::endl
+		<< "after the idols have settled (waiting at most settle-steps). Clicks at" << std::endl
+		<< "other points or times are not tried, so a map may be winnable even if" << std::endl
+		<< "no solution is found." << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+	int threads = sysconf(_SC_NPROCESSORS_ONLN);
+	long maxNodes = 100000;
+	int settleSteps = 60 * 10; // deset sekund hry
+	int opt;
+
+	while((opt = getopt(argc, argv, "j:n:s:h")) != -1) {
+		switch(opt) {
+			case 'j':
+				threads = std::atoi(optarg);
+				break;
+			case 'n':
+				maxNodes = std::atol(optarg);
+				break;
+			case 's':
+				settleSteps = std::atoi(optarg);
+				break;
+			default:
+				usage(argv[0]);
+				return opt == 'h' ? 0 : 2;
+		}
+	}
+
+	if(optind + 1 != argc) {
+		usage(argv[0]);
+		return 2;
+	}
+
+	if(threads < 1)
+		threads = 1;
+
+	Search search;
+	search.map = argv[optind];
+	search.settleSteps = settleSteps;
+	search.maxNodes = maxNodes;
+	search.queues.resize(threads);
+	search.pending = 0;
+	search.nodes = 0;
+	search.steals = 0;
+	search.solved = 0;
+	search.solutionSteps = 0;
+	search.posted = 0;
+	pthread_mutex_init(&search.solutionMutex, NULL);
+	pthread_mutex_init(&search.waitMutex, NULL);
+	pthread_cond_init(&search.workAvailable, NULL);
+	for(int i = 0; i != threads; i++)
+		pthread_mutex_init(&search.queues[i].mutex, NULL);
+
+	double start = now();
+
+	/* koren - uklidneny stav bez kliknuti */
+	std::string mapName;
+	try {
+		Level level(search.map);
+		mapName = level.mapName();
+		int step = settle(level, search.settleSteps);
+		expand(search, 0, level, Path(), step);
+	} catch(std::exception &e) {
+		std::cerr << e.what() << std::endl;
+		return 2;
+	}
+
+	std::vector<Worker> workers(threads);
+	std::vector<pthread_t> pool(threads);
+	for(int i = 0; i != threads; i++) {
+		workers[i].search = &search;
+		workers[i].id = i;
+		if(i != 0)
+			pthread_create(&pool[i], NULL, worker, &workers[i]);
+	}
+	worker(&workers[0]);
+	for(int i = 1; i != threads; i++)
+		pthread_join(pool[i], NULL);
+	double wall = now() - start;
+
+	for(int i = 0; i != threads; i++)
+		pthread_mutex_destroy(&search.queues[i].mutex);
+	pthread_mutex_destroy(&search.solutionMutex);
+	pthread_mutex_destroy(&search.waitMutex);
+	pthread_cond_destroy(&search.workAvailable);
+
+	long nodes = search.nodes;
+	if(nodes > search.maxNodes)
+		nodes = search.maxNodes;
+	std::cout << search.map << "  name=\"" << mapName << "\"  nodes=" << nodes
+		<< "  steals=" << search.steals << "  threads=" << threads
+		<< "  time=" << std::fixed << std::setprecision(3) << wall * 1000.0
+		<< "ms" << std::endl;
+
+	if(!search.solved) {
+		if(search.nodes > search.maxNodes)
+			std::cout << "UNKNOWN (node limit reached)" << std::endl;
+		else
+			std::cout << "NO SOLUTION FOUND (settle-then-click search)" << std::endl;
+		return 1;
+	}
+
+	/* reseni: krok a pozice kazdeho kliknuti */
+	std::cout << "SOLVED in " << search.solution.size() << " clicks, won at step "
+		<< search.solutionSteps << std::endl;
+	Path::const_iterator click;
+	for(click = search.solution.begin(); click != search.solution.end(); click++) {
+		std::cout << click->step << " " << std::setprecision(4)
+			<< click->pos.x << " " << click->pos.y << std::endl;
+	}
+
+	return 0;
+}
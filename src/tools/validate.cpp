@@ -0,0 +1,259 @@
+/** @file validate.cpp
+ * @brief Davkova kontrola map
+ *
+ * Nacte vsechny mapy (z TOTEM_DESTROYER_MAPS nebo z adresare s daty, pripadne
+ * ty zadane na prikazove radce) a bez vykreslovani je nechava bezet, dokud se
+ * vsichni buzci neuklidni. Pokud nektery buzek spadne na zem nebo z obrazovky,
+ * nebo se totem neuklidni do zadaneho poctu kroku, je mapa spatne.
+ *
+ * Mapy se simuluji paralelne, kazde vlakno ma vzdy jen jeden svet (Level).
+ */
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <cstdlib>
+#include <cerrno>
+#include <ctime>
+#include <sys/types.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "config.h"
+#include "level.hpp"
+
+/** Vysledek kontroly jedne mapy */
+struct Result {
+	std::string file; ///< Soubor s mapou
+	std::string name; ///< Jmeno mapy
+	bool ok; ///< Je mapa v poradku?
+	std::string error; ///< Popis chyby
+	int steps; ///< Po kolika krocich se totem uklidnil
+	double time; ///< Doba simulace v sekundach
+	double cpu; ///< Procesorovy cas vlakna behem simulace v sekundach
+
+	Result(): ok(false), steps(0), time(0.0), cpu(0.0) { }
+};
+
+/** Prace sdilena vsemi vlakny */
+struct Work {
+	std::vector<Result> results; ///< Vysledky, jeden pro kazdou mapu
+	size_t next; ///< Index dalsi mapy ke zpracovani
+	int maxSteps; ///< Nejvetsi pocet kroku simulace
+	pthread_mutex_t mutex; ///< Zamek pro next
+};
+
+/** Aktualni cas v sekundach (monotonni) */
+static double now()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+/** Procesorovy cas volajiciho vlakna v sekundach.
+ * Na rozdil od now() nepocita dobu kdy vlakno ceka nebo bylo odstaveno.
+ */
+static double threadCpu()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+/** Zkontroluje jednu mapu.
+ * Krokuje uroven bez niceni kosticek dokud vsichni buzci nespi, nebo dokud
+ * hrac neprohraje (buzek se dotkl zeme nebo vypadl z obrazovky).
+ */
+static void validate(Result &result, int maxSteps)
+{
+	double start = now();
+	double startCpu = threadCpu();
+
+	try {
+		Level level(result.file);
+		result.name = level.mapName();
+
+		int steps;
+		for(steps = 0; steps < maxSteps; steps++) {
+			level.step();
+			if(level.lost() or level.idolsSleeping())
+				break;
+		}
+		result.steps = steps;
+
+		if(level.lost()) {
+			result.error = "idol fell";
+		} else if(!level.idolsSleeping()) {
+			std::stringstream s;
+			s << "not settled after " << maxSteps << " steps";
+			result.error = s.str();
+		} else {
+			result.ok = true;
+		}
+	} catch(std::exception &e) {
+		result.error = e.what();
+		/* chybove hlasky z Level konci novym radkem */
+		if(!result.error.empty() and result.error[result.error.size() - 1] == '\n')
+			result.error.erase(result.error.size() - 1);
+	}
+
+	result.time = now() - start;
+	result.cpu = threadCpu() - startCpu;
+}
+
+/** Pracovni vlakno.
+ * Bere si mapy jednu po druhe, dokud nejaka zbyva.
+ */
+static void *worker(void *arg)
+{
+	Work *work = static_cast<Work*>(arg);
+
+	for(;;) {
+		pthread_mutex_lock(&work->mutex);
+		size_t i = work->next++;
+		pthread_mutex_unlock(&work->mutex);
+
+		if(i >= work->results.size())
+			break;
+
+		validate(work->results[i], work->maxSteps);
+	}
+
+	return NULL;
+}
+
+/** Vrati vsechny mapy v adresari (serazene) */
+static std::vector<std::string> listMaps(const std::string &dir)
+{
+	std::vector<std::string> maps;
+	DIR *dp;
+	struct dirent *dirp;
+
+	if((dp = opendir(dir.c_str())) == NULL) {
+		std::stringstream s;
+		s << "Error(" << errno << ") opening " << dir;
+		throw std::runtime_error(s.str());
+	}
+
+	while((dirp = readdir(dp)) != NULL) {
+		std::string file = dirp->d_name;
+		if(file[0] != '.') // preskoci se skryte soubory
+			maps.push_back(dir + "/" + file);
+	}
+
+	closedir(dp);
+
+	std::sort(maps.begin(), maps.end());
+	return maps;
+}
+
+static void usage(const char *name)
+{
+	std::cerr << "Usage: " << name << " [-j threads] [-s max-steps] [map.json...]"
+		<< std::endl
+		<< "Without maps, checks every map in $TOTEM_DESTROYER_MAPS." << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+	int threads = sysconf(_SC_NPROCESSORS_ONLN);
+	int maxSteps = 60 * 60; // minuta hry
+	int opt;
+
+	while((opt = getopt(argc, argv, "j:s:h")) != -1) {
+		switch(opt) {
+			case 'j':
+				threads = std::atoi(optarg);
+				break;
+			case 's':
+				maxSteps = std::atoi(optarg);
+				break;
+			default:
+				usage(argv[0]);
+				return opt == 'h' ? 0 : 2;
+		}
+	}
+
+	if(threads < 1)
+		threads = 1;
+
+	Work work;
+	work.next = 0;
+	work.maxSteps = maxSteps;
+	pthread_mutex_init(&work.mutex, NULL);
+
+	try {
+		std::vector<std::string> maps;
+		if(optind < argc) {
+			maps.assign(argv + optind, argv + argc);
+		} else {
+			/* stejne jako v Menu */
+			std::string dataDir = INSTALL_DATADIR;
+			if(std::getenv("TOTEM_DESTROYER_DATADIR"))
+				dataDir = std::getenv("TOTEM_DESTROYER_DATADIR");
+
+			if(std::getenv("TOTEM_DESTROYER_MAPS"))
+				maps = listMaps(std::getenv("TOTEM_DESTROYER_MAPS"));
+			else
+				maps = listMaps(dataDir + "/maps");
+		}
+
+		work.results.resize(maps.size());
+		for(size_t i = 0; i != maps.size(); i++)
+			work.results[i].file = maps[i];
+	} catch(std::exception &e) {
+		std::cerr << e.what() << std::endl;
+		return 2;
+	}
+
+	if((size_t)threads > work.results.size())
+		threads = std::max<size_t>(work.results.size(), 1);
+
+	/* spusteni vlaken, hlavni vlakno pracuje taky. Kdyz vlakno nejde
+	 * spustit, pracuje se s temi co uz bezi. */
+	double start = now();
+	std::vector<pthread_t> pool(threads - 1);
+	for(size_t i = 0; i != pool.size(); i++) {
+		if(pthread_create(&pool[i], NULL, worker, &work) != 0) {
+			pool.resize(i);
+			threads = i + 1;
+			break;
+		}
+	}
+	worker(&work);
+	for(size_t i = 0; i != pool.size(); i++)
+		pthread_join(pool[i], NULL);
+	double wall = now() - start;
+
+	pthread_mutex_destroy(&work.mutex);
+
+	/* vypis vysledku */
+	int failed = 0;
+	double cpu = 0.0;
+	std::vector<Result>::const_iterator r;
+	for(r = work.results.begin(); r != work.results.end(); r++) {
+		std::cout << (r->ok ? "OK   " : "FAIL ") << r->file
+			<< "  steps=" << r->steps
+			<< "  time=" << std::fixed << std::setprecision(3) << r->time * 1000.0
+			<< "ms";
+		if(!r->name.empty())
+			std::cout << "  name=\"" << r->name << "\"";
+		if(!r->ok)
+			std::cout << "  error: " << r->error;
+		std::cout << std::endl;
+
+		cpu += r->cpu;
+		if(!r->ok)
+			failed++;
+	}
+
+	std::cout << work.results.size() << " maps, " << failed << " failed, "
+		<< threads << " threads, wall " << std::setprecision(3) << wall * 1000.0
+		<< "ms, cpu " << cpu * 1000.0 << "ms" << std::endl;
+
+	return failed ? 1 : 0;
+}